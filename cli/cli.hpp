@@ -39,6 +39,7 @@ struct Command {
     Function function;
 };
 
+extern const Command compile_command;
 extern const Command diff_command;
 extern const Command diff_state_command;
 extern const Command diff_images_command;
@@ -26,41 +26,92 @@
  *********************************************************************/
 
 #include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+#ifndef _WIN32
+#include <unistd.h> // for isatty()
+#endif
+
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include "cli.hpp"
+#include "cli_pager.hpp"
 #include "os_string.hpp"
 #include "os_process.hpp"
 #include "cli_resources.hpp"
 
-static const char *synopsis = "Identify differences between two traces.";
+#include "highlight.hpp"
+#include "trace_parser.hpp"
+#include "trace_callset.hpp"
+#include "trace_diff.hpp"
+#include "trace_dump.hpp"
 
-static os::String
-find_command(void)
-{
-    return findScript("tracediff.py");
-}
+
+static const char *synopsis = "Identify differences between two traces.";
 
 static void
 usage(void)
 {
-    os::String command = find_command();
+    std::cout
+        << "usage: apitrace diff [OPTIONS] TRACE TRACE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help               show this help message and exit\n"
+        "    -t, --tool=TOOL          diff tool: native, diff, sdiff, wdiff, or python\n"
+        "                             [default: native]\n"
+        "    -c, --calls=CALLSET      calls to compare [default: 0-10000]\n"
+        "    --ref-calls=CALLSET      calls to compare from reference trace\n"
+        "    --src-calls=CALLSET      calls to compare from source trace\n"
+        "    --call-nos               dump call numbers\n"
+        "    --suppress-common-lines  do not output common lines\n"
+        "    -w, --width=NUM          columns, for sdiff [default: auto]\n"
+        "\n"
+        "The native tool hashes calls and matches identical frames first, so it\n"
+        "scales to whole traces; the other tools dump the traces to text and are\n"
+        "run via tracediff.py.  Like tracediff.py, the native tool treats\n"
+        "glGetError calls which returned GL_NO_ERROR as junk, and leaves them out.\n"
+        "\n"
+    ;
+}
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
+enum {
+    REF_CALLS_OPT = CHAR_MAX + 1,
+    SRC_CALLS_OPT,
+    CALL_NOS_OPT,
+    SUPPRESS_COMMON_LINES_OPT,
+};
 
-    os::execute(args);
-}
+const static char *
+shortOptions = "ht:c:w:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"tool", required_argument, 0, 't'},
+    {"calls", required_argument, 0, 'c'},
+    {"ref-calls", required_argument, 0, REF_CALLS_OPT},
+    {"src-calls", required_argument, 0, SRC_CALLS_OPT},
+    {"call-nos", no_argument, 0, CALL_NOS_OPT},
+    {"suppress-common-lines", no_argument, 0, SUPPRESS_COMMON_LINES_OPT},
+    {"width", required_argument, 0, 'w'},
+    {0, 0, 0, 0}
+};
 
+
+/**
+ * Run tracediff.py for the external diff tools.
+ */
 static int
-command(int argc, char *argv[])
+scriptCommand(const std::vector<char *> &argv)
 {
-    int i;
-
-    os::String command = find_command();
+    os::String command = findScript("tracediff.py");
 
     os::String apitracePath = os::getProcessName();
 
@@ -69,7 +120,7 @@ command(int argc, char *argv[])
     args.push_back(command.str());
     args.push_back("--apitrace");
     args.push_back(apitracePath.str());
-    for (i = 1; i < argc; i++) {
+    for (size_t i = 1; i < argv.size(); i++) {
         args.push_back(argv[i]);
     }
     args.push_back(NULL);
@@ -77,6 +128,535 @@ command(int argc, char *argv[])
     return os::execute((char * const *)&args[0]);
 }
 
+
+/*
+ * Calls that vary from run to run regardless of the application, same as
+ * tracediff.py.
+ */
+static const char *
+ignoredFunctionNames[] = {
+    "glGetString",
+    "glXGetClientString",
+    "glXGetCurrentDisplay",
+    "glXGetCurrentContext",
+    "glXGetFBConfigAttrib",
+    "glXGetProcAddress",
+    "glXGetProcAddressARB",
+    "wglGetProcAddress",
+};
+
+
+/*
+ * Successful glGetError calls, which tracediff.py passes as isjunk to
+ * difflib, as applications often check errors in one run but not the other.
+ */
+static bool
+isJunk(const trace::Call &call)
+{
+    return call.ret &&
+           !call.ret->toBool() &&  // GL_NO_ERROR
+           strcmp(call.sig->name, "glGetError") == 0;
+}
+
+
+typedef std::unordered_set<unsigned> CallNoSet;
+
+
+/**
+ * Sequential reader of the calls being compared.
+ */
+class CallReader
+{
+    trace::Parser parser;
+    trace::CallSet calls;
+    std::vector<signed char> ignored;
+    const CallNoSet *junk;
+    bool done = false;
+
+public:
+    /**
+     * junk holds the numbers of further calls to skip, as they may not be
+     * recognizable when scanning.
+     */
+    CallReader(const char *callSet, const CallNoSet *_junk = NULL) :
+        calls(trace::FREQUENCY_ALL),
+        junk(_junk)
+    {
+        calls.merge(callSet);
+    }
+
+    bool
+    open(const char *filename) {
+        return parser.open(filename);
+    }
+
+    /**
+     * Return the next call, or NULL at the end.  When scan is true the
+     * call's arguments are not parsed.
+     */
+    trace::Call *
+    next(bool scan = false) {
+        while (!done) {
+            trace::Call *call = scan ? parser.scan_call() : parser.parse_call();
+            if (!call) {
+                done = true;
+                break;
+            }
+            if (call->no > calls.getLast()) {
+                delete call;
+                done = true;
+                break;
+            }
+            if (calls.contains(*call) &&
+                !isIgnored(call->sig) &&
+                !(junk && junk->count(call->no))) {
+                return call;
+            }
+            delete call;
+        }
+        return NULL;
+    }
+
+private:
+    bool
+    isIgnored(const trace::FunctionSig *sig) {
+        if (sig->id >= ignored.size()) {
+            ignored.resize(sig->id + 1, -1);
+        }
+        signed char &result = ignored[sig->id];
+        if (result < 0) {
+            result = 0;
+            for (auto name : ignoredFunctionNames) {
+                if (strcmp(sig->name, name) == 0) {
+                    result = 1;
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+};
+
+
+struct CallSequence
+{
+    std::vector<trace::CallHash> hashes;
+    std::vector<trace::CallHash> names;
+    std::vector<size_t> frames;
+    CallNoSet junk;
+    bool ok = false;
+};
+
+
+static void
+loadTrace(const char *filename, const char *callSet, CallSequence &seq)
+{
+    CallReader reader(callSet);
+    if (!reader.open(filename)) {
+        return;
+    }
+
+    trace::Call *call;
+    while ((call = reader.next())) {
+        if (isJunk(*call)) {
+            seq.junk.insert(call->no);
+            delete call;
+            continue;
+        }
+        seq.hashes.push_back(trace::hashCall(*call));
+        seq.names.push_back(trace::hashCallName(*call));
+        if (call->flags & trace::CALL_FLAG_END_FRAME) {
+            seq.frames.push_back(seq.hashes.size());
+        }
+        delete call;
+    }
+
+    seq.ok = true;
+}
+
+
+/**
+ * Print the edit script, re-reading both traces in lockstep, in the same
+ * format as tracediff.py's python differ.
+ */
+class DiffPrinter
+{
+    CallReader &a;
+    CallReader &b;
+    const CallSequence &aSeq;
+    const CallSequence &bSeq;
+
+    std::ostream &os;
+    const highlight::Highlighter &highlighter;
+    const highlight::Attribute &normal;
+    const highlight::Attribute &bold;
+    const highlight::Attribute &strike;
+    const highlight::Attribute &deleteColor;
+    const highlight::Attribute &insertColor;
+
+    bool callNos;
+    bool suppressCommonLines;
+    size_t aSpace = 0;
+    size_t bSpace = 0;
+
+    static const trace::DumpFlags dumpFlags =
+        trace::DUMP_FLAG_NO_COLOR |
+        trace::DUMP_FLAG_NO_CALL_NO |
+        trace::DUMP_FLAG_NO_MULTILINE;
+
+public:
+    DiffPrinter(CallReader &_a, const CallSequence &_aSeq,
+                CallReader &_b, const CallSequence &_bSeq,
+                std::ostream &_os, bool color,
+                bool _callNos, bool _suppressCommonLines) :
+        a(_a),
+        b(_b),
+        aSeq(_aSeq),
+        bSeq(_bSeq),
+        os(_os),
+        highlighter(highlight::defaultHighlighter(color)),
+        normal(highlighter.normal()),
+        bold(highlighter.bold()),
+        strike(highlighter.strike()),
+        deleteColor(highlighter.color(highlight::RED)),
+        insertColor(highlighter.color(highlight::GREEN)),
+        callNos(_callNos),
+        suppressCommonLines(_suppressCommonLines)
+    {
+    }
+
+    void
+    print(const trace::DiffScript &script) {
+        for (auto & op : script) {
+            switch (op.tag) {
+            case trace::DIFF_EQUAL:
+                equal(op.aEnd - op.aBegin);
+                break;
+            case trace::DIFF_DELETE:
+                remove(op.aEnd - op.aBegin);
+                break;
+            case trace::DIFF_INSERT:
+                insert(op.bEnd - op.bBegin);
+                break;
+            case trace::DIFF_REPLACE:
+                replace(op);
+                break;
+            }
+        }
+    }
+
+private:
+    void
+    replace(const trace::DiffOp &op) {
+        // Pair up calls to the same functions
+        std::vector<trace::CallHash> aNames(aSeq.names.begin() + op.aBegin,
+                                            aSeq.names.begin() + op.aEnd);
+        std::vector<trace::CallHash> bNames(bSeq.names.begin() + op.bBegin,
+                                            bSeq.names.begin() + op.bEnd);
+        trace::DiffScript script;
+        trace::diff(aNames, bNames, script);
+        for (auto & subop : script) {
+            size_t aCount = subop.aEnd - subop.aBegin;
+            size_t bCount = subop.bEnd - subop.bBegin;
+            switch (subop.tag) {
+            case trace::DIFF_EQUAL:
+                replaceSimilar(aCount);
+                break;
+            case trace::DIFF_DELETE:
+                remove(aCount);
+                break;
+            case trace::DIFF_INSERT:
+                insert(bCount);
+                break;
+            case trace::DIFF_REPLACE:
+                if (bCount < aCount) {
+                    insert(bCount);
+                    remove(aCount);
+                } else {
+                    remove(aCount);
+                    insert(bCount);
+                }
+                break;
+            }
+        }
+    }
+
+    void
+    equal(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            trace::Call *aCall = a.next(suppressCommonLines);
+            trace::Call *bCall = b.next(suppressCommonLines);
+            if (!suppressCommonLines && aCall && bCall) {
+                os << "  ";
+                dumpCallNos(aCall, bCall);
+                dumpCall(bCall);
+            }
+            delete aCall;
+            delete bCall;
+        }
+    }
+
+    void
+    remove(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            trace::Call *call = a.next();
+            if (call) {
+                os << "- ";
+                dumpCallNos(call, NULL);
+                os << strike << deleteColor;
+                dumpCall(call);
+                delete call;
+            }
+        }
+    }
+
+    void
+    insert(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            trace::Call *call = b.next();
+            if (call) {
+                os << "+ ";
+                dumpCallNos(NULL, call);
+                os << insertColor;
+                dumpCall(call);
+                delete call;
+            }
+        }
+    }
+
+    void
+    replaceSimilar(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            trace::Call *aCall = a.next();
+            trace::Call *bCall = b.next();
+            if (aCall && bCall) {
+                os << "| ";
+                dumpCallNos(aCall, bCall);
+                os << bold << bCall->sig->name << normal << "(";
+                size_t numArgs = std::max(aCall->args.size(), bCall->args.size());
+                const char *sep = "";
+                for (size_t j = 0; j < numArgs; ++j) {
+                    os << sep;
+                    replaceValue(argName(aCall, j), argName(bCall, j));
+                    os << " = ";
+                    replaceValue(argValue(aCall, j), argValue(bCall, j));
+                    sep = ", ";
+                }
+                os << ")";
+                if (aCall->ret || bCall->ret) {
+                    os << " = ";
+                    replaceValue(valueToString(aCall->ret), valueToString(bCall->ret));
+                }
+                os << "\n";
+            }
+            delete aCall;
+            delete bCall;
+        }
+    }
+
+    void
+    replaceValue(const std::string &aValue, const std::string &bValue) {
+        if (aValue == bValue) {
+            os << bValue;
+        } else {
+            os << strike << deleteColor << aValue << normal
+               << " -> "
+               << insertColor << bValue << normal;
+        }
+    }
+
+    static std::string
+    argName(const trace::Call *call, size_t index) {
+        if (index < call->args.size()) {
+            return call->sig->arg_names[index];
+        }
+        return std::string();
+    }
+
+    static std::string
+    argValue(const trace::Call *call, size_t index) {
+        if (index < call->args.size()) {
+            return valueToString(call->args[index].value);
+        }
+        return std::string();
+    }
+
+    static std::string
+    valueToString(trace::Value *value) {
+        if (!value) {
+            return "?";
+        }
+        std::ostringstream ss;
+        trace::dump(value, ss, dumpFlags);
+        return ss.str();
+    }
+
+    void
+    dumpCallNos(const trace::Call *aCall, const trace::Call *bCall) {
+        if (!callNos) {
+            return;
+        }
+
+        if (aCall && bCall && aCall->no == bCall->no) {
+            std::string no = std::to_string(aCall->no);
+            os << no << " ";
+            aSpace = bSpace = no.length();
+            return;
+        }
+
+        if (aCall) {
+            std::string no = std::to_string(aCall->no);
+            os << strike << deleteColor << no << normal;
+            aSpace = no.length();
+        } else {
+            os << std::string(aSpace, ' ');
+        }
+        os << " ";
+        if (bCall) {
+            std::string no = std::to_string(bCall->no);
+            os << insertColor << no << normal;
+            bSpace = no.length();
+        } else {
+            os << std::string(bSpace, ' ');
+        }
+        os << " ";
+    }
+
+    void
+    dumpCall(trace::Call *call) {
+        os << bold << call->sig->name << normal;
+        os << "(";
+        const char *sep = "";
+        for (size_t i = 0; i < call->args.size(); ++i) {
+            os << sep << call->sig->arg_names[i] << " = "
+               << valueToString(call->args[i].value);
+            sep = ", ";
+        }
+        os << ")";
+        if (call->ret) {
+            os << " = " << valueToString(call->ret);
+        }
+        os << normal << "\n";
+    }
+};
+
+
+static int
+command(int argc, char *argv[])
+{
+    // getopt may permute argv, so keep the original for tracediff.py
+    std::vector<char *> originalArgs(argv, argv + argc);
+
+    const char *tool = "native";
+    const char *calls = "0-10000";
+    const char *refCalls = NULL;
+    const char *srcCalls = NULL;
+    bool callNos = false;
+    bool suppressCommonLines = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 't':
+            tool = optarg;
+            break;
+        case 'c':
+            calls = optarg;
+            break;
+        case REF_CALLS_OPT:
+            refCalls = optarg;
+            break;
+        case SRC_CALLS_OPT:
+            srcCalls = optarg;
+            break;
+        case CALL_NOS_OPT:
+            callNos = true;
+            break;
+        case SUPPRESS_COMMON_LINES_OPT:
+            suppressCommonLines = true;
+            break;
+        case 'w':
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (strcmp(tool, "native") != 0) {
+        if (strcmp(tool, "diff") != 0 &&
+            strcmp(tool, "sdiff") != 0 &&
+            strcmp(tool, "wdiff") != 0 &&
+            strcmp(tool, "python") != 0) {
+            std::cerr << "error: unknown diff tool `" << tool << "`\n";
+            return 1;
+        }
+        return scriptCommand(originalArgs);
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: incorrect number of arguments\n";
+        usage();
+        return 1;
+    }
+
+    const char *refTrace = argv[optind];
+    const char *srcTrace = argv[optind + 1];
+    if (!refCalls) {
+        refCalls = calls;
+    }
+    if (!srcCalls) {
+        srcCalls = calls;
+    }
+
+    // Hash both traces in parallel
+    CallSequence refSeq;
+    CallSequence srcSeq;
+    std::thread refThread(loadTrace, refTrace, refCalls, std::ref(refSeq));
+    loadTrace(srcTrace, srcCalls, srcSeq);
+    refThread.join();
+
+    if (!refSeq.ok || !srcSeq.ok) {
+        return 1;
+    }
+
+    trace::DiffScript script;
+    trace::diff(refSeq.hashes, refSeq.frames,
+                srcSeq.hashes, srcSeq.frames,
+                script);
+
+    // Free what is no longer needed before reparsing
+    refSeq.hashes = std::vector<trace::CallHash>();
+    srcSeq.hashes = std::vector<trace::CallHash>();
+
+    bool color = false;
+#ifndef _WIN32
+    if (isatty(STDOUT_FILENO)) {
+        color = true;
+        pipepager();
+    }
+#endif
+
+    CallReader refReader(refCalls, &refSeq.junk);
+    CallReader srcReader(srcCalls, &srcSeq.junk);
+    if (!refReader.open(refTrace) ||
+        !srcReader.open(srcTrace)) {
+        return 1;
+    }
+
+    DiffPrinter printer(refReader, refSeq, srcReader, srcSeq,
+                        std::cout, color,
+                        callNos, suppressCommonLines);
+    printer.print(script);
+    std::cout << std::flush;
+
+    return 0;
+}
+
 const Command diff_command = {
     "diff",
     synopsis,
@@ -26,51 +26,406 @@
  *********************************************************************/
 
 #include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "cli.hpp"
 #include "os_string.hpp"
-#include "os_process.hpp"
-#include "cli_resources.hpp"
+#include "os_thread.hpp"
+#include "thread_pool.hpp"
+#include "image.hpp"
 
 static const char *synopsis = "Identify differences between two image dumps.";
 
-static os::String
-find_command(void)
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace diff-images [OPTIONS] REF_PREFIX SRC_PREFIX\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help           Show this help message and exit\n"
+        "    -v, --verbose        Verbose output\n"
+        "    -o, --output=FILE    Output filename [default: index.html]\n"
+        "    -f, --fuzz=FUZZ      Fuzz ratio [default: 0.05]\n"
+        "    -a, --alpha          Take alpha channel in consideration\n"
+        "        --overwrite      Overwrite images\n"
+        "        --show-all       Show all images, including similar ones\n"
+        "    -j, --jobs=N         Compare N images at a time [default: number of CPUs]\n"
+    ;
+}
+
+enum {
+    OVERWRITE_OPT = CHAR_MAX + 1,
+    SHOW_ALL_OPT,
+};
+
+const static char *
+shortOptions = "hvo:f:aj:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"verbose", no_argument, 0, 'v'},
+    {"output", required_argument, 0, 'o'},
+    {"fuzz", required_argument, 0, 'f'},
+    {"alpha", no_argument, 0, 'a'},
+    {"overwrite", no_argument, 0, OVERWRITE_OPT},
+    {"show-all", no_argument, 0, SHOW_ALL_OPT},
+    {"jobs", required_argument, 0, 'j'},
+    {0, 0, 0, 0}
+};
+
+
+static const unsigned thumbSize = 320;
+
+
+struct Surface {
+    std::string filename;
+    unsigned width = 0;
+    unsigned height = 0;
+};
+
+
+struct Result {
+    std::string name;
+
+    enum {
+        MATCH,
+        MISMATCH,
+        MISSING,
+    } status = MISSING;
+
+    image::Difference diff;
+
+    Surface ref;
+    Surface src;
+    Surface delta;
+};
+
+
+static bool
+endsWith(const std::string &s, const char *suffix)
 {
-    return findScript("snapdiff.py");
+    size_t len = strlen(suffix);
+    return s.length() >= len &&
+           s.compare(s.length() - len, len, suffix) == 0;
 }
 
+
+static bool
+isImage(const std::string &path)
+{
+    return endsWith(path, ".png") &&
+           !endsWith(path, ".diff.png") &&
+           !endsWith(path, ".thumb.png");
+}
+
+
 static void
-usage(void)
+findImages(const os::String &dir,
+           const std::string &base,
+           const std::string &prefix,
+           std::set<std::string> &images)
+{
+    std::vector<os::String> names;
+    if (!os::listDirectory(dir, names)) {
+        return;
+    }
+
+    for (auto & name : names) {
+        os::String path(base.c_str());
+        path.join(name);
+        if (path.isDirectory()) {
+            findImages(path, path.str(), prefix, images);
+        } else {
+            std::string filepath(path.str());
+            if (filepath.compare(0, prefix.length(), prefix) == 0 &&
+                isImage(filepath)) {
+                images.insert(filepath.substr(prefix.length()));
+            }
+        }
+    }
+}
+
+
+static void
+findImages(const std::string &prefix, std::set<std::string> &images)
 {
-    os::String command = find_command();
+    os::String dir(prefix.c_str());
+    if (!dir.isDirectory()) {
+        dir.trimFilename();
+        if (prefix.find_first_of("/\\") == std::string::npos) {
+            // Relative to the current directory
+            findImages(dir, "", prefix, images);
+            return;
+        }
+    }
+    findImages(dir, dir.str(), prefix, images);
+}
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
 
-    os::execute(args);
+static bool
+getModificationTime(const std::string &filename, time_t &mtime)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return false;
+    }
+    mtime = st.st_mtime;
+    return true;
 }
 
+
+struct Options {
+    double fuzz = 0.05;
+    bool alpha = false;
+    bool overwrite = false;
+    bool showAll = false;
+    unsigned threads = 0;
+};
+
+
+static void
+compareImages(const Options &options, Result *result)
+{
+    std::unique_ptr<image::Image> ref(image::readPNG(result->ref.filename.c_str()));
+    std::unique_ptr<image::Image> src(image::readPNG(result->src.filename.c_str()));
+    if (!ref || !src) {
+        result->status = Result::MISSING;
+        return;
+    }
+
+    result->ref.width = ref->width;
+    result->ref.height = ref->height;
+    result->src.width = src->width;
+    result->src.height = src->height;
+
+    image::CompareOptions compareOptions;
+    compareOptions.fuzz = options.fuzz;
+    compareOptions.alpha = options.alpha;
+    compareOptions.threads = options.threads;
+
+    // Whether a previously written delta image can be kept
+    const std::string &deltaFilename = result->delta.filename;
+    time_t deltaTime, refTime, srcTime;
+    bool deltaUpToDate =
+        !options.overwrite &&
+        getModificationTime(deltaFilename, deltaTime) &&
+        getModificationTime(result->ref.filename, refTime) &&
+        getModificationTime(result->src.filename, srcTime) &&
+        (deltaTime >= refTime || deltaTime >= srcTime);
+
+    // Only produce the heatmap upfront when it is sure to be written, as
+    // most pairs are expected to match
+    bool wantHeatmap = options.showAll && !deltaUpToDate;
+
+    image::Image *heatmap = NULL;
+    result->diff = image::compare(*ref, *src, compareOptions,
+                                  wantHeatmap ? &heatmap : NULL);
+    std::unique_ptr<image::Image> heatmapGuard(heatmap);
+    result->status = result->diff.ae == 0 ? Result::MATCH : Result::MISMATCH;
+
+    if ((result->status == Result::MATCH && !options.showAll) ||
+        result->diff.sizeMismatch) {
+        return;
+    }
+
+    result->delta.width = src->width;
+    result->delta.height = src->height;
+
+    if (deltaUpToDate) {
+        return;
+    }
+
+    if (!wantHeatmap) {
+        image::compare(*ref, *src, compareOptions, &heatmap);
+        heatmapGuard.reset(heatmap);
+    }
+
+    if (heatmap) {
+        heatmap->writePNG(deltaFilename.c_str());
+    }
+}
+
+
+static void
+writeSurface(std::ostream &html, const Surface &surface)
+{
+    html << "        <td><a href=\"" << surface.filename << "\"><img src=\"" << surface.filename << "\"";
+    if (surface.width && surface.height) {
+        unsigned width = surface.width;
+        unsigned height = surface.height;
+        if (width >= height) {
+            height = std::max(height * thumbSize / width, 1U);
+            width = thumbSize;
+        } else {
+            width = std::max(width * thumbSize / height, 1U);
+            height = thumbSize;
+        }
+        html << " width=\"" << width << "\" height=\"" << height << "\"";
+    }
+    html << "/></a></td>\n";
+}
+
+
 static int
 command(int argc, char *argv[])
 {
-    int i;
+    Options options;
+    bool verbose = false;
+    std::string output = "index.html";
+    unsigned jobs = std::max(std::thread::hardware_concurrency(), 1U);
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'v':
+            verbose = true;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'f':
+            options.fuzz = atof(optarg);
+            break;
+        case 'a':
+            options.alpha = true;
+            break;
+        case OVERWRITE_OPT:
+            options.overwrite = true;
+            break;
+        case SHOW_ALL_OPT:
+            options.showAll = true;
+            break;
+        case 'j':
+            jobs = std::max(atoi(optarg), 1);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: incorrect number of arguments\n";
+        usage();
+        return 1;
+    }
+
+    std::string refPrefix = argv[optind];
+    std::string srcPrefix = argv[optind + 1];
+
+    std::set<std::string> images;
+    findImages(refPrefix, images);
+    findImages(srcPrefix, images);
+
+    std::vector<Result> results(images.size());
 
-    os::String command = find_command();
+    {
+        // When comparing several images at a time, there's no point in
+        // splitting each image among threads as well.
+        options.threads = jobs > 1 ? 1 : 0;
 
-    std::vector<const char *> args;
-    args.push_back(APITRACE_PYTHON_EXECUTABLE);
-    args.push_back(command.str());
-    for (i = 1; i < argc; i++) {
-        args.push_back(argv[i]);
+        ThreadPool pool(jobs);
+
+        size_t i = 0;
+        for (auto & image : images) {
+            Result *result = &results[i++];
+            result->name = image;
+            result->ref.filename = refPrefix + image;
+            result->src.filename = srcPrefix + image;
+            result->delta.filename = result->src.filename.substr(0, result->src.filename.length() - 4) + ".diff.png";
+
+            if (os::String(result->ref.filename.c_str()).exists() &&
+                os::String(result->src.filename.c_str()).exists()) {
+                pool.enqueue(compareImages, std::cref(options), result);
+            }
+        }
+
+        // ~ThreadPool waits for all comparisons to finish
     }
-    args.push_back(NULL);
 
-    return os::execute((char * const *)&args[0]);
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output.c_str());
+        if (!file) {
+            std::cerr << "error: failed to open " << output << "\n";
+            return 1;
+        }
+    }
+    std::ostream &html = output.empty() ? std::cout : file;
+
+    html << "<html>\n";
+    html << "  <body>\n";
+    html << "    <table border=\"1\">\n";
+    html << "      <tr><th>File</th><th>" << refPrefix << "</th><th>" << srcPrefix << "</th><th>&Delta;</th></tr>\n";
+
+    unsigned failures = 0;
+    for (auto & result : results) {
+        const char *status;
+        const char *bgcolor;
+        switch (result.status) {
+        case Result::MATCH:
+            status = "MATCH";
+            bgcolor = "#20ff20";
+            break;
+        case Result::MISMATCH:
+            status = "MISMATCH";
+            bgcolor = "#ff2020";
+            ++failures;
+            break;
+        case Result::MISSING:
+        default:
+            status = "MISSING";
+            bgcolor = "#ff2020";
+            ++failures;
+            break;
+        }
+
+        if (verbose) {
+            std::cout << "Comparing " << result.ref.filename << " and " << result.src.filename << " ... " << status;
+            if (result.status == Result::MISMATCH) {
+                if (result.diff.sizeMismatch) {
+                    std::cout << " (size mismatch)";
+                } else {
+                    std::cout << " (max " << result.diff.maxDiff
+                              << ", mean " << result.diff.meanDiff
+                              << ", PSNR " << result.diff.psnr << " dB"
+                              << ", " << result.diff.ae << " pixels)";
+                }
+            }
+            std::cout << "\n";
+        }
+
+        html << "      <tr>\n";
+        html << "        <td bgcolor=\"" << bgcolor << "\"><a href=\"" << result.ref.filename << "\">" << result.name << "<a/></td>\n";
+        if (result.status != Result::MATCH || options.showAll) {
+            writeSurface(html, result.ref);
+            writeSurface(html, result.src);
+            writeSurface(html, result.delta);
+        }
+        html << "      </tr>\n";
+    }
+
+    html << "    </table>\n";
+    html << "  </body>\n";
+    html << "</html>\n";
+
+    return failures ? 1 : 0;
 }
 
 const Command diff_images_command = {
@@ -25,52 +25,1986 @@
  *
  *********************************************************************/
 
+/*
+ * Native differ for state dumps, as produced by glretrace -D.
+ *
+ * Both documents (JSON or UBJSON) are read into lightweight trees, in
+ * parallel.  Large strings and image data are hashed while reading and only
+ * their digest and file offset is kept, so memory usage depends on the amount
+ * of state, not on the size of the textures and framebuffers in it.  Payloads
+ * are re-read from disk, two at a time, only when they need to be compared
+ * pixel by pixel or printed.
+ *
+ * The output format is the same as scripts/jsondiff.py.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h> // for CHAR_MAX
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "cli.hpp"
-#include "os_string.hpp"
-#include "os_process.hpp"
-#include "cli_resources.hpp"
+#include "image.hpp"
+#include "trace_diff.hpp"
+#include "ubjson.hpp"
+
 
 static const char *synopsis = "Identify differences between two state dumps.";
 
-static os::String
-find_command(void)
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace diff-state [OPTIONS] REF_STATE SRC_STATE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help               show this help message and exit\n"
+        "    --ignore-added           ignore added state\n"
+        "    --keep-images            compare images\n"
+        "    --image-tolerance=N      maximum difference of any pixel channel, in\n"
+        "                             [0, 255], for images to compare equal [default: 0]\n"
+        "    -f, --fuzz=FUZZ          fuzz ratio for image comparisons [default: 0.05]\n"
+        "    -a, --alpha              take alpha channel in consideration\n"
+        "\n"
+        "State dumps may be in either JSON or UBJSON format.\n"
+        "\n"
+    ;
+}
+
+enum {
+    IGNORE_ADDED_OPT = CHAR_MAX + 1,
+    KEEP_IMAGES_OPT,
+    IMAGE_TOLERANCE_OPT,
+};
+
+const static char *
+shortOptions = "haf:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"ignore-added", no_argument, 0, IGNORE_ADDED_OPT},
+    {"keep-images", no_argument, 0, KEEP_IMAGES_OPT},
+    {"image-tolerance", required_argument, 0, IMAGE_TOLERANCE_OPT},
+    {"fuzz", required_argument, 0, 'f'},
+    {"alpha", no_argument, 0, 'a'},
+    {0, 0, 0, 0}
+};
+
+
+// Strings longer than this are hashed instead of kept in memory
+static const size_t STRING_INLINE_MAX = 4096;
+
+
+namespace {
+
+
+/**
+ * Content that is not kept in memory, but can be re-read when needed.
+ */
+struct Payload
+{
+    image::Digest digest;
+
+    // Size in bytes, after decoding
+    uint64_t size = 0;
+
+    // Offset of the encoded data in the file
+    uint64_t offset = 0;
+};
+
+
+struct Node
+{
+    enum Type : unsigned char {
+        TYPE_NULL = 0,
+        TYPE_BOOL,
+        TYPE_INT,
+        TYPE_FLOAT,
+        TYPE_STRING,
+        TYPE_BLOB,
+        TYPE_ARRAY,
+        TYPE_OBJECT,
+    };
+
+    typedef std::pair<std::string, Node> Member;
+
+    Type type = TYPE_NULL;
+
+    // Whether a string's contents were replaced by its payload
+    bool digested = false;
+
+    union {
+        bool b;
+        long long i;
+        double f;
+    };
+
+    std::string str;
+    std::unique_ptr<Payload> payload;
+    std::vector<Node> elements;
+    std::vector<Member> members;
+
+    Node() : i(0) {}
+
+    bool
+    isString(void) const {
+        return type == TYPE_STRING;
+    }
+
+    bool
+    isNumber(void) const {
+        return type == TYPE_INT || type == TYPE_FLOAT;
+    }
+
+    double
+    toDouble(void) const {
+        return type == TYPE_INT ? (double)i : f;
+    }
+
+    void
+    sortMembers(void) {
+        std::stable_sort(members.begin(), members.end(),
+                         [] (const Member &a, const Member &b) {
+                             return a.first < b.first;
+                         });
+    }
+
+    // Members must be sorted
+    const Node *
+    member(const std::string &name) const {
+        auto it = std::lower_bound(members.begin(), members.end(), name,
+                                   [] (const Member &m, const std::string &n) {
+                                       return m.first < n;
+                                   });
+        if (it != members.end() && it->first == name) {
+            return &it->second;
+        }
+        return NULL;
+    }
+
+    bool
+    isImage(void) const {
+        if (type != TYPE_OBJECT) {
+            return false;
+        }
+        const Node *cls = member("__class__");
+        return cls && cls->isString() && cls->str == "image";
+    }
+};
+
+
+/**
+ * Buffered file input which keeps track of the offset.
+ */
+class InputFile
+{
+    FILE *fp = NULL;
+    unsigned char buf[64*1024];
+    size_t pos = 0;
+    size_t len = 0;
+    uint64_t base = 0;
+
+public:
+    ~InputFile() {
+        if (fp) {
+            fclose(fp);
+        }
+    }
+
+    bool
+    open(const char *filename) {
+        fp = fopen(filename, "rb");
+        return fp != NULL;
+    }
+
+    inline int
+    peek(void) {
+        if (pos == len && !fill()) {
+            return EOF;
+        }
+        return buf[pos];
+    }
+
+    inline int
+    get(void) {
+        if (pos == len && !fill()) {
+            return EOF;
+        }
+        return buf[pos++];
+    }
+
+    bool
+    read(void *dst, size_t size) {
+        unsigned char *p = static_cast<unsigned char *>(dst);
+        while (size) {
+            if (pos == len && !fill()) {
+                return false;
+            }
+            size_t n = std::min(size, len - pos);
+            memcpy(p, buf + pos, n);
+            pos += n;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    // Feed the next size bytes to a callback, without copying them
+    template< class Sink >
+    bool
+    stream(uint64_t size, Sink sink) {
+        while (size) {
+            if (pos == len && !fill()) {
+                return false;
+            }
+            size_t n = (size_t)std::min<uint64_t>(size, len - pos);
+            sink(buf + pos, n);
+            pos += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    // Feed string characters up to the next quote or backslash to a callback
+    template< class Sink >
+    void
+    streamString(Sink sink) {
+        for (;;) {
+            if (pos == len && !fill()) {
+                return;
+            }
+            const unsigned char *start = buf + pos;
+            const unsigned char *end = buf + len;
+            const unsigned char *p = start;
+            while (p < end && *p != '"' && *p != '\\') {
+                ++p;
+            }
+            if (p != start) {
+                sink((const char *)start, p - start);
+            }
+            pos = p - buf;
+            if (p != end) {
+                return;
+            }
+        }
+    }
+
+    inline uint64_t
+    tell(void) const {
+        return base + pos;
+    }
+
+    bool
+    seek(uint64_t offset) {
+#ifdef _WIN32
+        int ret = _fseeki64(fp, offset, SEEK_SET);
+#else
+        int ret = fseeko(fp, offset, SEEK_SET);
+#endif
+        if (ret != 0) {
+            return false;
+        }
+        base = offset;
+        pos = len = 0;
+        return true;
+    }
+
+private:
+    bool
+    fill(void) {
+        base += len;
+        pos = 0;
+        len = fread(buf, 1, sizeof buf, fp);
+        return len > 0;
+    }
+};
+
+
+/**
+ * Incremental base64 decoder.
+ */
+class Base64Decoder
+{
+    unsigned bits = 0;
+    unsigned count = 0;
+
+public:
+    template< class Sink >
+    void
+    decode(const char *s, size_t n, Sink sink) {
+        const signed char *lut = table();
+        unsigned char out[4096];
+        size_t outLen = 0;
+        for (size_t j = 0; j < n; ++j) {
+            int v = lut[(unsigned char)s[j]];
+            if (v < 0) {
+                continue;
+            }
+            bits = (bits << 6) | v;
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                out[outLen++] = (bits >> count) & 0xff;
+                if (outLen == sizeof out) {
+                    sink(out, outLen);
+                    outLen = 0;
+                }
+            }
+        }
+        if (outLen) {
+            sink(out, outLen);
+        }
+    }
+
+private:
+    static const signed char *
+    table(void) {
+        // Function-local statics are initialized thread-safely
+        static const struct Table {
+            signed char lut[256];
+            Table() {
+                for (unsigned c = 0; c < 256; ++c) {
+                    lut[c] = value((char)c);
+                }
+            }
+        } t;
+        return t.lut;
+    }
+
+    static int
+    value(char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        // Padding and whitespace
+        return -1;
+    }
+};
+
+
+/**
+ * Accumulates a string, switching to hashing once it gets too long.
+ */
+class StringBuilder
+{
+    Node &node;
+    image::Hasher hasher;
+    uint64_t size = 0;
+
+public:
+    StringBuilder(Node &_node) :
+        node(_node)
+    {
+        node.type = Node::TYPE_STRING;
+        node.str.clear();
+    }
+
+    inline void
+    append(const char *s, size_t n) {
+        size += n;
+        if (!node.digested) {
+            node.str.append(s, n);
+            if (node.str.size() <= STRING_INLINE_MAX) {
+                return;
+            }
+            node.digested = true;
+            hasher.update(node.str.data(), node.str.size());
+            node.str = std::string();
+            return;
+        }
+        hasher.update(s, n);
+    }
+
+    void
+    finish(uint64_t offset) {
+        if (node.digested) {
+            node.payload.reset(new Payload);
+            node.payload->digest = hasher.digest();
+            node.payload->size = size;
+            node.payload->offset = offset;
+        }
+    }
+};
+
+
+/**
+ * Reads a state dump one member of the root object at a time, like
+ * gui/qubjson.h's UBJSONObjectReader, so that only the state being compared
+ * needs to be kept in memory.
+ */
+class DocumentReader
+{
+protected:
+    InputFile file;
+    std::string error;
+    bool begun = false;
+    bool ended = false;
+
+public:
+    virtual ~DocumentReader() {}
+
+    bool
+    open(const char *filename) {
+        if (!file.open(filename)) {
+            error = strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Read the next member of the root object, returning false once there
+     * are no more members or on error.
+     */
+    virtual bool
+    readMember(std::string &name, Node &value) = 0;
+
+    /**
+     * Re-read the full contents of a digested string or blob, without
+     * disturbing the position of readMember().
+     */
+    bool
+    readPayload(const Node &node, std::string &data) {
+        assert(node.payload);
+        data.clear();
+        uint64_t position = file.tell();
+        if (!file.seek(node.payload->offset)) {
+            return fail("seek failed");
+        }
+        bool ok = readPayloadData(node, data);
+        if (!file.seek(position)) {
+            ended = true;
+            return fail("seek failed");
+        }
+        return ok;
+    }
+
+    const std::string &
+    getError(void) const {
+        return error;
+    }
+
+protected:
+    virtual bool
+    readPayloadData(const Node &node, std::string &data) = 0;
+
+    bool
+    fail(const char *message) {
+        if (error.empty()) {
+            std::ostringstream ss;
+            ss << "offset " << file.tell() << ": " << message;
+            error = ss.str();
+        }
+        return false;
+    }
+};
+
+
+class JSONReader : public DocumentReader
+{
+public:
+    bool
+    readMember(std::string &name, Node &value) override {
+        if (ended) {
+            return false;
+        }
+        bool more = true;
+        if (!begun) {
+            begun = true;
+            skipSpace();
+            if (file.get() != '{') {
+                ended = true;
+                return fail("expected object");
+            }
+            skipSpace();
+            if (file.peek() == '}') {
+                file.get();
+                more = false;
+            }
+        } else if (!parseSeparator('}', more)) {
+            ended = true;
+            return false;
+        }
+        if (!more) {
+            ended = true;
+            skipSpace();
+            if (file.peek() != EOF) {
+                fail("trailing garbage");
+            }
+            return false;
+        }
+        value = Node();
+        if (!parseMember(name, value)) {
+            ended = true;
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    bool
+    readPayloadData(const Node &node, std::string &data) override {
+        if (node.type == Node::TYPE_BLOB) {
+            Base64Decoder decoder;
+            return parseChars([&] (const char *s, size_t n) {
+                decoder.decode(s, n, [&] (const unsigned char *b, size_t m) {
+                    data.append((const char *)b, m);
+                });
+            });
+        }
+        return parseChars([&] (const char *s, size_t n) {
+            data.append(s, n);
+        });
+    }
+
+private:
+    void
+    skipSpace(void) {
+        for (;;) {
+            int c = file.peek();
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                file.get();
+            } else if (c == '/') {
+                // Non-standard comments
+                file.get();
+                if (file.get() != '/') {
+                    return;
+                }
+                do {
+                    c = file.get();
+                } while (c != '\n' && c != EOF);
+            } else {
+                return;
+            }
+        }
+    }
+
+    bool
+    expect(const char *literal) {
+        for (const char *p = literal; *p; ++p) {
+            if (file.get() != *p) {
+                return fail("invalid literal");
+            }
+        }
+        return true;
+    }
+
+    bool
+    parseValue(Node &node, bool blob) {
+        skipSpace();
+        int c = file.peek();
+        switch (c) {
+        case '{':
+            return parseObject(node);
+        case '[':
+            return parseArray(node);
+        case '"':
+            file.get();
+            return blob ? parseBlob(node) : parseString(node);
+        case 't':
+            node.type = Node::TYPE_BOOL;
+            node.b = true;
+            return expect("true");
+        case 'f':
+            node.type = Node::TYPE_BOOL;
+            node.b = false;
+            return expect("false");
+        case 'n':
+            node.type = Node::TYPE_NULL;
+            return expect("null");
+        case 'N':
+            node.type = Node::TYPE_FLOAT;
+            node.f = NAN;
+            return expect("NaN");
+        case 'I':
+            node.type = Node::TYPE_FLOAT;
+            node.f = INFINITY;
+            return expect("Infinity");
+        case EOF:
+            return fail("unexpected end of file");
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                return parseNumber(node);
+            }
+            return fail("unexpected character");
+        }
+    }
+
+    bool
+    parseObject(Node &node) {
+        file.get();
+        node.type = Node::TYPE_OBJECT;
+        skipSpace();
+        if (file.peek() == '}') {
+            file.get();
+            return true;
+        }
+        bool more = true;
+        while (more) {
+            node.members.emplace_back();
+            Node::Member &member = node.members.back();
+            if (!parseMember(member.first, member.second) ||
+                !parseSeparator('}', more)) {
+                return false;
+            }
+        }
+        node.sortMembers();
+        return true;
+    }
+
+    bool
+    parseMember(std::string &name, Node &value) {
+        skipSpace();
+        if (file.get() != '"') {
+            return fail("expected member name");
+        }
+        name.clear();
+        if (!parseChars([&] (const char *s, size_t n) { name.append(s, n); })) {
+            return false;
+        }
+        skipSpace();
+        if (file.get() != ':') {
+            return fail("expected ':'");
+        }
+        // Only images have blobs, which JSON encodes as base64
+        return parseValue(value, name == "__data__");
+    }
+
+    bool
+    parseSeparator(int end, bool &more) {
+        skipSpace();
+        int c = file.get();
+        more = c == ',';
+        return more || c == end ||
+               fail(end == '}' ? "expected ',' or '}'" : "expected ',' or ']'");
+    }
+
+    bool
+    parseArray(Node &node) {
+        file.get();
+        node.type = Node::TYPE_ARRAY;
+        skipSpace();
+        if (file.peek() == ']') {
+            file.get();
+            return true;
+        }
+        bool more = true;
+        while (more) {
+            node.elements.emplace_back();
+            if (!parseValue(node.elements.back(), false) ||
+                !parseSeparator(']', more)) {
+                return false;
+            }
+        }
+        node.elements.shrink_to_fit();
+        return true;
+    }
+
+    bool
+    parseNumber(Node &node) {
+        char buf[64];
+        size_t len = 0;
+        bool isFloat = false;
+        for (;;) {
+            int c = file.peek();
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+') {
+            } else if (c == '.' || c == 'e' || c == 'E') {
+                isFloat = true;
+            } else if (c == 'I' && len == 1 && buf[0] == '-') {
+                node.type = Node::TYPE_FLOAT;
+                node.f = -INFINITY;
+                return expect("Infinity");
+            } else {
+                break;
+            }
+            if (len + 1 >= sizeof buf) {
+                return fail("number too long");
+            }
+            buf[len++] = (char)file.get();
+        }
+        buf[len] = 0;
+
+        if (!isFloat) {
+            errno = 0;
+            node.type = Node::TYPE_INT;
+            node.i = strtoll(buf, NULL, 10);
+            if (errno != ERANGE) {
+                return true;
+            }
+        }
+        node.type = Node::TYPE_FLOAT;
+        node.f = strtod(buf, NULL);
+        return true;
+    }
+
+    /**
+     * Parse the characters of a string, after the opening quote, decoding
+     * escapes into UTF-8.
+     */
+    template< class Sink >
+    bool
+    parseChars(Sink sink) {
+        unsigned highSurrogate = 0;
+        for (;;) {
+            file.streamString(sink);
+            int c = file.get();
+            if (c == '"') {
+                return true;
+            }
+            if (c == EOF) {
+                return fail("unterminated string");
+            }
+            assert(c == '\\');
+
+            char chunk[4];
+            size_t n = 1;
+            c = file.get();
+            switch (c) {
+            case 'b': chunk[0] = '\b'; break;
+            case 'f': chunk[0] = '\f'; break;
+            case 'n': chunk[0] = '\n'; break;
+            case 'r': chunk[0] = '\r'; break;
+            case 't': chunk[0] = '\t'; break;
+            case 'u':
+                {
+                    char hex[5] = {0};
+                    for (unsigned j = 0; j < 4; ++j) {
+                        hex[j] = (char)file.get();
+                    }
+                    unsigned cp = strtoul(hex, NULL, 16);
+                    if (cp >= 0xd800 && cp < 0xdc00) {
+                        highSurrogate = cp;
+                        continue;
+                    }
+                    if (cp >= 0xdc00 && cp < 0xe000 && highSurrogate) {
+                        cp = 0x10000 + ((highSurrogate - 0xd800) << 10) + (cp - 0xdc00);
+                    }
+                    highSurrogate = 0;
+                    n = encodeUTF8(cp, chunk);
+                }
+                break;
+            case EOF:
+                return fail("unterminated string");
+            default:
+                chunk[0] = (char)c;
+                break;
+            }
+            sink(chunk, n);
+        }
+    }
+
+    static size_t
+    encodeUTF8(unsigned cp, char *out) {
+        if (cp < 0x80) {
+            out[0] = (char)cp;
+            return 1;
+        }
+        if (cp < 0x800) {
+            out[0] = (char)(0xc0 | (cp >> 6));
+            out[1] = (char)(0x80 | (cp & 0x3f));
+            return 2;
+        }
+        if (cp < 0x10000) {
+            out[0] = (char)(0xe0 | (cp >> 12));
+            out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+            out[2] = (char)(0x80 | (cp & 0x3f));
+            return 3;
+        }
+        out[0] = (char)(0xf0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[3] = (char)(0x80 | (cp & 0x3f));
+        return 4;
+    }
+
+    bool
+    parseString(Node &node) {
+        uint64_t offset = file.tell();
+        StringBuilder builder(node);
+        if (!parseChars([&] (const char *s, size_t n) { builder.append(s, n); })) {
+            return false;
+        }
+        builder.finish(offset);
+        return true;
+    }
+
+    bool
+    parseBlob(Node &node) {
+        node.type = Node::TYPE_BLOB;
+        node.payload.reset(new Payload);
+        node.payload->offset = file.tell();
+        image::Hasher hasher;
+        Base64Decoder decoder;
+        uint64_t size = 0;
+        bool ok = parseChars([&] (const char *s, size_t n) {
+            decoder.decode(s, n, [&] (const unsigned char *b, size_t m) {
+                hasher.update(b, m);
+                size += m;
+            });
+        });
+        node.payload->digest = hasher.digest();
+        node.payload->size = size;
+        return ok;
+    }
+};
+
+
+class UBJSONReader : public DocumentReader
 {
-    return findScript("jsondiff.py");
+    // Optimized container header of the root object
+    int rootType = 0;
+    long long rootCount = -1;
+
+public:
+    bool
+    readMember(std::string &name, Node &value) override {
+        if (ended) {
+            return false;
+        }
+        if (!begun) {
+            begun = true;
+            if (readMarker() != ubjson::MARKER_OBJECT_BEGIN) {
+                ended = true;
+                return fail("expected object");
+            }
+            if (!parseContainerHeader(rootType, rootCount)) {
+                ended = true;
+                return false;
+            }
+        }
+        if (rootCount == 0 || (rootCount < 0 && atObjectEnd())) {
+            ended = true;
+            return false;
+        }
+        if (rootCount > 0) {
+            --rootCount;
+        }
+        value = Node();
+        if (!readName(name) ||
+            !parseValue(value, rootType ? rootType : readMarker())) {
+            ended = true;
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    bool
+    readPayloadData(const Node &node, std::string &data) override {
+        data.resize(node.payload->size);
+        return data.empty() ||
+               file.read(&data[0], data.size()) ||
+               fail("unexpected end of file");
+    }
+
+private:
+    int
+    readMarker(void) {
+        int c;
+        do {
+            c = file.get();
+        } while (c == ubjson::MARKER_NOOP);
+        return c;
+    }
+
+    template< typename T >
+    bool
+    readRaw(T &value) {
+        return file.read(&value, sizeof value) ||
+               fail("unexpected end of file");
+    }
+
+    bool
+    readInt(int marker, long long &value) {
+        switch (marker) {
+        case ubjson::MARKER_INT8:
+            {
+                int c = file.get();
+                value = (signed char)c;
+                return c != EOF || fail("unexpected end of file");
+            }
+        case ubjson::MARKER_UINT8:
+            {
+                int c = file.get();
+                value = (unsigned char)c;
+                return c != EOF || fail("unexpected end of file");
+            }
+        case ubjson::MARKER_INT16:
+            {
+                uint16_t u = 0;
+                if (!readRaw(u)) {
+                    return false;
+                }
+                value = (int16_t)ubjson::bigEndian16(u);
+                return true;
+            }
+        case ubjson::MARKER_INT32:
+            {
+                uint32_t u = 0;
+                if (!readRaw(u)) {
+                    return false;
+                }
+                value = (int32_t)ubjson::bigEndian32(u);
+                return true;
+            }
+        case ubjson::MARKER_INT64:
+            {
+                uint64_t u = 0;
+                if (!readRaw(u)) {
+                    return false;
+                }
+                value = (int64_t)ubjson::bigEndian64(u);
+                return true;
+            }
+        default:
+            return fail("expected integer");
+        }
+    }
+
+    bool
+    readLength(uint64_t &length) {
+        long long value = 0;
+        if (!readInt(readMarker(), value)) {
+            return false;
+        }
+        if (value < 0) {
+            return fail("negative length");
+        }
+        length = value;
+        return true;
+    }
+
+    bool
+    readName(std::string &name) {
+        uint64_t length = 0;
+        if (!readLength(length)) {
+            return false;
+        }
+        name.resize(length);
+        return length == 0 ||
+               file.read(&name[0], length) ||
+               fail("unexpected end of file");
+    }
+
+    bool
+    parseString(Node &node) {
+        uint64_t length = 0;
+        if (!readLength(length)) {
+            return false;
+        }
+        uint64_t offset = file.tell();
+        StringBuilder builder(node);
+        if (!file.stream(length, [&] (const unsigned char *s, size_t n) {
+                builder.append((const char *)s, n);
+            })) {
+            return fail("unexpected end of file");
+        }
+        builder.finish(offset);
+        return true;
+    }
+
+    /**
+     * Parse the optimized container header, if any.
+     */
+    bool
+    parseContainerHeader(int &type, long long &count) {
+        type = 0;
+        count = -1;
+        if (file.peek() == ubjson::MARKER_TYPE) {
+            file.get();
+            type = file.get();
+            if (file.peek() != ubjson::MARKER_COUNT) {
+                return fail("typed container without count");
+            }
+        }
+        if (file.peek() == ubjson::MARKER_COUNT) {
+            file.get();
+            uint64_t length = 0;
+            if (!readLength(length)) {
+                return false;
+            }
+            count = (long long)length;
+        }
+        return true;
+    }
+
+    bool
+    parseArray(Node &node) {
+        int type;
+        long long count;
+        if (!parseContainerHeader(type, count)) {
+            return false;
+        }
+
+        if (type == ubjson::MARKER_UINT8 || type == ubjson::MARKER_INT8) {
+            // Binary data
+            node.type = Node::TYPE_BLOB;
+            node.payload.reset(new Payload);
+            node.payload->offset = file.tell();
+            node.payload->size = count;
+            image::Hasher hasher;
+            if (!file.stream(count, [&] (const unsigned char *b, size_t n) {
+                    hasher.update(b, n);
+                })) {
+                return fail("unexpected end of file");
+            }
+            node.payload->digest = hasher.digest();
+            return true;
+        }
+
+        node.type = Node::TYPE_ARRAY;
+        if (count >= 0) {
+            node.elements.resize(count);
+            for (auto & element : node.elements) {
+                if (!parseValue(element, type ? type : readMarker())) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        for (;;) {
+            int marker = readMarker();
+            if (marker == ubjson::MARKER_ARRAY_END) {
+                break;
+            }
+            node.elements.emplace_back();
+            if (!parseValue(node.elements.back(), marker)) {
+                return false;
+            }
+        }
+        node.elements.shrink_to_fit();
+        return true;
+    }
+
+    /**
+     * Consume the end marker of an object without count, if it is next.
+     */
+    bool
+    atObjectEnd(void) {
+        // Names have no marker, so peek for the end
+        while (file.peek() == ubjson::MARKER_NOOP) {
+            file.get();
+        }
+        if (file.peek() == ubjson::MARKER_OBJECT_END) {
+            file.get();
+            return true;
+        }
+        return false;
+    }
+
+    bool
+    parseObject(Node &node) {
+        int type;
+        long long count;
+        if (!parseContainerHeader(type, count)) {
+            return false;
+        }
+
+        node.type = Node::TYPE_OBJECT;
+        for (long long j = 0; count < 0 || j < count; ++j) {
+            if (count < 0 && atObjectEnd()) {
+                break;
+            }
+            std::string name;
+            if (!readName(name)) {
+                return false;
+            }
+            node.members.emplace_back(name, Node());
+            if (!parseValue(node.members.back().second, type ? type : readMarker())) {
+                return false;
+            }
+        }
+        node.sortMembers();
+        return true;
+    }
+
+    bool
+    parseValue(Node &node, int marker) {
+        switch (marker) {
+        case ubjson::MARKER_NULL:
+            node.type = Node::TYPE_NULL;
+            return true;
+        case ubjson::MARKER_TRUE:
+        case ubjson::MARKER_FALSE:
+            node.type = Node::TYPE_BOOL;
+            node.b = marker == ubjson::MARKER_TRUE;
+            return true;
+        case ubjson::MARKER_INT8:
+        case ubjson::MARKER_UINT8:
+        case ubjson::MARKER_INT16:
+        case ubjson::MARKER_INT32:
+        case ubjson::MARKER_INT64:
+            node.type = Node::TYPE_INT;
+            return readInt(marker, node.i);
+        case ubjson::MARKER_FLOAT32:
+            {
+                ubjson::Float32 u;
+                if (!readRaw(u.i)) {
+                    return false;
+                }
+                u.i = ubjson::bigEndian32(u.i);
+                node.type = Node::TYPE_FLOAT;
+                node.f = u.f;
+                return true;
+            }
+        case ubjson::MARKER_FLOAT64:
+            {
+                ubjson::Float64 u;
+                if (!readRaw(u.i)) {
+                    return false;
+                }
+                u.i = ubjson::bigEndian64(u.i);
+                node.type = Node::TYPE_FLOAT;
+                node.f = u.f;
+                return true;
+            }
+        case ubjson::MARKER_HIGH_PRECISION:
+            {
+                Node number;
+                if (!parseString(number) || number.digested) {
+                    return fail("invalid high precision number");
+                }
+                node.type = Node::TYPE_FLOAT;
+                node.f = strtod(number.str.c_str(), NULL);
+                return true;
+            }
+        case ubjson::MARKER_CHAR:
+            {
+                int c = file.get();
+                if (c == EOF) {
+                    return fail("unexpected end of file");
+                }
+                node.type = Node::TYPE_STRING;
+                node.str = std::string(1, (char)c);
+                return true;
+            }
+        case ubjson::MARKER_STRING:
+            return parseString(node);
+        case ubjson::MARKER_ARRAY_BEGIN:
+            return parseArray(node);
+        case ubjson::MARKER_OBJECT_BEGIN:
+            return parseObject(node);
+        case EOF:
+            return fail("unexpected end of file");
+        default:
+            return fail("unexpected marker");
+        }
+    }
+};
+
+
+static DocumentReader *
+openDocument(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        std::cerr << "error: " << filename << ": " << strerror(errno) << "\n";
+        return NULL;
+    }
+
+    // UBJSON state dumps start with an object marker immediately followed
+    // by a length marker, whereas JSON must have a quote or whitespace
+    int c0 = fgetc(fp);
+    int c1 = fgetc(fp);
+    fclose(fp);
+
+    DocumentReader *reader;
+    if (c0 == '{' &&
+        (c1 == ubjson::MARKER_INT8 ||
+         c1 == ubjson::MARKER_UINT8 ||
+         c1 == ubjson::MARKER_INT16 ||
+         c1 == ubjson::MARKER_INT32 ||
+         c1 == ubjson::MARKER_INT64 ||
+         c1 == ubjson::MARKER_OBJECT_END ||
+         c1 == ubjson::MARKER_TYPE ||
+         c1 == ubjson::MARKER_COUNT)) {
+        reader = new UBJSONReader;
+    } else {
+        reader = new JSONReader;
+    }
+
+    if (!reader->open(filename)) {
+        std::cerr << "error: " << filename << ": " << reader->getError() << "\n";
+        delete reader;
+        return NULL;
+    }
+    return reader;
 }
 
+
 static void
-usage(void)
+readMember(DocumentReader *reader, std::string *name, Node *value, bool *more)
 {
-    os::String command = find_command();
+    *more = reader->readMember(*name, *value);
+}
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
 
-    os::execute(args);
+/**
+ * Mimic jsondiff.py's load(), which drops images and members whose names
+ * are __dunder__ unless images are kept.
+ */
+static void
+stripImages(Node &node)
+{
+    switch (node.type) {
+    case Node::TYPE_OBJECT:
+        if (node.member("__class__")) {
+            node = Node();
+            return;
+        }
+        node.members.erase(std::remove_if(node.members.begin(), node.members.end(),
+                                          [] (const Node::Member &m) {
+                                              const std::string &n = m.first;
+                                              return n.size() >= 4 &&
+                                                     n.compare(0, 2, "__") == 0 &&
+                                                     n.compare(n.size() - 2, 2, "__") == 0;
+                                          }),
+                           node.members.end());
+        for (auto & member : node.members) {
+            stripImages(member.second);
+        }
+        break;
+    case Node::TYPE_ARRAY:
+        for (auto & element : node.elements) {
+            stripImages(element);
+        }
+        break;
+    default:
+        break;
+    }
 }
 
+
+static const Node nullNode;
+
+
+class StateDiffer
+{
+    DocumentReader &aReader;
+    DocumentReader &bReader;
+
+    bool ignoreAdded;
+    unsigned imageTolerance;
+    image::CompareOptions compareOptions;
+    double tolerance = 1.0 / (1 << 24);
+
+    std::ostream &os;
+    int level = 0;
+
+    // Results of pixel comparisons, as they are needed more than once
+    std::map<std::pair<const Node *, const Node *>, image::Difference> imageDiffs;
+
+public:
+    StateDiffer(DocumentReader &_aReader, DocumentReader &_bReader,
+                bool _ignoreAdded, unsigned _imageTolerance,
+                const image::CompareOptions &_compareOptions,
+                std::ostream &_os) :
+        aReader(_aReader),
+        bReader(_bReader),
+        ignoreAdded(_ignoreAdded),
+        imageTolerance(_imageTolerance),
+        compareOptions(_compareOptions),
+        os(_os)
+    {
+    }
+
+    /**
+     * Diff a member of the root object, writing nothing if equal.
+     */
+    bool
+    diffMember(const Node &a, const Node &b) {
+        if (equal(a, b)) {
+            return false;
+        }
+        level = 1;
+        diff(a, b);
+        return true;
+    }
+
+    void
+    diff(const Node &a, const Node &b) {
+        if (equal(a, b)) {
+            return;
+        }
+        if (a.type == Node::TYPE_OBJECT) {
+            if (b.type != Node::TYPE_OBJECT) {
+                replace(a, b);
+            } else {
+                diffObject(a, b);
+            }
+        } else if (a.type == Node::TYPE_ARRAY) {
+            if (b.type != Node::TYPE_ARRAY) {
+                replace(a, b);
+            } else {
+                diffArray(a, b);
+            }
+        } else {
+            replace(a, b);
+        }
+    }
+
+private:
+
+    /*
+     * Comparison
+     */
+
+    bool
+    equal(const Node &a, const Node &b, const Node *parent = NULL) {
+        switch (a.type) {
+        case Node::TYPE_OBJECT:
+            return b.type == Node::TYPE_OBJECT && equalObject(a, b);
+        case Node::TYPE_ARRAY:
+            if (b.type != Node::TYPE_ARRAY ||
+                a.elements.size() != b.elements.size()) {
+                return false;
+            }
+            for (size_t j = 0; j < a.elements.size(); ++j) {
+                if (!equal(a.elements[j], b.elements[j])) {
+                    return false;
+                }
+            }
+            return true;
+        case Node::TYPE_INT:
+        case Node::TYPE_FLOAT:
+            if (!b.isNumber()) {
+                return false;
+            }
+            if (a.type == Node::TYPE_INT && b.type == Node::TYPE_INT) {
+                return a.i == b.i;
+            }
+            return equalFloat(a.toDouble(), b.toDouble());
+        case Node::TYPE_NULL:
+            return b.type == Node::TYPE_NULL;
+        case Node::TYPE_BOOL:
+            return b.type == Node::TYPE_BOOL && a.b == b.b;
+        case Node::TYPE_STRING:
+            if (b.type != Node::TYPE_STRING || a.digested != b.digested) {
+                return false;
+            }
+            if (a.digested) {
+                return samePayload(a, b);
+            }
+            return a.str == b.str;
+        case Node::TYPE_BLOB:
+            if (b.type != Node::TYPE_BLOB) {
+                return false;
+            }
+            if (samePayload(a, b)) {
+                return true;
+            }
+            if (parent) {
+                // Different encodings may still hold the same pixels
+                const image::Difference &d = compareImages(a, b);
+                return !d.sizeMismatch && d.maxDiff <= imageTolerance;
+            }
+            return false;
+        }
+        return false;
+    }
+
+    bool
+    equalObject(const Node &a, const Node &b) {
+        if (a.members.size() != b.members.size() && !ignoreAdded) {
+            return false;
+        }
+        const Node *image = a.isImage() && b.isImage() ? &a : NULL;
+        auto bit = b.members.begin();
+        for (auto & am : a.members) {
+            while (bit != b.members.end() && bit->first < am.first) {
+                if (!ignoreAdded) {
+                    return false;
+                }
+                ++bit;
+            }
+            if (bit == b.members.end() || bit->first != am.first) {
+                return false;
+            }
+            if (!equal(am.second, bit->second,
+                       am.first == "__data__" ? image : NULL)) {
+                return false;
+            }
+            ++bit;
+        }
+        return true;
+    }
+
+    bool
+    equalFloat(double a, double b) const {
+        if (isnan(a) && isnan(b)) {
+            return true;
+        }
+        if (a == b) {
+            return true;
+        }
+        if (a == 0) {
+            return fabs(b) < tolerance;
+        }
+        return fabs((b - a)/a) < tolerance;
+    }
+
+    static bool
+    samePayload(const Node &a, const Node &b) {
+        assert(a.payload && b.payload);
+        return a.payload->size == b.payload->size &&
+               a.payload->digest == b.payload->digest;
+    }
+
+    const image::Difference &
+    compareImages(const Node &a, const Node &b) {
+        auto key = std::make_pair(&a, &b);
+        auto it = imageDiffs.find(key);
+        if (it != imageDiffs.end()) {
+            return it->second;
+        }
+
+        image::Difference &d = imageDiffs[key];
+        std::unique_ptr<image::Image> aImage(readImage(aReader, a));
+        std::unique_ptr<image::Image> bImage(readImage(bReader, b));
+        if (aImage && bImage) {
+            d = image::compare(*aImage, *bImage, compareOptions);
+        } else {
+            d.sizeMismatch = true;
+        }
+        return d;
+    }
+
+    static image::Image *
+    readImage(DocumentReader &reader, const Node &node) {
+        std::string data;
+        if (!reader.readPayload(node, data)) {
+            std::cerr << "error: " << reader.getError() << "\n";
+            return NULL;
+        }
+        if (data.size() >= 8 && memcmp(data.data(), "\x89PNG", 4) == 0) {
+            std::istringstream is(data);
+            return image::readPNG(is);
+        }
+        return image::readPNM(data.data(), data.size());
+    }
+
+    /*
+     * Output, same as jsondiff.py
+     */
+
+    void
+    indent(void) {
+        for (int j = 0; j < level; ++j) {
+            os << "  ";
+        }
+    }
+
+    void
+    diffObject(const Node &a, const Node &b) {
+        os << "{\n";
+        ++level;
+
+        std::vector<std::string> names;
+        for (auto & m : a.members) {
+            names.push_back(m.first);
+        }
+        if (!ignoreAdded) {
+            for (auto & m : b.members) {
+                names.push_back(m.first);
+            }
+            std::sort(names.begin(), names.end());
+            names.erase(std::unique(names.begin(), names.end()), names.end());
+        }
+
+        const Node *image = a.isImage() && b.isImage() ? &a : NULL;
+        for (size_t j = 0; j < names.size(); ++j) {
+            const std::string &name = names[j];
+            const Node *ae = a.member(name);
+            const Node *be = b.member(name);
+            ae = ae ? ae : &nullNode;
+            be = be ? be : &nullNode;
+            const Node *parent = name == "__data__" ? image : NULL;
+            if (!equal(*ae, *be, parent)) {
+                indent();
+                os << name << ": ";
+                if (parent && ae->type == Node::TYPE_BLOB && be->type == Node::TYPE_BLOB) {
+                    replaceImage(*ae, *be);
+                } else {
+                    diff(*ae, *be);
+                }
+                if (j != names.size() - 1) {
+                    os << ',';
+                }
+                os << '\n';
+            }
+        }
+
+        --level;
+        indent();
+        os << '}';
+        if (level <= 0) {
+            os << '\n';
+        }
+    }
+
+    void
+    diffArray(const Node &a, const Node &b) {
+        os << "[\n";
+        ++level;
+        size_t count = std::max(a.elements.size(), b.elements.size());
+        for (size_t j = 0; j < count; ++j) {
+            const Node &ae = j < a.elements.size() ? a.elements[j] : nullNode;
+            const Node &be = j < b.elements.size() ? b.elements[j] : nullNode;
+            indent();
+            if (equal(ae, be)) {
+                dump(aReader, ae);
+            } else {
+                diff(ae, be);
+            }
+            if (j != count - 1) {
+                os << ',';
+            }
+            os << '\n';
+        }
+        --level;
+        indent();
+        os << ']';
+    }
+
+    void
+    replace(const Node &a, const Node &b) {
+        if (isMultilineString(aReader, a) || isMultilineString(bReader, b)) {
+            replaceLines(a, b);
+            return;
+        }
+        dump(aReader, a);
+        os << " -> ";
+        dump(bReader, b);
+    }
+
+    void
+    replaceImage(const Node &a, const Node &b) {
+        dump(aReader, a);
+        os << " -> ";
+        dump(bReader, b);
+
+        const image::Difference &d = compareImages(a, b);
+        if (d.sizeMismatch) {
+            os << " (size mismatch)";
+        } else {
+            os << " (max diff " << d.maxDiff
+               << ", AE " << d.ae
+               << ", precision " << std::setprecision(3) << d.precision << " bits)";
+        }
+    }
+
+    std::string
+    stringValue(DocumentReader &reader, const Node &node) {
+        if (!node.digested) {
+            return node.str;
+        }
+        std::string data;
+        if (!reader.readPayload(node, data)) {
+            std::cerr << "error: " << reader.getError() << "\n";
+        }
+        return data;
+    }
+
+    bool
+    isMultilineString(DocumentReader &reader, const Node &node) {
+        if (!node.isString()) {
+            return false;
+        }
+        if (!node.digested) {
+            return node.str.find('\n') != std::string::npos;
+        }
+        // Long strings are almost certainly source code
+        return stringValue(reader, node).find('\n') != std::string::npos;
+    }
+
+    static void
+    splitLines(const std::string &s,
+               std::vector<std::string> &lines,
+               std::vector<trace::CallHash> &hashes) {
+        std::hash<std::string> hasher;
+        size_t start = 0;
+        while (start < s.size()) {
+            size_t end = s.find('\n', start);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            size_t len = end - start;
+            if (len && s[start + len - 1] == '\r') {
+                --len;
+            }
+            lines.push_back(s.substr(start, len));
+            hashes.push_back(hasher(lines.back()));
+            start = end + 1;
+        }
+    }
+
+    void
+    replaceLines(const Node &a, const Node &b) {
+        std::vector<std::string> aLines, bLines;
+        std::vector<trace::CallHash> aHashes, bHashes;
+        if (a.isString()) {
+            splitLines(stringValue(aReader, a), aLines, aHashes);
+        } else {
+            std::ostringstream ss;
+            dumpValue(aReader, a, ss);
+            splitLines(ss.str(), aLines, aHashes);
+        }
+        if (b.isString()) {
+            splitLines(stringValue(bReader, b), bLines, bHashes);
+        } else {
+            std::ostringstream ss;
+            dumpValue(bReader, b, ss);
+            splitLines(ss.str(), bLines, bHashes);
+        }
+
+        trace::DiffScript script;
+        trace::diff(aHashes, bHashes, script);
+
+        ++level;
+        for (auto & op : script) {
+            if (op.tag == trace::DIFF_EQUAL) {
+                for (size_t j = op.bBegin; j < op.bEnd; ++j) {
+                    writeLine("  ", bLines[j]);
+                }
+                continue;
+            }
+            for (size_t j = op.aBegin; j < op.aEnd; ++j) {
+                writeLine("- ", aLines[j]);
+            }
+            for (size_t j = op.bBegin; j < op.bEnd; ++j) {
+                writeLine("+ ", bLines[j]);
+            }
+        }
+        --level;
+    }
+
+    void
+    writeLine(const char *tag, const std::string &text) {
+        os << '\n';
+        indent();
+        os << tag << '"' << text << "\\n\"";
+    }
+
+    void
+    dump(DocumentReader &reader, const Node &node) {
+        switch (node.type) {
+        case Node::TYPE_OBJECT:
+            {
+                os << "{\n";
+                ++level;
+                for (size_t j = 0; j < node.members.size(); ++j) {
+                    indent();
+                    os << node.members[j].first << ": ";
+                    dump(reader, node.members[j].second);
+                    if (j != node.members.size() - 1) {
+                        os << ',';
+                    }
+                    os << '\n';
+                }
+                --level;
+                indent();
+                os << '}';
+                if (level <= 0) {
+                    os << '\n';
+                }
+            }
+            break;
+        case Node::TYPE_ARRAY:
+            os << "[\n";
+            ++level;
+            for (size_t j = 0; j < node.elements.size(); ++j) {
+                indent();
+                dump(reader, node.elements[j]);
+                if (j != node.elements.size() - 1) {
+                    os << ',';
+                }
+                os << '\n';
+            }
+            --level;
+            indent();
+            os << ']';
+            break;
+        default:
+            dumpValue(reader, node, os);
+            break;
+        }
+    }
+
+    void
+    dumpValue(DocumentReader &reader, const Node &node, std::ostream &out) {
+        switch (node.type) {
+        case Node::TYPE_NULL:
+            out << "null";
+            break;
+        case Node::TYPE_BOOL:
+            out << (node.b ? "true" : "false");
+            break;
+        case Node::TYPE_INT:
+            out << node.i;
+            break;
+        case Node::TYPE_FLOAT:
+            writeFloat(out, node.f);
+            break;
+        case Node::TYPE_STRING:
+            writeString(out, stringValue(reader, node));
+            break;
+        case Node::TYPE_BLOB:
+            // Never dump the actual bytes
+            out << "\"blob(" << node.payload->size << ", "
+                << node.payload->digest.str() << ")\"";
+            break;
+        default:
+            dump(reader, node);
+            break;
+        }
+    }
+
+    // Shortest representation that round-trips, like Python's repr()
+    static void
+    writeFloat(std::ostream &out, double f) {
+        if (isnan(f)) {
+            out << "NaN";
+            return;
+        }
+        if (isinf(f)) {
+            out << (f < 0 ? "-Infinity" : "Infinity");
+            return;
+        }
+        char buf[32];
+        for (int precision = 1; precision <= 17; ++precision) {
+            snprintf(buf, sizeof buf, "%.*g", precision, f);
+            if (strtod(buf, NULL) == f) {
+                break;
+            }
+        }
+        out << buf;
+        if (!strpbrk(buf, ".en")) {
+            out << ".0";
+        }
+    }
+
+    // Same escaping as Python's json.dumps()
+    static void
+    writeString(std::ostream &out, const std::string &s) {
+        static const char hex[] = "0123456789abcdef";
+        out << '"';
+        for (size_t j = 0; j < s.size(); ++j) {
+            unsigned char c = s[j];
+            switch (c) {
+            case '"':  out << "\\\""; continue;
+            case '\\': out << "\\\\"; continue;
+            case '\n': out << "\\n"; continue;
+            case '\r': out << "\\r"; continue;
+            case '\t': out << "\\t"; continue;
+            case '\b': out << "\\b"; continue;
+            case '\f': out << "\\f"; continue;
+            }
+            if (c >= 0x20 && c < 0x7f) {
+                out << (char)c;
+                continue;
+            }
+
+            unsigned cp = c;
+            if (c >= 0xc0) {
+                unsigned extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+                cp = c & (0x3f >> extra);
+                for (unsigned k = 0; k < extra && j + 1 < s.size(); ++k) {
+                    cp = (cp << 6) | (s[++j] & 0x3f);
+                }
+            }
+            auto escape = [&] (unsigned u) {
+                out << "\\u" << hex[(u >> 12) & 0xf] << hex[(u >> 8) & 0xf]
+                    << hex[(u >> 4) & 0xf] << hex[u & 0xf];
+            };
+            if (cp >= 0x10000) {
+                cp -= 0x10000;
+                escape(0xd800 + (cp >> 10));
+                escape(0xdc00 + (cp & 0x3ff));
+            } else {
+                escape(cp);
+            }
+        }
+        out << '"';
+    }
+};
+
+
+} /* anonymous namespace */
+
+
 static int
 command(int argc, char *argv[])
 {
-    int i;
+    bool ignoreAdded = false;
+    bool keepImages = false;
+    unsigned imageTolerance = 0;
+    image::CompareOptions compareOptions;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case IGNORE_ADDED_OPT:
+            ignoreAdded = true;
+            break;
+        case KEEP_IMAGES_OPT:
+            keepImages = true;
+            break;
+        case IMAGE_TOLERANCE_OPT:
+            imageTolerance = atoi(optarg);
+            break;
+        case 'f':
+            compareOptions.fuzz = atof(optarg);
+            break;
+        case 'a':
+            compareOptions.alpha = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
 
-    os::String command = find_command();
+    if (argc - optind != 2) {
+        std::cerr << "error: incorrect number of arguments\n";
+        usage();
+        return 1;
+    }
+
+    const char *aFilename = argv[optind];
+    const char *bFilename = argv[optind + 1];
+
+    std::unique_ptr<DocumentReader> aReader(openDocument(aFilename));
+    std::unique_ptr<DocumentReader> bReader(openDocument(bFilename));
+    if (!aReader || !bReader) {
+        return 1;
+    }
+
+    /*
+     * Walk the root objects of both documents in lock step, reading each
+     * pair of members in parallel, and diff members as soon as both sides
+     * have them.  As state dumps list their members in the same order, this
+     * keeps at most one member of each document in memory.  The diffs are
+     * buffered to output them sorted by name, like jsondiff.py.
+     */
+    std::map<std::string, Node> aPending, bPending;
+    std::set<std::string> names;
+    std::map<std::string, std::string> diffs;
+
+    auto diffMember = [&] (const std::string &name, const Node &a, const Node &b) {
+        std::ostringstream ss;
+        StateDiffer differ(*aReader, *bReader, ignoreAdded, imageTolerance,
+                           compareOptions, ss);
+        if (differ.diffMember(a, b)) {
+            diffs[name] = ss.str();
+        }
+    };
+
+    for (;;) {
+        std::string aName, bName;
+        Node aValue, bValue;
+        bool aMore = false, bMore = false;
+        std::thread aThread(readMember, aReader.get(), &aName, &aValue, &aMore);
+        readMember(bReader.get(), &bName, &bValue, &bMore);
+        aThread.join();
+
+        if (!aMore && !bMore) {
+            break;
+        }
+
+        if (aMore) {
+            if (!keepImages) {
+                stripImages(aValue);
+            }
+            names.insert(aName);
+            auto it = bPending.find(aName);
+            if (it != bPending.end()) {
+                diffMember(aName, aValue, it->second);
+                bPending.erase(it);
+            } else {
+                aPending[aName] = std::move(aValue);
+            }
+        }
+
+        if (bMore) {
+            if (!keepImages) {
+                stripImages(bValue);
+            }
+            if (!ignoreAdded) {
+                names.insert(bName);
+            }
+            auto it = aPending.find(bName);
+            if (it != aPending.end()) {
+                diffMember(bName, it->second, bValue);
+                aPending.erase(it);
+            } else {
+                bPending[bName] = std::move(bValue);
+            }
+        }
+    }
+
+    if (!aReader->getError().empty()) {
+        std::cerr << "error: " << aFilename << ": " << aReader->getError() << "\n";
+        return 1;
+    }
+    if (!bReader->getError().empty()) {
+        std::cerr << "error: " << bFilename << ": " << bReader->getError() << "\n";
+        return 1;
+    }
+
+    // Members only present in one of the documents
+    for (auto & member : aPending) {
+        diffMember(member.first, member.second, nullNode);
+    }
+    if (!ignoreAdded) {
+        for (auto & member : bPending) {
+            diffMember(member.first, nullNode, member.second);
+        }
+    }
 
-    std::vector<const char *> args;
-    args.push_back(APITRACE_PYTHON_EXECUTABLE);
-    args.push_back(command.str());
-    for (i = 1; i < argc; i++) {
-        args.push_back(argv[i]);
+    if (!diffs.empty()) {
+        std::cout << "{\n";
+        size_t j = 0;
+        for (auto & name : names) {
+            ++j;
+            auto it = diffs.find(name);
+            if (it != diffs.end()) {
+                std::cout << "  " << name << ": " << it->second;
+                if (j != names.size()) {
+                    std::cout << ',';
+                }
+                std::cout << '\n';
+            }
+        }
+        std::cout << "}\n";
     }
-    args.push_back(NULL);
+    std::cout << std::flush;
 
-    return os::execute((char * const *)&args[0]);
+    return 0;
 }
 
 const Command diff_state_command = {
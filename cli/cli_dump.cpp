@@ -47,6 +47,7 @@
 #include "trace_dump_internal.hpp"
 #include "trace_callset.hpp"
 #include "trace_option.hpp"
+#include "trace_symbolizer.hpp"
 
 
 enum ColorOption {
@@ -78,6 +79,7 @@ usage(void)
         "                         WHEN is 'auto', 'always', or 'never'\n"
         "    --grep[=REGEX]       dump only calls whose function names match regex\n"
         "    --thread-ids=[=BOOL] dump thread ids [default: no]\n"
+        "    --timestamps[=BOOL]  dump the recorded call timestamps [default: no]\n"
         "    --call-nos[=BOOL]    dump call numbers[default: yes]\n"
         "    --arg-names[=BOOL]   dump argument names [default: yes]\n"
         "    --blobs              dump blobs into files\n"
@@ -91,6 +93,7 @@ enum {
     COLOR_OPT,
     GREP_OPT,
     THREAD_IDS_OPT,
+    TIMESTAMPS_OPT,
     CALL_NOS_OPT,
     ARG_NAMES_OPT,
     BLOBS_OPT,
@@ -109,6 +112,7 @@ longOptions[] = {
     {"color", optional_argument, 0, COLOR_OPT},
     {"grep", required_argument, 0, GREP_OPT},
     {"thread-ids", optional_argument, 0, THREAD_IDS_OPT},
+    {"timestamps", optional_argument, 0, TIMESTAMPS_OPT},
     {"call-nos", optional_argument, 0, CALL_NOS_OPT},
     {"arg-names", optional_argument, 0, ARG_NAMES_OPT},
     {"blobs", no_argument, 0, BLOBS_OPT},
@@ -201,6 +205,13 @@ command(int argc, char *argv[])
                 dumpFlags &= ~trace::DUMP_FLAG_THREAD_IDS;
             }
             break;
+        case TIMESTAMPS_OPT:
+            if (trace::boolOption(optarg)) {
+                dumpFlags |= trace::DUMP_FLAG_TIMESTAMPS;
+            } else {
+                dumpFlags &= ~trace::DUMP_FLAG_TIMESTAMPS;
+            }
+            break;
         case CALL_NOS_OPT:
             if (trace::boolOption(optarg)) {
                 dumpFlags &= ~trace::DUMP_FLAG_NO_CALL_NO;
@@ -246,12 +257,14 @@ command(int argc, char *argv[])
     }
 
     std::unique_ptr<trace::Dumper> dumper;
+    trace::Symbolizer symbolizer;
 
     if (blobs) {
         dumper = std::make_unique<BlobDumper>(std::cout, dumpFlags);
     } else {
         dumper = std::make_unique<trace::Dumper>(std::cout, dumpFlags);
     }
+    dumper->setSymbolizer(&symbolizer);
 
     for (int i = optind; i < argc; ++i) {
         trace::Parser p;
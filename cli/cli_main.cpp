@@ -86,6 +86,7 @@ const Command version_command = {
 };
 
 static const Command * commands[] = {
+    &compile_command,
     &diff_command,
     &diff_state_command,
     &diff_images_command,
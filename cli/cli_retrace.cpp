@@ -35,6 +35,7 @@
 #include "os_process.hpp"
 
 #include "trace_parser.hpp"
+#include "trace_plan.hpp"
 #include "cli_resources.hpp"
 
 #include "cli.hpp"
@@ -44,6 +45,14 @@
 static trace::API
 guessApi(const char *filename)
 {
+    if (trace::isPlan(filename)) {
+        trace::PlanParser plan;
+        if (!plan.open(filename)) {
+            exit(1);
+        }
+        return plan.api;
+    }
+
     trace::Parser p;
     if (!p.open(filename)) {
         exit(1);
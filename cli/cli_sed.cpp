@@ -95,6 +95,8 @@ protected:
     unsigned long long searchPointer = 0;
     unsigned long long replacePointer = 0;
 
+    bool replaced = false;
+
 public:
     Replacer(const std::string & _searchString, const std::string & _replaceString) :
         searchString(_searchString),
@@ -139,6 +141,7 @@ public:
             char *str = new char [len];
             memcpy(str, replaceString.c_str(), len);
             node->value = str;
+            replaced = true;
         }
     }
 
@@ -153,6 +156,7 @@ public:
                 for (unsigned i = 0; i < sig->num_values; ++i) {
                     if (replaceString.compare(sig->values[i].name) == 0) {
                         node->value = sig->values[i].value;
+                        replaced = true;
                         break;
                     }
                 }
@@ -166,6 +170,7 @@ public:
             if (searchIt->value && (bitmask->value & searchIt->value) == searchIt->value &&
                 searchString.compare(searchIt->name) == 0) {
                 bitmask->value &= ~searchIt->value;
+                replaced = true;
                 for (const BitmaskFlag *replaceIt = sig->flags; replaceIt != sig->flags + sig->num_flags; ++replaceIt) {
                     if (replaceString.compare(replaceIt->name) == 0) {
                         bitmask->value |= replaceIt->value;
@@ -201,6 +206,7 @@ public:
         if (isPointer &&
             p->value == searchPointer) {
             p->value = replacePointer;
+            replaced = true;
         }
     }
 
@@ -208,7 +214,12 @@ public:
         _visit(r->humanValue);
     }
 
-    void visit(Call *call) {
+    /**
+     * Returns whether anything in the call was replaced.
+     */
+    bool visit(Call *call) {
+        replaced = false;
+
         for (auto & arg : call->args) {
             if (arg.value) {
                 _visit(arg.value);
@@ -218,6 +229,8 @@ public:
         if (call->ret) {
             _visit(call->ret);
         }
+
+        return replaced;
     }
 };
 
@@ -234,6 +247,9 @@ sed_trace(Replacements &replacements,
 {
     trace::Parser p;
 
+    /* Calls without replacements are copied as they are. */
+    p.setRecordRawCalls(true);
+
     if (!p.open(inFileName)) {
         std::cerr << "error: failed to open " << inFileName << "\n";
         return 1;
@@ -260,13 +276,18 @@ sed_trace(Replacements &replacements,
 
     trace::Call *call;
     while ((call = p.parse_call())) {
+        bool modified = false;
         if (calls.empty() || calls.contains(*call)) {
             for (auto & replacement : replacements) {
-                replacement.visit(call);
+                modified |= replacement.visit(call);
             }
         }
 
-        writer.writeCall(call);
+        if (call->raw && !modified) {
+            writer.writeRawCall(call);
+        } else {
+            writer.writeCall(call);
+        }
 
         delete call;
     }
@@ -100,6 +100,24 @@ trim_trace(const char *filename, struct trim_options *options)
     trace::Parser p;
     unsigned frame;
 
+    /* Calls are copied as they are, so there's no need to decode them. */
+    p.setRecordRawCalls(true);
+
+    /* Only hold on to the bytes of the calls that will be written.  The
+     * decision is made when the call is entered, so frames are counted in
+     * the order calls are entered. */
+    unsigned enter_frame = 0;
+    p.setRawCallFilter([&](const trace::Call *call) {
+        bool keep = (options->threadIds.empty() ||
+                     options->threadIds.find(call->thread_id) != options->threadIds.end()) &&
+                    (options->calls.contains(*call) ||
+                     options->frames.contains(enter_frame, call->flags));
+        if (call->flags & trace::CALL_FLAG_END_FRAME) {
+            enter_frame++;
+        }
+        return keep;
+    });
+
     if (!p.open(filename)) {
         std::cerr << "error: failed to open " << filename << "\n";
         return 1;
@@ -120,9 +138,11 @@ trim_trace(const char *filename, struct trim_options *options)
     }
 
 
+    bool raw = p.recordsRawCalls();
+
     frame = 0;
     trace::Call *call;
-    while ((call = p.parse_call())) {
+    while ((call = raw ? p.scan_call() : p.parse_call())) {
 
         /* There's no use doing any work past the last call and frame
          * requested by the user. */
@@ -142,9 +162,12 @@ trim_trace(const char *filename, struct trim_options *options)
         /* If this call is included in the user-specified call set,
          * then require it (and all dependencies) in the trimmed
          * output. */
-        if (options->calls.contains(*call) ||
-            options->frames.contains(frame, call->flags)) {
-
+        if (raw) {
+            if (call->raw) {
+                writer.writeRawCall(call);
+            }
+        } else if (options->calls.contains(*call) ||
+                   options->frames.contains(frame, call->flags)) {
             writer.writeCall(call);
         }
 
@@ -27,6 +27,7 @@
 
 #include "ft_dependecyobject.hpp"
 
+#include <algorithm>
 #include <cstring>
 
 #include <GL/gl.h>
@@ -41,6 +42,32 @@ UsedObject::UsedObject(unsigned id):
 
 }
 
+UsedObject::Pointer
+UsedObject::clone() const
+{
+    return std::make_shared<UsedObject>(*this);
+}
+
+void
+UsedObject::remap(ObjectCloner& cloner)
+{
+    m_dependency_set.clear();
+    for (auto& dep : m_dependencies) {
+        dep = cloner(dep);
+        m_dependency_set.insert(dep.get());
+    }
+
+    decltype(m_dependents) dependents;
+    for (auto&& [key, dependent] : m_dependents) {
+        auto obj = dependent.lock();
+        if (obj) {
+            auto copy = cloner(obj);
+            dependents[copy.get()] = copy;
+        }
+    }
+    m_dependents.swap(dependents);
+}
+
 unsigned
 UsedObject::id() const
 {
@@ -54,32 +81,156 @@ UsedObject::emitted() const
 }
 
 void
-UsedObject::addCall(PTraceCall call)
+UsedObject::addCall(TraceCall call)
 {
-    m_calls.push_back(call);
+    m_calls.push_back(call.callNo());
+    if (call.test(tc_non_repeat))
+        m_non_repeat_calls.push_back(call.callNo());
     m_emitted = false;
 }
 
 void
-UsedObject::setCall(PTraceCall call)
+UsedObject::setCall(TraceCall call)
 {
     m_calls.clear();
+    m_non_repeat_calls.clear();
+    m_pending_uploads.clear();
     addCall(call);
 }
 
 void
 UsedObject::addDependency(Pointer dep)
 {
-    m_dependencies.push_back(dep);
+    if (m_dependency_set.insert(dep.get()).second) {
+        m_dependencies.push_back(dep);
+        dep->m_dependents[this] = weak_from_this();
+    }
+
+    /* The dependency is used in its current state */
+    dep->pinUploads();
     m_emitted = false;
 }
 
 void UsedObject::setDependency(Pointer dep)
 {
     m_dependencies.clear();
+    m_dependency_set.clear();
     addDependency(dep);
 }
 
+/* Remove the parts of the regions that overlap "cut", returns true if
+ * nothing is left */
+static bool
+subtractRegion(std::vector<UploadRegion>& regions, const UploadRegion& cut)
+{
+    std::vector<UploadRegion> result;
+    for (auto& r : regions) {
+        bool overlaps = true;
+        for (int d = 0; d < 3; ++d)
+            overlaps &= r.begin[d] < cut.end[d] && cut.begin[d] < r.end[d];
+
+        if (!overlaps) {
+            result.push_back(r);
+            continue;
+        }
+
+        /* Split off the parts outside of the cut, one axis at a time */
+        auto rest = r;
+        for (int d = 0; d < 3; ++d) {
+            if (rest.begin[d] < cut.begin[d]) {
+                auto part = rest;
+                part.end[d] = cut.begin[d];
+                result.push_back(part);
+                rest.begin[d] = cut.begin[d];
+            }
+            if (rest.end[d] > cut.end[d]) {
+                auto part = rest;
+                part.begin[d] = cut.end[d];
+                result.push_back(part);
+                rest.end[d] = cut.end[d];
+            }
+        }
+    }
+    regions.swap(result);
+    return regions.empty();
+}
+
+/* Give up on uploads that are overwritten in too many pieces */
+static const size_t max_live_regions = 32;
+
+void
+UsedObject::addUpload(TraceCall call, const UploadRegion& region)
+{
+    for (auto u = m_pending_uploads.begin(); u != m_pending_uploads.end();) {
+        if (u->level == region.level &&
+            (region.respecify ||
+             (!u->respecify && subtractRegion(u->live, region)))) {
+            dropCall(u->call_no);
+            u = m_pending_uploads.erase(u);
+        } else if (u->live.size() > max_live_regions) {
+            u = m_pending_uploads.erase(u);
+        } else
+            ++u;
+    }
+
+    addCall(call);
+    m_pending_uploads.push_back({call.callNo(), region.level, region.respecify, {region}});
+    markUploadsDirty();
+}
+
+void
+UsedObject::dropCall(unsigned call_no)
+{
+    auto i = std::find(m_calls.rbegin(), m_calls.rend(), call_no);
+    if (i != m_calls.rend())
+        m_calls.erase(std::next(i).base());
+
+    auto k = std::find(m_non_repeat_calls.rbegin(), m_non_repeat_calls.rend(), call_no);
+    if (k != m_non_repeat_calls.rend())
+        m_non_repeat_calls.erase(std::next(k).base());
+}
+
+/* An object is marked dirty when it or one of its dependencies has
+ * pending uploads, so that pinning only has to visit these objects.
+ * If an object is dirty then so are all objects that depend on it. */
+void
+UsedObject::markUploadsDirty()
+{
+    std::vector<Pointer> stack;
+    stack.push_back(shared_from_this());
+    while (!stack.empty()) {
+        auto obj = stack.back();
+        stack.pop_back();
+        if (obj->m_uploads_dirty)
+            continue;
+        obj->m_uploads_dirty = true;
+        for (auto&& [key, dependent] : obj->m_dependents) {
+            auto d = dependent.lock();
+            if (d)
+                stack.push_back(d);
+        }
+    }
+}
+
+void
+UsedObject::pinUploads()
+{
+    std::vector<UsedObject *> stack;
+    stack.push_back(this);
+    while (!stack.empty()) {
+        auto obj = stack.back();
+        stack.pop_back();
+        if (!obj->m_uploads_dirty)
+            continue;
+        obj->m_uploads_dirty = false;
+        obj->m_pending_uploads.clear();
+        for (auto& dep : obj->m_dependencies) {
+            if (dep->m_uploads_dirty)
+                stack.push_back(dep.get());
+        }
+    }
+}
+
 void
 UsedObject::emitCallsTo(CallSet& out_list)
 {
@@ -114,7 +265,7 @@ bool UsedObject::createdBefore(unsigned callno) const
     if (m_calls.empty())
         return false;
 
-    return callno > 0 && m_calls[0]->callNo() < callno;
+    return callno > 0 && m_calls[0] < callno;
 }
 
 void
@@ -301,6 +452,17 @@ DependecyObjectMap::callOnBoundObject(const trace::Call& call)
     obj->addCall(trace2call(call));
 }
 
+/* A call that reads the data of the bound object */
+UsedObject::Pointer
+DependecyObjectMap::readBoundObject(const trace::Call& call)
+{
+    callOnBoundObject(call);
+    auto obj = boundAtBinding(getBindpointFromCall(call));
+    if (obj)
+        obj->pinUploads();
+    return obj;
+}
+
 UsedObject::Pointer
 DependecyObjectMap::bindWithCreate(const trace::Call& call, unsigned obj_id_param)
 {
@@ -337,6 +499,16 @@ DependecyObjectMap::callOnNamedObject(const trace::Call& call)
         obj->addCall(trace2call(call));
 }
 
+UsedObject::Pointer
+DependecyObjectMap::readNamedObject(const trace::Call& call)
+{
+    callOnNamedObject(call);
+    auto obj = getById(call.arg(0).toUInt());
+    if (obj)
+        obj->pinUploads();
+    return obj;
+}
+
 UsedObject::Pointer
 DependecyObjectMap::callOnBoundObjectWithDep(const trace::Call& call,
                                              DependecyObjectMap& other_objects,
@@ -386,8 +558,8 @@ DependecyObjectMap::callOnBoundObjectWithDepBoundTo(const trace::Call& call,
     auto dep = other_objects.boundTo(bindingpoint);
     if (dep) {
         bound_obj->addDependency(dep);
-        if (global_state.emit_dependencies)
-            dep->emitCallsTo(*global_state.out_list);
+        if (global_state->emit_dependencies)
+            dep->emitCallsTo(*global_state->out_list);
     }
 }
 
@@ -437,8 +609,8 @@ DependecyObjectMap::callOnNamedObjectWithNamedDep(const trace::Call& call,
     auto dep = other_objects.getById(call.arg(dep_call_param).toUInt());
     if (dep) {
         obj->addDependency(dep);
-        if (global_state.emit_dependencies)
-            dep->emitCallsTo(*global_state.out_list);
+        if (global_state->emit_dependencies)
+            dep->emitCallsTo(*global_state->out_list);
     }
 }
 
@@ -459,15 +631,15 @@ DependecyObjectMap::callOnNamedObjectWithDepBoundTo(const trace::Call& call,
     auto dep = other_objects.boundTo(dep_call_param);
     if (dep) {
         obj->addDependency(dep);
-        if (global_state.emit_dependencies)
-            dep->emitCallsTo(*global_state.out_list);
+        if (global_state->emit_dependencies)
+            dep->emitCallsTo(*global_state->out_list);
     }
 }
 
 
-void DependecyObjectMap::addCall(PTraceCall call)
+void DependecyObjectMap::addCall(TraceCall call)
 {
-    m_calls.push_back(call);
+    m_calls.push_back(call.callNo());
 }
 
 UsedObject::Pointer
@@ -477,17 +649,6 @@ DependecyObjectMap::getById(unsigned id) const
     return i !=  m_objects.end() ? i->second : nullptr;
 }
 
-static bool isNonRepeatCall(const std::string& name)
-{
-    static const std::unordered_set<std::string> nonRepeateCalls = {
-        "glShaderSource",
-        "glCompileShader",
-        "glAttachShader",
-        "glLinkProgram",
-    };
-    return nonRepeateCalls.find(name) != nonRepeateCalls.end();
-}
-
 void
 DependecyObjectMap::unbalancedCreateCallsInLastFrame(uint32_t last_frame_start,
                                                      std::unordered_set<unsigned>& outSet)
@@ -502,9 +663,9 @@ DependecyObjectMap::unbalancedCreateCallsInLastFrame(uint32_t last_frame_start,
             if (reused_callno >= last_frame_start) {
                 outSet.insert(reused_callno);
             }
-            for (auto&& c : obj->calls()) {
-                if (c->callNo() >= last_frame_start && isNonRepeatCall(c->name()))
-                    outSet.insert(c->callNo());
+            for (auto&& callno : obj->nonRepeatCalls()) {
+                if (callno >= last_frame_start)
+                    outSet.insert(callno);
             }
         }
     }
@@ -538,6 +699,42 @@ void DependecyObjectMap::emitBoundObjectsExt(CallSet& out_calls)
     (void)out_calls;
 }
 
+void DependecyObjectMap::remap(ObjectCloner& cloner)
+{
+    for (auto&& [id, obj]: m_objects)
+        obj = cloner(obj);
+
+    for (auto&& [ctx_id, bound_objects]: m_bound_object) {
+        for (auto&& [key, obj]: bound_objects)
+            obj = cloner(obj);
+    }
+}
+
+UsedObject::Pointer
+ObjectCloner::operator () (const UsedObject::Pointer& obj)
+{
+    if (!obj)
+        return nullptr;
+
+    auto& copy = m_clones[obj.get()];
+    if (!copy) {
+        copy = obj->clone();
+        m_pending.push_back(copy);
+    }
+    return copy;
+}
+
+void ObjectCloner::finish()
+{
+    /* Remapping may copy more objects, so don't recurse, the
+     * dependency chains can be very long */
+    while (!m_pending.empty()) {
+        auto obj = m_pending.back();
+        m_pending.pop_back();
+        obj->remap(*this);
+    }
+}
+
 unsigned
 DependecyObjectWithSingleBindPointMap::getBindpointFromCall(const trace::Call& call) const
 {
@@ -626,6 +823,16 @@ BufferObjectMap::getBindpointFromCall(const trace::Call& call) const
     return getBindpoint(call.arg(0).toUInt(), 0);
 }
 
+static UploadRegion
+bufferRegion(uint64_t offset, uint64_t size, bool respecify)
+{
+    UploadRegion region;
+    region.begin[0] = offset;
+    region.end[0] = offset + size;
+    region.respecify = respecify;
+    return region;
+}
+
 void
 BufferObjectMap::data(const trace::Call& call)
 {
@@ -633,7 +840,7 @@ BufferObjectMap::data(const trace::Call& call)
     auto buf = boundAtBinding(target);
     if (buf) {
         m_buffer_sizes[buf->id()] = call.arg(1).toUInt();
-        buf->addCall(trace2call(call));
+        buf->addUpload(trace2call(call), bufferRegion(0, call.arg(1).toUInt(), true));
     }
 }
 
@@ -643,16 +850,51 @@ BufferObjectMap::namedData(const trace::Call& call)
     auto buf = getById(call.arg(0).toUInt());
     if (buf) {
         m_buffer_sizes[buf->id()] = call.arg(1).toUInt();
-        buf->addCall(trace2call(call));
+        buf->addUpload(trace2call(call), bufferRegion(0, call.arg(1).toUInt(), true));
     }
 }
 
+void
+BufferObjectMap::subData(const trace::Call& call)
+{
+    auto buf = boundAtBinding(getBindpointFromCall(call));
+    if (buf)
+        buf->addUpload(trace2call(call),
+                       bufferRegion(call.arg(1).toUInt(), call.arg(2).toUInt(), false));
+}
+
+void
+BufferObjectMap::namedSubData(const trace::Call& call)
+{
+    auto buf = getById(call.arg(0).toUInt());
+    if (buf)
+        buf->addUpload(trace2call(call),
+                       bufferRegion(call.arg(1).toUInt(), call.arg(2).toUInt(), false));
+}
+
+void
+BufferObjectMap::clearData(const trace::Call& call)
+{
+    auto buf = boundAtBinding(getBindpointFromCall(call));
+    if (buf)
+        buf->addUpload(trace2call(call), bufferRegion(0, UINT64_MAX, false));
+}
+
+void
+BufferObjectMap::namedClearData(const trace::Call& call)
+{
+    auto buf = getById(call.arg(0).toUInt());
+    if (buf)
+        buf->addUpload(trace2call(call), bufferRegion(0, UINT64_MAX, false));
+}
+
 void
 BufferObjectMap::map(const trace::Call& call)
 {
     unsigned target = getBindpointFromCall(call);
     auto buf = boundAtBinding(target);
     if (buf) {
+        buf->pinUploads();
         m_mapped_buffers[target][buf->id()] = buf;
         uint64_t begin = call.ret->toUInt();
         uint64_t end = begin + m_buffer_sizes[buf->id()];
@@ -666,6 +908,7 @@ BufferObjectMap::namedMap(const trace::Call& call)
 {
     auto buf = getById(call.arg(0).toUInt());
     if (buf) {
+        buf->pinUploads();
         m_mapped_buffers[bt_names_access][buf->id()] = buf;
         uint64_t begin = call.ret->toUInt();
         uint64_t end = begin + m_buffer_sizes[buf->id()];
@@ -680,6 +923,7 @@ BufferObjectMap::mapRange(const trace::Call& call)
     unsigned target = getBindpointFromCall(call);
     auto buf = boundAtBinding(target);
     if (buf) {
+        buf->pinUploads();
         m_mapped_buffers[target][buf->id()] = buf;
         uint64_t begin = call.ret->toUInt();
         uint64_t end = begin + call.arg(2).toUInt();
@@ -693,6 +937,7 @@ BufferObjectMap::namedMapRange(const trace::Call& call)
 {
     auto buf = getById(call.arg(0).toUInt());
     if (buf) {
+        buf->pinUploads();
         m_mapped_buffers[bt_names_access][buf->id()] = buf;
         uint64_t begin = call.ret->toUInt();
         uint64_t end = begin + call.arg(2).toUInt();
@@ -786,6 +1031,15 @@ void BufferObjectMap::addSSBODependencies(UsedObject::Pointer dep)
     }
 }
 
+void BufferObjectMap::remap(ObjectCloner& cloner)
+{
+    DependecyObjectMap::remap(cloner);
+    for (auto&& [ctx_id, mapped]: m_mapped_buffers) {
+        for (auto&& [target, buf]: mapped)
+            buf = cloner(buf);
+    }
+}
+
 void BufferObjectMap::copyBufferSubData(const trace::Call& call)
 {
     auto src = boundTo(call.arg(0).toUInt());
@@ -824,12 +1078,12 @@ VertexAttribObjectMap::bindAVO(const trace::Call& call, BufferObjectMap& buffers
     auto buf = buffers.boundToTarget(GL_ARRAY_BUFFER);
     if (buf) {
         obj->addDependency(buf);
-        if (global_state.emit_dependencies) {
-            buf->emitCallsTo(*global_state.out_list);
+        if (global_state->emit_dependencies) {
+            buf->emitCallsTo(*global_state->out_list);
         }
     }
-    if (global_state.current_vao) {
-        global_state.current_vao->addDependency(obj);
+    if (global_state->current_vao) {
+        global_state->current_vao->addDependency(obj);
     }
 
     ++next_id;
@@ -847,8 +1101,8 @@ void VertexAttribObjectMap::bindVAOBuf(const trace::Call& call, BufferObjectMap&
     assert(buf || (call.arg(1).toUInt() == 0));
     if (buf) {
         obj->addDependency(buf);
-        if (global_state.emit_dependencies) {
-            buf->emitCallsTo(*global_state.out_list);
+        if (global_state->emit_dependencies) {
+            buf->emitCallsTo(*global_state->out_list);
         }
     }
     ++next_id;
@@ -1002,6 +1256,78 @@ void TextureObjectMap::addImageDependencies(UsedObject::Pointer dep)
     }
 }
 
+/* The texel region written by glTex[Sub]Image* like calls, "level_param"
+ * is followed by the internal format and size, or by offset and size */
+static UploadRegion
+textureRegion(const trace::Call& call, unsigned target, unsigned level_param,
+              unsigned dims, bool sub)
+{
+    UploadRegion region;
+    region.level = (target << 16) | (call.arg(level_param).toUInt() & 0xffff);
+    region.respecify = !sub;
+
+    unsigned size_param = sub ? level_param + 1 + dims : level_param + 2;
+    for (unsigned d = 0; d < dims; ++d) {
+        uint64_t offset = sub ? call.arg(level_param + 1 + d).toUInt() : 0;
+        region.begin[d] = offset;
+        region.end[d] = offset + call.arg(size_param + d).toUInt();
+    }
+    return region;
+}
+
+void TextureObjectMap::upload(const trace::Call& call, DependecyObjectMap& buffers,
+                              unsigned dims, bool sub)
+{
+    auto tex = boundAtBinding(getBindpointFromCall(call));
+    if (!tex)
+        return;
+
+    tex->addUpload(trace2call(call),
+                   textureRegion(call, call.arg(0).toUInt(), 1, dims, sub));
+
+    auto pbo = buffers.boundTo(GL_PIXEL_UNPACK_BUFFER);
+    if (pbo) {
+        tex->addDependency(pbo);
+        if (global_state->emit_dependencies)
+            pbo->emitCallsTo(*global_state->out_list);
+    }
+}
+
+void TextureObjectMap::namedUpload(const trace::Call& call, DependecyObjectMap& buffers,
+                                   unsigned dims, bool sub)
+{
+    auto tex = getById(call.arg(0).toUInt());
+    if (!tex) {
+        std::cerr << "No object named " << call.arg(0).toUInt()
+                  << " in call " << call.no << ":" << call.name() << "\n";
+        assert(0);
+        return;
+    }
+
+    /* The EXT_direct_state_access versions also take the target */
+    if (strstr(call.name(), "EXT"))
+        tex->addUpload(trace2call(call),
+                       textureRegion(call, call.arg(1).toUInt(), 2, dims, sub));
+    else
+        tex->addUpload(trace2call(call), textureRegion(call, 0, 1, dims, sub));
+
+    auto pbo = buffers.boundTo(GL_PIXEL_UNPACK_BUFFER);
+    if (pbo) {
+        tex->addDependency(pbo);
+        if (global_state->emit_dependencies)
+            pbo->emitCallsTo(*global_state->out_list);
+    }
+}
+
+void TextureObjectMap::remap(ObjectCloner& cloner)
+{
+    DependecyObjectMap::remap(cloner);
+    for (auto&& [ctx_id, images]: m_bound_images) {
+        for (auto&& [unit, tex]: images)
+            tex = cloner(tex);
+    }
+}
+
 int
 TextureObjectMap::getBindpointFromTargetAndUnit(unsigned target, unsigned unit) const
 {
@@ -1202,6 +1528,6 @@ void FramebufferObjectMap::oglDrawFromBuffer(const trace::Call& call, BufferObje
     }
 }
 
-GlobalState global_state;
+GlobalState *global_state = nullptr;
 
 }
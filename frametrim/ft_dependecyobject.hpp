@@ -31,20 +31,49 @@
 
 namespace frametrim {
 
-class UsedObject {
+class ObjectCloner;
+
+/* Part of the data of a buffer, or of one texture level, that is written
+ * by an upload call. Buffers only use the first dimension. */
+struct UploadRegion {
+    unsigned level = 0;
+    uint64_t begin[3] = {0, 0, 0};
+    uint64_t end[3] = {UINT64_MAX, 1, 1};
+
+    /* The call (re)allocates the storage of the level, such a call can
+     * only be replaced by another one that allocates the storage */
+    bool respecify = false;
+};
+
+class UsedObject : public std::enable_shared_from_this<UsedObject> {
 public:
     using Pointer = std::shared_ptr<UsedObject>;
 
     UsedObject(unsigned id);
+    virtual ~UsedObject() = default;
+
+    /* Copy the object, the dependencies still point to the original
+     * objects until remap is called */
+    virtual Pointer clone() const;
+    virtual void remap(ObjectCloner& cloner);
 
     unsigned id() const;
 
-    void addCall(PTraceCall call);
-    void setCall(PTraceCall call);
+    void addCall(TraceCall call);
+    void setCall(TraceCall call);
 
     void addDependency(Pointer dep);
     void setDependency(Pointer dep);
 
+    /* Record a call that writes the given region of the object's data.
+     * Earlier uploads that are overwritten completely before anything
+     * could read them are dropped from the call list. */
+    void addUpload(TraceCall call, const UploadRegion& region);
+
+    /* The current data of the object and of its dependencies may be
+     * read, so all uploads recorded so far must be kept. */
+    void pinUploads();
+
     void emitCallsTo(CallSet& out_list);
     bool emitted() const;
 
@@ -54,20 +83,61 @@ public:
 
     bool createdBefore(unsigned callno) const;
 
-    auto calls() { return m_calls; }
+    const std::vector<unsigned>& nonRepeatCalls() const { return m_non_repeat_calls; }
 private:
+    struct PendingUpload {
+        unsigned call_no;
+        unsigned level;
+        bool respecify;
+        /* Parts of the upload that were not overwritten yet */
+        std::vector<UploadRegion> live;
+    };
+
+    void dropCall(unsigned call_no);
+    void markUploadsDirty();
 
-    std::vector<PTraceCall> m_calls;
+    std::vector<unsigned> m_calls;
+    std::vector<unsigned> m_non_repeat_calls;
     std::vector<Pointer> m_dependencies;
+    std::unordered_set<const UsedObject *> m_dependency_set;
+
+    /* Uploads that may still be dropped, and the objects that depend on
+     * this one, so that they know that a dependency has such uploads. */
+    std::vector<PendingUpload> m_pending_uploads;
+    std::unordered_map<const UsedObject *, std::weak_ptr<UsedObject>> m_dependents;
+    bool m_uploads_dirty = false;
     unsigned m_id;
     bool m_emitted;
     std::unordered_map<std::string, unsigned> m_extra_info;
 };
 
+/* Creates a deep copy of a graph of objects, every object is copied
+ * only once, so shared objects and dependency cycles are preserved. */
+class ObjectCloner {
+public:
+    UsedObject::Pointer operator () (const UsedObject::Pointer& obj);
+
+    template <typename T>
+    std::shared_ptr<T> get(const std::shared_ptr<T>& obj) {
+        return std::static_pointer_cast<T>((*this)(obj));
+    }
+
+    /* Remap the dependencies of all objects copied so far */
+    void finish();
+private:
+    std::unordered_map<const UsedObject *, UsedObject::Pointer> m_clones;
+    std::vector<UsedObject::Pointer> m_pending;
+};
+
 class DependecyObjectMap {
 public:
     using ObjectMap=std::unordered_map<unsigned, UsedObject::Pointer>;
 
+    virtual ~DependecyObjectMap() = default;
+
+    /* Replace all objects by their copies */
+    virtual void remap(ObjectCloner& cloner);
+
     void generate(const trace::Call& call);
     void destroy(const trace::Call& call);
 
@@ -76,9 +146,11 @@ public:
 
     UsedObject::Pointer bind(const trace::Call& call, unsigned obj_id_param);
     void callOnBoundObject(const trace::Call& call);
+    UsedObject::Pointer readBoundObject(const trace::Call& call);
     UsedObject::Pointer bindWithCreate(const trace::Call& call, unsigned obj_id_param);
     void callOnObjectBoundTo(const trace::Call& call, unsigned bindpoint);
     void callOnNamedObject(const trace::Call& call);
+    UsedObject::Pointer readNamedObject(const trace::Call& call);
     UsedObject::Pointer
     callOnBoundObjectWithDep(const trace::Call& call,
                              DependecyObjectMap& other_objects, int dep_obj_param, bool reverse_dep_too);
@@ -96,7 +168,7 @@ public:
                                        int dep_call_param);
 
     UsedObject::Pointer getById(unsigned id) const;
-    void addCall(PTraceCall call);
+    void addCall(TraceCall call);
 
     void emitBoundObjects(CallSet& out_calls);
     UsedObject::Pointer boundTo(unsigned target, unsigned index = 0);
@@ -141,7 +213,7 @@ private:
     ObjectMap m_objects;
     std::unordered_map<uint32_t, ObjectMap> m_bound_object;
 
-    std::vector<PTraceCall> m_calls;
+    std::vector<unsigned> m_calls;
 
     uint32_t m_current_context_id {0xffffffff};
 };
@@ -190,11 +262,17 @@ public:
     void namedUnmap(const trace::Call& call);
 
     void namedData(const trace::Call& call);
+    void subData(const trace::Call& call);
+    void namedSubData(const trace::Call& call);
+    void clearData(const trace::Call& call);
+    void namedClearData(const trace::Call& call);
 
     UsedObject::Pointer boundToTarget(unsigned target);
 
     void addSSBODependencies(UsedObject::Pointer dep);
 
+    void remap(ObjectCloner& cloner) override;
+
     void copyBufferSubData(const trace::Call& call);
     void copyNamedBufferSubData(const trace::Call& call);
 
@@ -233,6 +311,11 @@ public:
     void addImageDependencies(UsedObject::Pointer dep);
     void unbindUnits(unsigned first, unsigned count);
     void generateWithTarget(const trace::Call& call); 
+    void upload(const trace::Call& call, DependecyObjectMap& buffers,
+                unsigned dims, bool sub);
+    void namedUpload(const trace::Call& call, DependecyObjectMap& buffers,
+                     unsigned dims, bool sub);
+    void remap(ObjectCloner& cloner) override;
 private:
     void emitBoundObjectsExt(CallSet& out_calls) override;
     unsigned getBindpointFromCall(const trace::Call& call) const override;
@@ -286,7 +369,8 @@ struct GlobalState {
     UsedObject::Pointer current_vao;
 };
 
-extern GlobalState global_state;
+/* State of the trimmer that is currently processing a call */
+extern GlobalState *global_state;
 
 
 }
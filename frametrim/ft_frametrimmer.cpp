@@ -41,6 +41,22 @@ FrameTrimmer::FrameTrimmer(bool keep_all_states, bool swap_to_finish):
 {
 }
 
+FrameTrimmer::FrameTrimmer(const FrameTrimmer& other):
+    m_last_swap(other.m_last_swap),
+    m_recording_frame(other.m_recording_frame),
+    m_keep_all_state_calls(other.m_keep_all_state_calls),
+    m_swaps_to_finish(other.m_swaps_to_finish),
+    m_last_frame_start(other.m_last_frame_start),
+    m_current_thread(other.m_current_thread),
+    m_required_calls(other.m_required_calls),
+    m_unhandled_calls(other.m_unhandled_calls),
+    m_swap_calls(other.m_swap_calls),
+    m_skip_loop_calls(other.m_skip_loop_calls)
+{
+    /* The call handlers are bound to the owning trimmer, so the copy
+     * has to resolve them again */
+}
+
 bool
 FrameTrimmer::isSupported(trace::API api)
 {
@@ -58,12 +74,36 @@ FrameTrimmer::create(trace::API api, bool keep_all_states, bool swap_to_finish)
     }
 }
 
+const ft_call_handler&
+FrameTrimmer::handlerForSig(const trace::FunctionSig *sig)
+{
+    trace::Id id = sig->id;
+    if (id >= m_callbacks.size())
+        m_callbacks.resize(id + 1);
+
+    if (!m_callbacks[id]) {
+        auto handler = findCallback(sig->name);
+        if (!handler.callback)
+            handler.needed_args = 0;
+        m_callbacks[id] = std::make_unique<ft_call_handler>(handler);
+    }
+    return *m_callbacks[id];
+}
+
+unsigned
+FrameTrimmer::neededArgs(const trace::FunctionSig *sig)
+{
+    return handlerForSig(sig).needed_args;
+}
+
 void
 FrameTrimmer::call(const trace::Call& call, Frametype frametype)
 {
     const char *call_name = call.name();
     bool end_frame = (call.flags & trace::CALL_FLAG_END_FRAME);
 
+    activate();
+
     if (!m_recording_frame && (frametype != ft_none)) {
         std::cerr << "Start recording\n";
         m_recording_frame = true;
@@ -75,10 +115,12 @@ FrameTrimmer::call(const trace::Call& call, Frametype frametype)
         m_recording_frame = false;
     }
 
+    auto& handler = handlerForSig(call.sig);
+
     /* Skip delete calls for objects that have never been emitted, or
      * if we are in the last frame and the object was created in an earlier frame.
      * By not deleting such objects looping the last frame will work in more cases */
-    if (skipDeleteObj(call)) {
+    if (handler.deletes_objects && skipDeleteObj(call)) {
         return;
     }
 
@@ -87,22 +129,14 @@ FrameTrimmer::call(const trace::Call& call, Frametype frametype)
         m_current_thread = call.thread_id;
     }
 
-    auto icb = m_call_table_cache.find(call_name);
-    if (icb != m_call_table_cache.end())
-        icb->second(call);
-    else {
-        auto func = findCallback(call_name);
-        if (func) {
-            m_call_table_cache[call_name] = func;
-            func(call);
-        } else if (!end_frame) {
-            /* This should be some debug output only, because we might
-             * not handle some calls deliberately */
-            if (m_unhandled_calls.find(call_name) == m_unhandled_calls.end()) {
-                std::cerr << "Call " << call.no
-                          << " " << call_name << " not handled\n";
-                m_unhandled_calls.insert(call_name);
-            }
+    if (handler.callback) {
+        handler.callback(call);
+    } else if (!end_frame) {
+        /* This should be some debug output only, because we might
+         * not handle some calls deliberately */
+        if (m_unhandled_calls.insert(call.sig->id).second) {
+            std::cerr << "Call " << call.no
+                      << " " << call_name << " not handled\n";
         }
     }
 
@@ -112,7 +146,7 @@ FrameTrimmer::call(const trace::Call& call, Frametype frametype)
         if (end_frame) {
             if (m_swaps_to_finish && m_last_swap) {
                 m_required_calls.insert(c);
-                m_swap_calls.insert(m_last_swap->callNo());
+                m_swap_calls.insert(m_last_swap.callNo());
             }
             m_last_swap = c;
         }
@@ -124,7 +158,7 @@ FrameTrimmer::call(const trace::Call& call, Frametype frametype)
                 m_required_calls.insert(c);
                 if (m_last_swap) {
                     m_required_calls.insert(m_last_swap);
-                    m_last_swap = nullptr;
+                    m_last_swap = TraceCall();
                 }
             } else
                 m_last_swap = c;
@@ -142,6 +176,7 @@ FrameTrimmer::start_last_frame(uint32_t callno)
 void
 FrameTrimmer::end_last_frame()
 {
+    activate();
     finalize();
     if (m_last_swap)
         m_required_calls.insert(m_last_swap);
@@ -162,21 +197,23 @@ FrameTrimmer::get_swap_to_finish_calls()
 std::vector<unsigned>
 FrameTrimmer::getSortedCallIds()
 {
-    auto make_sure_its_singular = getUniqueCallIds();
+    /* The call set is a bitmap, so it is already sorted and unique */
+    return std::vector<unsigned>(m_required_calls.begin(),
+                                 m_required_calls.end());
+}
 
-    std::vector<unsigned> sorted_calls(
-                make_sure_its_singular.begin(),
-                make_sure_its_singular.end());
-    std::sort(sorted_calls.begin(), sorted_calls.end());
-    return sorted_calls;
+const CallSet&
+FrameTrimmer::getRequiredCalls() const
+{
+    return m_required_calls;
 }
 
 std::unordered_set<unsigned>
 FrameTrimmer::getUniqueCallIds()
 {
     std::unordered_set<unsigned> retval;
-    for (auto&& c: m_required_calls)
-        retval.insert(c->callNo());
+    for (auto&& callno: m_required_calls)
+        retval.insert(callno);
     return retval;
 }
 
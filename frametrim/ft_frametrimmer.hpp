@@ -31,6 +31,7 @@
 #include "trace_parser.hpp"
 
 #include <functional>
+#include <memory>
 #include <set>
 #include <unordered_set>
 #include <vector>
@@ -39,6 +40,18 @@ namespace frametrim {
 
 using ft_callback = std::function<void(const trace::Call&)>;
 
+/* A call handler together with the number of leading call arguments it
+ * looks at, so that the parser can skip decoding all the others. */
+struct ft_call_handler {
+    ft_call_handler(ft_callback cb = nullptr,
+                    unsigned nargs = trace::Parser::ALL_ARGS):
+        callback(cb), needed_args(nargs) {}
+
+    ft_callback callback;
+    unsigned needed_args;
+    bool deletes_objects = false;
+};
+
 struct string_part_less {
     bool operator () (const char *lhs, const char *rhs) const
     {
@@ -57,6 +70,12 @@ class FrameTrimmer
 {
 public:
     FrameTrimmer(bool keep_all_states, bool swap_to_finish);
+    virtual ~FrameTrimmer() = default;
+
+    /* Create an independent copy of the trimmer that continues from
+     * the current state, used to branch off when processing several
+     * target frame ranges in one pass over the trace. */
+    virtual std::shared_ptr<FrameTrimmer> clone() const = 0;
 
     static bool isSupported(trace::API api);
     static std::shared_ptr<FrameTrimmer> create(trace::API api, bool keep_all_states, bool swap_to_finish);
@@ -70,19 +89,28 @@ public:
 
     std::vector<unsigned> getSortedCallIds();
     std::unordered_set<unsigned> getUniqueCallIds();
+    const CallSet& getRequiredCalls() const;
 
     virtual void switch_thread(int new_thread) {}
 
+    unsigned neededArgs(const trace::FunctionSig *sig);
+
 protected:
+    FrameTrimmer(const FrameTrimmer& other);
+
+    /* Make this trimmer the one the object maps report to */
+    virtual void activate() {};
     virtual void emitState() {};
     virtual void finalize() {};
-    virtual ft_callback findCallback(const char *name) = 0;
+    virtual ft_call_handler findCallback(const char *name) = 0;
     virtual bool skipDeleteObj(const trace::Call& call) = 0;
 
-    using CallTableCache =  std::map<const char *, ft_callback>;
-    CallTableCache m_call_table_cache;
+    const ft_call_handler& handlerForSig(const trace::FunctionSig *sig);
+
+    /* Call handlers indexed by signature id, resolved on first use */
+    std::vector<std::unique_ptr<ft_call_handler>> m_callbacks;
 
-    PTraceCall m_last_swap;
+    TraceCall m_last_swap;
     bool m_recording_frame;
     bool m_keep_all_state_calls;
     bool m_swaps_to_finish;
@@ -90,7 +118,7 @@ protected:
     int m_current_thread;
 
     CallSet m_required_calls;
-    std::set<std::string> m_unhandled_calls;
+    std::unordered_set<unsigned> m_unhandled_calls;
     std::unordered_set<unsigned> m_swap_calls;
     std::unordered_set<unsigned> m_skip_loop_calls;
 };
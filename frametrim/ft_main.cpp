@@ -36,13 +36,30 @@
 #include "trace_parser.hpp"
 #include "trace_writer.hpp"
 
+#include "thread_pool.hpp"
+
 #include <limits.h> // for CHAR_MAX
 #include <getopt.h>
+#include <atomic>
 #include <memory>
 #include <queue>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 using namespace frametrim;
 
+struct trim_target {
+    /* Frames to be included in trace. */
+    trace::CallSet setupframes;
+
+    /* Frames to keep replayable */
+    trace::CallSet frames;
+
+    /* Output filename */
+    std::string output;
+};
+
 struct trim_options {
     /* Frames to be included in trace. */
     trace::CallSet setupframes;
@@ -50,6 +67,9 @@ struct trim_options {
     /* Frames to keep replayable */
     trace::CallSet frames;
 
+    /* Additional traces to create in the same pass */
+    std::vector<trim_target> targets;
+
     unsigned top_frame_call_counts;
     bool keep_all_states;
     bool swap_to_finish;
@@ -70,6 +90,9 @@ usage(void)
                            "    -h, --help               Show detailed help for trim options and exit\n"
                            "    -f, --frames=FRAME       Frame the trace should be reduced to.\n"
                            "    -s, --setupframes=FRAME  Frame that are kept in the trace but but without the end-of-frame command.\n"
+                           "    -T, --target=FRAMES[:SETUPFRAMES[:TRACE_FILE]]\n"
+                           "                             Create an additional trace for the given frames, can be repeated\n"
+                           "                             to trim to several frame sets in one pass over the input trace\n"
                            "    -t, --top-calls-per-frame=NUMBER Print NUMBER of frames with the top amount of OpenGL calls\n"
                            "    -k, --keep-all-states    Keep all state calls in the trace (This may help with textures that are created by using FBO\n"
                            "    -F, --swap-to-finish     Replace swaps in the setup frame with glFinish\n"
@@ -79,11 +102,12 @@ usage(void)
 
 enum {
     FRAMES_OPT = 'f',
-    SETUPFRAMES_OPT = 's'
+    SETUPFRAMES_OPT = 's',
+    TARGET_OPT = 'T'
 };
 
 const static char *
-shortOptions = "t:hkFo:f:s:x";
+shortOptions = "t:hkFo:f:s:T:x";
 
 bool operator < (std::pair<unsigned, unsigned>& lhs, std::pair<unsigned, unsigned>& rhs)
 {
@@ -96,12 +120,167 @@ longOptions[] = {
     {"top-calls-per-frame", required_argument, 0, 't'},
     {"frames", required_argument, 0, 'f'},
     {"setupframes", required_argument, 0, 's'},
+    {"target", required_argument, 0, 'T'},
     {"keep-all-states", no_argument, 0, 'k'},
     {"swap-to-finish", no_argument, 0, 'F'},
     {"output", required_argument, 0, 'o'},
     {0, 0, 0, 0}
 };
 
+static bool
+parse_target(const char *arg, trim_target& target)
+{
+    std::string spec(arg);
+    std::string parts[3];
+    unsigned n = 0;
+    size_t pos = 0;
+
+    while (n < 3) {
+        size_t sep = n < 2 ? spec.find(':', pos) : std::string::npos;
+        parts[n++] = spec.substr(pos, sep - pos);
+        if (sep == std::string::npos)
+            break;
+        pos = sep + 1;
+    }
+
+    if (parts[0].empty())
+        return false;
+
+    target.frames = trace::CallSet(trace::FREQUENCY_NONE);
+    target.frames.merge(parts[0].c_str());
+    if (!parts[1].empty())
+        target.setupframes.merge(parts[1].c_str());
+    target.output = parts[2];
+    return true;
+}
+
+/* Everything the writer needs to know about a trimmed trace, copied out
+ * of the trimmer so that the scan can go on while the output is written */
+struct trim_result {
+    std::string out_filename;
+    CallSet call_ids;
+    std::unordered_set<unsigned> skip_loop_calls;
+    std::unordered_set<unsigned> swap_calls;
+    uint32_t last_frame_start;
+};
+
+/* State of one target frame set during the scan */
+struct trim_state {
+    const trim_target *target;
+    std::string out_filename;
+    std::shared_ptr<FrameTrimmer> trimmer;
+    uint32_t last_frame_start = 0;
+    Frametype frametype = ft_none;
+    bool done = false;
+};
+
+static int
+write_trimmed_trace(const char *filename, const trim_result& result,
+                    bool swap_to_finish)
+{
+    trace::Parser p;
+    const char *out_filename = result.out_filename.c_str();
+    auto& call_ids = result.call_ids;
+    auto& skip_loop_calls = result.skip_loop_calls;
+    auto& swap_calls = result.swap_calls;
+    auto last_frame_start = result.last_frame_start;
+
+    /* The kept calls are copied as they are, so there's no need to decode
+     * them. */
+    p.setRecordRawCalls(true);
+
+    if (!p.open(filename)) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return 1;
+    }
+
+    trace::Writer writer;
+    if (!writer.open(out_filename, p.getVersion(), p.getProperties())) {
+        std::cerr << "error: failed to create " << out_filename << "\n";
+        return 2;
+    }
+
+    std::cerr << out_filename << ": Copying " << call_ids.size() << " calls\n";
+    if (call_ids.empty())
+        return 0;
+
+    /* Don't read the trace beyond the last call that is needed */
+    unsigned last_call = call_ids.last();
+
+    bool raw = p.recordsRawCalls();
+    auto next_call = [&p, raw]() {
+        return raw ? p.scan_call() : p.parse_call();
+    };
+    auto write_call = [&writer](trace::Call *call) {
+        if (call->raw)
+            writer.writeRawCall(call);
+        else
+            writer.writeCall(call);
+    };
+
+    int call_id = 0;
+    const trace::FunctionSig glFinishSig = {0, "glFinish", 0, NULL};
+
+    auto is_skip_loop_call = [&skip_loop_calls](unsigned no) {
+        return skip_loop_calls.find(no) != skip_loop_calls.end();
+    };
+
+    // Write setup calls in last frame  before last frame starts
+    p.setRawCallFilter([&](const trace::Call *c) {
+        return call_ids.contains(c->no) &&
+               (c->no < last_frame_start || is_skip_loop_call(c->no)) &&
+               !(swap_to_finish && swap_calls.find(c->no) != swap_calls.end());
+    });
+    std::unique_ptr<trace::Call> call(next_call());
+    while (1) {
+        while (call && call->no <= last_call && !call_ids.contains(call->no))
+            call.reset(next_call());
+
+        if (!call || call->no > last_call)
+            break;
+
+        if (call->no < last_frame_start || is_skip_loop_call(call->no)) {
+
+            if (swap_to_finish &&
+                    swap_calls.find(call->no) != swap_calls.end()) {
+                call.reset(new trace::Call(&glFinishSig, 0, call->thread_id));
+            }
+
+            call->no = call_id++;
+            write_call(call.get());
+        }
+        call.reset(next_call());
+    }
+
+    // Now write the last frame without the setup calls
+    p.close();
+    p.setRawCallFilter([&](const trace::Call *c) {
+        return call_ids.contains(c->no) &&
+               c->no >= last_frame_start && !is_skip_loop_call(c->no);
+    });
+    p.open(filename);
+    call.reset(next_call());
+
+    while (1) {
+        while (call && call->no <= last_call &&
+               (call->no < last_frame_start ||
+                !call_ids.contains(call->no)))
+            call.reset(next_call());
+
+        if (!call || call->no > last_call)
+            break;
+
+        if (!is_skip_loop_call(call->no)) {
+            call->no = call_id++;
+            write_call(call.get());
+        }
+        call.reset(next_call());
+    }
+
+    std::cerr << out_filename << ": Done\n";
+    return 0;
+}
+
 static int trim_to_frame(const char *filename,
                          const struct trim_options& options)
 {
@@ -114,23 +293,40 @@ static int trim_to_frame(const char *filename,
         return 1;
     }
 
-    if (options.frames.getLast() < options.setupframes.getLast() &&
-        !options.setupframes.empty()) {
-        std::cerr << "error: last frame to keep ("
-                  << options.frames.getLast()
-                  << ") must be larger than last key frame"
-                  << options.setupframes.getLast() << "\n";
-        return 1;
-    }
+    std::vector<trim_target> targets = options.targets;
+    if (targets.empty() || !options.frames.empty())
+        targets.insert(targets.begin(),
+                       trim_target{options.setupframes, options.frames, options.output});
+
+    os::String base(filename);
+    base.trimExtension();
+
+    std::vector<trim_state> states(targets.size());
+    unsigned last_frame = 0;
+    for (unsigned i = 0; i < targets.size(); ++i) {
+        auto& target = targets[i];
+        if (target.frames.getLast() < target.setupframes.getLast() &&
+            !target.setupframes.empty()) {
+            std::cerr << "error: last frame to keep ("
+                      << target.frames.getLast()
+                      << ") must be larger than last key frame"
+                      << target.setupframes.getLast() << "\n";
+            return 1;
+        }
 
-    auto out_filename = options.output;
+        auto& state = states[i];
+        state.target = &target;
+        state.out_filename = target.output;
 
-    /* Prepare output file and writer for output. */
-    if (options.output.empty()) {
-        os::String base(filename);
-        base.trimExtension();
+        /* Prepare output file and writer for output. */
+        if (state.out_filename.empty()) {
+            state.out_filename = std::string(base.str()) + std::string("-trim");
+            if (targets.size() > 1)
+                state.out_filename += "-" + std::to_string(target.frames.getLast());
+            state.out_filename += ".trace";
+        }
 
-        out_filename = std::string(base.str()) + std::string("-trim.trace");
+        last_frame = std::max(last_frame, target.frames.getLast());
     }
 
     frame = 0;
@@ -145,34 +341,98 @@ static int trim_to_frame(const char *filename,
         std::cerr << "error: unsupported API" << std::endl;
         return 1;
     }
+
+    /* All targets share the history up to their first frame, so only
+     * one trimmer tracks it, and a copy is branched off for each target
+     * when its frames start. */
+    auto trimmer = FrameTrimmer::create(p.api, options.keep_all_states, options.swap_to_finish);
+
+    /* Only decode the call arguments the trimmer actually looks at, this
+     * doesn't depend on the state, so any trimmer will do */
+    auto args_trimmer = trimmer->clone();
     p.close();
+    p.setDecodedArgsCallback([args_trimmer](const trace::FunctionSig *sig) {
+        return args_trimmer->neededArgs(sig);
+    });
     p.open(filename);
     call.reset(p.parse_call());
 
-    auto trimmer = FrameTrimmer::create(p.api, options.keep_all_states, options.swap_to_finish);
+    auto branch = [&](trim_state& state) {
+        bool others_waiting = false;
+        for (auto& s : states)
+            others_waiting |= &s != &state && !s.done && !s.trimmer;
+
+        /* The last target to start can take over the shared trimmer */
+        if (others_waiting)
+            state.trimmer = trimmer->clone();
+        else
+            state.trimmer = std::move(trimmer);
+    };
+
+    std::atomic<int> status(0);
+    std::unique_ptr<ThreadPool> pool(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+
+    auto finish = [&](trim_state& state) {
+        if (!state.trimmer)
+            branch(state);
+
+        state.trimmer->end_last_frame();
+
+        auto result = std::make_shared<trim_result>();
+        result->out_filename = state.out_filename;
+        result->call_ids = state.trimmer->getRequiredCalls();
+        result->skip_loop_calls = state.trimmer->get_skip_loop_calls();
+        result->swap_calls = state.trimmer->get_swap_to_finish_calls();
+        result->last_frame_start = state.last_frame_start;
+
+        state.trimmer = nullptr;
+        state.done = true;
+
+        std::cerr << "\nDone scanning frames for " << state.out_filename << "\n";
+        pool->enqueue([filename, result, &options, &status]() {
+            int retval = write_trimmed_trace(filename, *result, options.swap_to_finish);
+            if (retval)
+                status = retval;
+        });
+    };
 
     unsigned calls_in_this_frame = 0;
-    uint32_t last_frame_start = 0;
 
     while (call) {
         /* There's no use doing any work past the last call and frame
         * requested by the user. */
-        if (frame > options.frames.getLast()) {
+        if (frame > last_frame) {
             break;
         }
 
-        Frametype ft = ft_none;
-        if (options.setupframes.contains(frame, call->flags))
-            ft = ft_key_frame;
-        if (options.frames.contains(frame, call->flags)) {
-            ft = ft_retain_frame;
-            if ((last_frame_start == 0) && frame == options.frames.getLast()) {
-                last_frame_start = call->no - 1;
-                trimmer->start_last_frame(last_frame_start);
+        for (auto& state : states) {
+            if (state.done)
+                continue;
+
+            auto& target = *state.target;
+            Frametype ft = ft_none;
+            if (target.setupframes.contains(frame, call->flags))
+                ft = ft_key_frame;
+            if (target.frames.contains(frame, call->flags))
+                ft = ft_retain_frame;
+
+            if (ft != ft_none && !state.trimmer)
+                branch(state);
+
+            if (ft == ft_retain_frame &&
+                (state.last_frame_start == 0) && frame == target.frames.getLast()) {
+                state.last_frame_start = call->no - 1;
+                state.trimmer->start_last_frame(state.last_frame_start);
             }
+            state.frametype = ft;
         }
 
-        trimmer->call(*call, ft);
+        if (trimmer)
+            trimmer->call(*call, ft_none);
+        for (auto& state : states) {
+            if (state.trimmer)
+                state.trimmer->call(*call, state.frametype);
+        }
 
         if (call->flags & trace::CALL_FLAG_END_FRAME) {
             if (options.top_frame_call_counts > 0) {
@@ -180,86 +440,28 @@ static int trim_to_frame(const char *filename,
             }
             calls_in_this_frame = 0;
             frame++;
+
+            for (auto& state : states) {
+                if (!state.done && frame > state.target->frames.getLast())
+                    finish(state);
+            }
         }
 
         callid++;
         if (!(callid & 0xff))
             std::cerr << "\rScanning frame:" << frame
-                      << " type:" << ft
                       << " call:" << call->no;
 
         call.reset(p.parse_call());
         ++calls_in_this_frame;
     }
 
-    trimmer->end_last_frame();
-    auto skip_loop_calls = trimmer->get_skip_loop_calls();
-    auto swap_calls = trimmer->get_swap_to_finish_calls();
-
-    std::cerr << "\nDone scanning frames\n";
-
-    trace::Writer writer;
-    if (!writer.open(out_filename.c_str(), p.getVersion(), p.getProperties())) {
-        std::cerr << "error: failed to create " << out_filename << "\n";
-        return 2;
+    for (auto& state : states) {
+        if (!state.done)
+            finish(state);
     }
 
-    auto call_ids = trimmer->getUniqueCallIds();
-    std::cerr << "Write output file\n";
-
-    p.close();
-    p.open(filename);
-    call.reset(p.parse_call());
-
-    std::cerr << "Copying " << call_ids.size() << " calls\n";
-    std::cerr << "Write calls before " << last_frame_start << " and setup calls from last frame\n";
-
-    int call_id = 0;
-    const trace::FunctionSig glFinishSig = {0, "glFinish", 0, NULL};
-
-    while (1) {
-        while (call && call_ids.find(call->no) == call_ids.end())
-            call.reset(p.parse_call());
-
-        if (!call)
-            break;
-
-        // Write setup calls in last frame  before last frame starts
-        if (call->no < last_frame_start ||
-                skip_loop_calls.find(call->no) != skip_loop_calls.end()) {
-
-            if (options.swap_to_finish &&
-                    swap_calls.find(call->no) != swap_calls.end()) {
-                call.reset(new trace::Call(&glFinishSig, 0, call->thread_id));
-            }
-
-            call->no = call_id++;
-            writer.writeCall(call.get());
-        }
-        call.reset(p.parse_call());
-    }
-
-    // Now write the last frame without the setup calls
-    p.close();
-    p.open(filename);
-    call.reset(p.parse_call());
-
-    std::cerr << "Write calls after " << last_frame_start << " without setup calls\n";
-    while (1) {
-        while (call &&
-               (call->no < last_frame_start ||
-                call_ids.find(call->no) == call_ids.end()))
-            call.reset(p.parse_call());
-
-        if (!call)
-            break;
-
-        if (skip_loop_calls.find(call->no) == skip_loop_calls.end()) {
-            call->no = call_id++;
-            writer.writeCall(call.get());
-        }
-        call.reset(p.parse_call());
-    }
+    std::cerr << "\nDone scanning frames\n";
 
     if (options.top_frame_call_counts) {
         unsigned count = options.top_frame_call_counts;
@@ -271,7 +473,10 @@ static int trim_to_frame(const char *filename,
         }
     }
 
-    return 0;
+    /* ~ThreadPool waits for all outputs to be written */
+    pool.reset();
+
+    return status;
 }
 
 
@@ -295,6 +500,16 @@ int main(int argc, char **argv)
         case SETUPFRAMES_OPT:
             options.setupframes.merge(optarg);
             break;
+        case TARGET_OPT: {
+            trim_target target;
+            if (!parse_target(optarg, target)) {
+                std::cerr << "error: invalid target `" << optarg << "`\n";
+                usage();
+                return 1;
+            }
+            options.targets.push_back(target);
+            break;
+        }
         case 'o':
             options.output = optarg;
             break;
@@ -41,6 +41,19 @@ MatrixState::MatrixState(MatrixState::Pointer parent):
 
 }
 
+UsedObject::Pointer
+MatrixState::clone() const
+{
+    return std::make_shared<MatrixState>(*this);
+}
+
+void
+MatrixState::remap(ObjectCloner& cloner)
+{
+    UsedObject::remap(cloner);
+    m_parent = cloner.get(m_parent);
+}
+
 void
 MatrixState::selectMatrixType(const trace::Call& call)
 {
@@ -74,6 +87,44 @@ AllMatrisStates::AllMatrisStates()
     m_current_matrix_stack = &m_mv_matrix;
 }
 
+AllMatrisStates::AllMatrisStates(const AllMatrisStates& other):
+    m_mv_matrix(other.m_mv_matrix),
+    m_proj_matrix(other.m_proj_matrix),
+    m_texture_matrix(other.m_texture_matrix),
+    m_color_matrix(other.m_color_matrix),
+    m_current_matrix(other.m_current_matrix)
+{
+    if (other.m_current_matrix_stack == &other.m_proj_matrix)
+        m_current_matrix_stack = &m_proj_matrix;
+    else if (other.m_current_matrix_stack == &other.m_texture_matrix)
+        m_current_matrix_stack = &m_texture_matrix;
+    else if (other.m_current_matrix_stack == &other.m_color_matrix)
+        m_current_matrix_stack = &m_color_matrix;
+    else
+        m_current_matrix_stack = &m_mv_matrix;
+}
+
+static void
+remapStack(std::stack<PMatrixState>& stack, ObjectCloner& cloner)
+{
+    std::vector<PMatrixState> entries;
+    while (!stack.empty()) {
+        entries.push_back(cloner.get(stack.top()));
+        stack.pop();
+    }
+    for (auto i = entries.rbegin(); i != entries.rend(); ++i)
+        stack.push(*i);
+}
+
+void AllMatrisStates::remap(ObjectCloner& cloner)
+{
+    remapStack(m_mv_matrix, cloner);
+    remapStack(m_proj_matrix, cloner);
+    remapStack(m_texture_matrix, cloner);
+    remapStack(m_color_matrix, cloner);
+    m_current_matrix = cloner.get(m_current_matrix);
+}
+
 void AllMatrisStates::emitStateTo(CallSet& list) const
 {
     if (!m_mv_matrix.empty())
@@ -39,12 +39,15 @@ public:
 
     MatrixState(Pointer parent);
 
+    UsedObject::Pointer clone() const override;
+    void remap(ObjectCloner& cloner) override;
+
     void selectMatrixType(const trace::Call& call);
     void setMatrix(const trace::Call& call);
 
 private:
     Pointer m_parent;
-    PTraceCall m_type_select_call;
+    TraceCall m_type_select_call;
 };
 
 using PMatrixState = std::shared_ptr<MatrixState>;
@@ -53,6 +56,9 @@ class AllMatrisStates {
 public:
 
     AllMatrisStates();
+    AllMatrisStates(const AllMatrisStates& other);
+
+    void remap(ObjectCloner& cloner);
 
     void loadIdentity(const trace::Call& call);
     void loadMatrix(const trace::Call& call);
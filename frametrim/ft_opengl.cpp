@@ -30,7 +30,6 @@
 #include <unordered_set>
 #include <algorithm>
 #include <functional>
-#include <sstream>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -57,7 +56,98 @@ uint32_t PerContextObjects::m_next_id = 1;
 
 OpenGLImpl::OpenGLImpl(bool keep_all_states, bool swaps_to_finish):
     FrameTrimmer(keep_all_states, swaps_to_finish),
-    m_fbo_ext(1)
+    m_fbo_ext(1),
+    m_report_aliases(true)
+{
+    registerCalls();
+
+    m_global_state.out_list = &m_required_calls;
+    m_global_state.emit_dependencies = m_recording_frame;
+}
+
+OpenGLImpl::OpenGLImpl(const OpenGLImpl& other):
+    FrameTrimmer(other),
+    m_display_lists(other.m_display_lists),
+    m_active_display_list(other.m_active_display_list),
+    m_matrix_states(other.m_matrix_states),
+    m_legacy_programs(other.m_legacy_programs),
+    m_programs(other.m_programs),
+    m_textures(other.m_textures),
+    m_buffers(other.m_buffers),
+    m_shaders(other.m_shaders),
+    m_renderbuffers(other.m_renderbuffers),
+    m_samplers(other.m_samplers),
+    m_sync_objects(other.m_sync_objects),
+    m_vertex_attrib_pointers(other.m_vertex_attrib_pointers),
+    m_vertex_buffer_pointers(other.m_vertex_buffer_pointers),
+    m_fbo_ext(other.m_fbo_ext),
+    m_queries(other.m_queries),
+    m_state_calls(other.m_state_calls),
+    m_enables(other.m_enables),
+    m_global_state(other.m_global_state),
+    m_report_aliases(false)
+{
+    registerCalls();
+
+    /* The object graph is shared with the original trimmer, so give
+     * this copy its own objects */
+    ObjectCloner cloner;
+
+    for (auto&& [id, list]: m_display_lists)
+        list = cloner(list);
+    m_active_display_list = cloner(m_active_display_list);
+
+    m_matrix_states.remap(cloner);
+
+    m_legacy_programs.remap(cloner);
+    m_programs.remap(cloner);
+    m_textures.remap(cloner);
+    m_buffers.remap(cloner);
+    m_shaders.remap(cloner);
+    m_renderbuffers.remap(cloner);
+    m_samplers.remap(cloner);
+    m_sync_objects.remap(cloner);
+    m_vertex_attrib_pointers.remap(cloner);
+    m_vertex_buffer_pointers.remap(cloner);
+    m_fbo_ext.remap(cloner);
+    m_queries.remap(cloner);
+
+    std::unordered_map<const PerContextObjects *,
+                       std::shared_ptr<PerContextObjects>> contexts;
+    for (auto&& [key, ctx]: other.m_contexts) {
+        auto copy = make_shared<PerContextObjects>(*ctx);
+        copy->m_vertex_arrays.remap(cloner);
+        copy->m_program_pipelines.remap(cloner);
+        copy->m_fbo.remap(cloner);
+        contexts[ctx.get()] = copy;
+        m_contexts[key] = copy;
+    }
+
+    if (other.m_current_context)
+        m_current_context = contexts[other.m_current_context.get()];
+    for (auto&& [thread, ctx]: other.m_thread_active_context)
+        m_thread_active_context[thread] = ctx ? contexts[ctx.get()] : nullptr;
+
+    m_global_state.out_list = &m_required_calls;
+    m_global_state.current_vao = cloner(other.m_global_state.current_vao);
+
+    cloner.finish();
+}
+
+std::shared_ptr<FrameTrimmer>
+OpenGLImpl::clone() const
+{
+    return make_shared<OpenGLImpl>(*this);
+}
+
+void
+OpenGLImpl::activate()
+{
+    global_state = &m_global_state;
+}
+
+void
+OpenGLImpl::registerCalls()
 {
     registerStateCalls();
     registerLegacyCalls();
@@ -70,9 +160,6 @@ OpenGLImpl::OpenGLImpl(bool keep_all_states, bool swaps_to_finish):
     registerQueryCalls();
     registerDrawCalls();
     registerIgnoreHistoryCalls();
-
-    global_state.out_list = &m_required_calls;
-    global_state.emit_dependencies = m_recording_frame;
 }
 
 void OpenGLImpl::emitState()
@@ -168,7 +255,7 @@ OpenGLImpl::checkCommonSuffixes(const char *suffix) const
     return false;
 }
 
-ft_callback OpenGLImpl::findCallback(const char *name)
+ft_call_handler OpenGLImpl::findCallback(const char *name)
 {
     auto cb_range = m_call_table.equal_range(name);
     if (cb_range.first != m_call_table.end() &&
@@ -191,14 +278,17 @@ ft_callback OpenGLImpl::findCallback(const char *name)
 
         if (max_equal) {
             if (strcmp(name, cb->first)) {
-                if (!checkCommonSuffixes(name + strlen(cb->first)))
+                if (m_report_aliases &&
+                    !checkCommonSuffixes(name + strlen(cb->first)))
                     std::cerr << "Handle " << name << " as " << cb->first << "\n";
             }
-            return cb->second;
+            auto handler = cb->second;
+            handler.deletes_objects = !strncmp(name, "glDelete", 8);
+            return handler;
         }
     }
 
-    return nullptr;
+    return ft_call_handler();
 }
 
 bool
@@ -252,6 +342,12 @@ OpenGLImpl::skipDeleteImpl(unsigned obj_id, DependecyObjectMap& map)
 
 #define MAP(name, call) m_call_table.insert(std::make_pair(#name, bind(&OpenGLImpl:: call, this, _1)))
 
+// Map callbacks that don't look at the call arguments, so that the
+// parser doesn't need to decode them
+
+#define MAP_NOARGS(name, call) \
+    m_call_table.insert(std::make_pair(#name, ft_call_handler(bind(&OpenGLImpl:: call, this, _1), 0)))
+
 #define MAP_V(name, call, param1) \
     m_call_table.insert(std::make_pair(#name, bind(&OpenGLImpl:: call, this, _1, \
                         param1)))
@@ -312,21 +408,21 @@ OpenGLImpl::skipDeleteImpl(unsigned obj_id, DependecyObjectMap& map)
 void OpenGLImpl::registerLegacyCalls()
 {
     // draw calls
-    MAP(glBegin, oglBegin);
-    MAP(glColor2, oglVertex);
-    MAP(glColor3, oglVertex);
-    MAP(glColor4, oglVertex);
-    MAP(glEnd, oglEnd);
-    MAP(glNormal, oglVertex);
-    MAP(glRect, oglVertex);
-    MAP(glTexCoord2, oglVertex);
-    MAP(glTexCoord3, oglVertex);
-    MAP(glTexCoord4, oglVertex);
-    MAP(glVertex3, oglVertex);
-    MAP(glVertex4, oglVertex);
-    MAP(glVertex2, oglVertex);
-    MAP(glVertex3, oglVertex);
-    MAP(glVertex4, oglVertex);
+    MAP_NOARGS(glBegin, oglBegin);
+    MAP_NOARGS(glColor2, oglVertex);
+    MAP_NOARGS(glColor3, oglVertex);
+    MAP_NOARGS(glColor4, oglVertex);
+    MAP_NOARGS(glEnd, oglEnd);
+    MAP_NOARGS(glNormal, oglVertex);
+    MAP_NOARGS(glRect, oglVertex);
+    MAP_NOARGS(glTexCoord2, oglVertex);
+    MAP_NOARGS(glTexCoord3, oglVertex);
+    MAP_NOARGS(glTexCoord4, oglVertex);
+    MAP_NOARGS(glVertex3, oglVertex);
+    MAP_NOARGS(glVertex4, oglVertex);
+    MAP_NOARGS(glVertex2, oglVertex);
+    MAP_NOARGS(glVertex3, oglVertex);
+    MAP_NOARGS(glVertex4, oglVertex);
 
     // display lists
     MAP(glCallList, oglCallList);
@@ -401,6 +497,8 @@ void OpenGLImpl::registerFramebufferCalls()
     MAP_V(glNamedFramebufferDrawBuffers, callOnNamedObject, pc_fbo); 
     MAP_V(glNamedFramebufferReadBuffer, callOnNamedObject, pc_fbo); 
     MAP(glReadBuffer, fboReadBuffer);
+    MAP(glReadPixels, oglReadPixels);
+    MAP(glReadnPixels, oglReadPixels);
 
     MAP_VV(glDrawBuffer, callOnObjectBoundTo, pc_fbo, GL_DRAW_FRAMEBUFFER);
     MAP_VV(glDrawBuffers, callOnObjectBoundTo, pc_fbo, GL_DRAW_FRAMEBUFFER);
@@ -454,10 +552,10 @@ OpenGLImpl::registerBufferCalls()
     MAP_OBJ(glBufferStorage, m_buffers, BufferObjectMap::data);
     MAP_OBJ(glNamedBufferData, m_buffers, BufferObjectMap::namedData);
     MAP_OBJ(glNamedBufferStorage, m_buffers, BufferObjectMap::namedData);
-    MAP_OBJ(glBufferSubData, m_buffers, BufferObjectMap::callOnBoundObject);
-    MAP_OBJ(glGetBufferSubData, m_buffers, BufferObjectMap::callOnBoundObject);
-    MAP_OBJ(glNamedBufferSubData, m_buffers, BufferObjectMap::callOnNamedObject);
-    MAP_OBJ(glGetNamedBufferSubData, m_buffers, BufferObjectMap::callOnNamedObject);
+    MAP_OBJ(glBufferSubData, m_buffers, BufferObjectMap::subData);
+    MAP_OBJ(glGetBufferSubData, m_buffers, BufferObjectMap::readBoundObject);
+    MAP_OBJ(glNamedBufferSubData, m_buffers, BufferObjectMap::namedSubData);
+    MAP_OBJ(glGetNamedBufferSubData, m_buffers, BufferObjectMap::readNamedObject);
     MAP_OBJ(glCopyBufferSubData, m_buffers, BufferObjectMap::copyBufferSubData);
     MAP_OBJ(glCopyNamedBufferSubData, m_buffers, BufferObjectMap::copyNamedBufferSubData);
 
@@ -470,8 +568,8 @@ OpenGLImpl::registerBufferCalls()
     MAP_OBJ(glFlushMappedBufferRange, m_buffers, BufferObjectMap::callOnBoundObject);
     MAP_OBJ(glFlushMappedNamedBufferRange, m_buffers, BufferObjectMap::callOnNamedObject);
     MAP_OBJ(glUnmapBuffer, m_buffers, BufferObjectMap::unmap);
-    MAP_OBJ(glClearBufferData, m_buffers, BufferObjectMap::callOnBoundObject);
-    MAP_OBJ(glClearNamedBufferData, m_buffers, BufferObjectMap::callOnNamedObject);
+    MAP_OBJ(glClearBufferData, m_buffers, BufferObjectMap::clearData);
+    MAP_OBJ(glClearNamedBufferData, m_buffers, BufferObjectMap::namedClearData);
     MAP_OBJ(glInvalidateBufferData, m_buffers, BufferObjectMap::callOnNamedObject);
 }
 
@@ -551,29 +649,29 @@ void OpenGLImpl::registerTextureCalls()
     MAP_RV(glBindTexture, oglBind, m_textures, 1);
     MAP(glBindMultiTexture, oglBindMultitex);
 
-    MAP_OBJ(glGenerateMipmap, m_textures, TextureObjectMap::callOnBoundObject);
-    MAP_OBJ(glGenerateTextureMipmap, m_textures, TextureObjectMap::callOnNamedObject);
-    MAP_OBJ_RV(glTexImage1D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTexImage2D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
+    MAP_OBJ(glGenerateMipmap, m_textures, TextureObjectMap::readBoundObject);
+    MAP_OBJ(glGenerateTextureMipmap, m_textures, TextureObjectMap::readNamedObject);
+    MAP_OBJ_RVV(glTexImage1D, m_textures, TextureObjectMap::upload,
+                m_buffers, 1, false);
+    MAP_OBJ_RVV(glTexImage2D, m_textures, TextureObjectMap::upload,
+                m_buffers, 2, false);
     MAP_OBJ_RV(glTexImage2DMultisample, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
                m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTexImage3D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-
-    MAP_OBJ_RV(glTextureImage1D, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTextureSubImage1D, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTextureImage2D, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTextureSubImage2D, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTextureImage3D, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTextureSubImage3D, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
+    MAP_OBJ_RVV(glTexImage3D, m_textures, TextureObjectMap::upload,
+                m_buffers, 3, false);
+
+    MAP_OBJ_RVV(glTextureImage1D, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 1, false);
+    MAP_OBJ_RVV(glTextureSubImage1D, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 1, true);
+    MAP_OBJ_RVV(glTextureImage2D, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 2, false);
+    MAP_OBJ_RVV(glTextureSubImage2D, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 2, true);
+    MAP_OBJ_RVV(glTextureImage3D, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 3, false);
+    MAP_OBJ_RVV(glTextureSubImage3D, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 3, true);
 
     MAP_OBJ(glTexStorage1D, m_textures, TextureObjectMap::callOnBoundObject);
     MAP_OBJ(glTexStorage2D, m_textures, TextureObjectMap::callOnBoundObject);
@@ -585,20 +683,20 @@ void OpenGLImpl::registerTextureCalls()
     MAP_OBJ(glClearTexImage, m_textures, TextureObjectMap::callOnNamedObject);
     MAP_OBJ(glClearTexSubImage, m_textures, TextureObjectMap::callOnNamedObject);
     MAP_OBJ(glTexImage3DMultisample, m_textures, TextureObjectMap::callOnBoundObject);
-    MAP_OBJ_RV(glTexSubImage1D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-                    m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTexSubImage2D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-                    m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glCompressedTexImage2D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glCompressedTexSubImage2D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-                  m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glCompressedTextureSubImage2DEXT, m_textures, TextureObjectMap::callOnNamedObjectWithDepBoundTo,
-               m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glCompressedTexSubImage3D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-                  m_buffers, GL_PIXEL_UNPACK_BUFFER);
-    MAP_OBJ_RV(glTexSubImage3D, m_textures, TextureObjectMap::callOnBoundObjectWithDepBoundTo,
-                  m_buffers, GL_PIXEL_UNPACK_BUFFER);
+    MAP_OBJ_RVV(glTexSubImage1D, m_textures, TextureObjectMap::upload,
+                m_buffers, 1, true);
+    MAP_OBJ_RVV(glTexSubImage2D, m_textures, TextureObjectMap::upload,
+                m_buffers, 2, true);
+    MAP_OBJ_RVV(glCompressedTexImage2D, m_textures, TextureObjectMap::upload,
+                m_buffers, 2, false);
+    MAP_OBJ_RVV(glCompressedTexSubImage2D, m_textures, TextureObjectMap::upload,
+                m_buffers, 2, true);
+    MAP_OBJ_RVV(glCompressedTextureSubImage2DEXT, m_textures, TextureObjectMap::namedUpload,
+                m_buffers, 2, true);
+    MAP_OBJ_RVV(glCompressedTexSubImage3D, m_textures, TextureObjectMap::upload,
+                m_buffers, 3, true);
+    MAP_OBJ_RVV(glTexSubImage3D, m_textures, TextureObjectMap::upload,
+                m_buffers, 3, true);
     MAP_OBJ(glTexParameter, m_textures, TextureObjectMap::callOnBoundObject);
     MAP_OBJ(glTextureParameter, m_textures, TextureObjectMap::callOnNamedObject);
     MAP_OBJ_RVV(glTextureView, m_textures, TextureObjectMap::callOnNamedObjectWithDep,
@@ -609,12 +707,22 @@ void OpenGLImpl::registerTextureCalls()
     MAP_OBJ_RVV(glTextureBuffer, m_textures, TextureObjectMap::callOnNamedObjectWithDep,
                    m_buffers, 2, true);
 
-    /* Should add a dependency on the read fbo */
-    MAP_OBJ(glCopyTexSubImage1D, m_textures, TextureObjectMap::callOnBoundObject);
-    MAP_OBJ(glCopyTexSubImage2D, m_textures, TextureObjectMap::callOnBoundObject);
+    MAP(glCopyTexSubImage1D, oglCopyTexImage);
+    MAP(glCopyTexSubImage2D, oglCopyTexImage);
+    MAP(glCopyTexSubImage3D, oglCopyTexImage);
+    MAP(glCopyTextureSubImage1D, oglCopyTextureImage);
+    MAP(glCopyTextureSubImage2D, oglCopyTextureImage);
+    MAP(glCopyTextureSubImage3D, oglCopyTextureImage);
 
-    MAP_OBJ(glCopyTexImage1D, m_textures, TextureObjectMap::callOnBoundObject);
-    MAP_OBJ(glCopyTexImage2D, m_textures, TextureObjectMap::callOnBoundObject);
+    MAP(glCopyTexImage1D, oglCopyTexImage);
+    MAP(glCopyTexImage2D, oglCopyTexImage);
+
+    MAP(glGetTexImage, oglGetTexImage);
+    MAP(glGetnTexImage, oglGetTexImage);
+    MAP(glGetCompressedTexImage, oglGetTexImage);
+    MAP(glGetnCompressedTexImage, oglGetTexImage);
+    MAP(glGetTextureImage, oglGetTextureImage);
+    MAP(glGetCompressedTextureImage, oglGetTextureImage);
 
     MAP_OBJ(glCopyImageSubData, m_textures, TextureObjectMap::copy);
     MAP_OBJ(glBindImageTexture, m_textures, TextureObjectMap::bindToImageUnit);
@@ -692,9 +800,9 @@ OpenGLImpl::registerStateCalls()
         "glFinish",
     };
 
-    auto state_call_func = bind(&OpenGLImpl::recordStateCall, this, _1, 0);
-    auto state_call_1_func = bind(&OpenGLImpl::recordStateCall, this, _1, 1);
-    auto keep_state_calls_func = bind(&OpenGLImpl::recordRequiredCall, this, _1);
+    ft_call_handler state_call_func(bind(&OpenGLImpl::recordStateCall, this, _1, 0), 0);
+    ft_call_handler state_call_1_func(bind(&OpenGLImpl::recordStateCall, this, _1, 1), 1);
+    ft_call_handler keep_state_calls_func(bind(&OpenGLImpl::recordRequiredCall, this, _1), 0);
 
     /* These are state functions with an extra parameter */
 
@@ -727,7 +835,7 @@ OpenGLImpl::registerStateCalls()
     };
 
     /* These are state functions with an extra parameter */
-    auto state_call_2_func = bind(&OpenGLImpl::recordStateCall, this, _1, 2);
+    ft_call_handler state_call_2_func(bind(&OpenGLImpl::recordStateCall, this, _1, 2), 2);
     const std::vector<const char *> state_calls_2  = {
         "glMaterial",
         "glTexEnv",
@@ -743,10 +851,10 @@ OpenGLImpl::registerStateCalls()
         updateCallTable(state_calls_2, state_call_2_func);
     }
 
-    MAP(glDisable, recordRequiredCall);
-    MAP(glDisablei, recordRequiredCall);
-    MAP(glEnable, recordRequiredCall);
-    MAP(glEnablei, recordRequiredCall);
+    MAP_NOARGS(glDisable, recordRequiredCall);
+    MAP_NOARGS(glDisablei, recordRequiredCall);
+    MAP_NOARGS(glEnable, recordRequiredCall);
+    MAP_NOARGS(glEnablei, recordRequiredCall);
 
     MAP_OBJ(glFenceSync, m_sync_objects, SyncObjectMap::create);
     MAP(glWaitSync, oglWaitSync);
@@ -759,7 +867,7 @@ void OpenGLImpl::registerRequiredCalls()
     /* These function set up the context and are, therefore, required
      * TODO: figure out what is really required, and whether the can be
      * tracked like state variables. */
-    auto required_func = bind(&OpenGLImpl::recordRequiredCall, this, _1);
+    ft_call_handler required_func(bind(&OpenGLImpl::recordRequiredCall, this, _1), 0);
     const std::vector<const char *> required_calls = {
         "glXChooseVisual",
         "glXCreatePbuffer",
@@ -832,7 +940,6 @@ void OpenGLImpl::registerIgnoreHistoryCalls()
         "glGetShaderInfoLog",
         "glGetTexLevelParameter",
         "glGetTexParameter",
-        "glGetTexImage",
         "glGetUniform",
         "glLabelObjectEXT",
         "glIsEnabled",
@@ -841,7 +948,6 @@ void OpenGLImpl::registerIgnoreHistoryCalls()
         "glIsSync",
         "glIsTexture", 
         "glIsVertexArray",
-        "glReadPixels",
         "glXGetClientString",
         "glXGetCurrentContext",
         "glXGetCurrentDisplay",
@@ -872,7 +978,7 @@ void OpenGLImpl::registerIgnoreHistoryCalls()
         "wglDeleteContext", 
         "wglDescribePixelFormat"
      };
-    auto ignore_history_func = bind(&OpenGLImpl::ignoreHistory, this, _1);
+    ft_call_handler ignore_history_func(bind(&OpenGLImpl::ignoreHistory, this, _1), 0);
     updateCallTable(ignore_history_calls, ignore_history_func);
 }
 
@@ -885,8 +991,8 @@ OpenGLImpl::registerVaCalls()
     MAP(glBindVertexArray, oglBindVertexArray);
     //MAP_OBJ(glVertexAttribBinding, m_vertex_buffer_pointers, VertexAttribObjectMap::vaBinding);
 
-    MAP(glDisableVertexAttribArray, recordRequiredCall);
-    MAP(glEnableVertexAttribArray, recordRequiredCall);
+    MAP_NOARGS(glDisableVertexAttribArray, recordRequiredCall);
+    MAP_NOARGS(glEnableVertexAttribArray, recordRequiredCall);
     MAP_OBJ_R(glVertexAttribPointer, m_vertex_attrib_pointers,
                    VertexAttribObjectMap::bindAVO, m_buffers);
     MAP_OBJ_R(glVertexAttribIPointer, m_vertex_attrib_pointers,
@@ -897,54 +1003,49 @@ OpenGLImpl::registerVaCalls()
     MAP_OBJ_R(glBindVertexBuffer, m_vertex_buffer_pointers,
                 VertexAttribObjectMap::bindVAOBuf, m_buffers);
 
-    MAP(glColorPointer, recordRequiredCall);
-    MAP(glVertexPointer, recordRequiredCall);
-    MAP(glNormalPointer, recordRequiredCall);
-    MAP(glTexCoordPointer, recordRequiredCall);
+    MAP_NOARGS(glColorPointer, recordRequiredCall);
+    MAP_NOARGS(glVertexPointer, recordRequiredCall);
+    MAP_NOARGS(glNormalPointer, recordRequiredCall);
+    MAP_NOARGS(glTexCoordPointer, recordRequiredCall);
 
-    MAP(glVertexAttribBinding, recordRequiredCall);
-    MAP(glVertexAttribFormat, recordRequiredCall);
-    MAP(glVertexAttribIFormat, recordRequiredCall);
-    MAP(glVertexAttribLFormat, recordRequiredCall);
-    MAP(glVertexBindingDivisor, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribBinding, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribFormat, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribIFormat, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribLFormat, recordRequiredCall);
+    MAP_NOARGS(glVertexBindingDivisor, recordRequiredCall);
 
-    MAP(glVertexAttrib1, recordRequiredCall);
-    MAP(glVertexAttrib2, recordRequiredCall);
-    MAP(glVertexAttrib3, recordRequiredCall);
-    MAP(glVertexAttrib4, recordRequiredCall);
-    MAP(glVertexAttribI, recordRequiredCall);
-    MAP(glVertexAttribL, recordRequiredCall);
-    MAP(glVertexAttribP1, recordRequiredCall);
-    MAP(glVertexAttribP2, recordRequiredCall);
-    MAP(glVertexAttribP3, recordRequiredCall);
-    MAP(glVertexAttribP4, recordRequiredCall);
-    MAP(glTexGen, recordRequiredCall);
-    MAP(glTextureBarrier, recordRequiredCall);
+    MAP_NOARGS(glVertexAttrib1, recordRequiredCall);
+    MAP_NOARGS(glVertexAttrib2, recordRequiredCall);
+    MAP_NOARGS(glVertexAttrib3, recordRequiredCall);
+    MAP_NOARGS(glVertexAttrib4, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribI, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribL, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribP1, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribP2, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribP3, recordRequiredCall);
+    MAP_NOARGS(glVertexAttribP4, recordRequiredCall);
+    MAP_NOARGS(glTexGen, recordRequiredCall);
+    MAP_NOARGS(glTextureBarrier, recordRequiredCall);
 
-    MAP(glDisableClientState, recordRequiredCall);
-    MAP(glEnableClientState, recordRequiredCall);
+    MAP_NOARGS(glDisableClientState, recordRequiredCall);
+    MAP_NOARGS(glEnableClientState, recordRequiredCall);
 
 }
 
 void
 OpenGLImpl::updateCallTable(const std::vector<const char*>& names,
-                                        ft_callback cb)
+                                        ft_call_handler cb)
 {
     for (auto& i : names)
         m_call_table.insert(std::make_pair(i, cb));
 }
 
-PTraceCall
+TraceCall
 OpenGLImpl::recordStateCall(const trace::Call& call,
                                    unsigned no_param_sel)
 {
-    std::stringstream s;
-    s << call.name();
-    for (unsigned i = 0; i < no_param_sel; ++i)
-        s << "_" << call.arg(i).toUInt();
-
-    auto c = std::make_shared<TraceCall>(call, s.str());
-    m_state_calls[s.str()] = c;
+    auto c = trace2call(call);
+    m_state_calls[StateCallKey(call, no_param_sel)] = c;
 
     if (m_active_display_list)
         m_active_display_list->addCall(c);
@@ -1051,8 +1152,8 @@ OpenGLImpl::oglBindBuffer(const trace::Call& call)
     if (bound_obj) {
         bound_obj->addCall(trace2call(call));
         if (call.arg(0).toUInt() == GL_ELEMENT_ARRAY_BUFFER) {
-            if (global_state.current_vao)
-                global_state.current_vao->addDependency(bound_obj);
+            if (global_state->current_vao)
+                global_state->current_vao->addDependency(bound_obj);
         }
     } else
         m_buffers.addCall(trace2call(call));
@@ -1351,11 +1452,11 @@ void
 OpenGLImpl::oglBindVertexArray(const trace::Call& call)
 {
     auto vao = m_current_context->m_vertex_arrays.bind(call, 0);
-    global_state.current_vao = vao;
+    global_state->current_vao = vao;
     if (vao) {
         vao->addCall(trace2call(call));
-        if (global_state.emit_dependencies)
-            vao->emitCallsTo(*global_state.out_list);
+        if (global_state->emit_dependencies)
+            vao->emitCallsTo(*global_state->out_list);
         auto fb = m_current_context->m_fbo.boundTo(GL_DRAW_FRAMEBUFFER);
         if (fb->id())
             fb->addDependency(vao);
@@ -1424,6 +1525,56 @@ void OpenGLImpl::fboReadBuffer(const trace::Call& call)
     m_current_context->m_fbo.oglReadBuffer(call);
 }
 
+/* Pixels that are read back into a pixel pack buffer write the buffer,
+ * so it then depends on the object they were read from */
+void OpenGLImpl::writePackBuffer(const trace::Call& call, UsedObject::Pointer src)
+{
+    auto buf = m_buffers.boundToTarget(GL_PIXEL_PACK_BUFFER);
+    if (!buf)
+        return;
+
+    buf->addCall(trace2call(call));
+    if (src)
+        buf->addDependency(src);
+}
+
+void OpenGLImpl::oglReadPixels(const trace::Call& call)
+{
+    auto fb = m_current_context->m_fbo.boundTo(GL_READ_FRAMEBUFFER);
+    if (!fb)
+        fb = m_fbo_ext.boundTo(GL_READ_FRAMEBUFFER);
+
+    /* The framebuffer depends on its attachments, so this keeps
+     * the uploads to them */
+    if (fb) {
+        fb->addCall(trace2call(call));
+        fb->pinUploads();
+    }
+    writePackBuffer(call, fb);
+}
+
+void OpenGLImpl::oglGetTexImage(const trace::Call& call)
+{
+    writePackBuffer(call, m_textures.readBoundObject(call));
+}
+
+void OpenGLImpl::oglGetTextureImage(const trace::Call& call)
+{
+    writePackBuffer(call, m_textures.readNamedObject(call));
+}
+
+void OpenGLImpl::oglCopyTexImage(const trace::Call& call)
+{
+    m_textures.callOnBoundObjectWithDepBoundTo(call, m_current_context->m_fbo,
+                                               GL_READ_FRAMEBUFFER);
+}
+
+void OpenGLImpl::oglCopyTextureImage(const trace::Call& call)
+{
+    m_textures.callOnNamedObjectWithDepBoundTo(call, m_current_context->m_fbo,
+                                               GL_READ_FRAMEBUFFER);
+}
+
 void OpenGLImpl::createContext(const trace::Call& call, int shared_param)
 {
     if (!m_contexts.empty()) {
@@ -65,17 +65,22 @@ public:
     using ObjectMap = std::unordered_map<unsigned, UsedObject::Pointer>;
 
     OpenGLImpl(bool keep_all_states, bool swaps_to_finish);
+    OpenGLImpl(const OpenGLImpl& other);
+
+    std::shared_ptr<FrameTrimmer> clone() const override;
 
     void switch_thread(int new_thread) override;
 
 protected:
+    void activate() override;
     void emitState() override;
     void finalize() override;
-    ft_callback findCallback(const char *name) override;
+    ft_call_handler findCallback(const char *name) override;
     bool skipDeleteObj(const trace::Call& call) override;
 
 private:
-    PTraceCall recordStateCall(const trace::Call& call, unsigned no_param_sel);
+    void registerCalls();
+    TraceCall recordStateCall(const trace::Call& call, unsigned no_param_sel);
 
     void registerStateCalls();
     void registerLegacyCalls();
@@ -93,7 +98,7 @@ private:
 
     void update_context_id(uint32_t context_id);
     void updateCallTable(const std::vector<const char*>& names,
-                           ft_callback cb);
+                           ft_call_handler cb);
 
     void oglBegin(const trace::Call& call);
     void oglEnd(const trace::Call& call);
@@ -142,6 +147,12 @@ private:
     void fboBlit(const trace::Call& call);
     void fboBlitNamed(const trace::Call& call);
     void fboReadBuffer(const trace::Call& call);
+    void writePackBuffer(const trace::Call& call, UsedObject::Pointer src);
+    void oglReadPixels(const trace::Call& call);
+    void oglGetTexImage(const trace::Call& call);
+    void oglGetTextureImage(const trace::Call& call);
+    void oglCopyTexImage(const trace::Call& call);
+    void oglCopyTextureImage(const trace::Call& call);
     void bindPerContext(const trace::Call& call, ePerContext map_type, unsigned bind_param);
 
 
@@ -149,7 +160,7 @@ private:
 
     void createContext(const trace::Call& call, int shared_param);
     void makeCurrent(const trace::Call& call, unsigned param);
-    using CallTable = std::multimap<const char *, ft_callback, string_part_less>;
+    using CallTable = std::multimap<const char *, ft_call_handler, string_part_less>;
     CallTable m_call_table;
 
     DisplayListMap m_display_lists;
@@ -173,10 +184,13 @@ private:
     std::shared_ptr<PerContextObjects> m_current_context;
     QueryObjectMap m_queries;
 
-    std::map<std::string, PTraceCall> m_state_calls;
-    std::map<unsigned, PTraceCall> m_enables;
+    StateCallMap m_state_calls;
+    std::map<unsigned, TraceCall> m_enables;
 
     std::unordered_map<unsigned, std::shared_ptr<PerContextObjects>> m_thread_active_context;
+
+    GlobalState m_global_state;
+    bool m_report_aliases;
 };
 
 }
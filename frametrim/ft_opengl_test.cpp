@@ -0,0 +1,247 @@
+/*********************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *********************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "ft_frametrimmer.hpp"
+
+#include <initializer_list>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+
+using namespace frametrim;
+
+
+static const trace::FunctionSig glXCreateContext_sig = {0, "glXCreateContext", 4, NULL};
+static const trace::FunctionSig glXMakeCurrent_sig = {1, "glXMakeCurrent", 3, NULL};
+static const trace::FunctionSig glGenTextures_sig = {2, "glGenTextures", 2, NULL};
+static const trace::FunctionSig glBindTexture_sig = {3, "glBindTexture", 2, NULL};
+static const trace::FunctionSig glTexImage2D_sig = {4, "glTexImage2D", 9, NULL};
+static const trace::FunctionSig glTexSubImage2D_sig = {5, "glTexSubImage2D", 9, NULL};
+static const trace::FunctionSig glGetTexImage_sig = {6, "glGetTexImage", 5, NULL};
+static const trace::FunctionSig glGenFramebuffers_sig = {7, "glGenFramebuffers", 2, NULL};
+static const trace::FunctionSig glBindFramebuffer_sig = {8, "glBindFramebuffer", 2, NULL};
+static const trace::FunctionSig glFramebufferTexture2D_sig = {9, "glFramebufferTexture2D", 5, NULL};
+static const trace::FunctionSig glCopyTexSubImage2D_sig = {10, "glCopyTexSubImage2D", 8, NULL};
+static const trace::FunctionSig glDrawArrays_sig = {11, "glDrawArrays", 3, NULL};
+static const trace::FunctionSig glGenBuffers_sig = {12, "glGenBuffers", 2, NULL};
+static const trace::FunctionSig glBindBuffer_sig = {13, "glBindBuffer", 2, NULL};
+static const trace::FunctionSig glBufferData_sig = {14, "glBufferData", 4, NULL};
+static const trace::FunctionSig glFinish_sig = {15, "glFinish", 0, NULL};
+
+
+static const unsigned long long context = 0x1000;
+static const unsigned size = 4;
+
+
+class DeadUploadTest : public ::testing::Test
+{
+protected:
+    std::shared_ptr<FrameTrimmer> trimmer =
+        FrameTrimmer::create(trace::API_GL, false, false);
+    unsigned next_call_no = 0;
+
+    static trace::Value *
+    uint(unsigned long long value) {
+        return new trace::UInt(value);
+    }
+
+    static trace::Value *
+    ids(unsigned id) {
+        auto array = new trace::Array(1);
+        array->values[0] = uint(id);
+        return array;
+    }
+
+    unsigned
+    call(const trace::FunctionSig& sig,
+         std::initializer_list<trace::Value *> args,
+         trace::Value *ret = nullptr,
+         Frametype frametype = ft_none) {
+        trace::Call c(&sig, 0, 0);
+        c.no = next_call_no++;
+        unsigned i = 0;
+        for (auto arg : args)
+            c.args[i++].value = arg;
+        c.ret = ret;
+        trimmer->call(c, frametype);
+        return c.no;
+    }
+
+    void
+    makeCurrent() {
+        call(glXCreateContext_sig,
+             {uint(0), uint(0), new trace::Pointer(0), uint(1)},
+             new trace::Pointer(context));
+        call(glXMakeCurrent_sig,
+             {uint(0), uint(1), new trace::Pointer(context)});
+    }
+
+    unsigned
+    createTexture(unsigned id) {
+        call(glGenTextures_sig, {uint(1), ids(id)});
+        bindTexture(id);
+        return call(glTexImage2D_sig,
+                    {uint(GL_TEXTURE_2D), uint(0), uint(GL_RGBA8),
+                     uint(size), uint(size), uint(0),
+                     uint(GL_RGBA), uint(GL_UNSIGNED_BYTE), new trace::Null});
+    }
+
+    void
+    bindTexture(unsigned id) {
+        call(glBindTexture_sig, {uint(GL_TEXTURE_2D), uint(id)});
+    }
+
+    /* Replaces all texels of the bound texture */
+    unsigned
+    upload() {
+        return call(glTexSubImage2D_sig,
+                    {uint(GL_TEXTURE_2D), uint(0), uint(0), uint(0),
+                     uint(size), uint(size),
+                     uint(GL_RGBA), uint(GL_UNSIGNED_BYTE), new trace::Null});
+    }
+
+    /* Creates a framebuffer with the texture as color attachment */
+    void
+    createFramebuffer(unsigned id, unsigned texture) {
+        call(glGenFramebuffers_sig, {uint(1), ids(id)});
+        call(glBindFramebuffer_sig, {uint(GL_FRAMEBUFFER), uint(id)});
+        call(glFramebufferTexture2D_sig,
+             {uint(GL_FRAMEBUFFER), uint(GL_COLOR_ATTACHMENT0),
+              uint(GL_TEXTURE_2D), uint(texture), uint(0)});
+    }
+
+    /* Records the target frame, which emits the bound objects */
+    const CallSet&
+    trim() {
+        trimmer->start_last_frame(next_call_no);
+        call(glFinish_sig, {}, nullptr, ft_key_frame);
+        trimmer->end_last_frame();
+        return trimmer->getRequiredCalls();
+    }
+};
+
+
+TEST_F(DeadUploadTest, overwritten)
+{
+    makeCurrent();
+    unsigned alloc = createTexture(1);
+    unsigned first = upload();
+    unsigned second = upload();
+
+    auto& calls = trim();
+    EXPECT_TRUE(calls.contains(alloc));
+    EXPECT_FALSE(calls.contains(first));
+    EXPECT_TRUE(calls.contains(second));
+}
+
+
+TEST_F(DeadUploadTest, draw)
+{
+    makeCurrent();
+    createTexture(2);
+    createFramebuffer(3, 2);
+
+    createTexture(1);
+    unsigned first = upload();
+    unsigned draw = call(glDrawArrays_sig, {uint(GL_TRIANGLES), uint(0), uint(3)});
+    unsigned second = upload();
+
+    auto& calls = trim();
+    EXPECT_TRUE(calls.contains(draw));
+    EXPECT_TRUE(calls.contains(first));
+    EXPECT_TRUE(calls.contains(second));
+}
+
+
+TEST_F(DeadUploadTest, readback)
+{
+    makeCurrent();
+    createTexture(1);
+    unsigned first = upload();
+    unsigned readback = call(glGetTexImage_sig,
+                             {uint(GL_TEXTURE_2D), uint(0), uint(GL_RGBA),
+                              uint(GL_UNSIGNED_BYTE), new trace::Pointer(0)});
+    unsigned second = upload();
+
+    auto& calls = trim();
+    EXPECT_TRUE(calls.contains(readback));
+    EXPECT_TRUE(calls.contains(first));
+    EXPECT_TRUE(calls.contains(second));
+}
+
+
+TEST_F(DeadUploadTest, readbackToPackBuffer)
+{
+    makeCurrent();
+    unsigned texture_alloc = createTexture(1);
+    unsigned first = upload();
+
+    call(glGenBuffers_sig, {uint(1), ids(4)});
+    call(glBindBuffer_sig, {uint(GL_PIXEL_PACK_BUFFER), uint(4)});
+    call(glBufferData_sig, {uint(GL_PIXEL_PACK_BUFFER), uint(size * size * 4),
+                            new trace::Null, uint(GL_STREAM_READ)});
+    unsigned readback = call(glGetTexImage_sig,
+                             {uint(GL_TEXTURE_2D), uint(0), uint(GL_RGBA),
+                              uint(GL_UNSIGNED_BYTE), new trace::Pointer(0)});
+
+    /* Nothing uses the texture itself anymore */
+    createTexture(5);
+
+    auto& calls = trim();
+    EXPECT_TRUE(calls.contains(readback));
+    EXPECT_TRUE(calls.contains(texture_alloc));
+    EXPECT_TRUE(calls.contains(first));
+}
+
+
+TEST_F(DeadUploadTest, copy)
+{
+    makeCurrent();
+    createTexture(1);
+    createFramebuffer(3, 1);
+    unsigned first = upload();
+
+    createTexture(2);
+    unsigned copy = call(glCopyTexSubImage2D_sig,
+                         {uint(GL_TEXTURE_2D), uint(0), uint(0), uint(0),
+                          uint(0), uint(0), uint(size), uint(size)});
+
+    bindTexture(1);
+    unsigned second = upload();
+
+    /* Only the copy destination is bound in the target frame */
+    call(glBindFramebuffer_sig, {uint(GL_FRAMEBUFFER), uint(0)});
+    bindTexture(2);
+
+    auto& calls = trim();
+    EXPECT_TRUE(calls.contains(copy));
+    EXPECT_TRUE(calls.contains(first));
+    EXPECT_TRUE(calls.contains(second));
+}
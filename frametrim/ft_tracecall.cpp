@@ -25,115 +25,180 @@
  *
  *********************************************************************/
 
-#include "ft_tracecall.hpp"
 
-#include <sstream>
-#include <iostream>
+#include "ft_tracecall.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <string>
 
-namespace trace {
+namespace frametrim {
 
-class StreamVisitor : public Visitor
+/* Calls that must not be repeated when looping the last frame. The
+ * answer is cached per signature so the name is only compared once for
+ * each function in the trace. */
+static bool isNonRepeatCall(const trace::Call& call)
 {
-public:
-    StreamVisitor(std::stringstream& ss): s(ss) {}
-    void visit(Null *) override { s << "(null)";}
-    void visit(Bool *v) override { s << v->value;}
-    void visit(SInt *v) override { s << v->value;}
-    void visit(UInt *v) override { s << v->value;}
-    void visit(Float *v) override { s << v->value;}
-    void visit(Double *v) override { s << v->value;}
-    void visit(String *v) override { s << v->value;}
-    void visit(WString *v) override { s << v->value;}
-    void visit(Enum *v) override { s << v->value;}
-    void visit(Bitmask *v) override { s << v->value;}
-    void visit(Struct *v) override { s << v;}
-    void visit(Array *v) override { s << v;}
-    void visit(Blob *v) override { s << v;}
-    void visit(Pointer *v) override { s << v->value;}
-    void visit(Repr *v) override { s << v;}
-protected:
-    inline void _visit(Value *value) {
-        if (value) {
-            value->visit(*this);
+    static const char *nonRepeatCalls[] = {
+        "glShaderSource",
+        "glCompileShader",
+        "glAttachShader",
+        "glLinkProgram",
+    };
+    static std::vector<int8_t> cache;
+
+    unsigned id = call.sig->id;
+    if (id >= cache.size())
+        cache.resize(id + 1, -1);
+
+    if (cache[id] < 0) {
+        cache[id] = 0;
+        for (auto name : nonRepeatCalls) {
+            if (!strcmp(call.name(), name)) {
+                cache[id] = 1;
+                break;
+            }
         }
     }
-    std::stringstream& s;
-};
-
+    return cache[id] > 0;
 }
 
-namespace frametrim {
-
-TraceCall::TraceCall(const trace::Call& call, const std::string& name):
+TraceCall::TraceCall(const trace::Call& call):
     m_trace_call_no(call.no),
-    m_name(name)
+    m_flags(0)
 {
-    std::stringstream s;
-    s << call.name();
-
-    trace::StreamVisitor sv(s);
-    for(auto&& a: call.args) {
-        s << "_";  a.value->visit(sv);
-    }
-
-    m_name_with_params = s.str();
+    assert(call.no != no_call);
+    if (isNonRepeatCall(call))
+        m_flags |= 1u << tc_non_repeat;
 }
 
-TraceCall::TraceCall(const trace::Call& call, unsigned nsel):
-    TraceCall(call, nameWithParamsel(call, nsel))
+/* Selector parameters are mostly enums, but can also be negative integers
+ * or floats, which Value::toUInt() asserts on, so look at the actual type.
+ * Aggregates fall back to the call number, i.e. the call is never replaced. */
+static uint64_t
+stateKeyParam(const trace::Call& call, const trace::Value& arg)
 {
-
+    const trace::Value *value = &arg;
+    if (auto repr = dynamic_cast<const trace::Repr *>(value))
+        value = repr->machineValue;
+
+    if (auto v = dynamic_cast<const trace::SInt *>(value))
+        return static_cast<uint64_t>(v->value);
+    if (auto v = dynamic_cast<const trace::UInt *>(value))
+        return v->value;
+    if (auto v = dynamic_cast<const trace::Bool *>(value))
+        return v->value;
+    if (auto v = dynamic_cast<const trace::Float *>(value)) {
+        uint32_t bits;
+        memcpy(&bits, &v->value, sizeof bits);
+        return bits;
+    }
+    if (auto v = dynamic_cast<const trace::Double *>(value)) {
+        uint64_t bits;
+        memcpy(&bits, &v->value, sizeof bits);
+        return bits;
+    }
+    if (dynamic_cast<const trace::Null *>(value))
+        return 0;
+    if (auto v = dynamic_cast<const trace::String *>(value))
+        return std::hash<std::string>{}(v->value);
+    return call.no;
 }
 
-TraceCall::TraceCall(const trace::Call& call):
-    TraceCall(call, call.name())
+StateCallKey::StateCallKey(const trace::Call& call, unsigned nsel):
+    sig_id(call.sig->id),
+    params{0, 0}
 {
+    assert(nsel <= 2);
+    for (unsigned i = 0; i < nsel; ++i)
+        params[i] = stateKeyParam(call, call.arg(i));
 }
 
-std::string
-TraceCall::nameWithParamsel(const trace::Call &call, unsigned nsel)
+void CallSet::insert(unsigned callno)
 {
-    std::stringstream s;
-    s << call.name();
+    size_t word = callno / 64;
+    uint64_t mask = uint64_t(1) << (callno % 64);
+
+    if (word >= m_bits.size())
+        m_bits.resize(std::max(word + 1, m_bits.size() * 2), 0);
 
-    trace::StreamVisitor sv(s);
-    for(unsigned i = 0; i < nsel; ++i ) {
-        s << "_";
-        call.args[i].value->visit(sv);
+    if (!(m_bits[word] & mask)) {
+        m_bits[word] |= mask;
+        ++m_size;
     }
-    return s.str();
 }
 
-void CallSet::insert(PTraceCall call)
+bool CallSet::contains(unsigned callno) const
 {
-    if (!call)
-        return;
-    m_calls.insert(call);
+    size_t word = callno / 64;
+    return word < m_bits.size() &&
+            (m_bits[word] & (uint64_t(1) << (callno % 64)));
 }
 
 void CallSet::clear()
 {
-    m_calls.clear();
+    m_bits.clear();
+    m_size = 0;
 }
 
-bool CallSet::empty() const
+unsigned CallSet::last() const
 {
-    return m_calls.empty();
+    assert(m_size > 0);
+    size_t word = m_bits.size();
+    while (!m_bits[--word]);
+
+    unsigned bit = 63;
+    while (!(m_bits[word] & (uint64_t(1) << bit)))
+        --bit;
+    return word * 64 + bit;
 }
 
 CallSet::const_iterator
 CallSet::begin() const
 {
-    return m_calls.begin();
+    return const_iterator(&m_bits, 0);
 }
 
 CallSet::const_iterator
 CallSet::end() const
 {
-    return m_calls.end();
+    return const_iterator(&m_bits, m_bits.size() * 64);
+}
+
+CallSet::const_iterator::const_iterator(const std::vector<uint64_t> *bits, size_t pos):
+    m_bits(bits),
+    m_pos(pos)
+{
+    seek();
 }
 
+CallSet::const_iterator&
+CallSet::const_iterator::operator ++ ()
+{
+    ++m_pos;
+    seek();
+    return *this;
+}
 
+/* Advance to the next set bit, or to the end */
+void
+CallSet::const_iterator::seek()
+{
+    size_t end = m_bits->size() * 64;
+    while (m_pos < end) {
+        uint64_t word = (*m_bits)[m_pos / 64] >> (m_pos % 64);
+        if (word) {
+            while (!(word & 1)) {
+                word >>= 1;
+                ++m_pos;
+            }
+            return;
+        }
+        m_pos = (m_pos / 64 + 1) * 64;
+    }
+    m_pos = end;
+}
 
 }
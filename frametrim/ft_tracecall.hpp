@@ -25,15 +25,18 @@
  *
  *********************************************************************/
 
+
 #pragma once
 
 #include "trace_model.hpp"
 
+#include <cstdint>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <iostream>
-#include <bitset>
+#include <iterator>
+#include <vector>
 
 namespace frametrim {
 
@@ -41,61 +44,103 @@ enum ECallFlags {
     tc_required,
     tc_persistent_mapping,
     tc_skip_record_in_fbo,
+    tc_non_repeat,
     tc_last
 };
 
-class CallSet;
-
+/* A recorded call is only identified by its number in the trace, the
+ * call itself is re-read from the trace when the output is written.
+ * Keep this small, there may be hundreds of millions of them. */
 class TraceCall {
 public:
-    using Pointer = std::shared_ptr<TraceCall>;
-
-    TraceCall(const trace::Call& call, const std::string& name);
-
-    TraceCall(const trace::Call& call, unsigned nparam_sel);
+    TraceCall():
+        m_trace_call_no(no_call),
+        m_flags(0) {}
 
-    TraceCall(const trace::Call& call);
+    explicit TraceCall(const trace::Call& call);
 
     unsigned callNo() const { return m_trace_call_no;};
-    const std::string& name() const { return m_name;}
-    const std::string& nameWithParams() const { return m_name_with_params;}
-private:
+    bool test(ECallFlags flag) const { return m_flags & (1u << flag); }
 
-    static std::string nameWithParamsel(const trace::Call& call, unsigned nsel);
+    explicit operator bool() const { return m_trace_call_no != no_call; }
+private:
+    static const uint32_t no_call = 0xffffffff;
 
-    unsigned m_trace_call_no;
-    std::string m_name;
-    std::string m_name_with_params;
+    uint32_t m_trace_call_no;
+    uint32_t m_flags;
 };
-using PTraceCall = TraceCall::Pointer;
 
-using StateCallMap=std::unordered_map<std::string, PTraceCall>;
-
-inline PTraceCall trace2call(const trace::Call& call) {
-    return std::make_shared<TraceCall>(call);
+inline TraceCall trace2call(const trace::Call& call) {
+    return TraceCall(call);
 }
 
-struct CallHash {
-    std::size_t operator () (const PTraceCall& call) const {
-        return std::hash<unsigned>{}(call->callNo());
+/* Key for calls that set a piece of state that is completely replaced
+ * by the next call to the same function with the same first nsel
+ * parameters, e.g. glBlendFunc, or glLight(GL_LIGHT0, GL_AMBIENT, ...). */
+struct StateCallKey {
+    StateCallKey(const trace::Call& call, unsigned nsel);
+
+    bool operator == (const StateCallKey& other) const {
+        return sig_id == other.sig_id &&
+                params[0] == other.params[0] &&
+                params[1] == other.params[1];
     }
+
+    unsigned sig_id;
+    uint64_t params[2];
 };
 
-class CallSet {
-public:
-    using Pointer = std::shared_ptr<CallSet>;
+struct StateCallKeyHash {
+    std::size_t operator () (const StateCallKey& key) const {
+        uint64_t h = key.sig_id;
+        h = h * 0x9e3779b97f4a7c15ull ^ key.params[0];
+        h = h * 0x9e3779b97f4a7c15ull ^ key.params[1];
+        return std::hash<uint64_t>{}(h);
+    }
+};
 
-    using const_iterator = std::unordered_set<PTraceCall, CallHash>::const_iterator;
+using StateCallMap = std::unordered_map<StateCallKey, TraceCall, StateCallKeyHash>;
 
-    void insert(PTraceCall call);
+/* Set of call numbers, stored as a bitmap indexed by call number. */
+class CallSet {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = unsigned;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const unsigned *;
+        using reference = unsigned;
+
+        const_iterator(const std::vector<uint64_t> *bits, size_t pos);
+
+        unsigned operator * () const { return m_pos; }
+        const_iterator& operator ++ ();
+        bool operator == (const const_iterator& other) const { return m_pos == other.m_pos; }
+        bool operator != (const const_iterator& other) const { return m_pos != other.m_pos; }
+    private:
+        void seek();
+
+        const std::vector<uint64_t> *m_bits;
+        size_t m_pos;
+    };
+
+    void insert(const TraceCall& call) {
+        if (call)
+            insert(call.callNo());
+    }
+    void insert(unsigned callno);
+    bool contains(unsigned callno) const;
     void clear();
-    bool empty() const;
-    size_t size() const {return m_calls.size(); }
+    bool empty() const { return m_size == 0; }
+    size_t size() const {return m_size; }
+    /* Highest call number in the set, the set must not be empty */
+    unsigned last() const;
     const_iterator begin() const;
     const_iterator end() const;
 private:
-    std::unordered_set<PTraceCall, CallHash> m_calls;
+    std::vector<uint64_t> m_bits;
+    size_t m_size = 0;
 };
-using PCallSet = std::shared_ptr<CallSet>;
 
 }
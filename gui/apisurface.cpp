@@ -41,6 +41,24 @@ QImage ApiSurface::calculateThumbnail(bool opaque, bool alpha) const
 QImage ApiSurface::calculateThumbnail(const QByteArray &data, bool opaque,
                                       bool alpha) const
 {
+    /*
+     * Raw RGBA8 images can be wrapped by QImage in place, without
+     * decoding into an intermediate image::Image.
+     */
+    if (!alpha) {
+        image::PNMInfo info;
+        const char *pixels = image::readPNMHeader(data.constData(), data.size(), info);
+        if (pixels &&
+            info.channelType == image::TYPE_UNORM8 &&
+            info.channels == 4 &&
+            size_t(info.width) * info.height * 4 <= size_t(data.constData() + data.size() - pixels)) {
+            QImage img(reinterpret_cast<const uchar *>(pixels),
+                       info.width, info.height, info.width * 4,
+                       opaque ? QImage::Format_RGBX8888 : QImage::Format_RGBA8888);
+            return thumbnail(img);
+        }
+    }
+
     /*
      * We need to do the conversion to create the thumbnail
      */
@@ -6,11 +6,18 @@
 #include <QDebug>
 #include <QFileInfo>
 #include <QDir>
+#include <QSettings>
 #include <QThread>
 
 ApiTrace::ApiTrace()
-    : m_needsSaving(false)
+    : m_needsSaving(false),
+      m_frameCacheUsage(0),
+      m_frameUseCounter(0),
+      m_loaderRequests(0)
 {
+    m_frameCacheSize =
+        QSettings().value("frameCacheSize", 2048).toULongLong() << 20;
+
     m_loader = new TraceLoader();
 
     connect(this, SIGNAL(loadTrace(QString)),
@@ -36,13 +43,13 @@ ApiTrace::ApiTrace()
     connect(this, SIGNAL(loaderFindFrameEnd(ApiTraceFrame*)),
             m_loader, SLOT(findFrameEnd(ApiTraceFrame*)));
     connect(m_loader, SIGNAL(foundFrameStart(ApiTraceFrame*)),
-            this, SIGNAL(foundFrameStart(ApiTraceFrame*)));
+            this, SLOT(loaderFoundFrameStart(ApiTraceFrame*)));
     connect(m_loader, SIGNAL(foundFrameEnd(ApiTraceFrame*)),
-            this, SIGNAL(foundFrameEnd(ApiTraceFrame*)));
+            this, SLOT(loaderFoundFrameEnd(ApiTraceFrame*)));
     connect(this, SIGNAL(loaderFindCallIndex(int)),
             m_loader, SLOT(findCallIndex(int)));
     connect(m_loader, SIGNAL(foundCallIndex(ApiTraceCall*)),
-            this, SIGNAL(foundCallIndex(ApiTraceCall*)));
+            this, SLOT(loaderFoundCallIndex(ApiTraceCall*)));
 
 
     connect(m_loader, SIGNAL(parseProblem(const QString&)),
@@ -124,6 +131,9 @@ void ApiTrace::setFileName(const QString &name)
         m_errors.clear();
         m_editedCalls.clear();
         m_queuedErrors.clear();
+        m_cachedFrames.clear();
+        m_pinnedFrames.clear();
+        m_frameCacheUsage = 0;
         m_needsSaving = false;
         emit invalidated();
 
@@ -274,6 +284,20 @@ void ApiTrace::loaderFrameLoaded(ApiTraceFrame *frame,
         frame->setCalls(topLevelItems, calls, binaryDataSize);
         emit endLoadingFrame(frame);
         m_loadingFrames.remove(frame);
+
+        /* Thumbnails outlive the calls of unloaded frames */
+        if (!m_thumbnails.isEmpty()) {
+            for (ApiTraceCall *call : calls) {
+                ImageHash::const_iterator itr = m_thumbnails.constFind(call->index());
+                if (itr != m_thumbnails.constEnd()) {
+                    call->setThumbnail(*itr);
+                }
+            }
+        }
+
+        m_cachedFrames.append(frame);
+        m_frameCacheUsage += frame->memoryUsage();
+        touchFrame(frame);
     }
 
     if (!m_queuedErrors.isEmpty()) {
@@ -303,6 +327,8 @@ void ApiTrace::loaderFrameLoaded(ApiTraceFrame *frame,
             }
         }
     }
+
+    evictFrames(frame);
 }
 
 void ApiTrace::findNext(ApiTraceFrame *frame,
@@ -334,6 +360,7 @@ void ApiTrace::findNext(ApiTraceFrame *frame,
         ApiTraceFrame *frame = m_frames[i];
         request.frame = frame;
         if (!frame->isLoaded()) {
+            beginLoaderRequest();
             emit loaderSearch(request);
             return;
         } else {
@@ -375,6 +402,7 @@ void ApiTrace::findPrev(ApiTraceFrame *frame,
         ApiTraceFrame *frame = m_frames[i];
         request.frame = frame;
         if (!frame->isLoaded()) {
+            beginLoaderRequest();
             emit loaderSearch(request);
             return;
         } else {
@@ -388,6 +416,12 @@ void ApiTrace::findPrev(ApiTraceFrame *frame,
     emit findResult(request, SearchResult_Wrapped, 0);
 }
 
+void ApiTrace::cancelSearch()
+{
+    /* Not queued, the loader thread may be busy */
+    m_loader->cancelSearch();
+}
+
 void ApiTrace::loaderSearchResult(const ApiTrace::SearchRequest &request,
                                   ApiTrace::SearchResult result,
                                   ApiTraceCall *call)
@@ -395,6 +429,25 @@ void ApiTrace::loaderSearchResult(const ApiTrace::SearchRequest &request,
     //qDebug()<<"Search result = "<<result
     //       <<", call is = "<<call;
     emit findResult(request, result, call);
+    endLoaderRequest();
+}
+
+void ApiTrace::loaderFoundFrameStart(ApiTraceFrame *frame)
+{
+    emit foundFrameStart(frame);
+    endLoaderRequest();
+}
+
+void ApiTrace::loaderFoundFrameEnd(ApiTraceFrame *frame)
+{
+    emit foundFrameEnd(frame);
+    endLoaderRequest();
+}
+
+void ApiTrace::loaderFoundCallIndex(ApiTraceCall *call)
+{
+    emit foundCallIndex(call);
+    endLoaderRequest();
 }
 
 void ApiTrace::findFrameStart(ApiTraceFrame *frame)
@@ -405,6 +458,7 @@ void ApiTrace::findFrameStart(ApiTraceFrame *frame)
     if (frame->isLoaded()) {
         emit foundFrameStart(frame);
     } else {
+        beginLoaderRequest();
         emit loaderFindFrameStart(frame);
     }
 }
@@ -417,6 +471,7 @@ void ApiTrace::findFrameEnd(ApiTraceFrame *frame)
     if (frame->isLoaded()) {
         emit foundFrameEnd(frame);
     } else {
+        beginLoaderRequest();
         emit loaderFindFrameEnd(frame);
     }
 }
@@ -438,6 +493,7 @@ void ApiTrace::findCallIndex(int index)
             ApiTraceCall *call = frame->callWithIndex(index);
             emit foundCallIndex(call);
         } else {
+            beginLoaderRequest();
             emit loaderFindCallIndex(index);
         }
     }
@@ -570,3 +626,102 @@ void ApiTrace::iterateMissingThumbnails(void *object, ThumbnailCallback cb)
         (*cb)(object, thumbnailIndex);
     }
 }
+
+quint64 ApiTrace::frameCacheSize() const
+{
+    return m_frameCacheSize;
+}
+
+void ApiTrace::setFrameCacheSize(quint64 size)
+{
+    m_frameCacheSize = size;
+    evictFrames();
+}
+
+quint64 ApiTrace::frameCacheUsage() const
+{
+    return m_frameCacheUsage;
+}
+
+void ApiTrace::touchFrame(ApiTraceFrame *frame)
+{
+    frame->setLastUse(++m_frameUseCounter);
+}
+
+void ApiTrace::setPinnedFrames(const QSet<ApiTraceFrame*> &frames)
+{
+    m_pinnedFrames = frames;
+}
+
+void ApiTrace::beginLoaderRequest()
+{
+    ++m_loaderRequests;
+}
+
+void ApiTrace::endLoaderRequest()
+{
+    Q_ASSERT(m_loaderRequests > 0);
+    if (--m_loaderRequests == 0) {
+        evictFrames();
+    }
+}
+
+bool ApiTrace::isFrameEvictable(ApiTraceFrame *frame) const
+{
+    if (m_pinnedFrames.contains(frame)) {
+        return false;
+    }
+    foreach (ApiTraceCall *call, m_editedCalls) {
+        if (call->parentFrame() == frame) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ApiTrace::unloadFrame(ApiTraceFrame *frame)
+{
+    /* Errors are applied again when the frame is reloaded */
+    foreach (ApiTraceCall *call, frame->calls()) {
+        if (m_errors.remove(call)) {
+            ApiTraceError error;
+            error.callIndex = call->index();
+            error.message = call->error();
+            m_queuedErrors.append(qMakePair(frame, error));
+        }
+    }
+
+    m_cachedFrames.removeOne(frame);
+    m_frameCacheUsage -= frame->memoryUsage();
+
+    int numChildren = frame->numChildren();
+    if (numChildren) {
+        emit beginUnloadingFrame(frame, numChildren);
+    }
+    frame->unload();
+    if (numChildren) {
+        emit endUnloadingFrame(frame);
+    }
+}
+
+void ApiTrace::evictFrames(ApiTraceFrame *keep)
+{
+    if (m_frameCacheSize && !m_loaderRequests) {
+        while (m_frameCacheUsage > m_frameCacheSize) {
+            ApiTraceFrame *victim = 0;
+            foreach (ApiTraceFrame *frame, m_cachedFrames) {
+                if (frame != keep &&
+                    (!victim || frame->lastUse() < victim->lastUse()) &&
+                    isFrameEvictable(frame)) {
+                    victim = frame;
+                }
+            }
+            if (!victim) {
+                break;
+            }
+            unloadFrame(victim);
+        }
+    }
+
+    emit frameCacheChanged(m_frameCacheUsage, m_frameCacheSize);
+}
@@ -21,7 +21,8 @@ public:
     enum SearchResult {
         SearchResult_NotFound,
         SearchResult_Found,
-        SearchResult_Wrapped
+        SearchResult_Wrapped,
+        SearchResult_Cancelled
     };
     struct SearchRequest {
         enum Direction {
@@ -90,6 +91,18 @@ public:
 
     void iterateMissingThumbnails(void *object, ThumbnailCallback cb);
 
+    /* Loaded frames are unloaded, least recently used first, once their
+     * calls take more than this many bytes; 0 means no limit. */
+    quint64 frameCacheSize() const;
+    void setFrameCacheSize(quint64 size);
+    quint64 frameCacheUsage() const;
+
+    void touchFrame(ApiTraceFrame *frame);
+
+    /* Frames whose calls are referenced from outside the trace, and must
+     * thus stay loaded. */
+    void setPinnedFrames(const QSet<ApiTraceFrame*> &frames);
+
 public slots:
     void setFileName(const QString &name);
     void save();
@@ -105,6 +118,7 @@ public slots:
                   const QString &str,
                   Qt::CaseSensitivity sensitivity,
                   bool useRegex);
+    void cancelSearch();
     void findFrameStart(ApiTraceFrame *frame);
     void findFrameEnd(ApiTraceFrame *frame);
     void findCallIndex(int index);
@@ -132,6 +146,9 @@ signals:
     void endAddingFrames();
     void beginLoadingFrame(ApiTraceFrame *frame, int numAdded);
     void endLoadingFrame(ApiTraceFrame *frame);
+    void beginUnloadingFrame(ApiTraceFrame *frame, int numRemoved);
+    void endUnloadingFrame(ApiTraceFrame *frame);
+    void frameCacheChanged(quint64 usage, quint64 size);
     void foundFrameStart(ApiTraceFrame *frame);
     void foundFrameEnd(ApiTraceFrame *frame);
     void foundCallIndex(ApiTraceCall *call);
@@ -153,11 +170,20 @@ private slots:
     void loaderSearchResult(const ApiTrace::SearchRequest &request,
                             ApiTrace::SearchResult result,
                             ApiTraceCall *call);
+    void loaderFoundFrameStart(ApiTraceFrame *frame);
+    void loaderFoundFrameEnd(ApiTraceFrame *frame);
+    void loaderFoundCallIndex(ApiTraceCall *call);
 
 private:
     int callInFrame(int callIdx) const;
     bool isFrameLoading(ApiTraceFrame *frame) const;
 
+    void beginLoaderRequest();
+    void endLoaderRequest();
+    bool isFrameEvictable(ApiTraceFrame *frame) const;
+    void unloadFrame(ApiTraceFrame *frame);
+    void evictFrames(ApiTraceFrame *keep = 0);
+
     void missingThumbnail(int callIdx);
 private:
     QString m_fileName;
@@ -181,4 +207,13 @@ private:
     QSet<int> m_missingThumbnails;
 
     ImageHash m_thumbnails;
+
+    QList<ApiTraceFrame*> m_cachedFrames;
+    QSet<ApiTraceFrame*> m_pinnedFrames;
+    quint64 m_frameCacheSize;
+    quint64 m_frameCacheUsage;
+    quint64 m_frameUseCounter;
+    /* The loader accesses loaded frames while it searches, so frames are
+     * not unloaded while such requests are in flight. */
+    int m_loaderRequests;
 };
@@ -4,14 +4,18 @@
 #include "traceloader.h"
 #include "trace_model.hpp"
 
+#include <QCache>
 #include <QDebug>
 #include <QLocale>
+#include <QMutex>
 #include <QObject>
 #define QT_USE_FAST_OPERATOR_PLUS
 #include <QStringBuilder>
 #include <QTextDocument>
 #include <QRegularExpression>
 
+#include <string.h>
+
 const char * const styleSheet =
     ".call {\n"
     "    font-weight:bold;\n"
@@ -153,6 +157,130 @@ apiVariantToString(const QVariant &variant, bool multiLine)
     return QString();
 }
 
+/*
+ * Formats trace::Values the way apiVariantToString() formats their
+ * QVariant conversions, without building any of the intermediate
+ * QVariants.  Used to search the trace from the loader threads.
+ */
+class SearchTextVisitor : public trace::Visitor
+{
+public:
+    SearchTextVisitor(QString &text)
+        : m_text(text)
+    {}
+
+    void visit(trace::Null *) override
+    {
+        m_text += QLatin1String("NULL");
+    }
+    void visit(trace::Bool *node) override
+    {
+        m_text += node->value ? QLatin1String("true") : QLatin1String("false");
+    }
+    void visit(trace::SInt *node) override
+    {
+        m_text += QString::number(node->value);
+    }
+    void visit(trace::UInt *node) override
+    {
+        m_text += QString::number(node->value);
+    }
+    void visit(trace::Float *node) override
+    {
+        m_text += QString::number(node->value);
+    }
+    void visit(trace::Double *node) override
+    {
+        m_text += QString::number(node->value);
+    }
+    void visit(trace::String *node) override
+    {
+        m_text += plainTextToHTML(QString::fromLatin1(node->value), false);
+    }
+    void visit(trace::WString *node) override
+    {
+        m_text += plainTextToHTML(QString::fromWCharArray(node->value), false);
+    }
+    void visit(trace::Enum *e) override
+    {
+        m_text += ApiEnum(e->sig, e->value).toString();
+    }
+    void visit(trace::Bitmask *bitmask) override
+    {
+        m_text += ApiBitmask(bitmask).toString();
+    }
+    void visit(trace::Struct *str) override
+    {
+        m_text += QLatin1String("{");
+        for (unsigned i = 0; i < str->sig->num_members; ++i) {
+            m_text += QLatin1String(str->sig->member_names[i]);
+            m_text += QLatin1String(" = ");
+            str->members[i]->visit(*this);
+            if (i < str->sig->num_members - 1)
+                m_text += QLatin1String(", ");
+        }
+        m_text += QLatin1String("}");
+    }
+    void visit(trace::Array *array) override
+    {
+        m_text += QLatin1String("[");
+        for (size_t i = 0; i < array->values.size(); ++i) {
+            array->values[i]->visit(*this);
+            if (i < array->values.size() - 1)
+                m_text += QLatin1String(", ");
+        }
+        m_text += QLatin1String("]");
+    }
+    void visit(trace::Blob *blob) override
+    {
+        if (blob->size < 1024) {
+            m_text += QObject::tr("[binary data, size = %1 bytes]")
+                .arg(blob->size);
+        } else {
+            float kb = blob->size/1024.;
+            m_text += QObject::tr("[binary data, size = %1 kb]").arg(kb);
+        }
+    }
+    void visit(trace::Pointer *ptr) override
+    {
+        m_text += ApiPointer(ptr->value).toString();
+    }
+    void visit(trace::Repr *repr) override
+    {
+        repr->humanValue->visit(*this);
+    }
+
+private:
+    QString &m_text;
+};
+
+QString
+traceCallToSearchText(const trace::Call *call)
+{
+    QString text = QString::fromLatin1(call->sig->name);
+    SearchTextVisitor visitor(text);
+
+    text += QLatin1String("(");
+    for (unsigned i = 0; i < call->sig->num_args; ++i) {
+        text += QLatin1String(call->sig->arg_names[i]);
+        text += QLatin1String(" = ");
+        if (i < call->args.size() && call->args[i].value) {
+            call->args[i].value->visit(visitor);
+        } else {
+            text += QLatin1String("?");
+        }
+        if (i < call->sig->num_args - 1)
+            text += QLatin1String(", ");
+    }
+    text += QLatin1String(")");
+
+    if (call->ret) {
+        text += QLatin1String(" = ");
+        call->ret->visit(visitor);
+    }
+    return text;
+}
+
 
 void VariantVisitor::visit(trace::Null *)
 {
@@ -467,61 +595,67 @@ static ApiTexture getTextureFrom(QVariantMap const &image, QString label)
 
 ApiTraceState::ApiTraceState(const QVariantMap &parsedJson)
 {
-    m_parameters = parsedJson[QLatin1String("parameters")].toMap();
-    QVariantMap attachedShaders =
-        parsedJson[QLatin1String("shaders")].toMap();
     QVariantMap::const_iterator itr;
-
-
-    for (itr = attachedShaders.constBegin(); itr != attachedShaders.constEnd();
-         ++itr) {
-        QString type = itr.key();
-        QString source = itr.value().toString();
-        m_shaderSources[type] = source;
+    for (itr = parsedJson.constBegin(); itr != parsedJson.constEnd(); ++itr) {
+        addSection(itr.key(), itr.value());
     }
+}
 
-    m_uniforms = parsedJson[QLatin1String("uniforms")].toMap();
-
-    m_buffers = parsedJson[QLatin1String("buffers")].toMap();
-
-    m_shaderStorageBufferBlocks =
-        parsedJson[QLatin1String("shaderstoragebufferblocks")].toMap();
+void ApiTraceState::addSection(const QString &name, const QVariant &value)
+{
+    QVariantMap::const_iterator itr;
 
-    {
-        QVariantMap textures =
-            parsedJson[QLatin1String("textures")].toMap();
+    if (name == QLatin1String("parameters")) {
+        m_parameters = value.toMap();
+    } else if (name == QLatin1String("shaders")) {
+        QVariantMap attachedShaders = value.toMap();
+        for (itr = attachedShaders.constBegin(); itr != attachedShaders.constEnd();
+             ++itr) {
+            QString type = itr.key();
+            QString source = itr.value().toString();
+            m_shaderSources[type] = source;
+        }
+    } else if (name == QLatin1String("uniforms")) {
+        m_uniforms = value.toMap();
+    } else if (name == QLatin1String("buffers")) {
+        m_buffers = value.toMap();
+    } else if (name == QLatin1String("shaderstoragebufferblocks")) {
+        m_shaderStorageBufferBlocks = value.toMap();
+    } else if (name == QLatin1String("textures")) {
+        QVariantMap textures = value.toMap();
         for (itr = textures.constBegin(); itr != textures.constEnd(); ++itr) {
             m_textures.append(getTextureFrom(itr.value().toMap(), itr.key()));
         }
-    }
+    } else if (name == QLatin1String("framebuffer")) {
+        QVariantMap fbos = value.toMap();
+        for (itr = fbos.constBegin(); itr != fbos.constEnd(); ++itr) {
+            QVariantMap buffer = itr.value().toMap();
+            QSize size(buffer[QLatin1String("__width__")].toInt(),
+                       buffer[QLatin1String("__height__")].toInt());
+            QString cls = buffer[QLatin1String("__class__")].toString();
+            int depth = buffer[QLatin1String("__depth__")].toInt();
+            QString formatName = buffer[QLatin1String("__format__")].toString();
+
+            /* QByteArray is implicitly shared, so the pixels decoded from the
+             * stream are not copied again */
+            QByteArray dataArray =
+                buffer[QLatin1String("__data__")].toByteArray();
+
+            QString label = itr.key();
+            QString userLabel =
+                buffer[QLatin1String("__label__")].toString();
+            if (!userLabel.isEmpty()) {
+                label += QString(", \"%1\"").arg(userLabel);
+            }
 
-    QVariantMap fbos =
-        parsedJson[QLatin1String("framebuffer")].toMap();
-    for (itr = fbos.constBegin(); itr != fbos.constEnd(); ++itr) {
-        QVariantMap buffer = itr.value().toMap();
-        QSize size(buffer[QLatin1String("__width__")].toInt(),
-                   buffer[QLatin1String("__height__")].toInt());
-        QString cls = buffer[QLatin1String("__class__")].toString();
-        int depth = buffer[QLatin1String("__depth__")].toInt();
-        QString formatName = buffer[QLatin1String("__format__")].toString();
-
-        QByteArray dataArray =
-            buffer[QLatin1String("__data__")].toByteArray();
-
-        QString label = itr.key();
-        QString userLabel =
-            buffer[QLatin1String("__label__")].toString();
-        if (!userLabel.isEmpty()) {
-            label += QString(", \"%1\"").arg(userLabel);
+            ApiFramebuffer fbo;
+            fbo.setSize(size);
+            fbo.setDepth(depth);
+            fbo.setFormatName(formatName);
+            fbo.setType(label);
+            fbo.setData(dataArray);
+            m_framebuffers.append(fbo);
         }
-
-        ApiFramebuffer fbo;
-        fbo.setSize(size);
-        fbo.setDepth(depth);
-        fbo.setFormatName(formatName);
-        fbo.setType(label);
-        fbo.setData(dataArray);
-        m_framebuffers.append(fbo);
     }
 }
 
@@ -660,10 +794,78 @@ bool ApiTraceEvent::ignored() const
     return m_ignored;
 }
 
+static quint64 variantMemoryUsage(const QVariant &var)
+{
+    quint64 size = sizeof var;
+    int type = var.userType();
+    if (type == QMetaType::QByteArray) {
+        size += var.toByteArray().size();
+    } else if (type == QMetaType::QString) {
+        size += var.toString().size() * sizeof(QChar);
+    } else if (type == qMetaTypeId<ApiArray>()) {
+        for (const QVariant &value : var.value<ApiArray>().values()) {
+            size += variantMemoryUsage(value);
+        }
+    } else if (type == qMetaTypeId<ApiStruct>()) {
+        for (const QVariant &value : var.value<ApiStruct>().values()) {
+            size += variantMemoryUsage(value);
+        }
+    }
+    return size;
+}
+
+static quint64 valueMemoryUsage(const trace::Value *value)
+{
+    if (!value) {
+        return 0;
+    }
+    quint64 size = sizeof(trace::UInt);
+    if (const trace::Array *array = value->toArray()) {
+        for (const trace::Value *elem : array->values) {
+            size += sizeof elem + valueMemoryUsage(elem);
+        }
+    } else if (const trace::Struct *str = value->toStruct()) {
+        for (const trace::Value *member : str->members) {
+            size += sizeof member + valueMemoryUsage(member);
+        }
+    } else if (const trace::Blob *blob = value->toBlob()) {
+        size += blob->size;
+    } else if (const trace::String *string =
+                   dynamic_cast<const trace::String *>(value)) {
+        size += strlen(string->value) + 1;
+    } else if (const trace::Repr *repr =
+                   dynamic_cast<const trace::Repr *>(value)) {
+        size += valueMemoryUsage(repr->humanValue) +
+                valueMemoryUsage(repr->machineValue);
+    }
+    return size;
+}
+
+namespace {
+
+struct CallValues
+{
+    QVector<QVariant> arguments;
+    QVariant returnValue;
+};
+
+}
+
+/*
+ * Converting trace::Values to QVariants is expensive and the result is
+ * several times larger, so it is only done for the calls being shown,
+ * edited or searched, and kept in a small cache shared by all calls.
+ * The cost is in KiB.  Calls are created and searched in the loader
+ * thread, hence the mutex.
+ */
+static QMutex callValuesMutex;
+static QCache<const ApiTraceCall *, CallValues> callValuesCache(64 * 1024);
+
 ApiTraceCall::ApiTraceCall(ApiTraceFrame *parentFrame,
                            TraceLoader *loader,
-                           const trace::Call *call)
+                           trace::Call *call)
     : ApiTraceEvent(ApiTraceEvent::Call),
+      m_call(call),
       m_parentFrame(parentFrame),
       m_parentCall(0)
 {
@@ -672,8 +874,9 @@ ApiTraceCall::ApiTraceCall(ApiTraceFrame *parentFrame,
 
 ApiTraceCall::ApiTraceCall(ApiTraceCall *parentCall,
                            TraceLoader *loader,
-                           const trace::Call *call)
+                           trace::Call *call)
     : ApiTraceEvent(ApiTraceEvent::Call),
+      m_call(call),
       m_parentFrame(parentCall->parentFrame()),
       m_parentCall(parentCall)
 {
@@ -683,6 +886,11 @@ ApiTraceCall::ApiTraceCall(ApiTraceCall *parentCall,
 
 ApiTraceCall::~ApiTraceCall()
 {
+    QMutexLocker locker(&callValuesMutex);
+    callValuesCache.remove(this);
+    locker.unlock();
+
+    delete m_call;
 }
 
 
@@ -692,6 +900,7 @@ ApiTraceCall::loadData(TraceLoader *loader,
 {
     m_index = call->no;
     m_thread = call->thread_id;
+    m_parser = loader->parser();
     m_signature = loader->signature(call->sig->id);
 
     if (!m_signature) {
@@ -704,44 +913,30 @@ ApiTraceCall::loadData(TraceLoader *loader,
         m_signature = new ApiTraceCallSignature(name, argNames);
         loader->addSignature(call->sig->id, m_signature);
     }
-    if (call->ret) {
-        VariantVisitor retVisitor;
-        call->ret->visit(retVisitor);
-        m_returnValue = retVisitor.variant();
-    }
-    m_argValues.reserve(call->args.size());
     for (int i = 0; i < call->args.size(); ++i) {
-        if (call->args[i].value) {
-            VariantVisitor argVisitor;
-            call->args[i].value->visit(argVisitor);
-            m_argValues.append(argVisitor.variant());
-            if (m_argValues[i].type() == QVariant::ByteArray) {
-                m_binaryDataIndex = i;
-            }
-        } else {
-            m_argValues.append(QVariant());
+        if (call->args[i].value && call->args[i].value->toBlob()) {
+            m_binaryDataIndex = i;
         }
     }
-    m_argValues.squeeze();
     m_flags = call->flags;
     if (call->backtrace != NULL) {
         QString qbacktrace;
-        for (auto frame : *call->backtrace) {
-            if (frame->module != NULL) {
-                qbacktrace += QString("%1 ").arg(frame->module);
+        for (auto & frame : loader->symbolize(*call->backtrace)) {
+            if (frame.module != NULL) {
+                qbacktrace += QString("%1 ").arg(frame.module);
             }
-            if (frame->function != NULL) {
-                qbacktrace += QString("at %1() ").arg(frame->function);
+            if (frame.function != NULL) {
+                qbacktrace += QString("at %1() ").arg(frame.function);
             }
-            if (frame->filename != NULL) {
-                qbacktrace += QString("at %1").arg(frame->filename);
-                if (frame->linenumber >= 0) {
-                    qbacktrace += QString(":%1 ").arg(frame->linenumber);
+            if (frame.filename != NULL) {
+                qbacktrace += QString("at %1").arg(frame.filename);
+                if (frame.linenumber >= 0) {
+                    qbacktrace += QString(":%1 ").arg(frame.linenumber);
                 }
             }
             else {
-                if (frame->offset >= 0) {
-                    qbacktrace += QString("[0x%1]").arg(frame->offset, 0, 16);
+                if (frame.offset >= 0) {
+                    qbacktrace += QString("[0x%1]").arg(frame.offset, 0, 16);
                 }
             }
             qbacktrace += "\n";
@@ -750,6 +945,61 @@ ApiTraceCall::loadData(TraceLoader *loader,
     }
 }
 
+void
+ApiTraceCall::loadValues(QVector<QVariant> *arguments,
+                         QVariant *returnValue) const
+{
+    QMutexLocker locker(&callValuesMutex);
+
+    const CallValues *cached = callValuesCache.object(this);
+    if (cached) {
+        if (arguments) {
+            *arguments = cached->arguments;
+        }
+        if (returnValue) {
+            *returnValue = cached->returnValue;
+        }
+        return;
+    }
+
+    locker.unlock();
+
+    CallValues values;
+    if (m_call) {
+        values.arguments.reserve(m_call->args.size());
+        for (const trace::Arg &arg : m_call->args) {
+            if (arg.value) {
+                VariantVisitor argVisitor;
+                arg.value->visit(argVisitor);
+                values.arguments.append(argVisitor.variant());
+            } else {
+                values.arguments.append(QVariant());
+            }
+        }
+        if (m_call->ret) {
+            VariantVisitor retVisitor;
+            m_call->ret->visit(retVisitor);
+            values.returnValue = retVisitor.variant();
+        }
+    }
+
+    if (arguments) {
+        *arguments = values.arguments;
+    }
+    if (returnValue) {
+        *returnValue = values.returnValue;
+    }
+
+    quint64 size = sizeof values + variantMemoryUsage(values.returnValue);
+    for (const QVariant &value : values.arguments) {
+        size += variantMemoryUsage(value);
+    }
+
+    locker.relock();
+    callValuesCache.insert(this, new CallValues(values),
+                           qMax<quint64>(size >> 10, 1));
+}
+
 ApiTraceCall *
 ApiTraceCall::parentCall() const
 {
@@ -818,7 +1068,9 @@ ApiTrace * ApiTraceCall::parentTrace() const
 
 QVector<QVariant> ApiTraceCall::originalValues() const
 {
-    return m_argValues;
+    QVector<QVariant> values;
+    loadValues(&values, 0);
+    return values;
 }
 
 void ApiTraceCall::setEditedValues(const QVector<QVariant> &lst)
@@ -889,7 +1141,7 @@ QStringList ApiTraceCall::argNames() const
 QVector<QVariant> ApiTraceCall::arguments() const
 {
     if (m_editedValues.isEmpty())
-        return m_argValues;
+        return originalValues();
     else
         return m_editedValues;
 }
@@ -905,7 +1157,9 @@ ApiTraceCall::eventAtRow(int row) const
 
 QVariant ApiTraceCall::returnValue() const
 {
-    return m_returnValue;
+    QVariant value;
+    loadValues(0, &value);
+    return value;
 }
 
 trace::CallFlags ApiTraceCall::flags() const
@@ -946,6 +1200,7 @@ QStaticText ApiTraceCall::staticText() const
 
     QStringList argNames = m_signature->argNames();
     QVector<QVariant> argValues = arguments();
+    QVariant retValue = returnValue();
 
     QString richText;
 
@@ -990,11 +1245,11 @@ QStaticText ApiTraceCall::staticText() const
                 richText += QLatin1String(", ");
         }
         richText += QLatin1String(")");
-        if (m_returnValue.isValid()) {
+        if (retValue.isValid()) {
             richText +=
                 QLatin1String(" = ") %
                 QLatin1String("<span style=\"color:#0000ff\">") %
-                apiVariantToString(m_returnValue) %
+                apiVariantToString(retValue) %
                 QLatin1String("</span>");
         }
     }
@@ -1047,6 +1302,7 @@ QString ApiTraceCall::toHtml() const
     }
 
     QVector<QVariant> argValues = arguments();
+    QVariant retValue = returnValue();
     QStringList argNames = m_signature->argNames();
     for (int i = 0; i < argNames.count(); ++i) {
         m_richText +=
@@ -1062,11 +1318,11 @@ QString ApiTraceCall::toHtml() const
     }
     m_richText += QLatin1String(")");
 
-    if (m_returnValue.isValid()) {
+    if (retValue.isValid()) {
         m_richText +=
             QLatin1String(" = ") +
             QLatin1String("<span style=\"color:#0000ff\">") +
-            apiVariantToString(m_returnValue, true) +
+            apiVariantToString(retValue, true) +
             QLatin1String("</span>");
     }
     m_richText += QLatin1String("</div>");
@@ -1096,7 +1352,14 @@ QString ApiTraceCall::searchText() const
     if (!m_searchText.isEmpty())
         return m_searchText;
 
+    if (m_editedValues.isEmpty() && m_call) {
+        m_searchText = traceCallToSearchText(m_call);
+        m_searchText.squeeze();
+        return m_searchText;
+    }
+
     QVector<QVariant> argValues = arguments();
+    QVariant retValue = returnValue();
     m_searchText = m_signature->name();
     m_searchText += QLatin1String("(");
     QStringList argNames = m_signature->argNames();
@@ -1109,9 +1372,9 @@ QString ApiTraceCall::searchText() const
     }
     m_searchText += QLatin1String(")");
 
-    if (m_returnValue.isValid()) {
+    if (retValue.isValid()) {
         m_searchText += QLatin1String(" = ") +
-                        apiVariantToString(m_returnValue);
+                        apiVariantToString(retValue);
     }
     m_searchText.squeeze();
     return m_searchText;
@@ -1142,11 +1405,39 @@ void ApiTraceCall::missingThumbnail()
     m_parentFrame->parentTrace()->missingThumbnail(this);
 }
 
+/* An estimate, good enough to budget the frame cache */
+quint64 ApiTraceCall::memoryUsage() const
+{
+    quint64 size = sizeof *this;
+    if (m_call) {
+        size += sizeof *m_call +
+                m_call->args.capacity() * sizeof(trace::Arg) +
+                valueMemoryUsage(m_call->ret);
+        for (const trace::Arg &arg : m_call->args) {
+            size += valueMemoryUsage(arg.value);
+        }
+    }
+    for (const QVariant &value : m_editedValues) {
+        size += variantMemoryUsage(value);
+    }
+    size += (m_backtrace.size() + m_richText.size() + m_searchText.size()) *
+            sizeof(QChar);
+    if (m_staticText) {
+        size += sizeof *m_staticText +
+                m_staticText->text().size() * sizeof(QChar);
+    }
+    size += m_children.capacity() * sizeof(ApiTraceCall*);
+    size += m_thumbnail.sizeInBytes();
+    return size;
+}
+
 
 ApiTraceFrame::ApiTraceFrame(ApiTrace *parentTrace)
     : ApiTraceEvent(ApiTraceEvent::Frame),
       m_parentTrace(parentTrace),
       m_binaryDataSize(0),
+      m_memoryUsage(0),
+      m_lastUse(0),
       m_loaded(false),
       m_callsToLoad(0),
       m_lastCallIndex(0)
@@ -1283,6 +1574,37 @@ void ApiTraceFrame::setCalls(const QVector<ApiTraceCall*> &children,
     m_loaded = true;
     delete m_staticText;
     m_staticText = 0;
+
+    m_memoryUsage = sizeof *this;
+    for (ApiTraceCall *call : m_calls) {
+        m_memoryUsage += call->memoryUsage();
+    }
+}
+
+void ApiTraceFrame::unload()
+{
+    qDeleteAll(m_calls);
+    m_calls.clear();
+    m_children.clear();
+    m_memoryUsage = 0;
+    m_loaded = false;
+    delete m_staticText;
+    m_staticText = 0;
+}
+
+quint64 ApiTraceFrame::memoryUsage() const
+{
+    return m_memoryUsage;
+}
+
+void ApiTraceFrame::setLastUse(quint64 counter)
+{
+    m_lastUse = counter;
+}
+
+quint64 ApiTraceFrame::lastUse() const
+{
+    return m_lastUse;
 }
 
 bool ApiTraceFrame::isLoaded() const
@@ -2,6 +2,7 @@
 
 #include "apisurface.h"
 
+#include <QSharedPointer>
 #include <QStaticText>
 #include <QStringList>
 #include <QUrl>
@@ -10,6 +11,10 @@
 #include "trace_model.hpp"
 
 
+namespace trace {
+class Parser;
+}
+
 class ApiTrace;
 class TraceLoader;
 
@@ -137,6 +142,9 @@ Q_DECLARE_METATYPE(ApiArray);
 
 QString apiVariantToString(const QVariant &variant, bool multiLine = false);
 
+/* Same text as ApiTraceCall::searchText(), straight from the parsed call */
+QString traceCallToSearchText(const trace::Call *call);
+
 class ApiTraceFrame;
 
 class ApiTraceState {
@@ -144,6 +152,10 @@ public:
     ApiTraceState();
     explicit ApiTraceState(const QVariantMap &parseJson);
 
+    /* Merges one top-level member of the retraced state dump, so that a
+     * state can be built up while the dump is still being received. */
+    void addSection(const QString &name, const QVariant &value);
+
     bool isEmpty() const;
     const QVariantMap & parameters() const;
     const QMap<QString, QString> & shaderSources() const;
@@ -243,10 +255,12 @@ Q_DECLARE_METATYPE(ApiTraceEvent*);
 class ApiTraceCall : public ApiTraceEvent
 {
 public:
+    /* Takes ownership of tcall, whose values are only converted to
+     * QVariants when the call is displayed, edited or searched */
     ApiTraceCall(ApiTraceCall *parentCall, TraceLoader *loader,
-                 const trace::Call *tcall);
+                 trace::Call *tcall);
     ApiTraceCall(ApiTraceFrame *parentFrame, TraceLoader *loader,
-                 const trace::Call *tcall);
+                 trace::Call *tcall);
     ~ApiTraceCall();
 
     int index() const;
@@ -298,15 +312,20 @@ public:
 
     void missingThumbnail() override;
 
+    quint64 memoryUsage() const;
+
 private:
     void loadData(TraceLoader *loader,
                   const trace::Call *tcall);
+    void loadValues(QVector<QVariant> *arguments,
+                    QVariant *returnValue) const;
 private:
     int m_index;
     unsigned m_thread;
     ApiTraceCallSignature *m_signature;
-    QVector<QVariant> m_argValues;
-    QVariant m_returnValue;
+    trace::Call *m_call;
+    /* The parser frees the signatures m_call refers to when closed */
+    QSharedPointer<const trace::Parser> m_parser;
     trace::CallFlags m_flags;
     ApiTraceFrame *m_parentFrame;
     ApiTraceCall *m_parentCall;
@@ -368,9 +387,18 @@ public:
 
     void missingThumbnail() override;
 
+    /* Releases the calls, which will be loaded again when needed */
+    void unload();
+    quint64 memoryUsage() const;
+
+    void setLastUse(quint64 counter);
+    quint64 lastUse() const;
+
 private:
     ApiTrace *m_parentTrace;
     quint64 m_binaryDataSize;
+    quint64 m_memoryUsage;
+    quint64 m_lastUse;
     QVector<ApiTraceCall*> m_children;
     QVector<ApiTraceCall*> m_calls;
     bool m_loaded;
@@ -7,12 +7,127 @@
 #include <QToolTip>
 #include <QMouseEvent>
 
+MaxIndexPyramid::MaxIndexPyramid() :
+    m_data(NULL),
+    m_selectedOnly(false)
+{
+}
+
+
+void MaxIndexPyramid::build(const GraphDataProvider* data, bool selectedOnly)
+{
+    m_data = data;
+    m_selectedOnly = selectedOnly;
+    m_levels.clear();
+
+    if (!m_data) {
+        return;
+    }
+
+    qint64 size = m_data->size();
+
+    while (size > 1) {
+        QVector<qint64> level((size + 1) / 2);
+
+        for (qint64 i = 0; i < level.size(); ++i) {
+            qint64 a, b;
+
+            if (m_levels.isEmpty()) {
+                a = 2 * i;
+                b = 2 * i + 1 < size ? 2 * i + 1 : -1;
+
+                if (m_selectedOnly) {
+                    a = m_data->selected(a) ? a : -1;
+                    b = b >= 0 && m_data->selected(b) ? b : -1;
+                }
+            } else {
+                const QVector<qint64>& below = m_levels.last();
+                a = below[2 * i];
+                b = 2 * i + 1 < size ? below[2 * i + 1] : -1;
+            }
+
+            level[i] = higher(a, b);
+        }
+
+        m_levels.append(level);
+        size = level.size();
+    }
+}
+
+
+void MaxIndexPyramid::clear()
+{
+    m_data = NULL;
+    m_levels.clear();
+}
+
+
+qint64 MaxIndexPyramid::higher(qint64 a, qint64 b) const
+{
+    if (a < 0) {
+        return b;
+    }
+
+    if (b < 0) {
+        return a;
+    }
+
+    return m_data->value(b) > m_data->value(a) ? b : a;
+}
+
+
+qint64 MaxIndexPyramid::maxIndex(qint64 begin, qint64 end) const
+{
+    if (!m_data) {
+        return -1;
+    }
+
+    begin = qMax<qint64>(begin, 0);
+    end = qMin<qint64>(end, m_data->size());
+
+    qint64 best = -1;
+
+    /* Standard bottom up range query, level -1 being the items themselves */
+    for (int k = -1; begin < end; ++k, begin >>= 1, end >>= 1) {
+        if (begin & 1) {
+            qint64 index = begin++;
+
+            if (k >= 0) {
+                index = m_levels[k][index];
+            } else if (m_selectedOnly && !m_data->selected(index)) {
+                index = -1;
+            }
+
+            best = higher(best, index);
+        }
+
+        if (end & 1) {
+            qint64 index = --end;
+
+            if (k >= 0) {
+                index = m_levels[k][index];
+            } else if (m_selectedOnly && !m_data->selected(index)) {
+                index = -1;
+            }
+
+            best = higher(best, index);
+        }
+    }
+
+    return best;
+}
+
+
 HistogramView::HistogramView(QWidget* parent) :
     GraphView(parent),
     m_data(NULL)
 {
     setMouseTracking(true);
 
+    m_selectedPyramidState.type = SelectionState::None;
+    m_selectedPyramidState.start = 0;
+    m_selectedPyramidState.end = 0;
+
     m_gradientUnselected.setColorAt(0.9, QColor(200, 200, 200));
     m_gradientUnselected.setColorAt(0.0, QColor(220, 220, 220));
 
@@ -26,6 +141,10 @@ void HistogramView::setDataProvider(GraphDataProvider* data)
     delete m_data;
     m_data = data;
 
+    m_pyramid.build(m_data, false);
+    m_selectedPyramid.clear();
+    m_selectedPyramidState.type = SelectionState::None;
+
     if (m_data) {
         m_data->setSelectionState(m_selectionState);
         setDefaultView(0, m_data->size());
@@ -100,12 +219,10 @@ void HistogramView::update()
     m_graphTop = 0;
 
     if (m_data) {
-        for (qint64 i = m_viewLeft; i < m_viewRight; ++i) {
-            qint64 value = m_data->value(i);
+        qint64 index = m_pyramid.maxIndex(m_viewLeft, m_viewRight);
 
-            if (value > m_graphTop) {
-                m_graphTop = value;
-            }
+        if (index >= 0) {
+            m_graphTop = qMax<qint64>(0, m_data->value(index));
         }
     }
 
@@ -145,11 +262,8 @@ void HistogramView::paintEvent(QPaintEvent *)
     bool selection = m_selectionState && m_selectionState->type != SelectionState::None;
 
     if (dxdv < 1.0) {
-        /* Less than one pixel per item */
-        qint64 longestValue = m_graphBottom;
-        qint64 longestSelected = m_graphBottom;
-        int lastX = 0;
-        double x = 0;
+        /* Less than one pixel per item, query the highest item of each column */
+        double dvdx = 1.0 / dxdv;
 
         if (selection) {
             painter.setPen(unselectedPen);
@@ -157,33 +271,28 @@ void HistogramView::paintEvent(QPaintEvent *)
             painter.setPen(selectedPen);
         }
 
-        for (qint64 i = m_viewLeft; i < m_viewRight; ++i) {
-            qint64 value = m_data->value(i);
-            int ix;
+        for (int x = 0; x < width(); ++x) {
+            qint64 begin = m_viewLeft + qFloor(x * dvdx);
+            qint64 end = qMin<qint64>(m_viewLeft + qFloor((x + 1) * dvdx), m_viewRight);
 
-            if (value > longestValue) {
-                longestValue = value;
+            if (begin >= end) {
+                continue;
             }
 
-            if (selection && m_data->selected(i) && value > longestSelected) {
-                longestSelected = value;
-            }
+            qint64 index = m_pyramid.maxIndex(begin, end);
 
-            x += dxdv;
-            ix = (int)x;
+            if (index >= 0) {
+                painter.drawLine(x, height(), x, height() - (m_data->value(index) * dydv));
+            }
 
-            if (lastX != ix) {
-                painter.drawLine(lastX, height(), lastX, height() - (longestValue * dydv));
+            if (selection) {
+                index = selectedMaxIndex(begin, end);
 
-                if (selection && longestSelected > m_graphBottom) {
+                if (index >= 0 && m_data->value(index) > m_graphBottom) {
                     painter.setPen(selectedPen);
-                    painter.drawLine(lastX, height(), lastX, height() - (longestSelected * dydv));
+                    painter.drawLine(x, height(), x, height() - (m_data->value(index) * dydv));
                     painter.setPen(unselectedPen);
-                    longestSelected = m_graphBottom;
                 }
-
-                longestValue = m_graphBottom;
-                lastX = ix;
             }
         }
     } else {
@@ -231,23 +340,40 @@ qint64 HistogramView::itemAtPosition(QPoint pos) {
     qint64 left = qFloor(dvdx * (pos.x() - 1)) + m_viewLeft;
     qint64 right = qCeil(dvdx * (pos.x() + 1)) + m_viewLeft;
 
-    qint64 longestIndex = 0;
-    qint64 longestValue = 0;
-
     left = qBound<qint64>(0, left, m_data->size() - 1);
     right = qBound<qint64>(0, right, m_data->size() - 1);
 
-    for (qint64 i = left; i <= right; ++i) {
-        if (m_data->value(i) > longestValue) {
-            longestValue = m_data->value(i);
-            longestIndex = i;
-        }
+    qint64 longestIndex = m_pyramid.maxIndex(left, right + 1);
+
+    if (longestIndex < 0 || m_data->value(longestIndex) <= 0) {
+        return 0;
     }
 
     return longestIndex;
 }
 
 
+/* Find the selected item with the highest value in [begin, end) */
+qint64 HistogramView::selectedMaxIndex(qint64 begin, qint64 end)
+{
+    if (m_selectionState->type == SelectionState::Horizontal) {
+        /* Items are selected by index range */
+        return m_pyramid.maxIndex(qMax(begin, m_selectionState->start),
+                                  qMin(end, m_selectionState->end));
+    }
+
+    /* Otherwise it is up to the data provider, summarise the selection once */
+    if (m_selectedPyramidState.type != m_selectionState->type ||
+        m_selectedPyramidState.start != m_selectionState->start ||
+        m_selectedPyramidState.end != m_selectionState->end) {
+        m_selectedPyramid.build(m_data, true);
+        m_selectedPyramidState = *m_selectionState;
+    }
+
+    return m_selectedPyramid.maxIndex(begin, end);
+}
+
+
 /* Return the value at position */
 qint64 HistogramView::valueAtPosition(QPoint pos) {
     double value = m_graphTop / (double)height();
@@ -2,6 +2,35 @@
 
 #include "graphview.h"
 
+#include <QVector>
+
+/**
+ * Multi-resolution summary of a data provider's values.
+ *
+ * Level k holds, for every run of 2^(k+1) items, the index of the item with
+ * the highest value, so the highest item of any range is found in O(log n).
+ * When built for selected items only, unselected ones are left out.
+ */
+class MaxIndexPyramid {
+public:
+    MaxIndexPyramid();
+
+    void build(const GraphDataProvider* data, bool selectedOnly);
+    void clear();
+
+    /* Index of the highest item in [begin, end), -1 if there is none */
+    qint64 maxIndex(qint64 begin, qint64 end) const;
+
+private:
+    qint64 higher(qint64 a, qint64 b) const;
+
+private:
+    const GraphDataProvider* m_data;
+    bool m_selectedOnly;
+    QVector<QVector<qint64> > m_levels;
+};
+
+
 /**
  * Histogram graph view.
  *
@@ -30,9 +59,16 @@ protected:
     qint64 itemAtPosition(QPoint pos);
     qint64 valueAtPosition(QPoint pos);
 
+    qint64 selectedMaxIndex(qint64 begin, qint64 end);
+
 protected:
     QLinearGradient m_gradientSelected;
     QLinearGradient m_gradientUnselected;
 
     GraphDataProvider* m_data;
+
+    /* Built once per data provider, and once per selection respectively */
+    MaxIndexPyramid m_pyramid;
+    MaxIndexPyramid m_selectedPyramid;
+    SelectionState m_selectedPyramidState;
 };
@@ -30,6 +30,7 @@
 #include <QDesktopServices>
 #include <QDir>
 #include <QFileDialog>
+#include <QLabel>
 #include <QLineEdit>
 #include <QMessageBox>
 #include <QProgressBar>
@@ -46,6 +47,8 @@ MainWindow::MainWindow()
       m_initalCallNum(-1),
       m_selectedEvent(0),
       m_stateEvent(0),
+      m_partialState(0),
+      m_trimEvent(0),
       m_nonDefaultsLookupEvent(0)
 {
     m_ui.setupUi(this);
@@ -211,6 +214,7 @@ void MainWindow::callItemSelected(const QModelIndex &index)
         m_ui.backtraceDock->hide();
         m_ui.vertexDataDock->hide();
     }
+    updatePinnedFrames();
     if (m_selectedEvent && m_selectedEvent->hasState()) {
         fillStateForFrame();
     } else {
@@ -337,7 +341,9 @@ void MainWindow::replayFinished(const QString &message)
     updateActionsState(true);
     m_progressBar->hide();
     statusBar()->showMessage(message, 2000);
+    discardPartialState();
     m_stateEvent = 0;
+    updatePinnedFrames();
     m_ui.actionShowErrorsDock->setEnabled(m_trace->hasErrors());
     m_ui.errorsDock->setVisible(m_trace->hasErrors());
     if (!m_trace->hasErrors()) {
@@ -348,8 +354,10 @@ void MainWindow::replayFinished(const QString &message)
 void MainWindow::replayError(const QString &message)
 {
     updateActionsState(true);
+    discardPartialState();
     m_stateEvent = 0;
     m_nonDefaultsLookupEvent = 0;
+    updatePinnedFrames();
 
     m_progressBar->hide();
     statusBar()->showMessage(
@@ -492,6 +500,7 @@ void MainWindow::lookupState()
         return;
     }
     m_stateEvent = m_selectedEvent;
+    updatePinnedFrames();
     replayTrace(true, false);
 }
 
@@ -509,6 +518,7 @@ void MainWindow::trim()
         return;
     }
     m_trimEvent = m_selectedEvent;
+    updatePinnedFrames();
     trimEvent();
 }
 
@@ -965,6 +975,7 @@ void MainWindow::showSettings()
 {
     SettingsDialog dialog;
     dialog.setFilterModel(m_proxyModel);
+    dialog.setApiTrace(m_trace);
 
     dialog.exec();
 }
@@ -1107,6 +1118,9 @@ void MainWindow::initObjects()
     statusBar()->addPermanentWidget(m_progressBar);
     m_progressBar->hide();
 
+    m_frameCacheLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_frameCacheLabel);
+
     m_argsEditor = new ArgumentsEditor(this);
 
     m_ui.detailsDock->hide();
@@ -1160,6 +1174,8 @@ void MainWindow::initConnections()
             this, SLOT(slotFoundFrameEnd(ApiTraceFrame*)));
     connect(m_trace, SIGNAL(foundCallIndex(ApiTraceCall*)),
             this, SLOT(slotJumpToResult(ApiTraceCall*)));
+    connect(m_trace, SIGNAL(frameCacheChanged(quint64,quint64)),
+            this, SLOT(slotFrameCacheChanged(quint64,quint64)));
 
     connect(m_retracer, SIGNAL(finished(const QString&)),
             this, SLOT(replayFinished(const QString&)));
@@ -1167,6 +1183,8 @@ void MainWindow::initConnections()
             this, SLOT(replayError(const QString&)));
     connect(m_retracer, SIGNAL(foundState(ApiTraceState*)),
             this, SLOT(replayStateFound(ApiTraceState*)));
+    connect(m_retracer, SIGNAL(foundPartialState(ApiTraceState*)),
+            this, SLOT(replayPartialStateFound(ApiTraceState*)));
     connect(m_retracer, SIGNAL(foundProfile(trace::Profile*)),
             this, SLOT(replayProfileFound(trace::Profile*)));
     connect(m_retracer, SIGNAL(foundThumbnails(const ImageHash&)),
@@ -1253,6 +1271,8 @@ void MainWindow::initConnections()
     connect(m_searchWidget,
             SIGNAL(searchPrev(const QString&, Qt::CaseSensitivity, bool)),
             SLOT(slotSearchPrev(const QString&, Qt::CaseSensitivity, bool)));
+    connect(m_searchWidget, SIGNAL(cancelled()),
+            m_trace, SLOT(cancelSearch()));
 
     connect(m_traceProcess, SIGNAL(tracedFile(const QString&)),
             SLOT(createdTrace(const QString&)));
@@ -1352,9 +1372,40 @@ void MainWindow::replayProfileFound(trace::Profile *profile)
     m_profileDialog->setFocus();
 }
 
+void MainWindow::replayPartialStateFound(ApiTraceState *state)
+{
+    /* Only worth showing while the user is looking at the event being
+     * replayed; the complete state follows in replayStateFound. */
+    if (!m_stateEvent ||
+        m_nonDefaultsLookupEvent ||
+        m_selectedEvent != m_stateEvent) {
+        delete state;
+        return;
+    }
+
+    m_stateEvent->setState(state);
+    delete m_partialState;
+    m_partialState = state;
+    fillStateForFrame();
+}
+
+void MainWindow::discardPartialState()
+{
+    if (!m_partialState) {
+        return;
+    }
+    if (m_stateEvent && m_stateEvent->state() == m_partialState) {
+        m_stateEvent->setState(0);
+    }
+    delete m_partialState;
+    m_partialState = 0;
+}
+
 void MainWindow::replayStateFound(ApiTraceState *state)
 {
     m_stateEvent->setState(state);
+    delete m_partialState;
+    m_partialState = 0;
     m_model->stateSetOnEvent(m_stateEvent);
     if (m_selectedEvent == m_stateEvent ||
         m_nonDefaultsLookupEvent == m_selectedEvent) {
@@ -1363,6 +1414,7 @@ void MainWindow::replayStateFound(ApiTraceState *state)
         m_ui.stateDock->hide();
     }
     m_nonDefaultsLookupEvent = 0;
+    updatePinnedFrames();
 }
 
 void MainWindow::replayThumbnailsFound(const ImageHash &thumbnails)
@@ -1478,6 +1530,7 @@ void MainWindow::fillState(bool nonDefaults)
             m_selectedEvent = firstCall;
             lookupState();
             m_selectedEvent = oldSelected;
+            updatePinnedFrames();
         }
     }
     fillStateForFrame();
@@ -1513,6 +1566,7 @@ void MainWindow::editCall()
     if (m_selectedEvent && m_selectedEvent->type() == ApiTraceEvent::Call) {
         ApiTraceCall *call = static_cast<ApiTraceCall*>(m_selectedEvent);
         m_argsEditor->setCall(call);
+        updatePinnedFrames();
         m_argsEditor->show();
     }
 }
@@ -1765,6 +1819,8 @@ void MainWindow::slotSearchResult(const ApiTrace::SearchRequest &request,
     case ApiTrace::SearchResult_Wrapped:
         m_searchWidget->setFound(false);
         break;
+    case ApiTrace::SearchResult_Cancelled:
+        break;
     }
 }
 
@@ -1880,6 +1936,33 @@ void MainWindow::slotJumpToResult(ApiTraceCall *call)
     }
 }
 
+void MainWindow::slotFrameCacheChanged(quint64 usage, quint64 size)
+{
+    if (size) {
+        m_frameCacheLabel->setText(
+            tr("Frames: %1 / %2 MiB").arg(usage >> 20).arg(size >> 20));
+    } else {
+        m_frameCacheLabel->setText(
+            tr("Frames: %1 MiB").arg(usage >> 20));
+    }
+}
+
+/* Keep the frames of the calls referenced here loaded */
+void MainWindow::updatePinnedFrames()
+{
+    QSet<ApiTraceFrame*> frames;
+    for (ApiTraceEvent *event : {m_selectedEvent, m_stateEvent,
+                                 m_trimEvent, m_nonDefaultsLookupEvent}) {
+        if (event && event->type() == ApiTraceEvent::Call) {
+            frames.insert(static_cast<ApiTraceCall*>(event)->parentFrame());
+        }
+    }
+    if (m_argsEditor->call()) {
+        frames.insert(m_argsEditor->call()->parentFrame());
+    }
+    m_trace->setPinnedFrames(frames);
+}
+
 void MainWindow::thumbnailCallback(void *object, int thumbnailIdx)
 {
     //qDebug() << QLatin1String("debug: transfer from trace to retracer thumbnail index: ") << thumbnailIdx;
@@ -19,6 +19,7 @@ class ApiTraceModel;
 class ApiTraceState;
 class ArgumentsEditor;
 class JumpWidget;
+class QLabel;
 class QModelIndex;
 class QProgressBar;
 class QTreeWidgetItem;
@@ -65,6 +66,7 @@ private slots:
     void replayStop();
     void replayFinished(const QString &message);
     void replayStateFound(ApiTraceState *state);
+    void replayPartialStateFound(ApiTraceState *state);
     void replayProfileFound(trace::Profile *state);
     void replayThumbnailsFound(const ImageHash &thumbnails);
     void replayError(const QString &msg);
@@ -109,6 +111,7 @@ private slots:
     void slotFoundFrameStart(ApiTraceFrame *frame);
     void slotFoundFrameEnd(ApiTraceFrame *frame);
     void slotJumpToResult(ApiTraceCall *call);
+    void slotFrameCacheChanged(quint64 usage, quint64 size);
     void updateSurfacesView();
 
 private:
@@ -117,6 +120,8 @@ private:
     void initObjects();
     void initConnections();
     void updateActionsState(bool traceLoaded, bool stopped = true);
+    void updatePinnedFrames();
+    void discardPartialState();
     void newTraceFile(const QString &fileName);
     void replayTrace(bool dumpState, bool dumpThumbnails);
     void trimEvent();
@@ -159,10 +164,12 @@ private:
     int m_initalCallNum;
 
     QProgressBar *m_progressBar;
+    QLabel *m_frameCacheLabel;
 
     ApiTraceEvent *m_selectedEvent;
 
     ApiTraceEvent *m_stateEvent;
+    ApiTraceState *m_partialState;
 
     ApiTraceEvent *m_trimEvent;
 
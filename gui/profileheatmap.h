@@ -4,15 +4,107 @@
 #include "profiling.h"
 
 #include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
 
 /**
  * Data providers for a heatmap based off the trace::Profile call data
  */
 
+/**
+ * Multi-resolution summary of the calls on one heatmap row: the calls sorted
+ * by start time along with the running sum of their durations, so the time
+ * spent in calls over any interval takes two binary searches, whatever the
+ * zoom level, instead of a walk over every call in it.
+ */
+class ProfileTimeline {
+public:
+    void add(unsigned index, qint64 start, qint64 duration)
+    {
+        m_items.push_back(Item{index, start, start + duration, 0, 0});
+    }
+
+    void finish()
+    {
+        std::stable_sort(m_items.begin(), m_items.end(),
+                         [](const Item& a, const Item& b) { return a.start < b.start; });
+
+        qint64 busy = 0;
+        qint64 reach = std::numeric_limits<qint64>::min();
+
+        for (Item& item : m_items) {
+            item.busy = busy;
+            busy += item.end - item.start;
+            reach = std::max(reach, item.end);
+            item.reach = reach;
+        }
+    }
+
+    unsigned size() const
+    {
+        return m_items.size();
+    }
+
+    unsigned call(unsigned i) const
+    {
+        return m_items[i].call;
+    }
+
+    qint64 start(unsigned i) const
+    {
+        return m_items[i].start;
+    }
+
+    qint64 end(unsigned i) const
+    {
+        return m_items[i].end;
+    }
+
+    /* First item still running at or after time */
+    unsigned firstEndingAfter(qint64 time) const
+    {
+        return std::upper_bound(m_items.begin(), m_items.end(), time,
+                                [](qint64 t, const Item& item) { return t < item.reach; }) - m_items.begin();
+    }
+
+    /* Time spent in calls before time */
+    qint64 busyTime(qint64 time) const
+    {
+        unsigned i = std::upper_bound(m_items.begin(), m_items.end(), time,
+                                      [](qint64 t, const Item& item) { return t < item.start; }) - m_items.begin();
+
+        if (i == 0) {
+            return 0;
+        }
+
+        const Item& item = m_items[i - 1];
+        return item.busy + std::min(time, item.end) - item.start;
+    }
+
+private:
+    struct Item {
+        unsigned call;
+        qint64 start;
+        qint64 end;
+
+        /* Running sum of the durations of the items before this one */
+        qint64 busy;
+
+        /* Running maximum of the end times up to this item */
+        qint64 reach;
+    };
+
+    std::vector<Item> m_items;
+};
+
+
 class ProfileHeatmapRowIterator : public HeatmapRowIterator {
 public:
-    ProfileHeatmapRowIterator(const trace::Profile* profile, qint64 start, qint64 end, int steps, bool gpu, int program = -1) :
+    ProfileHeatmapRowIterator(const trace::Profile* profile, const ProfileTimeline* timeline, qint64 start, qint64 end, int steps, bool gpu, int program = -1) :
         m_profile(profile),
+        m_timeline(timeline),
+        m_selectedTimeline(NULL),
         m_step(-1),
         m_stepWidth(1),
         m_stepCount(steps),
@@ -21,118 +113,72 @@ public:
         m_timeEnd(end),
         m_useGpu(gpu),
         m_program(program),
-        m_selected(false),
         m_timeSelection(false),
         m_programSelection(false)
     {
         m_timeWidth = m_timeEnd - m_timeStart;
     }
 
+    /* Returns one item per step with calls in it, or one per call spanning
+     * several steps, so the cost depends on the steps not on the calls */
     virtual bool next() override
     {
-        unsigned maxIndex = m_program == -1 ? m_profile->calls.size() : m_profile->programs[m_program].calls.size();
-
-        if (m_index >= maxIndex) {
-            return false;
-        }
-
         double dtds = m_timeWidth / (double)m_stepCount;
 
-        qint64 heatDuration = 0;
-        qint64 programHeatDuration = 0;
         m_heat = 0.0f;
+        m_programHeat = 0.0f;
         m_step += m_stepWidth;
         m_stepWidth = 1;
+        m_label = QString();
 
-        m_selected = false;
-
-        /* Iterator through calls until step != lastStep */
-        for (; m_index < maxIndex; ++m_index)
-        {
-            const trace::Profile::Call* call;
-
-            if (m_program == -1) {
-                call = &m_profile->calls[m_index];
-            } else {
-                call = &m_profile->calls[ m_profile->programs[m_program].calls[m_index] ];
-            }
-
-            qint64 start, duration, end;
-
-            if (m_useGpu) {
-                start = call->gpuStart;
-                duration = call->gpuDuration;
-
-                if (call->pixels < 0) {
-                    continue;
-                }
-            } else {
-                start = call->cpuStart;
-                duration = call->cpuDuration;
-            }
+        if (m_step >= m_stepCount) {
+            return false;
+        }
 
-            end = start + duration;
+        /* Skip the steps where nothing happens */
+        unsigned index = std::max(m_index, m_timeline->firstEndingAfter(stepToTime(m_step)));
 
-            if (end < m_timeStart) {
-                continue;
-            }
+        if (index >= m_timeline->size() || m_timeline->start(index) > m_timeEnd) {
+            return false;
+        }
 
-            if (start > m_timeEnd) {
-                m_index = m_profile->calls.size();
-                break;
-            }
+        int leftStep = timeToStep(m_timeline->start(index));
+        int rightStep = timeToStep(m_timeline->end(index));
 
-            double left  = timeToStep(start);
-            double right = timeToStep(end);
+        m_step = std::max(m_step, leftStep);
 
-            int leftStep = left;
-            int rightStep = right;
+        if (m_step >= m_stepCount) {
+            return false;
+        }
 
-            if (leftStep > m_step) {
-                break;
-            }
+        const trace::Profile::Call& call = m_profile->calls[m_timeline->call(index)];
 
-            if (m_programSelection && call->program == m_programSel) {
-                m_selected = true;
-            }
+        if (rightStep - leftStep > 1) {
+            /* A single call spanning several steps */
+            m_label = QString::fromStdString(call.name);
+            m_step = leftStep;
+            m_stepWidth = rightStep - leftStep;
+            m_index = index + 1;
+            m_heat = 1.0f;
 
-            if (rightStep - leftStep > 1) {
-                m_label = QString::fromStdString(call->name);
-                m_step = left;
-                m_stepWidth = rightStep - leftStep;
-                heatDuration = dtds;
-                ++m_index;
-                break;
+            if (m_programSelection && (m_program == m_programSel || (int)call.program == m_programSel)) {
+                m_programHeat = 1.0;
             }
+        } else {
+            qint64 left = stepToTime(m_step);
+            qint64 right = stepToTime(m_step + 1);
 
-            if (leftStep < m_step) {
-                qint64 rightTime = stepToTime(rightStep);
-                heatDuration += end - rightTime;
-
-                if (m_programSelection && call->program == m_programSel) {
-                    programHeatDuration += end - rightTime;
-                }
-            } else if (leftStep == rightStep) {
-                heatDuration += duration;
-
-                if (m_programSelection && call->program == m_programSel) {
-                    programHeatDuration += duration;
-                }
-            } else if (rightStep - leftStep == 1) {
-                qint64 rightTime = stepToTime(rightStep);
-                heatDuration += rightTime - start;
+            m_heat = (m_timeline->busyTime(right) - m_timeline->busyTime(left)) / dtds;
 
-                if (m_programSelection && call->program == m_programSel) {
-                    programHeatDuration += rightTime - start;
+            if (m_programSelection) {
+                if (m_program == m_programSel) {
+                    m_programHeat = 1.0;
+                } else if (m_selectedTimeline) {
+                    m_programHeat = (m_selectedTimeline->busyTime(right) - m_selectedTimeline->busyTime(left)) / dtds;
                 }
-
-                break;
             }
         }
 
-        m_heat = heatDuration / dtds;
-        m_programHeat = programHeatDuration / dtds;
-
         if (m_timeSelection) {
             qint64 time = stepToTime(m_step);
 
@@ -141,14 +187,6 @@ public:
             }
         }
 
-        if (m_programSelection && (m_program == m_programSel || (m_selected && m_stepWidth > 1))) {
-            m_programHeat = 1.0;
-        }
-
-        if (m_programHeat > 0) {
-            m_selected = true;
-        }
-
         return true;
     }
 
@@ -182,10 +220,12 @@ public:
         return m_label;
     }
 
-    void setProgramSelection(int program)
+    /* The timeline of the selected program's calls on this row's clock */
+    void setProgramSelection(int program, const ProfileTimeline* timeline)
     {
         m_programSelection = true;
         m_programSel = program;
+        m_selectedTimeline = timeline;
     }
 
     void setTimeSelection(qint64 start, qint64 end)
@@ -216,6 +256,8 @@ private:
 
 private:
     const trace::Profile* m_profile;
+    const ProfileTimeline* m_timeline;
+    const ProfileTimeline* m_selectedTimeline;
 
     int m_step;
     int m_stepWidth;
@@ -234,8 +276,6 @@ private:
 
     QString m_label;
 
-    bool m_selected;
-
     bool m_timeSelection;
     qint64 m_timeSelStart;
     qint64 m_timeSelEnd;
@@ -297,13 +337,14 @@ public:
 
     virtual HeatmapRowIterator* dataRowIterator(int row, qint64 start, qint64 end, int steps) const override
     {
-        ProfileHeatmapRowIterator* itr = new ProfileHeatmapRowIterator(m_profile, start, end, steps, true, m_rowPrograms[row]);
+        int program = m_rowPrograms[row];
+        ProfileHeatmapRowIterator* itr = new ProfileHeatmapRowIterator(m_profile, timeline(program, true), start, end, steps, true, program);
 
         if (m_selectionState) {
             if (m_selectionState->type == SelectionState::Horizontal) {
                 itr->setTimeSelection(m_selectionState->start, m_selectionState->end);
             } else if (m_selectionState->type == SelectionState::Vertical) {
-                itr->setProgramSelection(m_selectionState->start);
+                itr->setProgramSelection(m_selectionState->start, NULL);
             }
         }
 
@@ -333,13 +374,21 @@ public:
 
     virtual HeatmapRowIterator* headerRowIterator(int row, qint64 start, qint64 end, int steps) const override
     {
-        ProfileHeatmapRowIterator* itr = new ProfileHeatmapRowIterator(m_profile, start, end, steps, row != 0);
+        bool gpu = row != 0;
+        ProfileHeatmapRowIterator* itr = new ProfileHeatmapRowIterator(m_profile, timeline(-1, gpu), start, end, steps, gpu);
 
         if (m_selectionState) {
             if (m_selectionState->type == SelectionState::Horizontal) {
                 itr->setTimeSelection(m_selectionState->start, m_selectionState->end);
             } else if (m_selectionState->type == SelectionState::Vertical) {
-                itr->setProgramSelection(m_selectionState->start);
+                int program = m_selectionState->start;
+                const ProfileTimeline* selected = NULL;
+
+                if (program >= 0 && program < (int)m_profile->programs.size()) {
+                    selected = timeline(program, gpu);
+                }
+
+                itr->setProgramSelection(program, selected);
             }
         }
 
@@ -436,6 +485,47 @@ public:
     }
 
 private:
+    /* Timeline of all calls (program -1) or of one program, built on first use */
+    const ProfileTimeline* timeline(int program, bool gpu) const
+    {
+        if (m_timelines.empty()) {
+            m_timelines.resize(2 * (m_profile->programs.size() + 1));
+        }
+
+        std::unique_ptr<ProfileTimeline>& timeline = m_timelines[2 * (program + 1) + gpu];
+
+        if (!timeline) {
+            timeline.reset(new ProfileTimeline);
+
+            if (program == -1) {
+                for (unsigned i = 0; i < m_profile->calls.size(); ++i) {
+                    addCall(*timeline, i, gpu);
+                }
+            } else {
+                for (unsigned i : m_profile->programs[program].calls) {
+                    addCall(*timeline, i, gpu);
+                }
+            }
+
+            timeline->finish();
+        }
+
+        return timeline.get();
+    }
+
+    void addCall(ProfileTimeline& timeline, unsigned index, bool gpu) const
+    {
+        const trace::Profile::Call& call = m_profile->calls[index];
+
+        if (gpu) {
+            if (call.pixels >= 0) {
+                timeline.add(index, call.gpuStart, call.gpuDuration);
+            }
+        } else {
+            timeline.add(index, call.cpuStart, call.cpuDuration);
+        }
+    }
+
     void sortRows()
     {
         typedef QPair<quint64, unsigned> Pair;
@@ -466,4 +556,6 @@ protected:
     trace::Profile* m_profile;
     std::vector<int> m_rowPrograms;
     SelectionState* m_selectionState;
+
+    mutable std::vector<std::unique_ptr<ProfileTimeline> > m_timelines;
 };
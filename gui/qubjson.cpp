@@ -296,3 +296,44 @@ QVariant decodeUBJSONObject(QIODevice *io)
     return readVariant(stream, marker);
 }
 
+
+
+UBJSONObjectReader::UBJSONObjectReader(QIODevice *io)
+    : m_stream(io),
+      m_begun(false),
+      m_ended(false)
+{
+    m_stream.setByteOrder(QDataStream::BigEndian);
+}
+
+
+bool UBJSONObjectReader::readMember(QString &name, QVariant &value)
+{
+    if (m_ended) {
+        return false;
+    }
+
+    Marker marker;
+    if (!m_begun) {
+        m_begun = true;
+        marker = readMarker(m_stream);
+        if (marker != MARKER_OBJECT_BEGIN) {
+            Q_ASSERT(marker == MARKER_EOF);
+            m_ended = true;
+            return false;
+        }
+    }
+
+    marker = readMarker(m_stream);
+    if (marker == MARKER_OBJECT_END ||
+        marker == MARKER_EOF) {
+        m_ended = true;
+        return false;
+    }
+
+    int nameSize = readSize(m_stream, marker);
+    name = readString(m_stream, nameSize);
+    marker = readMarker(m_stream);
+    value = readVariant(m_stream, marker);
+    return true;
+}
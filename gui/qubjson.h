@@ -28,7 +28,30 @@
 
 
 #include <QVariantMap>
+#include <QDataStream>
 
 class QIODevice;
 
 QVariant decodeUBJSONObject(QIODevice *io);
+
+
+/**
+ * Pulls the members of a top-level UBJSON object one at a time, so that
+ * consumers can act on each member as soon as it has been received instead
+ * of waiting for the whole object.
+ */
+class UBJSONObjectReader
+{
+public:
+    UBJSONObjectReader(QIODevice *io);
+
+    /**
+     * Reads the next member, returning false once the object ends.
+     */
+    bool readMember(QString &name, QVariant &value);
+
+private:
+    QDataStream m_stream;
+    bool m_begun;
+    bool m_ended;
+};
@@ -141,6 +141,32 @@ TEST(qubjson, object) {
 }
 
 
+TEST(qubjson, object_reader) {
+    static const unsigned char X[] = {
+        '{', 'U', 1, 'A', 'i', 1, 'U', 1, 'B', '[', '$', 'U', '#', 'U', 2, 'C', 'D', '}'
+    };
+    QByteArray bytearray((const char *)X, sizeof X);
+    QBuffer buffer(&bytearray);
+    buffer.open(QIODevice::ReadOnly);
+
+    UBJSONObjectReader reader(&buffer);
+    QString name;
+    QVariant value;
+
+    ASSERT_TRUE(reader.readMember(name, value));
+    EXPECT_EQ(name, QString("A"));
+    EXPECT_EQ(value, QVariant(1));
+
+    ASSERT_TRUE(reader.readMember(name, value));
+    EXPECT_EQ(name, QString("B"));
+    EXPECT_EQ(value, QVariant(QByteArray("CD")));
+
+    EXPECT_FALSE(reader.readMember(name, value));
+    EXPECT_FALSE(reader.readMember(name, value));
+    EXPECT_TRUE(buffer.atEnd());
+}
+
+
 TEST(qubjson, binary_data) {
     CHECK(BYTEARRAY('[', '$', 'U', '#', 'U', 0), QByteArray());
     CHECK(BYTEARRAY('[', '$', 'U', '#', 'U', 1, 'A'), QByteArray("A"));
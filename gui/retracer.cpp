@@ -395,6 +395,11 @@ void Retracer::run()
         arguments << QString::number(m_captureCall);
         arguments << QLatin1String("--dump-format");
         arguments << QLatin1String("ubjson");
+        if (m_remoteTarget.isEmpty()) {
+            // No point in compressing images sent through a local pipe
+            arguments << QLatin1String("--dump-image-format");
+            arguments << QLatin1String("raw");
+        }
     } else if (m_captureThumbnails) {
         if (!m_thumbnailsToCapture.isEmpty()) {
             arguments << QLatin1String("-S");
@@ -487,7 +492,7 @@ void Retracer::run()
      */
 
     ImageHash thumbnails;
-    QVariantMap parsedJson;
+    ApiTraceState parsedState;
     trace::Profile* profile = NULL;
 
     process.setReadChannel(QProcess::StandardOutput);
@@ -495,7 +500,20 @@ void Retracer::run()
         BlockingIODevice io(&process);
 
         if (m_captureState) {
-            parsedJson = decodeUBJSONObject(&io).toMap();
+            /*
+             * Decode the state dump one top-level section at a time, handing
+             * out what has been received so far, so that the parameters can
+             * be browsed while large textures and framebuffers are still
+             * streaming in.
+             */
+            UBJSONObjectReader reader(&io);
+            QString name;
+            QVariant value;
+            while (reader.readMember(name, value)) {
+                parsedState.addSection(name, value);
+                value = QVariant();
+                emit foundPartialState(new ApiTraceState(parsedState));
+            }
             process.waitForFinished(-1);
         } else if (m_captureThumbnails) {
             /*
@@ -617,7 +635,7 @@ void Retracer::run()
      */
 
     if (m_captureState) {
-        ApiTraceState *state = new ApiTraceState(parsedJson);
+        ApiTraceState *state = new ApiTraceState(parsedState);
         emit foundState(state);
     }
 
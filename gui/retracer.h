@@ -79,6 +79,7 @@ public:
 signals:
     void finished(const QString &output);
     void foundState(ApiTraceState *state);
+    void foundPartialState(ApiTraceState *state);
     void foundProfile(trace::Profile *profile);
     void foundThumbnails(const QList<QImage> &thumbnails);
     void foundThumbnails(const ImageHash &thumbnails);
@@ -46,6 +46,7 @@ void SearchWidget::slotSearchPrev()
 void SearchWidget::slotCancel()
 {
     hide();
+    emit cancelled();
 }
 
 void SearchWidget::showEvent(QShowEvent *event)
@@ -70,7 +71,7 @@ bool SearchWidget::eventFilter(QObject *object, QEvent* event)
 {
     if (event->type() == QEvent::KeyPress) {
         if ((static_cast<QKeyEvent*>(event))->key() == Qt::Key_Escape) {
-            hide();
+            slotCancel();
         }
     }
     return QWidget::eventFilter(object, event);
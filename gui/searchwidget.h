@@ -17,6 +17,7 @@ public:
 signals:
     void searchNext(const QString &str, Qt::CaseSensitivity cs = Qt::CaseInsensitive, bool useRegex=false);
     void searchPrev(const QString &str, Qt::CaseSensitivity cs = Qt::CaseInsensitive, bool useRegex=false);
+    void cancelled();
 
 private slots:
     void slotSearchNext();
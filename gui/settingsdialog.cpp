@@ -1,10 +1,14 @@
 #include "settingsdialog.h"
 
+#include "apitrace.h"
+
 #include <QMessageBox>
+#include <QSettings>
 
 SettingsDialog::SettingsDialog(QWidget *parent)
     : QDialog(parent),
-      m_filter(0)
+      m_filter(0),
+      m_trace(0)
 {
     setupUi(this);
 
@@ -121,6 +125,11 @@ void SettingsDialog::accept()
         }
     }
     filtersToModel(m_filter);
+    if (m_trace) {
+        quint64 cacheSize = frameCacheSB->value();
+        QSettings().setValue("frameCacheSize", cacheSize);
+        m_trace->setFrameCacheSize(cacheSize << 20);
+    }
     QDialog::accept();
 }
 
@@ -144,3 +153,9 @@ void SettingsDialog::setFilterModel(ApiTraceFilter *filter)
     m_filter = filter;
     filtersFromModel(m_filter);
 }
+
+void SettingsDialog::setApiTrace(ApiTrace *trace)
+{
+    m_trace = trace;
+    frameCacheSB->setValue(m_trace->frameCacheSize() >> 20);
+}
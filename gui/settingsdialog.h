@@ -6,6 +6,7 @@
 #include <QDialog>
 #include <QRegularExpression>
 
+class ApiTrace;
 
 class SettingsDialog : public QDialog, public Ui_Settings
 {
@@ -15,6 +16,7 @@ public:
     void accept() override;
 
     void setFilterModel(ApiTraceFilter *filter);
+    void setApiTrace(ApiTrace *trace);
 private slots:
     void changeRegexp(const QString &name);
     void regexpChanged(const QString &pattern);
@@ -25,4 +27,5 @@ private:
 private:
     QMap<QString, QRegularExpression> m_showFilters;
     ApiTraceFilter *m_filter;
+    ApiTrace *m_trace;
 };
@@ -3,11 +3,15 @@
 #include "apitrace.h"
 #include <QDebug>
 #include <QFile>
+#include <QMutexLocker>
+#include <QRegularExpression>
+
+#include <atomic>
 
 #define FRAMES_TO_CACHE 100
 
 static ApiTraceCall *
-apiCallFromTraceCall(const trace::Call *call,
+apiCallFromTraceCall(trace::Call *call,
                      const QHash<QString, QUrl> &helpHash,
                      ApiTraceFrame *frame,
                      ApiTraceCall *parentCall,
@@ -26,13 +30,162 @@ apiCallFromTraceCall(const trace::Call *call,
 }
 
 TraceLoader::TraceLoader(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_parser(new trace::Parser)
 {
 }
 
+/*
+ * A search runs as one task per range of frames, each with its own parser,
+ * numbered in search order: the result is the hit of the lowest numbered
+ * task that has one, which is known as soon as all the tasks before it
+ * are done.  Tasks give up as soon as an earlier one has a hit.
+ */
+struct TraceLoader::SearchState
+{
+    enum {
+        Pending = -2,
+        NoHit = -1
+    };
+
+    SearchState(const ApiTrace::SearchRequest &req, int numTasks)
+        : request(req),
+          cancelled(false),
+          firstHit(numTasks),
+          hits(numTasks, Pending),
+          foundCall(NoHit),
+          finished(false)
+    {}
+
+    /* Returns true when this settles the result of the search */
+    bool taskDone(int index, int hit)
+    {
+        if (hit >= 0) {
+            int first = firstHit;
+            while (index < first &&
+                   !firstHit.compare_exchange_weak(first, index)) {
+            }
+        }
+
+        QMutexLocker locker(&mutex);
+        hits[index] = hit;
+        if (finished) {
+            return false;
+        }
+        for (int i = 0; i < hits.count(); ++i) {
+            if (hits[i] == Pending) {
+                return false;
+            }
+            if (hits[i] >= 0) {
+                foundCall = hits[i];
+                break;
+            }
+        }
+        finished = true;
+        return true;
+    }
+
+    const ApiTrace::SearchRequest request;
+    std::atomic<bool> cancelled;
+    std::atomic<int> firstHit;
+
+    QMutex mutex;
+    QVector<int> hits;
+    int foundCall;
+    bool finished;
+};
+
+class TraceLoader::SearchTask : public QRunnable
+{
+public:
+    SearchTask(TraceLoader *loader,
+               const QSharedPointer<SearchState> &search,
+               int index,
+               trace::Parser *parser,
+               const trace::ParseBookmark &start,
+               int numCalls)
+        : m_loader(loader),
+          m_search(search),
+          m_index(index),
+          m_parser(parser),
+          m_start(start),
+          m_numCalls(numCalls)
+    {}
+
+    ~SearchTask()
+    {
+        delete m_parser;
+    }
+
+    void run() override
+    {
+        int hit = SearchState::NoHit;
+        if (m_parser) {
+            hit = scan();
+        }
+
+        if (m_search->taskDone(m_index, hit)) {
+            TraceLoader *loader = m_loader;
+            QSharedPointer<SearchState> search = m_search;
+            QMetaObject::invokeMethod(loader, [loader, search]() {
+                loader->finishSearch(search);
+            }, Qt::QueuedConnection);
+        }
+    }
+
+private:
+    int scan()
+    {
+        const ApiTrace::SearchRequest &request = m_search->request;
+        bool searchingNext =
+            request.direction == ApiTrace::SearchRequest::Next;
+        QRegularExpression regex;
+        if (request.useRegex) {
+            regex = QRegularExpression(
+                request.text,
+                request.cs == Qt::CaseInsensitive ?
+                    QRegularExpression::CaseInsensitiveOption :
+                    QRegularExpression::NoPatternOption);
+        }
+
+        int hit = SearchState::NoHit;
+        trace::Call *call;
+        m_parser->setBookmark(m_start);
+        for (int i = 0; i < m_numCalls && (call = m_parser->parse_call()); ++i) {
+            if (m_search->cancelled || m_search->firstHit < m_index) {
+                delete call;
+                return SearchState::NoHit;
+            }
+
+            QString text = traceCallToSearchText(call);
+            bool found = request.useRegex ?
+                text.contains(regex) :
+                text.contains(request.text, request.cs);
+            if (found) {
+                hit = call->no;
+            }
+            delete call;
+
+            /* Searching backwards we want the last hit of the range */
+            if (found && searchingNext) {
+                break;
+            }
+        }
+        return hit;
+    }
+
+    TraceLoader *m_loader;
+    QSharedPointer<SearchState> m_search;
+    int m_index;
+    trace::Parser *m_parser;
+    trace::ParseBookmark m_start;
+    int m_numCalls;
+};
+
 TraceLoader::~TraceLoader()
 {
-    m_parser.close();
+    cancelSearch();
+    m_searchPool.waitForDone();
     qDeleteAll(m_signatures);
 }
 
@@ -42,25 +195,31 @@ void TraceLoader::loadTrace(const QString &filename)
         loadHelpFile();
     }
 
+    cancelSearch();
+
     if (!m_frameBookmarks.isEmpty()) {
         qDeleteAll(m_signatures);
         m_signatures.clear();
         m_frameBookmarks.clear();
         m_createdFrames.clear();
-        m_parser.close();
+
+        /* The calls of the previous trace may outlive it, and keep its
+         * parser alive for the signatures they refer to. */
+        m_parser.reset(new trace::Parser);
     }
 
-    if (!m_parser.open(filename.toLatin1())) {
+    if (!m_parser->open(filename.toLatin1())) {
         qDebug() << "error: failed to open " << filename;
         return;
     }
+    m_fileName = filename;
 
-    if (!m_parser.supportsOffsets()) {
+    if (!m_parser->supportsOffsets()) {
         emit parseProblem(
             "This trace in compressed in a format that does not allow random seeking.\n"
             "Please repack the trace with `apitrace repack`."
         );
-        m_parser.close();
+        m_parser->close();
         return;
     }
 
@@ -68,7 +227,7 @@ void TraceLoader::loadTrace(const QString &filename)
 
     scanTrace();
 
-    emit guessedApi(static_cast<int>(m_parser.api));
+    emit guessedApi(static_cast<int>(m_parser->api));
     emit finishedParsing();
 }
 
@@ -122,9 +281,9 @@ void TraceLoader::scanTrace()
     int numOfCalls = 0;
     int lastPercentReport = 0;
 
-    m_parser.getBookmark(startBookmark);
+    m_parser->getBookmark(startBookmark);
 
-    while ((call = m_parser.scan_call())) {
+    while ((call = m_parser->scan_call())) {
         ++numOfCalls;
 
         if (call->flags & trace::CALL_FLAG_END_FRAME) {
@@ -141,11 +300,11 @@ void TraceLoader::scanTrace()
             m_frameBookmarks[numOfFrames] = frameBookmark;
             ++numOfFrames;
 
-            if (m_parser.percentRead() - lastPercentReport >= 5) {
-                emit parsed(m_parser.percentRead());
-                lastPercentReport = m_parser.percentRead();
+            if (m_parser->percentRead() - lastPercentReport >= 5) {
+                emit parsed(m_parser->percentRead());
+                lastPercentReport = m_parser->percentRead();
             }
-            m_parser.getBookmark(startBookmark);
+            m_parser->getBookmark(startBookmark);
             numOfCalls = 0;
         }
         delete call;
@@ -182,104 +341,14 @@ ApiTraceCallSignature * TraceLoader::signature(unsigned id)
     }
 }
 
-void TraceLoader::addSignature(unsigned id, ApiTraceCallSignature *signature)
+QSharedPointer<const trace::Parser> TraceLoader::parser() const
 {
-    m_signatures[id] = signature;
-}
-
-void TraceLoader::searchNext(const ApiTrace::SearchRequest &request)
-{
-    Q_ASSERT(m_parser.supportsOffsets());
-    int startFrame = m_createdFrames.indexOf(request.frame);
-    const FrameBookmark &frameBookmark = m_frameBookmarks[startFrame];
-    m_parser.setBookmark(frameBookmark.start);
-    trace::Call *call = 0;
-    while ((call = m_parser.parse_call())) {
-
-        if (callContains(call, request.text, request.cs, request.useRegex)) {
-            unsigned frameIdx = callInFrame(call->no);
-            ApiTraceFrame *frame = m_createdFrames[frameIdx];
-            const QVector<ApiTraceCall*> calls =
-                    fetchFrameContents(frame);
-            for (int i = 0; i < calls.count(); ++i) {
-                if (calls[i]->index() == call->no) {
-                    emit searchResult(request, ApiTrace::SearchResult_Found,
-                                      calls[i]);
-                    break;
-                }
-            }
-            delete call;
-            return;
-        }
-
-        delete call;
-    }
-    emit searchResult(request, ApiTrace::SearchResult_NotFound, 0);
-}
-
-void TraceLoader::searchPrev(const ApiTrace::SearchRequest &request)
-{
-    Q_ASSERT(m_parser.supportsOffsets());
-    int startFrame = m_createdFrames.indexOf(request.frame);
-    trace::Call *call = 0;
-    QList<trace::Call*> frameCalls;
-    int frameIdx = startFrame;
-
-    const FrameBookmark &frameBookmark = m_frameBookmarks[frameIdx];
-    int numCallsToParse = frameBookmark.numberOfCalls;
-    m_parser.setBookmark(frameBookmark.start);
-
-    while ((call = m_parser.parse_call())) {
-
-        frameCalls.append(call);
-        --numCallsToParse;
-
-        if (numCallsToParse == 0) {
-            bool foundCall = searchCallsBackwards(frameCalls,
-                                                  frameIdx,
-                                                  request);
-
-            qDeleteAll(frameCalls);
-            frameCalls.clear();
-            if (foundCall) {
-                return;
-            }
-
-            --frameIdx;
-
-            if (frameIdx >= 0) {
-                const FrameBookmark &frameBookmark =
-                        m_frameBookmarks[frameIdx];
-                m_parser.setBookmark(frameBookmark.start);
-                numCallsToParse = frameBookmark.numberOfCalls;
-            }
-        }
-    }
-    emit searchResult(request, ApiTrace::SearchResult_NotFound, 0);
+    return m_parser;
 }
 
-bool TraceLoader::searchCallsBackwards(const QList<trace::Call*> &calls,
-                                       int frameIdx,
-                                       const ApiTrace::SearchRequest &request)
+void TraceLoader::addSignature(unsigned id, ApiTraceCallSignature *signature)
 {
-    for (int i = calls.count() - 1; i >= 0; --i) {
-        trace::Call *call = calls[i];
-        if (callContains(call, request.text, request.cs, request.useRegex)) {
-            ApiTraceFrame *frame = m_createdFrames[frameIdx];
-            const QVector<ApiTraceCall*> apiCalls =
-                    fetchFrameContents(frame);
-            for (int i = 0; i < apiCalls.count(); ++i) {
-                if (apiCalls[i]->index() == call->no) {
-                    emit searchResult(request,
-                                      ApiTrace::SearchResult_Found,
-                                      apiCalls[i]);
-                    break;
-                }
-            }
-            return true;
-        }
-    }
-    return false;
+    m_signatures[id] = signature;
 }
 
 int TraceLoader::callInFrame(int callIdx) const
@@ -299,21 +368,6 @@ int TraceLoader::callInFrame(int callIdx) const
     return 0;
 }
 
-bool TraceLoader::callContains(trace::Call *call,
-                               const QString &str,
-                               Qt::CaseSensitivity sensitivity,
-                               bool useRegex)
-{
-    /*
-     * FIXME: do string comparison directly on trace::Call
-     */
-    ApiTraceCall *apiCall = apiCallFromTraceCall(call, m_helpHash,
-                                                 0, 0, this);
-    bool result = apiCall->contains(str, sensitivity, useRegex);
-    delete apiCall;
-    return result;
-}
-
 QVector<ApiTraceCall*>
 TraceLoader::fetchFrameContents(ApiTraceFrame *currentFrame)
 {
@@ -329,10 +383,10 @@ TraceLoader::fetchFrameContents(ApiTraceFrame *currentFrame)
     if (numOfCalls) {
         const FrameBookmark &frameBookmark = m_frameBookmarks[frameIdx];
 
-        m_parser.setBookmark(frameBookmark.start);
+        m_parser->setBookmark(frameBookmark.start);
 
         FrameContents frameCalls(numOfCalls);
-        frameCalls.load(this, currentFrame, m_helpHash, m_parser);
+        frameCalls.load(this, currentFrame, m_helpHash, *m_parser);
         if (frameCalls.topLevelCount() == frameCalls.allCallsCount()) {
             emit frameContentsLoaded(currentFrame,
                                      frameCalls.allCalls(),
@@ -378,20 +432,104 @@ void TraceLoader::findCallIndex(int index)
             break;
         }
     }
-    if (call) {
-        emit foundCallIndex(call);
-    }
+    emit foundCallIndex(call);
 }
 
 void TraceLoader::search(const ApiTrace::SearchRequest &request)
 {
+    Q_ASSERT(m_parser->supportsOffsets());
+
+    /* Only the latest search matters */
+    cancelSearch();
+
+    int startFrame = m_createdFrames.indexOf(request.frame);
+    int firstFrame, numFrames;
     if (request.direction == ApiTrace::SearchRequest::Next) {
-        searchNext(request);
+        firstFrame = startFrame;
+        numFrames = numberOfFrames() - startFrame;
     } else {
-        searchPrev(request);
+        firstFrame = 0;
+        numFrames = startFrame + 1;
+    }
+    if (startFrame < 0 || numFrames <= 0) {
+        emit searchResult(request, ApiTrace::SearchResult_NotFound, 0);
+        return;
+    }
+
+    int numTasks = qBound(1, numFrames, m_searchPool.maxThreadCount());
+    QSharedPointer<SearchState> search(new SearchState(request, numTasks));
+    {
+        QMutexLocker locker(&m_searchMutex);
+        m_search = search;
+    }
+
+    for (int i = 0; i < numTasks; ++i) {
+        int beginFrame = firstFrame + numFrames * i / numTasks;
+        int endFrame = firstFrame + numFrames * (i + 1) / numTasks;
+        int numCalls = 0;
+        for (int frameIdx = beginFrame; frameIdx < endFrame; ++frameIdx) {
+            numCalls += numberOfCallsInFrame(frameIdx);
+        }
+
+        /*
+         * Signatures are only defined the first time they are used, so
+         * the task parsers need to know all that m_parser has seen to
+         * start in the middle of the trace.
+         */
+        trace::Parser *parser = new trace::Parser;
+        if (parser->open(m_fileName.toLatin1())) {
+            parser->copySignatures(*m_parser);
+        } else {
+            delete parser;
+            parser = 0;
+        }
+
+        int index = request.direction == ApiTrace::SearchRequest::Next ?
+                    i : numTasks - 1 - i;
+        m_searchPool.start(new SearchTask(this, search, index, parser,
+                                          m_frameBookmarks[beginFrame].start,
+                                          numCalls));
     }
 }
 
+void TraceLoader::cancelSearch()
+{
+    QMutexLocker locker(&m_searchMutex);
+    if (m_search) {
+        m_search->cancelled = true;
+    }
+}
+
+void TraceLoader::finishSearch(QSharedPointer<SearchState> search)
+{
+    {
+        QMutexLocker locker(&m_searchMutex);
+        if (m_search == search) {
+            m_search.clear();
+        }
+    }
+
+    const ApiTrace::SearchRequest &request = search->request;
+    if (search->cancelled) {
+        emit searchResult(request, ApiTrace::SearchResult_Cancelled, 0);
+        return;
+    }
+
+    if (search->foundCall >= 0) {
+        int frameIdx = callInFrame(search->foundCall);
+        const QVector<ApiTraceCall*> calls =
+                fetchFrameContents(m_createdFrames[frameIdx]);
+        for (int i = 0; i < calls.count(); ++i) {
+            if (calls[i]->index() == search->foundCall) {
+                emit searchResult(request, ApiTrace::SearchResult_Found,
+                                  calls[i]);
+                return;
+            }
+        }
+    }
+    emit searchResult(request, ApiTrace::SearchResult_NotFound, 0);
+}
+
 TraceLoader::FrameContents::FrameContents(int numOfCalls)
     : m_allCalls(numOfCalls),
       m_binaryDataSize(0),
@@ -480,14 +618,11 @@ TraceLoader::FrameContents::load(TraceLoader   *loader,
             }
         }
         if (apiCall->hasBinaryData()) {
-            QByteArray data =
-                apiCall->arguments()[apiCall->binaryDataIndex()].
-                                                  toByteArray();
-            m_binaryDataSize += data.size();
+            const trace::Blob *blob =
+                call->args[apiCall->binaryDataIndex()].value->toBlob();
+            m_binaryDataSize += blob->size;
         }
 
-        delete call;
-
         if (apiCall->flags() & trace::CALL_FLAG_END_FRAME) {
             bEndFrameReached = true;
             break;
@@ -4,11 +4,15 @@
 #include "apitrace.h"
 #include "trace_file.hpp"
 #include "trace_parser.hpp"
+#include "trace_symbolizer.hpp"
 
 #include <QObject>
 #include <QList>
 #include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QStack>
+#include <QThreadPool>
 
 class TraceLoader : public QObject
 {
@@ -21,8 +25,19 @@ public:
     ApiTraceCallSignature *signature(unsigned id);
     void addSignature(unsigned id, ApiTraceCallSignature *signature);
 
+    /* Owner of the signatures and stack frames of the loaded calls */
+    QSharedPointer<const trace::Parser> parser() const;
+
     trace::EnumSig *enumSignature(unsigned id);
 
+    /* Thread safe */
+    std::vector<trace::RawStackFrame> symbolize(const trace::Backtrace &backtrace) {
+        return m_symbolizer.symbolize(backtrace);
+    }
+
+    /* Thread safe, meant to be called directly from the GUI thread */
+    void cancelSearch();
+
 private:
     class FrameContents
     {
@@ -94,21 +109,16 @@ private:
     void guessApi(const trace::Call *call);
     void scanTrace();
 
-    void searchNext(const ApiTrace::SearchRequest &request);
-    void searchPrev(const ApiTrace::SearchRequest &request);
+    struct SearchState;
+    class SearchTask;
+    void finishSearch(QSharedPointer<SearchState> search);
 
     int callInFrame(int callIdx) const;
-    bool callContains(trace::Call *call,
-                      const QString &str,
-                      Qt::CaseSensitivity sensitivity,
-                      bool useRegex);
      QVector<ApiTraceCall*> fetchFrameContents(ApiTraceFrame *frame);
-     bool searchCallsBackwards(const QList<trace::Call*> &calls,
-                               int frameIdx,
-                               const ApiTrace::SearchRequest &request);
 
 private:
-    trace::Parser m_parser;
+    QSharedPointer<trace::Parser> m_parser;
+    QString m_fileName;
 
     typedef QMap<int, FrameBookmark> FrameBookmarks;
     FrameBookmarks m_frameBookmarks;
@@ -117,4 +127,10 @@ private:
     QHash<QString, QUrl> m_helpHash;
 
     QVector<ApiTraceCallSignature*> m_signatures;
+
+    trace::Symbolizer m_symbolizer;
+
+    QThreadPool m_searchPool;
+    QMutex m_searchMutex;
+    QSharedPointer<SearchState> m_search;
 };
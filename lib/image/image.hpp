@@ -30,6 +30,7 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 #include <iostream>
@@ -46,6 +47,54 @@ enum ChannelType {
 };
 
 
+/**
+ * 128-bit digest, as produced by Hasher.
+ */
+struct Digest {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    inline bool
+    operator == (const Digest &other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+
+    inline bool
+    operator != (const Digest &other) const {
+        return !(*this == other);
+    }
+
+    // 32 hexadecimal digits
+    std::string
+    str(void) const;
+};
+
+
+/**
+ * Fast non-cryptographic 128-bit hash, for detecting identical images.
+ */
+class Hasher {
+public:
+    Hasher();
+
+    void
+    update(const void *data, size_t size);
+
+    Digest
+    digest(void) const;
+
+private:
+    alignas(16) uint64_t acc[8];
+    unsigned char buffer[64];
+    size_t bufferSize = 0;
+    unsigned stripes = 0;
+    uint64_t length = 0;
+
+    void
+    consume(const unsigned char *stripe);
+};
+
+
 class Image {
 public:
     unsigned width;
@@ -120,14 +169,20 @@ public:
     writeBMP(const char *filename) const;
 
     void
-    writePNM(std::ostream &os, const char *comment = NULL) const;
+    writePNM(std::ostream &os, const char *comment = NULL, bool strip_alpha = true) const;
 
     bool
-    writePNM(const char *filename, const char *comment = NULL) const;
+    writePNM(const char *filename, const char *comment = NULL, bool strip_alpha = true) const;
 
     void
     writeMD5(std::ostream &os) const;
 
+    Digest
+    hash(void) const;
+
+    void
+    writeHash(std::ostream &os) const;
+
     bool
     writePNG(std::ostream &os, bool strip_alpha = false) const;
 
@@ -165,6 +220,55 @@ Image *
 readPNM(const char *buffer, size_t bufferSize);
 
 
+/*
+ * Image comparison.
+ */
+
+struct CompareOptions
+{
+    // Fraction of the full range above which a pixel is deemed different
+    double fuzz = 0.05;
+
+    // Take the alpha channel in consideration
+    bool alpha = false;
+
+    // Number of threads to split the image rows among (0 for automatic)
+    unsigned threads = 0;
+};
+
+struct Difference
+{
+    bool sizeMismatch = false;
+
+    // Largest absolute difference of any channel, in [0, 255]
+    unsigned maxDiff = 0;
+
+    // Mean absolute difference across all compared channels
+    double meanDiff = 0.0;
+
+    // Peak signal-to-noise ratio, in dB (infinite for identical images)
+    double psnr = 0.0;
+
+    // Bits of precision, as computed by scripts/snapdiff.py
+    double precision = 0.0;
+
+    // Number of pixels whose (luminance weighted) error exceeds the fuzz
+    unsigned long long ae = 0;
+};
+
+/**
+ * Compare src against ref.
+ *
+ * When heatmap is not NULL it receives a newly allocated RGB image,
+ * similar to ImageMagick's compare utility, where pixels that differ
+ * beyond the fuzz threshold are highlighted in red.
+ */
+Difference
+compare(const Image &ref, const Image &src,
+        const CompareOptions &options = CompareOptions(),
+        Image **heatmap = NULL);
+
+
 } /* namespace image */
 
 
@@ -0,0 +1,377 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "image.hpp"
+
+
+#if \
+    (defined(__i386__) && defined(__SSE2__)) /* gcc */ || \
+    defined(_M_IX86) /* msvc */ || \
+    defined(__x86_64__) /* gcc */ || \
+    defined(_M_AMD64) /* msvc */
+
+#  define HAVE_SSE2
+#  include <emmintrin.h>
+
+#endif
+
+
+namespace image {
+
+
+/*
+ * Minimum number of rows worth handing over to a separate thread.
+ */
+#define TILE_ROWS 64
+
+
+/**
+ * Partial sums over a horizontal band of the images.
+ */
+struct Tile
+{
+    unsigned y0;
+    unsigned y1;
+
+    unsigned maxDiff = 0;
+    unsigned long long sum = 0;
+    unsigned long long sumSquares = 0;
+    unsigned long long ae = 0;
+};
+
+
+/**
+ * Compute the absolute difference of two spans of bytes into dst, and
+ * accumulate its sum, sum of squares, and maximum.
+ *
+ * mask is applied to every 32-bit word of the difference, which allows
+ * ignoring the alpha channel of RGBA8 pixels.
+ */
+static void
+diffSpan(const uint8_t *ref,
+         const uint8_t *src,
+         uint8_t *dst,
+         size_t size,
+         uint32_t mask,
+         Tile &tile)
+{
+    size_t i = 0;
+
+    unsigned maxDiff = 0;
+    unsigned long long sum = 0;
+    unsigned long long sumSquares = 0;
+
+#ifdef HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vmask = _mm_set1_epi32(mask);
+    __m128i vmax = zero;
+    __m128i vsum = zero;
+    __m128i vsq = zero;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(ref + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        d = _mm_and_si128(d, vmask);
+        _mm_storeu_si128((__m128i *)(dst + i), d);
+
+        vmax = _mm_max_epu8(vmax, d);
+        vsum = _mm_add_epi64(vsum, _mm_sad_epu8(d, zero));
+
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+        __m128i sq = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+        vsq = _mm_add_epi64(vsq, _mm_unpacklo_epi32(sq, zero));
+        vsq = _mm_add_epi64(vsq, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    alignas(16) uint8_t maxBytes[16];
+    alignas(16) uint64_t sums[2];
+    alignas(16) uint64_t squares[2];
+    _mm_store_si128((__m128i *)maxBytes, vmax);
+    _mm_store_si128((__m128i *)sums, vsum);
+    _mm_store_si128((__m128i *)squares, vsq);
+    for (unsigned j = 0; j < 16; ++j) {
+        maxDiff = std::max<unsigned>(maxDiff, maxBytes[j]);
+    }
+    sum = sums[0] + sums[1];
+    sumSquares = squares[0] + squares[1];
+#endif /* HAVE_SSE2 */
+
+    const uint8_t *maskBytes = (const uint8_t *)&mask;
+    for (; i < size; ++i) {
+        unsigned d = ref[i] > src[i] ? ref[i] - src[i] : src[i] - ref[i];
+        d &= maskBytes[i % 4];
+        dst[i] = d;
+        maxDiff = std::max(maxDiff, d);
+        sum += d;
+        sumSquares += d*d;
+    }
+
+    tile.maxDiff = std::max(tile.maxDiff, maxDiff);
+    tile.sum += sum;
+    tile.sumSquares += sumSquares;
+}
+
+
+static inline uint8_t
+blend(unsigned a, unsigned b, unsigned alpha)
+{
+    return (a*(255 - alpha) + b*alpha + 127) / 255;
+}
+
+
+static void
+compareTile(const Image &ref, const Image &src,
+            const CompareOptions &options,
+            Image *heatmap,
+            Tile &tile)
+{
+    const unsigned channels = src.channels;
+    const size_t rowSize = src.width * channels;
+
+    uint32_t mask = 0xffffffff;
+    if (channels == 4 && !options.alpha) {
+        // Little-endian byte order of RGBA8 pixels within each word
+        uint8_t bytes[4] = {0xff, 0xff, 0xff, 0x00};
+        memcpy(&mask, bytes, sizeof mask);
+    }
+
+    const unsigned threshold = unsigned(255 * options.fuzz);
+    const double scale = options.fuzz > 0.0 ? 1.0 / options.fuzz : HUGE_VAL;
+
+    std::vector<uint8_t> diffRow(rowSize);
+
+    for (unsigned y = tile.y0; y < tile.y1; ++y) {
+        const uint8_t *refRow = ref.start() + (ptrdiff_t)y * ref.stride();
+        const uint8_t *srcRow = src.start() + (ptrdiff_t)y * src.stride();
+
+        diffSpan(refRow, srcRow, diffRow.data(), rowSize, mask, tile);
+
+        uint8_t *heatRow = heatmap ? heatmap->start() + (ptrdiff_t)y * heatmap->stride() : NULL;
+
+        const uint8_t *d = diffRow.data();
+        const uint8_t *s = srcRow;
+        for (unsigned x = 0; x < src.width; ++x, d += channels, s += channels) {
+            unsigned luma;
+            unsigned dmax;
+            if (channels >= 3) {
+                // Same fixed point weights as PIL's RGB to L conversion
+                luma = (d[0]*19595 + d[1]*38470 + d[2]*7471 + 0x8000) >> 16;
+                dmax = std::max(std::max(d[0], d[1]), d[2]);
+                if (channels == 4) {
+                    dmax = std::max<unsigned>(dmax, d[3]);
+                }
+            } else {
+                luma = d[0];
+                dmax = channels == 2 ? std::max(d[0], d[1]) : d[0];
+            }
+
+            if (luma > threshold) {
+                ++tile.ae;
+            }
+
+            if (heatRow) {
+                // Fade the source pixel towards white, or red where the
+                // error exceeds the fuzz
+                unsigned weight = unsigned(std::min(dmax * scale, 255.0));
+                uint8_t r = blend(0xff, 0xf1, weight);
+                uint8_t g = blend(0xff, 0x00, weight);
+                uint8_t b = blend(0xff, 0x1e, weight);
+                unsigned sr = s[0];
+                unsigned sg = channels >= 3 ? s[1] : s[0];
+                unsigned sb = channels >= 3 ? s[2] : s[0];
+                *heatRow++ = blend(sr, r, 0xcc);
+                *heatRow++ = blend(sg, g, 0xcc);
+                *heatRow++ = blend(sb, b, 0xcc);
+            }
+        }
+    }
+}
+
+
+static inline uint8_t
+toUNORM8(float f)
+{
+    if (!(f > 0.0f)) {
+        return 0;
+    }
+    if (f >= 1.0f) {
+        return 255;
+    }
+    return uint8_t(f * 255.0f + 0.5f);
+}
+
+
+/**
+ * Convert an arbitrary image into RGBA8, replicating luminance into the
+ * color channels as PIL's RGB conversion does.
+ */
+static Image *
+convertToRGBA8(const Image &image)
+{
+    Image *rgba = new Image(image.width, image.height, 4);
+
+    for (unsigned y = 0; y < image.height; ++y) {
+        const unsigned char *srcRow = image.start() + (ptrdiff_t)y * image.stride();
+        unsigned char *dst = rgba->start() + (ptrdiff_t)y * rgba->stride();
+        for (unsigned x = 0; x < image.width; ++x) {
+            uint8_t c[4] = {0, 0, 0, 0xff};
+            for (unsigned i = 0; i < image.channels && i < 4; ++i) {
+                if (image.channelType == TYPE_FLOAT) {
+                    float f;
+                    memcpy(&f, srcRow + (x*image.channels + i)*sizeof f, sizeof f);
+                    c[i] = toUNORM8(f);
+                } else {
+                    c[i] = srcRow[x*image.channels + i];
+                }
+            }
+            if (image.channels <= 2) {
+                c[3] = image.channels == 2 ? c[1] : 0xff;
+                c[1] = c[2] = c[0];
+            }
+            memcpy(dst + x*4, c, 4);
+        }
+    }
+
+    return rgba;
+}
+
+
+Difference
+compare(const Image &_ref, const Image &_src,
+        const CompareOptions &options,
+        Image **heatmap)
+{
+    Difference result;
+
+    if (heatmap) {
+        *heatmap = NULL;
+    }
+
+    if (_ref.width != _src.width ||
+        _ref.height != _src.height) {
+        result.sizeMismatch = true;
+        result.maxDiff = 255;
+        result.meanDiff = 255.0;
+        result.ae = std::numeric_limits<unsigned long long>::max();
+        return result;
+    }
+
+    /*
+     * The kernels below operate on spans of bytes, so both images must
+     * share the same pixel layout.
+     */
+    const Image *ref = &_ref;
+    const Image *src = &_src;
+    std::unique_ptr<Image> refConverted;
+    std::unique_ptr<Image> srcConverted;
+    if (ref->channelType != TYPE_UNORM8 ||
+        src->channelType != TYPE_UNORM8 ||
+        ref->channels != src->channels ||
+        src->channels == 2) {
+        refConverted.reset(convertToRGBA8(*ref));
+        srcConverted.reset(convertToRGBA8(*src));
+        ref = refConverted.get();
+        src = srcConverted.get();
+    }
+
+    const unsigned width = src->width;
+    const unsigned height = src->height;
+
+    Image *diffImage = NULL;
+    if (heatmap) {
+        diffImage = new Image(width, height, 3);
+        *heatmap = diffImage;
+    }
+
+    unsigned numThreads = options.threads;
+    if (numThreads == 0) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    unsigned numTiles = std::max(std::min(numThreads, height / TILE_ROWS), 1U);
+
+    std::vector<Tile> tiles(numTiles);
+    for (unsigned i = 0; i < numTiles; ++i) {
+        tiles[i].y0 = (unsigned long long)height * i / numTiles;
+        tiles[i].y1 = (unsigned long long)height * (i + 1) / numTiles;
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < numTiles; ++i) {
+        workers.emplace_back(compareTile,
+                             std::cref(*ref), std::cref(*src),
+                             std::cref(options), diffImage,
+                             std::ref(tiles[i]));
+    }
+    compareTile(*ref, *src, options, diffImage, tiles[0]);
+    for (auto & worker : workers) {
+        worker.join();
+    }
+
+    unsigned long long sum = 0;
+    unsigned long long sumSquares = 0;
+    for (auto & tile : tiles) {
+        result.maxDiff = std::max(result.maxDiff, tile.maxDiff);
+        sum += tile.sum;
+        sumSquares += tile.sumSquares;
+        result.ae += tile.ae;
+    }
+
+    unsigned channels = src->channels;
+    if (channels == 4 && !options.alpha) {
+        channels = 3;
+    }
+    double samples = double(width) * double(height) * channels;
+    if (samples > 0.0) {
+        result.meanDiff = sum / samples;
+
+        double mse = sumSquares / samples;
+        result.psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : HUGE_VAL;
+
+        // See also http://effbot.org/zone/pil-comparing-images.htm
+        double relError = (sumSquares * 2.0 + 1.0) / (samples * 255.0 * 255.0 * 2.0);
+        result.precision = -log(relError) / log(2.0);
+    } else {
+        result.psnr = HUGE_VAL;
+    }
+
+    return result;
+}
+
+
+} /* namespace image */
@@ -0,0 +1,308 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Fast non-cryptographic 128-bit hashing of image pixels.
+ *
+ * The inner loop follows the same structure as XXH3's (32x32->64bit
+ * multiply-accumulate over 64 byte stripes, with periodic scrambling of the
+ * accumulators), so that it maps well onto SSE2 while the scalar fallback
+ * yields identical digests.  Digests are not meant to be compatible with
+ * any other hash function.
+ */
+
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <ostream>
+
+#include "image.hpp"
+
+
+#if \
+    (defined(__i386__) && defined(__SSE2__)) /* gcc */ || \
+    defined(_M_IX86) /* msvc */ || \
+    defined(__x86_64__) /* gcc */ || \
+    defined(_M_AMD64) /* msvc */
+
+#  define HAVE_SSE2
+#  include <emmintrin.h>
+
+#endif
+
+
+namespace image {
+
+
+#define STRIPE_SIZE 64
+#define STRIPES_PER_BLOCK 16
+
+static const uint32_t PRIME32_1 = 0x9E3779B1U;
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+
+alignas(16) static const uint64_t accumulateKeys[8] = {
+    0xc0e16b163a85a4dcULL, 0x890acd8dd443c47cULL, 0xb3889d8a6dc47761ULL, 0x6a0398e528f0ae6aULL,
+    0x048344ece48a855eULL, 0xf175cfea21871330ULL, 0x391ceef02702c2fdULL, 0x4baf8cac4784cb12ULL,
+};
+
+alignas(16) static const uint64_t scrambleKeys[8] = {
+    0x3547744583a3f88eULL, 0xd9cf2b15c6b6c90eULL, 0x961facc76d5fe21cULL, 0x0094ab49d50f11f9ULL,
+    0xe3211e37bdbeb6dcULL, 0x62fe6c274ff3511aULL, 0x5ac30b329fdf0574ULL, 0x1450582c6b65b406ULL,
+};
+
+static const uint64_t loKeys[8] = {
+    0x7a30fcc7888eb791ULL, 0x5540f5ba6a15576eULL, 0x16cef0559096d3e9ULL, 0x2cf8f14b06874899ULL,
+    0xc9c9263b6e2ce103ULL, 0xd6ff920b0a9faa6dULL, 0x53192697db998dc1ULL, 0x73ea9b9bc7cd18d7ULL,
+};
+
+static const uint64_t hiKeys[8] = {
+    0x102713f872c33fceULL, 0xf4183a0e5d2a033eULL, 0x71b63e307eebb517ULL, 0xda61f5713d036000ULL,
+    0x46eb7409ae691b21ULL, 0xb23ad691d6707698ULL, 0x67c8fe11d22fc4b9ULL, 0x7eb4661419481338ULL,
+};
+
+
+static inline uint64_t
+read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+#ifdef HAVE_BIGENDIAN
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+
+static inline void
+accumulateStripe(uint64_t *acc, const unsigned char *p)
+{
+#ifdef HAVE_SSE2
+    __m128i *vacc = (__m128i *)acc;
+    const __m128i *vkeys = (const __m128i *)accumulateKeys;
+    for (unsigned i = 0; i < STRIPE_SIZE / 16; ++i) {
+        __m128i data = _mm_loadu_si128((const __m128i *)(p + 16*i));
+        __m128i dataKey = _mm_xor_si128(data, _mm_load_si128(vkeys + i));
+        __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+        __m128i dataSwap = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i sum = _mm_add_epi64(_mm_load_si128(vacc + i), dataSwap);
+        _mm_store_si128(vacc + i, _mm_add_epi64(sum, product));
+    }
+#else
+    for (unsigned i = 0; i < 8; ++i) {
+        uint64_t data = read64(p + 8*i);
+        uint64_t dataKey = data ^ accumulateKeys[i];
+        acc[i ^ 1] += data;
+        acc[i] += (dataKey & 0xffffffff) * (dataKey >> 32);
+    }
+#endif
+}
+
+
+static inline void
+scrambleAccumulators(uint64_t *acc)
+{
+#ifdef HAVE_SSE2
+    __m128i *vacc = (__m128i *)acc;
+    const __m128i *vkeys = (const __m128i *)scrambleKeys;
+    const __m128i prime = _mm_set1_epi32(PRIME32_1);
+    for (unsigned i = 0; i < 4; ++i) {
+        __m128i a = _mm_load_si128(vacc + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_load_si128(vkeys + i));
+        __m128i aHi = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i productLo = _mm_mul_epu32(a, prime);
+        __m128i productHi = _mm_mul_epu32(aHi, prime);
+        _mm_store_si128(vacc + i, _mm_add_epi64(productLo, _mm_slli_epi64(productHi, 32)));
+    }
+#else
+    for (unsigned i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= scrambleKeys[i];
+        acc[i] = a * PRIME32_1;
+    }
+#endif
+}
+
+
+/*
+ * Multiply two 64-bit values into 128 bits, and fold the halves together.
+ */
+static inline uint64_t
+mul128Fold64(uint64_t a, uint64_t b)
+{
+    uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+    uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+    uint64_t loLo = aLo * bLo;
+    uint64_t hiLo = aHi * bLo;
+    uint64_t loHi = aLo * bHi;
+    uint64_t hiHi = aHi * bHi;
+    uint64_t cross = (loLo >> 32) + (hiLo & 0xffffffff) + loHi;
+    uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+    uint64_t lower = (cross << 32) | (loLo & 0xffffffff);
+    return lower ^ upper;
+}
+
+
+static inline uint64_t
+avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+static inline uint64_t
+mergeAccumulators(const uint64_t *acc, const uint64_t *keys, uint64_t start)
+{
+    uint64_t result = start;
+    for (unsigned i = 0; i < 8; i += 2) {
+        result += mul128Fold64(acc[i] ^ keys[i], acc[i + 1] ^ keys[i + 1]);
+    }
+    return avalanche(result);
+}
+
+
+Hasher::Hasher()
+{
+    static const uint64_t init[8] = {
+        PRIME32_1, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_1 ^ PRIME64_2, PRIME64_2 ^ PRIME64_3, PRIME64_3 ^ PRIME64_1, PRIME32_1 ^ PRIME64_1,
+    };
+    memcpy(acc, init, sizeof acc);
+}
+
+
+void
+Hasher::update(const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    length += size;
+
+    if (bufferSize) {
+        size_t n = std::min(size, (size_t)STRIPE_SIZE - bufferSize);
+        memcpy(buffer + bufferSize, p, n);
+        bufferSize += n;
+        p += n;
+        size -= n;
+        if (bufferSize < STRIPE_SIZE) {
+            return;
+        }
+        consume(buffer);
+        bufferSize = 0;
+    }
+
+    while (size >= STRIPE_SIZE) {
+        consume(p);
+        p += STRIPE_SIZE;
+        size -= STRIPE_SIZE;
+    }
+
+    memcpy(buffer, p, size);
+    bufferSize = size;
+}
+
+
+inline void
+Hasher::consume(const unsigned char *stripe)
+{
+    accumulateStripe(acc, stripe);
+    if (++stripes == STRIPES_PER_BLOCK) {
+        scrambleAccumulators(acc);
+        stripes = 0;
+    }
+}
+
+
+Digest
+Hasher::digest(void) const
+{
+    alignas(16) uint64_t tmp[8];
+    memcpy(tmp, acc, sizeof tmp);
+
+    if (bufferSize) {
+        // The length is mixed below, so zero padding is unambiguous
+        unsigned char last[STRIPE_SIZE];
+        memcpy(last, buffer, bufferSize);
+        memset(last + bufferSize, 0, STRIPE_SIZE - bufferSize);
+        accumulateStripe(tmp, last);
+    }
+
+    Digest digest;
+    digest.lo = mergeAccumulators(tmp, loKeys, length * PRIME64_1);
+    digest.hi = mergeAccumulators(tmp, hiKeys, ~(length * PRIME64_2));
+    return digest;
+}
+
+
+std::string
+Digest::str(void) const
+{
+    char buf[33];
+    snprintf(buf, sizeof buf, "%016llX%016llX",
+             (unsigned long long)hi,
+             (unsigned long long)lo);
+    return buf;
+}
+
+
+Digest
+Image::hash(void) const
+{
+    Hasher hasher;
+
+    // Prevent images with the same bytes but different layout from colliding
+    uint32_t header[4] = {width, height, channels, (uint32_t)channelType};
+    hasher.update(header, sizeof header);
+
+    const unsigned char *row;
+    unsigned len = width*bytesPerPixel;
+    for (row = start(); row != end(); row += stride()) {
+        hasher.update(row, len);
+    }
+
+    return hasher.digest();
+}
+
+
+void
+Image::writeHash(std::ostream &os) const
+{
+    os << hash().str() << "\n";
+}
+
+
+} /* namespace image */
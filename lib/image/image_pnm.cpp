@@ -44,7 +44,7 @@ namespace image {
  * http://netpbm.sourceforge.net/doc/pfm.html
  */
 void
-Image::writePNM(std::ostream &os, const char *comment) const
+Image::writePNM(std::ostream &os, const char *comment, bool strip_alpha) const
 {
     const char *identifier;
     unsigned outChannels;
@@ -54,6 +54,10 @@ Image::writePNM(std::ostream &os, const char *comment) const
         if (channels == 1) {
             identifier = "P5";
             outChannels = 1;
+        } else if (channels == 4 && !strip_alpha) {
+            // Non-standard extension for 4 unorm8s
+            identifier = "PA";
+            outChannels = 4;
         } else {
             identifier = "P6";
             outChannels = 3;
@@ -190,13 +194,13 @@ Image::writePNM(std::ostream &os, const char *comment) const
 
 
 bool
-Image::writePNM(const char *filename, const char *comment) const
+Image::writePNM(const char *filename, const char *comment, bool strip_alpha) const
 {
     std::ofstream os(filename, std::ofstream::binary);
     if (!os) {
         return false;
     }
-    writePNM(os, comment);
+    writePNM(os, comment, strip_alpha);
     return true;
 }
 
@@ -234,6 +238,10 @@ readPNMHeader(const char *buffer, size_t bufferSize, PNMInfo &info)
         info.channels = 3;
         info.channelType = TYPE_UNORM8;
         break;
+    case 'A':
+        info.channels = 4;
+        info.channelType = TYPE_UNORM8;
+        break;
     case 'f':
         info.channels = 1;
         info.channelType = TYPE_FLOAT;
@@ -0,0 +1,165 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <math.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "image.hpp"
+
+#include "gtest/gtest.h"
+
+
+static image::Image *
+createImage(unsigned width, unsigned height, unsigned channels, unsigned char value)
+{
+    image::Image *image = new image::Image(width, height, channels);
+    memset(image->pixels, value, image->sizeInBytes());
+    return image;
+}
+
+
+TEST(image_diff, identical)
+{
+    std::unique_ptr<image::Image> ref(createImage(67, 300, 4, 0x80));
+    std::unique_ptr<image::Image> src(createImage(67, 300, 4, 0x80));
+
+    image::Difference diff = image::compare(*ref, *src);
+    EXPECT_FALSE(diff.sizeMismatch);
+    EXPECT_EQ(diff.maxDiff, 0U);
+    EXPECT_EQ(diff.meanDiff, 0.0);
+    EXPECT_EQ(diff.ae, 0ULL);
+    EXPECT_TRUE(isinf(diff.psnr));
+}
+
+
+TEST(image_diff, size_mismatch)
+{
+    std::unique_ptr<image::Image> ref(createImage(16, 16, 3, 0));
+    std::unique_ptr<image::Image> src(createImage(16, 17, 3, 0));
+
+    image::Difference diff = image::compare(*ref, *src);
+    EXPECT_TRUE(diff.sizeMismatch);
+}
+
+
+TEST(image_diff, single_pixel)
+{
+    std::unique_ptr<image::Image> ref(createImage(37, 129, 3, 0x10));
+    std::unique_ptr<image::Image> src(createImage(37, 129, 3, 0x10));
+    src->pixels[(100*37 + 30)*3 + 1] = 0xf0;
+
+    for (unsigned threads = 1; threads <= 3; ++threads) {
+        image::CompareOptions options;
+        options.threads = threads;
+
+        image::Image *heatmap = NULL;
+        image::Difference diff = image::compare(*ref, *src, options, &heatmap);
+        std::unique_ptr<image::Image> heatmapGuard(heatmap);
+
+        EXPECT_EQ(diff.maxDiff, 0xe0U);
+        EXPECT_DOUBLE_EQ(diff.meanDiff, 0xe0 / (37.0*129.0*3.0));
+        EXPECT_EQ(diff.ae, 1ULL);
+
+        ASSERT_TRUE(heatmap != NULL);
+        const unsigned char *red = heatmap->pixels + (100*37 + 30)*3;
+        EXPECT_GT(red[0], red[1]);
+        const unsigned char *white = heatmap->pixels;
+        EXPECT_EQ(white[0], white[1]);
+    }
+}
+
+
+TEST(image_diff, alpha)
+{
+    std::unique_ptr<image::Image> ref(createImage(20, 20, 4, 0xff));
+    std::unique_ptr<image::Image> src(createImage(20, 20, 4, 0xff));
+    src->pixels[3] = 0;
+
+    image::Difference diff = image::compare(*ref, *src);
+    EXPECT_EQ(diff.maxDiff, 0U);
+
+    image::CompareOptions options;
+    options.alpha = true;
+    diff = image::compare(*ref, *src, options);
+    EXPECT_EQ(diff.maxDiff, 0xffU);
+}
+
+
+TEST(image_diff, channels)
+{
+    std::unique_ptr<image::Image> ref(createImage(8, 8, 1, 0x40));
+    std::unique_ptr<image::Image> src(createImage(8, 8, 3, 0x40));
+
+    image::Difference diff = image::compare(*ref, *src);
+    EXPECT_EQ(diff.maxDiff, 0U);
+}
+
+
+TEST(image_hash, incremental)
+{
+    unsigned char data[3000];
+    for (unsigned i = 0; i < sizeof data; ++i) {
+        data[i] = i * 31 + (i >> 8);
+    }
+
+    for (size_t size : {0, 1, 63, 64, 65, 1024, 1025, 3000}) {
+        image::Hasher whole;
+        whole.update(data, size);
+
+        image::Hasher pieces;
+        for (size_t offset = 0; offset < size; offset += 7) {
+            pieces.update(data + offset, std::min<size_t>(7, size - offset));
+        }
+
+        EXPECT_EQ(whole.digest(), pieces.digest()) << "size " << size;
+    }
+}
+
+
+TEST(image_hash, image)
+{
+    std::unique_ptr<image::Image> a(createImage(33, 20, 4, 0x55));
+    std::unique_ptr<image::Image> b(createImage(33, 20, 4, 0x55));
+    EXPECT_EQ(a->hash(), b->hash());
+    EXPECT_EQ(a->hash().str().length(), 32U);
+
+    b->pixels[33*4*10 + 7] ^= 1;
+    EXPECT_NE(a->hash(), b->hash());
+
+    // Same bytes, different layout
+    std::unique_ptr<image::Image> c(createImage(20, 33, 4, 0x55));
+    EXPECT_NE(a->hash(), c->hash());
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -38,12 +38,17 @@
 
 #if HAVE_BACKTRACE
 #  include <stdint.h>
+#  include <string.h>
 #  include <dlfcn.h>
+#  include <link.h>
 #  include <unistd.h>
+#  include <algorithm>
 #  include <map>
+#  include <string>
 #  include <vector>
 #  include <cxxabi.h>
 #  include <backtrace.h>
+#  include "os_string.hpp"
 #endif
 
 
@@ -173,12 +178,123 @@ static void dumpFrame(const RawStackFrame &frame)
 }
 
 
+/*
+ * Map of the loaded modules, used to record frames as module offsets
+ * without symbolizing them (APITRACE_BACKTRACE_DEFERRED).
+ */
+class ModuleMap {
+    struct Module {
+        uintptr_t start;
+        uintptr_t end;
+        uintptr_t base;
+        const char *path;
+        const char *buildId;
+    };
+
+    std::vector<Module> modules;
+
+    // Frames point to these, so they must outlive any refresh
+    std::set<std::string> strings;
+
+    const char *intern(const std::string &s) {
+        return strings.insert(s).first->c_str();
+    }
+
+    static inline size_t align4(size_t size) {
+        return (size + 3) & ~size_t(3);
+    }
+
+    const char *readBuildId(const struct dl_phdr_info *info) {
+        static const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < info->dlpi_phnum; ++i) {
+            const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+            if (phdr.p_type != PT_NOTE) {
+                continue;
+            }
+            const char *p = (const char *)(info->dlpi_addr + phdr.p_vaddr);
+            const char *end = p + phdr.p_memsz;
+            while (p + sizeof(ElfW(Nhdr)) <= end) {
+                const ElfW(Nhdr) *note = (const ElfW(Nhdr) *)p;
+                const char *name = p + sizeof *note;
+                const unsigned char *desc = (const unsigned char *)(name + align4(note->n_namesz));
+                if (note->n_type == NT_GNU_BUILD_ID &&
+                    note->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                    std::string buildId;
+                    for (size_t j = 0; j < note->n_descsz; ++j) {
+                        buildId += digits[desc[j] >> 4];
+                        buildId += digits[desc[j] & 0xf];
+                    }
+                    return intern(buildId);
+                }
+                p = (const char *)desc + align4(note->n_descsz);
+            }
+        }
+        return nullptr;
+    }
+
+    static int callback(struct dl_phdr_info *info, size_t size, void *data)
+    {
+        ModuleMap *this_ = (ModuleMap *)data;
+        Module module;
+        module.start = UINTPTR_MAX;
+        module.end = 0;
+        for (int i = 0; i < info->dlpi_phnum; ++i) {
+            const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+            if (phdr.p_type == PT_LOAD) {
+                uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+                module.start = std::min(module.start, start);
+                module.end = std::max(module.end, start + phdr.p_memsz);
+            }
+        }
+        if (module.start >= module.end) {
+            return 0;
+        }
+        module.base = info->dlpi_addr;
+        if (info->dlpi_name && info->dlpi_name[0]) {
+            module.path = this_->intern(info->dlpi_name);
+        } else {
+            // The main executable
+            module.path = this_->intern(getProcessName().str());
+        }
+        module.buildId = this_->readBuildId(info);
+        this_->modules.push_back(module);
+        return 0;
+    }
+
+public:
+    /*
+     * Fill in the module of the given address, reloading the map once if
+     * it isn't found, as modules may have been loaded meanwhile.
+     */
+    bool lookup(uintptr_t pc, RawStackFrame *frame)
+    {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (auto & module : modules) {
+                if (pc >= module.start && pc < module.end) {
+                    frame->module = module.path;
+                    frame->buildId = module.buildId;
+                    frame->offset = pc - module.base;
+                    return true;
+                }
+            }
+            if (pass == 0) {
+                modules.clear();
+                dl_iterate_phdr(callback, this);
+            }
+        }
+        return false;
+    }
+};
+
+
 #define BT_DEPTH 10
 
 class libbacktraceProvider {
     struct backtrace_state *state;
     int skipFrames;
     Id nextFrameId;
+    bool deferred;
+    ModuleMap modules;
     std::map<uintptr_t, std::vector<RawStackFrame> > cache;
     std::vector<RawStackFrame> *current, *current_frames;
     RawStackFrame *current_frame;
@@ -242,6 +358,15 @@ class libbacktraceProvider {
     {
         libbacktraceProvider *this_ = (libbacktraceProvider*)vdata;
         std::vector<RawStackFrame> &frames = this_->cache[pc];
+        if (!frames.size() && this_->deferred) {
+            // Leave symbolization to whoever reads the trace
+            RawStackFrame frame;
+            if (!this_->modules.lookup(pc, &frame)) {
+                frame.offset = pc;
+            }
+            frame.id = this_->nextFrameId++;
+            frames.push_back(frame);
+        }
         if (!frames.size()) {
             RawStackFrame frame;
             dl_fill(&frame, pc);
@@ -285,13 +410,15 @@ class libbacktraceProvider {
 
 public:
     libbacktraceProvider():
-        state(backtrace_create_state(NULL, 0, bt_err_callback, NULL))
+        state(backtrace_create_state(NULL, 0, bt_err_callback, NULL)),
+        deferred(false)
     {
         backtrace_simple(state, 0, bt_countskip, bt_err_callback, this);
     }
 
-    std::vector<RawStackFrame> getParsedBacktrace()
+    std::vector<RawStackFrame> getParsedBacktrace(bool deferred_)
     {
+        deferred = deferred_;
         std::vector<RawStackFrame> parsedBacktrace;
         current = &parsedBacktrace;
         backtrace_simple(state, skipFrames, bt_callback, bt_err_callback, this);
@@ -304,9 +431,9 @@ public:
     }
 };
 
-std::vector<RawStackFrame> get_backtrace() {
+std::vector<RawStackFrame> get_backtrace(bool deferred) {
     static libbacktraceProvider backtraceProvider;
-    return backtraceProvider.getParsedBacktrace();
+    return backtraceProvider.getParsedBacktrace(deferred);
 }
 
 void dump_backtrace() {
@@ -317,7 +444,7 @@ void dump_backtrace() {
 
 #else /* !HAVE_BACKTRACE */
 
-std::vector<RawStackFrame> get_backtrace() {
+std::vector<RawStackFrame> get_backtrace(bool deferred) {
     return std::vector<RawStackFrame>();
 }
 
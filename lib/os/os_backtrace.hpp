@@ -35,7 +35,11 @@ namespace os {
 using trace::RawStackFrame;
 
 
-std::vector<RawStackFrame> get_backtrace();
+/**
+ * With deferred, frames are only recorded as module offsets, to be
+ * symbolized when the trace is read.  It must be the same on every call.
+ */
+std::vector<RawStackFrame> get_backtrace(bool deferred = false);
 bool backtrace_is_needed(const char* fname);
 
 void dump_backtrace();
@@ -35,6 +35,7 @@
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <dirent.h>
 #include <pwd.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -235,6 +236,54 @@ String::exists(void) const
     return true;
 }
 
+bool
+String::isDirectory(void) const
+{
+    struct stat st;
+    int err;
+
+    err = stat(str(), &st);
+    if (err) {
+        return false;
+    }
+
+    return S_ISDIR(st.st_mode);
+}
+
+bool
+removeFile(const String &fileName)
+{
+    return unlink(fileName) == 0;
+}
+
+bool
+linkFile(const String &srcFileName, const String &dstFileName)
+{
+    unlink(dstFileName);
+    return link(srcFileName, dstFileName) == 0;
+}
+
+bool
+listDirectory(const String &path, std::vector<String> &names)
+{
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 ||
+            strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        names.push_back(entry->d_name);
+    }
+
+    closedir(dir);
+    return true;
+}
+
 int execute(char * const * args)
 {
     pid_t pid = fork();
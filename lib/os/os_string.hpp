@@ -371,6 +371,9 @@ public:
     bool
     exists(void) const;
 
+    bool
+    isDirectory(void) const;
+
     /* Trim directory (leaving base filename).
      */
     void trimDirectory(void) {
@@ -434,6 +437,14 @@ bool copyFile(const String &srcFileName, const String &dstFileName, bool overrid
 
 bool removeFile(const String &fileName);
 
+/* Create a hard link to srcFileName, replacing dstFileName if it exists.
+ */
+bool linkFile(const String &srcFileName, const String &dstFileName);
+
+/* List the names of the entries in a directory, excluding `.` and `..`.
+ */
+bool listDirectory(const String &path, std::vector<String> &names);
+
 String getTemporaryDirectoryPath(void);
 
 } /* namespace os */
@@ -108,6 +108,38 @@ String::exists(void) const
     return attrs != INVALID_FILE_ATTRIBUTES;
 }
 
+bool
+String::isDirectory(void) const
+{
+    DWORD attrs = GetFileAttributesA(str());
+    return attrs != INVALID_FILE_ATTRIBUTES &&
+           (attrs & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+bool
+listDirectory(const String &path, std::vector<String> &names)
+{
+    String pattern(path);
+    pattern.join("*");
+
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA(pattern, &findData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    do {
+        if (strcmp(findData.cFileName, ".") == 0 ||
+            strcmp(findData.cFileName, "..") == 0) {
+            continue;
+        }
+        names.push_back(findData.cFileName);
+    } while (FindNextFileA(hFind, &findData));
+
+    FindClose(hFind);
+    return true;
+}
+
 bool
 copyFile(const String &srcFileName, const String &dstFileName, bool override)
 {
@@ -120,6 +152,13 @@ removeFile(const String &srcFilename)
     return DeleteFileA(srcFilename);
 }
 
+bool
+linkFile(const String &srcFileName, const String &dstFileName)
+{
+    DeleteFileA(dstFileName);
+    return CreateHardLinkA(dstFileName, srcFileName, NULL);
+}
+
 /**
  * Determine whether an argument should be quoted.
  */
@@ -0,0 +1,619 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <algorithm>
+
+#include "trace_diff.hpp"
+
+
+namespace trace {
+
+
+/*
+ * Hashing
+ */
+
+class CallHasher : public Visitor
+{
+private:
+    uint64_t h = 0x243f6a8885a308d3ULL;
+
+    enum {
+        TAG_NULL = 1,
+        TAG_BOOL,
+        TAG_INT,
+        TAG_FLOAT,
+        TAG_STRING,
+        TAG_WSTRING,
+        TAG_STRUCT,
+        TAG_ARRAY,
+        TAG_BLOB,
+        TAG_POINTER,
+        TAG_CALL,
+        TAG_NONE,
+    };
+
+public:
+    inline void
+    mix(uint64_t v) {
+        h = (h ^ v) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 32;
+    }
+
+    void
+    mixBytes(const void *data, size_t size) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        mix(size);
+        while (size >= 8) {
+            uint64_t w;
+            memcpy(&w, p, sizeof w);
+            mix(w);
+            p += 8;
+            size -= 8;
+        }
+        if (size) {
+            uint64_t w = 0;
+            memcpy(&w, p, size);
+            mix(w);
+        }
+    }
+
+    void
+    mixString(const char *s) {
+        mixBytes(s, strlen(s));
+    }
+
+    uint64_t
+    digest(void) const {
+        uint64_t d = h;
+        d ^= d >> 33;
+        d *= 0xff51afd7ed558ccdULL;
+        d ^= d >> 33;
+        return d;
+    }
+
+    void
+    visitValue(Value *value) {
+        if (value) {
+            _visit(value);
+        } else {
+            mix(TAG_NONE);
+        }
+    }
+
+    void visit(Null *) override {
+        mix(TAG_NULL);
+    }
+
+    void visit(Bool *node) override {
+        mix(TAG_BOOL);
+        mix(node->value);
+    }
+
+    void visit(SInt *node) override {
+        mix(TAG_INT);
+        mix(static_cast<uint64_t>(node->value));
+    }
+
+    void visit(UInt *node) override {
+        mix(TAG_INT);
+        mix(node->value);
+    }
+
+    void visit(Float *node) override {
+        hashDouble(node->value);
+    }
+
+    void visit(Double *node) override {
+        hashDouble(node->value);
+    }
+
+    void visit(String *node) override {
+        mix(TAG_STRING);
+        mixString(node->value);
+    }
+
+    void visit(WString *node) override {
+        mix(TAG_WSTRING);
+        mixBytes(node->value, wcslen(node->value) * sizeof(wchar_t));
+    }
+
+    void visit(Enum *node) override {
+        visit(static_cast<SInt *>(node));
+    }
+
+    void visit(Bitmask *node) override {
+        visit(static_cast<UInt *>(node));
+    }
+
+    void visit(Struct *s) override {
+        mix(TAG_STRUCT);
+        mix(s->members.size());
+        for (auto member : s->members) {
+            visitValue(member);
+        }
+    }
+
+    void visit(Array *array) override {
+        mix(TAG_ARRAY);
+        mix(array->values.size());
+        for (auto value : array->values) {
+            visitValue(value);
+        }
+    }
+
+    void visit(Blob *blob) override {
+        // Contents are digested separately, so that blobs of the same size
+        // but different contents don't just differ on the last few words.
+        CallHasher contents;
+        contents.mixBytes(blob->buf, blob->size);
+        mix(TAG_BLOB);
+        mix(blob->size);
+        mix(contents.digest());
+    }
+
+    void visit(Pointer *p) override {
+        mix(TAG_POINTER);
+        mix(p->value);
+    }
+
+    void visit(Repr *r) override {
+        visitValue(r->humanValue);
+    }
+
+    void
+    visitCall(const Call &call) {
+        mix(TAG_CALL);
+        mixString(call.sig->name);
+        mix(call.args.size());
+        for (auto & arg : call.args) {
+            visitValue(arg.value);
+        }
+        visitValue(call.ret);
+    }
+
+private:
+    void
+    hashDouble(double value) {
+        // Make 0.0 and -0.0 hash the same, as they compare equal
+        if (value == 0.0) {
+            value = 0.0;
+        }
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        mix(TAG_FLOAT);
+        mix(bits);
+    }
+};
+
+
+CallHash
+hashCall(const Call &call)
+{
+    CallHasher hasher;
+    hasher.visitCall(call);
+    return hasher.digest();
+}
+
+
+CallHash
+hashCallName(const Call &call)
+{
+    CallHasher hasher;
+    hasher.mixString(call.sig->name);
+    return hasher.digest();
+}
+
+
+/*
+ * Differencing
+ */
+
+struct Match {
+    size_t a;
+    size_t b;
+    size_t len;
+
+    bool operator < (const Match &other) const {
+        return a < other.a;
+    }
+};
+
+
+/**
+ * Myers' O(ND) difference algorithm, linear space refinement, as described in
+ * "An O(ND) Difference Algorithm and Its Variations", Eugene W. Myers, 1986.
+ *
+ * Sub-problems are kept on an explicit stack rather than recursing, as the
+ * recursion depth is bounded by the number of differences, and matches are
+ * sorted at the end.
+ */
+class MyersDiff
+{
+private:
+    const CallHash *a;
+    const CallHash *b;
+    long maxCost;
+
+    std::vector<long> vf;
+    std::vector<long> vb;
+
+    std::vector<Match> &matches;
+
+    struct Box {
+        long aLo, aHi, bLo, bHi;
+    };
+
+    struct Snake {
+        long x0, y0, x1, y1;
+    };
+
+    static constexpr long NONE = -1;
+
+public:
+    // aSize and bSize bound the size of the boxes that will be run
+    MyersDiff(const CallHash *_a, size_t aSize,
+              const CallHash *_b, size_t bSize,
+              unsigned _maxCost,
+              std::vector<Match> &_matches) :
+        a(_a),
+        b(_b),
+        maxCost(std::max(_maxCost, 1U)),
+        vf(aSize + bSize + 3),
+        vb(aSize + bSize + 3),
+        matches(_matches)
+    {
+    }
+
+    void
+    run(long aLo, long aHi, long bLo, long bHi) {
+        std::vector<Box> stack;
+        stack.push_back(Box{aLo, aHi, bLo, bHi});
+
+        while (!stack.empty()) {
+            Box box = stack.back();
+            stack.pop_back();
+
+            // Strip common prefix and suffix
+            long start = box.aLo;
+            while (box.aLo < box.aHi && box.bLo < box.bHi &&
+                   a[box.aLo] == b[box.bLo]) {
+                ++box.aLo;
+                ++box.bLo;
+            }
+            addMatch(start, box.bLo - (box.aLo - start), box.aLo - start);
+
+            long end = box.aHi;
+            while (box.aLo < box.aHi && box.bLo < box.bHi &&
+                   a[box.aHi - 1] == b[box.bHi - 1]) {
+                --box.aHi;
+                --box.bHi;
+            }
+            addMatch(box.aHi, box.bHi, end - box.aHi);
+
+            if (box.aLo == box.aHi || box.bLo == box.bHi) {
+                continue;
+            }
+
+            Snake snake = split(box);
+
+            if (snake.x0 == box.aLo && snake.y0 == box.bLo &&
+                snake.x1 == box.aHi && snake.y1 == box.bHi) {
+                // Should not happen, but don't loop forever if it does
+                assert(0);
+                continue;
+            }
+
+            addMatch(snake.x0, snake.y0, snake.x1 - snake.x0);
+
+            stack.push_back(Box{snake.x1, box.aHi, snake.y1, box.bHi});
+            stack.push_back(Box{box.aLo, snake.x0, box.bLo, snake.y0});
+        }
+    }
+
+private:
+    inline void
+    addMatch(long x, long y, long len) {
+        if (len > 0) {
+            matches.push_back(Match{size_t(x), size_t(y), size_t(len)});
+        }
+    }
+
+    /**
+     * Find the middle snake of a box whose first and last elements differ.
+     *
+     * Diagonals are indexed by k = x - y, in local coordinates, and kept in
+     * the [-m, n] range, so that paths never leave the box.
+     */
+    Snake
+    split(const Box &box) {
+        const long n = box.aHi - box.aLo;
+        const long m = box.bHi - box.bLo;
+        const long delta = n - m;
+        const bool odd = delta & 1;
+        const long off = m + 1;
+        const CallHash *fa = a + box.aLo;
+        const CallHash *fb = b + box.bLo;
+        const CallHash *ra = a + box.aHi - 1;
+        const CallHash *rb = b + box.bHi - 1;
+
+        std::fill(vf.begin(), vf.begin() + n + m + 3, NONE);
+        std::fill(vb.begin(), vb.begin() + n + m + 3, NONE);
+
+        for (long d = 0; ; ++d) {
+            long kmin = std::max(-d, -m);
+            long kmax = std::min(d, n);
+            if ((kmin + d) & 1) {
+                ++kmin;
+            }
+            if ((kmax + d) & 1) {
+                --kmax;
+            }
+
+            // Forward
+            for (long k = kmin; k <= kmax; k += 2) {
+                long x = advance(vf, off, k, d, n, m);
+                if (x == NONE) {
+                    continue;
+                }
+                long y = x - k;
+                long x0 = x;
+                while (x < n && y < m && fa[x] == fb[y]) {
+                    ++x;
+                    ++y;
+                }
+                vf[off + k] = x;
+
+                if (odd) {
+                    long rk = delta - k;
+                    if (rk >= -m && rk <= n) {
+                        long rx = vb[off + rk];
+                        if (rx != NONE && x + rx >= n) {
+                            return Snake{box.aLo + x0, box.bLo + x0 - k,
+                                         box.aLo + x, box.bLo + y};
+                        }
+                    }
+                }
+            }
+
+            // Backward
+            for (long k = kmin; k <= kmax; k += 2) {
+                long x = advance(vb, off, k, d, n, m);
+                if (x == NONE) {
+                    continue;
+                }
+                long y = x - k;
+                long x0 = x;
+                while (x < n && y < m && ra[-x] == rb[-y]) {
+                    ++x;
+                    ++y;
+                }
+                vb[off + k] = x;
+
+                if (!odd) {
+                    long fk = delta - k;
+                    if (fk >= -m && fk <= n) {
+                        long fx = vf[off + fk];
+                        if (fx != NONE && x + fx >= n) {
+                            return Snake{box.aLo + n - x, box.bLo + m - y,
+                                         box.aLo + n - x0, box.bLo + m - (x0 - k)};
+                        }
+                    }
+                }
+            }
+
+            if (d >= maxCost) {
+                // Too expensive: split at the furthest reaching forward point
+                long best = NONE;
+                long bestK = 0;
+                for (long k = kmin; k <= kmax; k += 2) {
+                    long x = vf[off + k];
+                    if (x != NONE && 2*x - k > best) {
+                        best = 2*x - k;
+                        bestK = k;
+                    }
+                }
+                long x = vf[off + bestK];
+                long y = x - bestK;
+                return Snake{box.aLo + x, box.bLo + y, box.aLo + x, box.bLo + y};
+            }
+        }
+    }
+
+    /**
+     * Furthest x reachable on diagonal k with d edits, given the furthest
+     * points on the neighbouring diagonals with d - 1 edits, or NONE when
+     * those lie on the box edge.
+     */
+    static inline long
+    advance(const std::vector<long> &v, long off, long k, long d, long n, long m) {
+        if (d == 0) {
+            return 0;
+        }
+        long x = NONE;
+        // Down move from diagonal k + 1
+        if (k + 1 <= n) {
+            long xd = v[off + k + 1];
+            if (xd != NONE && xd - k <= m) {
+                x = xd;
+            }
+        }
+        // Right move from diagonal k - 1
+        if (k - 1 >= -m) {
+            long xr = v[off + k - 1];
+            if (xr != NONE && xr + 1 <= n) {
+                x = std::max(x, xr + 1);
+            }
+        }
+        return x;
+    }
+};
+
+
+static void
+findMatches(const std::vector<CallHash> &a, size_t aLo, size_t aHi,
+            const std::vector<CallHash> &b, size_t bLo, size_t bHi,
+            unsigned maxCost,
+            std::vector<Match> &matches)
+{
+    if (aLo == aHi || bLo == bHi) {
+        return;
+    }
+    MyersDiff myers(a.data(), aHi - aLo, b.data(), bHi - bLo, maxCost, matches);
+    myers.run(aLo, aHi, bLo, bHi);
+}
+
+
+static void
+matchesToScript(std::vector<Match> &matches,
+                size_t aSize, size_t bSize,
+                DiffScript &script)
+{
+    std::sort(matches.begin(), matches.end());
+
+    script.clear();
+
+    size_t i = 0;
+    size_t j = 0;
+    auto emit = [&] (size_t aEnd, size_t bEnd) {
+        if (i < aEnd || j < bEnd) {
+            DiffTag tag;
+            if (i < aEnd && j < bEnd) {
+                tag = DIFF_REPLACE;
+            } else if (i < aEnd) {
+                tag = DIFF_DELETE;
+            } else {
+                tag = DIFF_INSERT;
+            }
+            script.push_back(DiffOp{tag, i, aEnd, j, bEnd});
+        }
+    };
+
+    for (auto & match : matches) {
+        assert(match.a >= i && match.b >= j);
+        emit(match.a, match.b);
+        if (!script.empty() &&
+            script.back().tag == DIFF_EQUAL &&
+            script.back().aEnd == match.a &&
+            script.back().bEnd == match.b) {
+            script.back().aEnd += match.len;
+            script.back().bEnd += match.len;
+        } else {
+            script.push_back(DiffOp{DIFF_EQUAL,
+                                    match.a, match.a + match.len,
+                                    match.b, match.b + match.len});
+        }
+        i = match.a + match.len;
+        j = match.b + match.len;
+    }
+
+    emit(aSize, bSize);
+}
+
+
+void
+diff(const std::vector<CallHash> &a,
+     const std::vector<CallHash> &b,
+     DiffScript &script,
+     unsigned maxCost)
+{
+    std::vector<Match> matches;
+    findMatches(a, 0, a.size(), b, 0, b.size(), maxCost, matches);
+    matchesToScript(matches, a.size(), b.size(), script);
+}
+
+
+static void
+hashFrames(const std::vector<CallHash> &calls,
+           const std::vector<size_t> &frames,
+           std::vector<size_t> &bounds,
+           std::vector<CallHash> &hashes)
+{
+    bounds.clear();
+    bounds.push_back(0);
+    for (size_t end : frames) {
+        assert(end >= bounds.back() && end <= calls.size());
+        bounds.push_back(end);
+    }
+    if (bounds.back() < calls.size()) {
+        bounds.push_back(calls.size());
+    }
+
+    hashes.clear();
+    for (size_t f = 0; f + 1 < bounds.size(); ++f) {
+        CallHasher hasher;
+        hasher.mix(bounds[f + 1] - bounds[f]);
+        for (size_t i = bounds[f]; i < bounds[f + 1]; ++i) {
+            hasher.mix(calls[i]);
+        }
+        hashes.push_back(hasher.digest());
+    }
+}
+
+
+void
+diff(const std::vector<CallHash> &a,
+     const std::vector<size_t> &aFrames,
+     const std::vector<CallHash> &b,
+     const std::vector<size_t> &bFrames,
+     DiffScript &script,
+     unsigned maxCost)
+{
+    std::vector<size_t> aBounds, bBounds;
+    std::vector<CallHash> aFrameHashes, bFrameHashes;
+    hashFrames(a, aFrames, aBounds, aFrameHashes);
+    hashFrames(b, bFrames, bBounds, bFrameHashes);
+
+    // Anchor on identical frames
+    DiffScript frameScript;
+    diff(aFrameHashes, bFrameHashes, frameScript, maxCost);
+
+    // Then diff calls within the frames that differ
+    std::vector<Match> matches;
+    for (auto & op : frameScript) {
+        size_t aLo = aBounds[op.aBegin];
+        size_t aHi = aBounds[op.aEnd];
+        size_t bLo = bBounds[op.bBegin];
+        size_t bHi = bBounds[op.bEnd];
+        if (op.tag == DIFF_EQUAL) {
+            assert(aHi - aLo == bHi - bLo);
+            if (aHi > aLo) {
+                matches.push_back(Match{aLo, bLo, aHi - aLo});
+            }
+        } else {
+            findMatches(a, aLo, aHi, b, bLo, bHi, maxCost, matches);
+        }
+    }
+
+    matchesToScript(matches, a.size(), b.size(), script);
+}
+
+
+} /* namespace trace */
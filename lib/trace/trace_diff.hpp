@@ -0,0 +1,117 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Call hashing and sequence differencing, for comparing traces.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "trace_model.hpp"
+
+
+namespace trace {
+
+
+typedef uint64_t CallHash;
+
+
+/**
+ * Hash a call's function name, arguments, and return value.
+ *
+ * Values are canonicalized so that only what matters for comparison is
+ * hashed: integers, enums, and bitmasks hash by numeric value, floats hash
+ * as doubles, and blobs contribute their size and a digest of their contents
+ * rather than the contents themselves.
+ */
+CallHash
+hashCall(const Call &call);
+
+/**
+ * Hash just the call's function name.
+ */
+CallHash
+hashCallName(const Call &call);
+
+
+enum DiffTag {
+    DIFF_EQUAL = 0,
+    DIFF_DELETE,
+    DIFF_INSERT,
+    DIFF_REPLACE,
+};
+
+
+/**
+ * An edit operation, turning a[aBegin, aEnd) into b[bBegin, bEnd), with the
+ * same semantics as Python's difflib opcodes.
+ */
+struct DiffOp {
+    DiffTag tag;
+    size_t aBegin;
+    size_t aEnd;
+    size_t bBegin;
+    size_t bEnd;
+};
+
+typedef std::vector<DiffOp> DiffScript;
+
+
+/**
+ * Compute a shortest edit script between two hash sequences.
+ *
+ * Uses Myers' linear space algorithm.  When the number of differences within
+ * a region exceeds maxCost the search gives up on optimality and splits the
+ * region at the furthest reaching point, bounding the running time.
+ */
+void
+diff(const std::vector<CallHash> &a,
+     const std::vector<CallHash> &b,
+     DiffScript &script,
+     unsigned maxCost = 4096);
+
+/**
+ * Same as above, but first match whole frames, and then only diff the
+ * calls of frames that did not match.
+ *
+ * aFrames and bFrames hold the end index of each frame.  Calls past the last
+ * frame end are treated as an extra incomplete frame.
+ */
+void
+diff(const std::vector<CallHash> &a,
+     const std::vector<size_t> &aFrames,
+     const std::vector<CallHash> &b,
+     const std::vector<size_t> &bFrames,
+     DiffScript &script,
+     unsigned maxCost = 4096);
+
+
+} /* namespace trace */
@@ -0,0 +1,225 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "trace_diff.hpp"
+
+
+using namespace trace;
+
+
+static std::vector<CallHash>
+sequence(const char *s)
+{
+    std::vector<CallHash> seq;
+    for (; *s; ++s) {
+        seq.push_back(*s);
+    }
+    return seq;
+}
+
+
+// Check that the script is contiguous, covers both sequences, and that
+// equal ranges are indeed equal.  Returns the number of matched elements.
+static size_t
+checkScript(const std::vector<CallHash> &a,
+            const std::vector<CallHash> &b,
+            const DiffScript &script)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t matched = 0;
+    for (auto & op : script) {
+        EXPECT_EQ(op.aBegin, i);
+        EXPECT_EQ(op.bBegin, j);
+        switch (op.tag) {
+        case DIFF_EQUAL:
+            EXPECT_EQ(op.aEnd - op.aBegin, op.bEnd - op.bBegin);
+            for (size_t k = 0; k < op.aEnd - op.aBegin; ++k) {
+                EXPECT_EQ(a[op.aBegin + k], b[op.bBegin + k]);
+            }
+            matched += op.aEnd - op.aBegin;
+            break;
+        case DIFF_DELETE:
+            EXPECT_LT(op.aBegin, op.aEnd);
+            EXPECT_EQ(op.bBegin, op.bEnd);
+            break;
+        case DIFF_INSERT:
+            EXPECT_EQ(op.aBegin, op.aEnd);
+            EXPECT_LT(op.bBegin, op.bEnd);
+            break;
+        case DIFF_REPLACE:
+            EXPECT_LT(op.aBegin, op.aEnd);
+            EXPECT_LT(op.bBegin, op.bEnd);
+            break;
+        }
+        i = op.aEnd;
+        j = op.bEnd;
+    }
+    EXPECT_EQ(i, a.size());
+    EXPECT_EQ(j, b.size());
+    return matched;
+}
+
+
+static size_t
+lcsLength(const std::vector<CallHash> &a,
+          const std::vector<CallHash> &b)
+{
+    std::vector<size_t> prev(b.size() + 1, 0), cur(b.size() + 1, 0);
+    for (size_t i = 1; i <= a.size(); ++i) {
+        for (size_t j = 1; j <= b.size(); ++j) {
+            if (a[i - 1] == b[j - 1]) {
+                cur[j] = prev[j - 1] + 1;
+            } else {
+                cur[j] = std::max(prev[j], cur[j - 1]);
+            }
+        }
+        std::swap(prev, cur);
+    }
+    return prev[b.size()];
+}
+
+
+TEST(trace_diff, simple)
+{
+    std::vector<CallHash> a = sequence("abcabba");
+    std::vector<CallHash> b = sequence("cbabac");
+    DiffScript script;
+    diff(a, b, script);
+    EXPECT_EQ(checkScript(a, b, script), 4);
+
+    a = sequence("abcdef");
+    diff(a, a, script);
+    ASSERT_EQ(script.size(), 1);
+    EXPECT_EQ(script[0].tag, DIFF_EQUAL);
+
+    b = sequence("abXdef");
+    diff(a, b, script);
+    ASSERT_EQ(script.size(), 3);
+    EXPECT_EQ(script[1].tag, DIFF_REPLACE);
+    EXPECT_EQ(script[1].aBegin, 2);
+    EXPECT_EQ(script[1].aEnd, 3);
+
+    b = sequence("abdef");
+    diff(a, b, script);
+    ASSERT_EQ(script.size(), 3);
+    EXPECT_EQ(script[1].tag, DIFF_DELETE);
+
+    diff(b, a, script);
+    ASSERT_EQ(script.size(), 3);
+    EXPECT_EQ(script[1].tag, DIFF_INSERT);
+
+    diff(a, std::vector<CallHash>(), script);
+    ASSERT_EQ(script.size(), 1);
+    EXPECT_EQ(script[0].tag, DIFF_DELETE);
+}
+
+
+TEST(trace_diff, random)
+{
+    srand(1);
+    for (unsigned iter = 0; iter < 200; ++iter) {
+        std::vector<CallHash> a, b;
+        size_t aSize = rand() % 64;
+        size_t bSize = rand() % 64;
+        unsigned alphabet = 1 + rand() % 6;
+        for (size_t i = 0; i < aSize; ++i) {
+            a.push_back(rand() % alphabet);
+        }
+        for (size_t i = 0; i < bSize; ++i) {
+            b.push_back(rand() % alphabet);
+        }
+
+        DiffScript script;
+        diff(a, b, script);
+        EXPECT_EQ(checkScript(a, b, script), lcsLength(a, b));
+
+        // Bounding the cost must still yield a valid script
+        diff(a, b, script, 1);
+        EXPECT_LE(checkScript(a, b, script), lcsLength(a, b));
+    }
+}
+
+
+TEST(trace_diff, frames)
+{
+    std::vector<CallHash> a = sequence("abcXdefXghiX");
+    std::vector<CallHash> b = sequence("abcXdeefXghiXjk");
+    std::vector<size_t> aFrames = {4, 8, 12};
+    std::vector<size_t> bFrames = {4, 9, 13};
+    DiffScript script;
+    diff(a, aFrames, b, bFrames, script);
+    EXPECT_EQ(checkScript(a, b, script), a.size());
+    ASSERT_EQ(script.size(), 4);
+    EXPECT_EQ(script[1].tag, DIFF_INSERT);
+    EXPECT_EQ(script[1].bBegin, 6);
+    EXPECT_EQ(script[3].tag, DIFF_INSERT);
+    EXPECT_EQ(script[3].bBegin, 13);
+}
+
+
+TEST(trace_diff, hash)
+{
+    static const char *argNames[] = {"x"};
+    FunctionSig sig = {0, "glFoo", 1, argNames};
+
+    Call a(&sig, 0, 0);
+    Call b(&sig, 0, 0);
+    a.args[0].value = new SInt(1);
+    b.args[0].value = new UInt(1);
+    EXPECT_EQ(hashCall(a), hashCall(b));
+    EXPECT_EQ(hashCallName(a), hashCallName(b));
+
+    delete b.args[0].value;
+    b.args[0].value = new UInt(2);
+    EXPECT_NE(hashCall(a), hashCall(b));
+
+    Blob *blobA = new Blob(16);
+    Blob *blobB = new Blob(16);
+    memset(blobA->buf, 0, 16);
+    memset(blobB->buf, 0, 16);
+    delete a.args[0].value;
+    delete b.args[0].value;
+    a.args[0].value = blobA;
+    b.args[0].value = blobB;
+    EXPECT_EQ(hashCall(a), hashCall(b));
+    blobB->buf[15] = 1;
+    EXPECT_NE(hashCall(a), hashCall(b));
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -33,6 +33,7 @@
 
 #include "highlight.hpp"
 #include "guids.hpp"
+#include "trace_symbolizer.hpp"
 
 
 namespace trace {
@@ -207,6 +208,13 @@ void Dumper::visit(StackFrame *frame) {
 }
 
 void Dumper::visit(Backtrace & backtrace) {
+    if (symbolizer) {
+        for (auto & frame : symbolizer->symbolize(backtrace)) {
+            frame.dump(os);
+            os << '\n';
+        }
+        return;
+    }
     for (auto & frame : backtrace) {
         visit(frame);
         os << '\n';
@@ -254,8 +262,12 @@ void Dumper::visit(Call *call)
         _visit(call->ret);
     }
 
+    bool timestamp = (dumpFlags & DUMP_FLAG_TIMESTAMPS) && call->timestamp >= 0;
+
     if (callFlags & (CALL_FLAG_FAKE |
-                     CALL_FLAG_INCOMPLETE)) {
+                     CALL_FLAG_INCOMPLETE |
+                     CALL_FLAG_TRUNCATED) ||
+        timestamp) {
         os << " //";
         if (callFlags & CALL_FLAG_FAKE) {
             os << " " << "fake";
@@ -263,6 +275,15 @@ void Dumper::visit(Call *call)
         if (callFlags & CALL_FLAG_INCOMPLETE) {
             os << " " << red << "incomplete" << normal;
         }
+        if (callFlags & CALL_FLAG_TRUNCATED) {
+            os << " " << red << "truncated" << normal;
+        }
+        if (timestamp) {
+            os << " at " << call->timestamp << " ns";
+            if (call->duration >= 0) {
+                os << ", took " << call->duration << " ns";
+            }
+        }
     }
 
     if (!(dumpFlags & DUMP_FLAG_NO_MULTILINE)) {
@@ -33,6 +33,9 @@
 namespace trace {
 
 
+class Symbolizer;
+
+
 class Dumper : public Visitor
 {
 protected:
@@ -46,11 +49,17 @@ protected:
     const highlight::Attribute & red;
     const highlight::Attribute & pointer;
     const highlight::Attribute & literal;
+    Symbolizer *symbolizer = nullptr;
 
 public:
     Dumper(std::ostream &_os, DumpFlags _flags);
     virtual ~Dumper();
 
+    /// Symbolize backtraces recorded with APITRACE_BACKTRACE_DEFERRED
+    void setSymbolizer(Symbolizer *_symbolizer) {
+        symbolizer = _symbolizer;
+    }
+
     virtual void visit(Null *) override;
     virtual void visit(Bool *node) override;
     virtual void visit(SInt *node) override;
@@ -37,7 +37,9 @@
  *     uint32 - specifying the length of the compressed data
  *     compressed data, in little endian
  * }
- * File can contain any number of such chunks.
+ * File can contain any number of such chunks.  Chunks that did not
+ * compress are stored as is, with SNAPPY_CHUNK_UNCOMPRESSED set in their
+ * length.
  * The default size of an uncompressed chunk is specified in
  * SNAPPY_CHUNK_SIZE.
  *
@@ -233,6 +235,21 @@ void SnappyFile::flushReadCache(size_t skipLength)
         return;
     }
 
+    if (compressedLength & SNAPPY_CHUNK_UNCOMPRESSED) {
+        compressedLength &= ~size_t(SNAPPY_CHUNK_UNCOMPRESSED);
+        createCache(compressedLength);
+        if (skipLength >= compressedLength) {
+            m_stream.seekg(compressedLength, std::ios_base::cur);
+            return;
+        }
+        m_stream.read(m_cache, compressedLength);
+        if (m_stream.fail()) {
+            std::cerr << "warning: unexpected end of file while reading trace\n";
+            m_cacheSize = m_stream.gcount();
+        }
+        return;
+    }
+
     m_stream.read((char*)m_compressedCache, compressedLength);
     if (m_stream.fail()) {
         std::cerr << "warning: unexpected end of file while reading trace\n";
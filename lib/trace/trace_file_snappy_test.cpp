@@ -0,0 +1,190 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "os_process.hpp"
+#include "trace_file.hpp"
+#include "trace_ostream.hpp"
+#include "trace_snappy.hpp"
+
+
+using namespace trace;
+
+
+static const size_t chunkSize = 1024 * 1024;
+
+
+/* Incompressible bytes, like those of BCn/ASTC textures */
+static void
+appendNoise(std::vector<char> &data, size_t length)
+{
+    uint32_t state = 0x12345678;
+    for (size_t i = 0; i < length; ++i) {
+        state = state * 1664525 + 1013904223;
+        data.push_back(char(state >> 24));
+    }
+}
+
+
+class SnappyFileTest : public ::testing::Test
+{
+protected:
+    std::string filename = ::testing::TempDir() + "apitrace-snappy-" +
+                           std::to_string(os::getCurrentProcessId()) + ".trace";
+    std::vector<char> data;
+
+    void SetUp() override {
+        std::vector<char> blob;
+        appendNoise(blob, chunkSize);
+        blob.insert(blob.end(), chunkSize, 0);
+        appendNoise(blob, chunkSize / 2);
+
+        std::unique_ptr<OutStream> stream(createSnappyStream(filename.c_str()));
+        ASSERT_TRUE(stream);
+
+        // A small write is cached, the blob bypasses the cache, and its tail
+        // is cached along with the last small write
+        std::vector<char> header(100, 'a');
+        std::vector<char> footer(100, 'z');
+        for (auto *buffer : {&header, &blob, &footer}) {
+            EXPECT_TRUE(stream->write(buffer->data(), buffer->size()));
+            data.insert(data.end(), buffer->begin(), buffer->end());
+        }
+    }
+
+    void TearDown() override {
+        remove(filename.c_str());
+    }
+
+    /* Returns the length field of every chunk in the file */
+    std::vector<uint32_t> chunkLengths(void) {
+        std::vector<uint32_t> lengths;
+        FILE *fp = fopen(filename.c_str(), "rb");
+        EXPECT_NE(fp, nullptr);
+        if (!fp) {
+            return lengths;
+        }
+        EXPECT_EQ(fgetc(fp), SNAPPY_BYTE1);
+        EXPECT_EQ(fgetc(fp), SNAPPY_BYTE2);
+        unsigned char buf[4];
+        while (fread(buf, sizeof buf, 1, fp) == 1) {
+            uint32_t length = buf[0] | buf[1] << 8 | buf[2] << 16 | uint32_t(buf[3]) << 24;
+            lengths.push_back(length);
+            fseek(fp, length & ~SNAPPY_CHUNK_UNCOMPRESSED, SEEK_CUR);
+        }
+        fclose(fp);
+        return lengths;
+    }
+};
+
+
+TEST_F(SnappyFileTest, chunks)
+{
+    std::vector<uint32_t> lengths = chunkLengths();
+    ASSERT_EQ(lengths.size(), 4u);
+
+    // The header, cached on its own, compresses
+    EXPECT_FALSE(lengths[0] & SNAPPY_CHUNK_UNCOMPRESSED);
+    EXPECT_EQ(lengths[1], chunkSize | SNAPPY_CHUNK_UNCOMPRESSED);
+    EXPECT_FALSE(lengths[2] & SNAPPY_CHUNK_UNCOMPRESSED);
+    EXPECT_LT(lengths[2], chunkSize);
+    EXPECT_EQ(lengths[3], (chunkSize / 2 + 100) | SNAPPY_CHUNK_UNCOMPRESSED);
+}
+
+
+TEST_F(SnappyFileTest, read)
+{
+    std::unique_ptr<File> file(File::createSnappy());
+    ASSERT_TRUE(file->open(filename.c_str()));
+
+    // Read in pieces that straddle the chunk boundaries
+    std::vector<char> read;
+    char buf[300000];
+    size_t length;
+    while ((length = file->read(buf, sizeof buf)) > 0) {
+        read.insert(read.end(), buf, buf + length);
+    }
+    EXPECT_EQ(read.size(), data.size());
+    EXPECT_TRUE(read == data);
+}
+
+
+TEST_F(SnappyFileTest, seek)
+{
+    std::unique_ptr<File> file(File::createSnappy());
+    ASSERT_TRUE(file->open(filename.c_str()));
+    ASSERT_TRUE(file->supportsOffsets());
+
+    // Remember an offset inside each chunk
+    static const size_t positions[] = {
+        50,
+        100 + chunkSize / 2,
+        100 + chunkSize + 1000,
+        100 + 2 * chunkSize + 1000,
+    };
+    std::vector<File::Offset> offsets;
+    size_t position = 0;
+    for (size_t target : positions) {
+        ASSERT_TRUE(file->skip(target - position));
+        position = target;
+        offsets.push_back(file->currentOffset());
+    }
+
+    // Seek back and forth between raw and compressed chunks
+    static const unsigned order[] = {3, 0, 2, 1, 3, 2};
+    for (unsigned i : order) {
+        file->setCurrentOffset(offsets[i]);
+        char buf[4096];
+        ASSERT_EQ(file->read(buf, sizeof buf), sizeof buf);
+        EXPECT_EQ(memcmp(buf, &data[positions[i]], sizeof buf), 0) << "offset " << i;
+    }
+}
+
+
+/* Skipping must read past the raw chunks it doesn't need */
+TEST_F(SnappyFileTest, skip)
+{
+    std::unique_ptr<File> file(File::createSnappy());
+    ASSERT_TRUE(file->open(filename.c_str()));
+
+    size_t position = 100 + 2 * chunkSize + 10;
+    ASSERT_TRUE(file->skip(position));
+
+    std::vector<char> read(data.size() - position);
+    EXPECT_EQ(file->read(read.data(), read.size()), read.size());
+    EXPECT_TRUE(std::equal(read.begin(), read.end(), data.begin() + position));
+    EXPECT_EQ(file->read(read.data(), 1), 0u);
+}
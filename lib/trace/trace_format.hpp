@@ -34,7 +34,7 @@
 namespace trace {
 
 
-#define TRACE_VERSION 6
+#define TRACE_VERSION 7
 
 
 enum Event {
@@ -49,6 +49,7 @@ enum CallDetail {
     CALL_THREAD,
     CALL_BACKTRACE,
     CALL_FLAGS,
+    CALL_TIMESTAMP,
 };
 
 enum Type {
@@ -77,10 +78,12 @@ enum BacktraceDetail {
     BACKTRACE_FILENAME,
     BACKTRACE_LINENUMBER,
     BACKTRACE_OFFSET,
+    BACKTRACE_BUILD_ID,
 };
 
 enum {
     FLAG_FAKE = (1 << 0),
+    FLAG_TRUNCATED = (1 << 1),
 };
 
 
@@ -42,6 +42,7 @@ Call::~Call() {
     }
 
     delete ret;
+    delete raw;
 }
 
 Value &
@@ -136,6 +137,10 @@ Blob::~Blob() {
     // we can easily exhaust all memory.  So instead we maintain a queue of
     // bound blobs and keep the total size bounded.
 
+    if (!owned) {
+        return;
+    }
+
     if (!bound) {
         delete [] buf;
         return;
@@ -154,6 +159,7 @@ StackFrame::~StackFrame() {
     delete [] module;
     delete [] function;
     delete [] filename;
+    delete [] buildId;
 }
 
 
@@ -334,6 +334,15 @@ public:
         size = _size;
         buf = new char[_size];
         bound = false;
+        owned = true;
+    }
+
+    // Refers to memory that outlives the blob, such as a mapped replay plan
+    Blob(size_t _size, char *_buf) {
+        size = _size;
+        buf = _buf;
+        bound = false;
+        owned = false;
     }
 
     ~Blob();
@@ -350,6 +359,7 @@ public:
     size_t size;
     char *buf;
     bool bound;
+    bool owned;
 };
 
 
@@ -401,12 +411,14 @@ struct RawStackFrame {
     const char * filename;
     int linenumber;
     long long offset;
+    const char * buildId;
     RawStackFrame() :
         module(0),
         function(0),
         filename(0),
         linenumber(-1),
-        offset(-1)
+        offset(-1),
+        buildId(0)
     {
     }
 
@@ -541,6 +553,12 @@ enum {
     CALL_FLAG_MARKER                    = (1 << 8),
     CALL_FLAG_MARKER_PUSH               = (1 << 9),
     CALL_FLAG_MARKER_POP                = (1 << 10),
+
+    /**
+     * Whether blob arguments were truncated when tracing (see the blobcap
+     * capture policy), so that the call can't be replayed.
+     */
+    CALL_FLAG_TRUNCATED                 = (1 << 11),
 };
 
 
@@ -550,6 +568,56 @@ struct Arg
 };
 
 
+/**
+ * The encoded bytes of a call's enter and leave events, as read from a trace,
+ * so that tools which don't modify a call can copy it verbatim.
+ */
+struct RawCallRecord
+{
+    /**
+     * A signature referenced from within a span.  Signatures are only defined
+     * inline the first time they are referenced, so the definition may have
+     * to be dropped or added when the call is written elsewhere.
+     */
+    struct SigRef {
+        enum Kind {
+            FUNCTION,
+            STRUCT,
+            ENUM,
+            BITMASK,
+            FRAME,
+        } kind;
+
+        // Offset in the span just past the signature id
+        size_t offset;
+
+        // Length of the inline definition following the id, if any
+        size_t length;
+        bool defined;
+
+        union {
+            const FunctionSig *function;
+            const StructSig *structSig;
+            const EnumSig *enumSig;
+            const BitmaskSig *bitmaskSig;
+            const RawStackFrame *frame;
+        };
+    };
+
+    struct Span {
+        std::vector<char> bytes;
+        std::vector<SigRef> sigs;
+    };
+
+    // Enter event, from the thread number up to and including CALL_END
+    Span enter;
+
+    // Leave event details following the call number
+    Span leave;
+};
+
+
+
 class Call
 {
 public:
@@ -563,6 +631,14 @@ public:
     Backtrace *backtrace = nullptr;
     bool reuse_call = false;
 
+    // Nanoseconds since the trace started, and spent in the call, when the
+    // trace was recorded with TRACE_TIMESTAMPS, or -1
+    long long timestamp = -1;
+    long long duration = -1;
+
+    // Only set when the parser was asked to record raw calls
+    RawCallRecord *raw = nullptr;
+
     Call(const FunctionSig *_sig, const CallFlags &_flags, unsigned _thread_id) :
         thread_id(_thread_id), 
         sig(_sig), 
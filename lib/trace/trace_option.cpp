@@ -59,4 +59,26 @@ intOption(const char *option, int default_) {
     return atoi(option);
 }
 
+bool
+sizeOption(const char *option, unsigned long long &size) {
+    char *end = nullptr;
+    size = strtoull(option, &end, 10);
+    if (end == option) {
+        return false;
+    }
+    switch (*end) {
+    case 'G': case 'g':
+        size <<= 10;
+        /* fall-through */
+    case 'M': case 'm':
+        size <<= 10;
+        /* fall-through */
+    case 'K': case 'k':
+        size <<= 10;
+        ++end;
+        break;
+    }
+    return *end == '\0';
+}
+
 } /* namespace trace */
@@ -34,5 +34,11 @@ boolOption(const char *option, bool default_ = true);
 int
 intOption(const char *option, int default_ = 0);
 
+/**
+ * Parse a byte count, optionally followed by a K, M or G binary suffix.
+ */
+bool
+sizeOption(const char *option, unsigned long long &size);
+
 } /* namespace trace */
 
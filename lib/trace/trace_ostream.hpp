@@ -34,11 +34,30 @@ namespace trace {
 
 
 class OutStream {
+public:
+    /**
+     * Counters for TRACE_STATS, with times in os::timeFrequency units.
+     */
+    struct Stats {
+        unsigned long long uncompressedBytes = 0;
+        unsigned long long compressedBytes = 0;
+        long long compressionTime = 0;
+        long long writeTime = 0;
+    };
+
+protected:
+    Stats m_stats;
+
 public:
     virtual ~OutStream() {}
 
     virtual bool write(const void *buffer, size_t length) = 0;
     virtual void flush(void) = 0;
+
+    inline const Stats &
+    getStats(void) const {
+        return m_stats;
+    }
 };
 
 
@@ -35,11 +35,20 @@
 #include <snappy.h>
 
 #include "os.hpp"
+#include "os_time.hpp"
 #include "trace_snappy.hpp"
 
 
 #define SNAPPY_CHUNK_SIZE (1 * 1024 * 1024)
 
+/*
+ * Chunks are sampled at a few places before compressing them, and stored
+ * uncompressed if the samples don't shrink by at least 1/32th, as it is
+ * the case for already compressed data such as BCn/ASTC/ETC textures.
+ */
+#define SNAPPY_SAMPLE_SIZE (4 * 1024)
+#define SNAPPY_SAMPLE_COUNT 4
+
 
 using namespace trace;
 
@@ -80,6 +89,8 @@ private:
     }
     void flushWriteCache(void);
     void createCache(size_t size);
+    bool isCompressible(const char *data, size_t length);
+    void writeChunk(const char *data, size_t length);
     void writeCompressedLength(size_t length);
 private:
     std::ofstream m_stream;
@@ -121,6 +132,17 @@ SnappyOutStream::~SnappyOutStream()
 
 bool SnappyOutStream::write(const void *buffer, size_t length)
 {
+    if (length >= SNAPPY_CHUNK_SIZE) {
+        // Compress large blobs straight from the caller's buffer, instead of
+        // copying them into the cache first
+        flushWriteCache();
+        while (length >= SNAPPY_CHUNK_SIZE) {
+            writeChunk((const char *)buffer, SNAPPY_CHUNK_SIZE);
+            buffer = (const char *)buffer + SNAPPY_CHUNK_SIZE;
+            length -= SNAPPY_CHUNK_SIZE;
+        }
+    }
+
     if (freeCacheSize() > length) {
         memcpy(m_cachePtr, buffer, length);
         m_cachePtr += length;
@@ -169,16 +191,58 @@ void SnappyOutStream::flushWriteCache(void)
     size_t inputLength = usedCacheSize();
 
     if (inputLength) {
-        size_t compressedLength;
+        writeChunk(m_cache, inputLength);
+        m_cachePtr = m_cache;
+    }
+    assert(m_cachePtr == m_cache);
+}
+
+bool SnappyOutStream::isCompressible(const char *data, size_t length)
+{
+    if (length < SNAPPY_SAMPLE_SIZE * SNAPPY_SAMPLE_COUNT * 4) {
+        return true;
+    }
 
-        ::snappy::RawCompress(m_cache, inputLength,
+    size_t compressedLength = 0;
+    for (unsigned i = 0; i < SNAPPY_SAMPLE_COUNT; ++i) {
+        size_t sampleLength;
+        ::snappy::RawCompress(data + length / SNAPPY_SAMPLE_COUNT * i,
+                              SNAPPY_SAMPLE_SIZE,
+                              m_compressedCache, &sampleLength);
+        compressedLength += sampleLength;
+    }
+
+    size_t sampledLength = SNAPPY_SAMPLE_SIZE * SNAPPY_SAMPLE_COUNT;
+    return compressedLength < sampledLength - sampledLength / 32;
+}
+
+void SnappyOutStream::writeChunk(const char *data, size_t length)
+{
+    assert(length <= SNAPPY_CHUNK_SIZE);
+
+    long long startTime = os::getTime();
+    size_t compressedLength = 0;
+    bool compressed = isCompressible(data, length);
+    if (compressed) {
+        ::snappy::RawCompress(data, length,
                               m_compressedCache, &compressedLength);
+        compressed = compressedLength < length;
+    }
+    long long compressedTime = os::getTime();
 
+    if (compressed) {
         writeCompressedLength(compressedLength);
         m_stream.write(m_compressedCache, compressedLength);
-        m_cachePtr = m_cache;
+    } else {
+        writeCompressedLength(length | SNAPPY_CHUNK_UNCOMPRESSED);
+        m_stream.write(data, length);
+        compressedLength = length;
     }
-    assert(m_cachePtr == m_cache);
+
+    m_stats.uncompressedBytes += length;
+    m_stats.compressedBytes += 4 + compressedLength;
+    m_stats.compressionTime += compressedTime - startTime;
+    m_stats.writeTime += os::getTime() - compressedTime;
 }
 
 void SnappyOutStream::writeCompressedLength(size_t length)
@@ -177,6 +177,107 @@ void Parser::setBookmark(const ParseBookmark &bookmark) {
     deleteAll(calls);
 }
 
+static const char *
+copy_string(const char *str) {
+    if (!str) {
+        return NULL;
+    }
+    size_t len = strlen(str) + 1;
+    char *copy = new char[len];
+    memcpy(copy, str, len);
+    return copy;
+}
+
+
+void Parser::copySignatures(const Parser &other) {
+    assert(functions.empty() && structs.empty() && enums.empty() &&
+           bitmasks.empty() && frames.empty());
+
+    api = other.api;
+
+    functions.resize(other.functions.size());
+    for (size_t id = 0; id < other.functions.size(); ++id) {
+        const FunctionSigState *src = other.functions[id];
+        if (src) {
+            FunctionSigState *sig = new FunctionSigState(*src);
+            sig->name = copy_string(src->name);
+            const char **arg_names = new const char *[sig->num_args];
+            for (unsigned i = 0; i < sig->num_args; ++i) {
+                arg_names[i] = copy_string(src->arg_names[i]);
+            }
+            sig->arg_names = arg_names;
+            sig->num_decoded_args = decodedArgsCallback ? decodedArgsCallback(sig) : ALL_ARGS;
+            if (other.glGetErrorSig == src) {
+                glGetErrorSig = sig;
+            }
+            functions[id] = sig;
+        }
+    }
+
+    structs.resize(other.structs.size());
+    for (size_t id = 0; id < other.structs.size(); ++id) {
+        const StructSigState *src = other.structs[id];
+        if (src) {
+            StructSigState *sig = new StructSigState(*src);
+            sig->name = copy_string(src->name);
+            const char **member_names = new const char *[sig->num_members];
+            for (unsigned i = 0; i < sig->num_members; ++i) {
+                member_names[i] = copy_string(src->member_names[i]);
+            }
+            sig->member_names = member_names;
+            structs[id] = sig;
+        }
+    }
+
+    enums.resize(other.enums.size());
+    for (size_t id = 0; id < other.enums.size(); ++id) {
+        const EnumSigState *src = other.enums[id];
+        if (src) {
+            EnumSigState *sig = new EnumSigState(*src);
+            EnumValue *values = new EnumValue[sig->num_values];
+            for (unsigned i = 0; i < sig->num_values; ++i) {
+                values[i].name = copy_string(src->values[i].name);
+                values[i].value = src->values[i].value;
+            }
+            sig->values = values;
+            enums[id] = sig;
+        }
+    }
+
+    bitmasks.resize(other.bitmasks.size());
+    for (size_t id = 0; id < other.bitmasks.size(); ++id) {
+        const BitmaskSigState *src = other.bitmasks[id];
+        if (src) {
+            BitmaskSigState *sig = new BitmaskSigState(*src);
+            BitmaskFlag *flags = new BitmaskFlag[sig->num_flags];
+            for (unsigned i = 0; i < sig->num_flags; ++i) {
+                flags[i].name = copy_string(src->flags[i].name);
+                flags[i].value = src->flags[i].value;
+            }
+            sig->flags = flags;
+            bitmasks[id] = sig;
+        }
+    }
+
+    frames.resize(other.frames.size());
+    for (size_t id = 0; id < other.frames.size(); ++id) {
+        const StackFrameState *src = other.frames[id];
+        if (src) {
+            StackFrameState *frame = new StackFrameState;
+            frame->id = src->id;
+            frame->module = copy_string(src->module);
+            frame->function = copy_string(src->function);
+            frame->filename = copy_string(src->filename);
+            frame->linenumber = src->linenumber;
+            frame->offset = src->offset;
+            frame->fileOffset = src->fileOffset;
+            frame->buildId = copy_string(src->buildId);
+            frames[id] = frame;
+        }
+    }
+}
+
+
 void Parser::parseProperties(void)
 {
     if (TRACE_VERBOSE) {
@@ -247,8 +348,10 @@ T *lookup(std::vector<T *> &map, size_t index) {
 Parser::FunctionSigFlags *
 Parser::parse_function_sig(void) {
     size_t id = read_uint();
+    size_t rawOffset = raw_offset();
 
     FunctionSigState *sig = lookup(functions, id);
+    bool defined = !sig || file->currentOffset() < sig->fileOffset;
 
     if (!sig) {
         /* parse the signature */
@@ -300,6 +403,8 @@ Parser::parse_function_sig(void) {
             glGetErrorSig = sig;
         }
 
+        sig->num_decoded_args = decodedArgsCallback ? decodedArgsCallback(sig) : ALL_ARGS;
+
     } else if (file->currentOffset() < sig->fileOffset) {
         /* skip over the signature */
         skip_string(); /* name */
@@ -310,14 +415,19 @@ Parser::parse_function_sig(void) {
     }
 
     assert(sig);
+    if (auto ref = record_sig_ref(RawCallRecord::SigRef::FUNCTION, rawOffset, defined)) {
+        ref->function = sig;
+    }
     return sig;
 }
 
 
 StructSig *Parser::parse_struct_sig() {
     size_t id = read_uint();
+    size_t rawOffset = raw_offset();
 
     StructSigState *sig = lookup(structs, id);
+    bool defined = !sig || file->currentOffset() < sig->fileOffset;
 
     if (!sig) {
         /* parse the signature */
@@ -342,6 +452,9 @@ StructSig *Parser::parse_struct_sig() {
     }
 
     assert(sig);
+    if (auto ref = record_sig_ref(RawCallRecord::SigRef::STRUCT, rawOffset, defined)) {
+        ref->structSig = sig;
+    }
     return sig;
 }
 
@@ -381,8 +494,10 @@ EnumSig *Parser::parse_old_enum_sig() {
 
 EnumSig *Parser::parse_enum_sig() {
     size_t id = read_uint();
+    size_t rawOffset = raw_offset();
 
     EnumSigState *sig = lookup(enums, id);
+    bool defined = !sig || file->currentOffset() < sig->fileOffset;
 
     if (!sig) {
         /* parse the signature */
@@ -407,14 +522,19 @@ EnumSig *Parser::parse_enum_sig() {
     }
 
     assert(sig);
+    if (auto ref = record_sig_ref(RawCallRecord::SigRef::ENUM, rawOffset, defined)) {
+        ref->enumSig = sig;
+    }
     return sig;
 }
 
 
 BitmaskSig *Parser::parse_bitmask_sig() {
     size_t id = read_uint();
+    size_t rawOffset = raw_offset();
 
     BitmaskSigState *sig = lookup(bitmasks, id);
+    bool defined = !sig || file->currentOffset() < sig->fileOffset;
 
     if (!sig) {
         /* parse the signature */
@@ -442,11 +562,20 @@ BitmaskSig *Parser::parse_bitmask_sig() {
     }
 
     assert(sig);
+    if (auto ref = record_sig_ref(RawCallRecord::SigRef::BITMASK, rawOffset, defined)) {
+        ref->bitmaskSig = sig;
+    }
     return sig;
 }
 
 
 void Parser::parse_enter(Mode mode) {
+    RawCallRecord *raw = nullptr;
+    if (recordRawCalls && version >= 4) {
+        raw = new RawCallRecord;
+        rawSpan = &raw->enter;
+    }
+
     unsigned thread_id;
 
     if (version >= 4) {
@@ -461,7 +590,17 @@ void Parser::parse_enter(Mode mode) {
 
     call->no = next_call_no++;
 
-    if (parse_call_details(call, mode)) {
+    if (raw && rawCallFilter && !rawCallFilter(call)) {
+        delete raw;
+        raw = nullptr;
+        rawSpan = nullptr;
+    }
+    call->raw = raw;
+
+    bool complete = parse_call_details(call, EVENT_ENTER, mode);
+    rawSpan = nullptr;
+
+    if (complete) {
         calls.push_back(call);
     } else {
         delete call;
@@ -486,12 +625,19 @@ Call *Parser::parse_leave(Mode mode) {
          */
         const FunctionSig sig = {0, NULL, 0, NULL};
         call = new Call(&sig, 0, 0);
-        parse_call_details(call, SCAN);
+        parse_call_details(call, EVENT_LEAVE, SCAN);
         delete call;
         return NULL;
     }
 
-    if (parse_call_details(call, mode)) {
+    if (call->raw) {
+        rawSpan = &call->raw->leave;
+    }
+
+    bool complete = parse_call_details(call, EVENT_LEAVE, mode);
+    rawSpan = nullptr;
+
+    if (complete) {
         return call;
     } else {
         delete call;
@@ -500,7 +646,12 @@ Call *Parser::parse_leave(Mode mode) {
 }
 
 
-bool Parser::parse_call_details(Call *call, Mode mode) {
+bool Parser::parse_call_details(Call *call, Event event, Mode mode) {
+    unsigned num_decoded_args = ALL_ARGS;
+    if (mode == FULL) {
+        num_decoded_args = static_cast<const FunctionSigFlags *>(call->sig)->num_decoded_args;
+    }
+
     do {
         int c = read_byte();
         switch (c) {
@@ -513,13 +664,13 @@ bool Parser::parse_call_details(Call *call, Mode mode) {
             if (TRACE_VERBOSE) {
                 std::cerr << "\tCALL_ARG\n";
             }
-            parse_arg(call, mode);
+            parse_arg(call, mode, num_decoded_args);
             break;
         case trace::CALL_RET:
             if (TRACE_VERBOSE) {
                 std::cerr << "\tCALL_RET\n";
             }
-            call->ret = parse_value(mode);
+            call->ret = parse_value(num_decoded_args == ALL_ARGS ? mode : SCAN);
             break;
         case trace::CALL_BACKTRACE:
             if (TRACE_VERBOSE) {
@@ -536,6 +687,24 @@ bool Parser::parse_call_details(Call *call, Mode mode) {
                 if (flags & FLAG_FAKE) {
                     call->flags |= CALL_FLAG_FAKE;
                 }
+                if (flags & FLAG_TRUNCATED) {
+                    call->flags |= CALL_FLAG_TRUNCATED;
+                }
+            }
+            break;
+        case trace::CALL_TIMESTAMP:
+            if (TRACE_VERBOSE) {
+                std::cerr << "\tCALL_TIMESTAMP\n";
+            }
+            {
+                // The enter event has the start time, the leave event the
+                // duration
+                long long ns = read_uint();
+                if (event == EVENT_ENTER) {
+                    call->timestamp = ns;
+                } else {
+                    call->duration = ns;
+                }
             }
             break;
         default:
@@ -560,11 +729,14 @@ bool Parser::parse_call_backtrace(Call *call, Mode mode) {
 
 StackFrame * Parser::parse_backtrace_frame(Mode mode) {
     size_t id = read_uint();
+    size_t rawOffset = raw_offset();
 
     StackFrameState *frame = lookup(frames, id);
+    bool defined = !frame || file->currentOffset() < frame->fileOffset;
 
     if (!frame) {
         frame = new StackFrameState;
+        frame->id = id;
         int c = read_byte();
         while (c != trace::BACKTRACE_END &&
                c != -1) {
@@ -584,6 +756,9 @@ StackFrame * Parser::parse_backtrace_frame(Mode mode) {
             case trace::BACKTRACE_OFFSET:
                 frame->offset = read_uint();
                 break;
+            case trace::BACKTRACE_BUILD_ID:
+                frame->buildId = read_string();
+                break;
             default:
                 std::cerr << "error: unknown backtrace detail "
                           << c << "\n";
@@ -614,6 +789,9 @@ StackFrame * Parser::parse_backtrace_frame(Mode mode) {
             case trace::BACKTRACE_OFFSET:
                 scan_uint();
                 break;
+            case trace::BACKTRACE_BUILD_ID:
+                scan_string();
+                break;
             default:
                 std::cerr << "error: unknown backtrace detail "
                           << c << "\n";
@@ -623,6 +801,9 @@ StackFrame * Parser::parse_backtrace_frame(Mode mode) {
         }
     }
 
+    if (auto ref = record_sig_ref(RawCallRecord::SigRef::FRAME, rawOffset, defined)) {
+        ref->frame = frame;
+    }
     return frame;
 }
 
@@ -641,9 +822,9 @@ void Parser::adjust_call_flags(Call *call) {
     }
 }
 
-void Parser::parse_arg(Call *call, Mode mode) {
+void Parser::parse_arg(Call *call, Mode mode, unsigned num_decoded_args) {
     size_t index = (size_t)read_uint();
-    Value *value = parse_value(mode);
+    Value *value = parse_value(index < num_decoded_args ? mode : SCAN);
     if (value) {
         if (index >= call->args.size()) {
             call->args.resize(index + 1);
@@ -801,25 +982,25 @@ void Parser::scan_uint() {
 
 Value *Parser::parse_float() {
     float value;
-    file->read(&value, sizeof value);
+    read_bytes(&value, sizeof value);
     return new Float(value);
 }
 
 
 void Parser::scan_float() {
-    file->skip(sizeof(float));
+    skip_bytes(sizeof(float));
 }
 
 
 Value *Parser::parse_double() {
     double value;
-    file->read(&value, sizeof value);
+    read_bytes(&value, sizeof value);
     return new Double(value);
 }
 
 
 void Parser::scan_double() {
-    file->skip(sizeof(double));
+    skip_bytes(sizeof(double));
 }
 
 
@@ -895,7 +1076,7 @@ Value *Parser::parse_blob(void) {
     size_t size = read_uint();
     Blob *blob = new Blob(size);
     if (size) {
-        file->read(blob->buf, size);
+        read_bytes(blob->buf, size);
     }
     return blob;
 }
@@ -904,7 +1085,7 @@ Value *Parser::parse_blob(void) {
 void Parser::scan_blob(void) {
     size_t size = read_uint();
     if (size) {
-        file->skip(size);
+        skip_bytes(size);
     }
 }
 
@@ -980,7 +1161,7 @@ char * Parser::read_string(void) {
     size_t len = read_uint();
     char * value = new char[len + 1];
     if (len) {
-        file->read(value, len);
+        read_bytes(value, len);
     }
     value[len] = 0;
     if (TRACE_VERBOSE) {
@@ -992,7 +1173,7 @@ char * Parser::read_string(void) {
 
 void Parser::skip_string(void) {
     size_t len = read_uint();
-    file->skip(len);
+    skip_bytes(len);
 }
 
 
@@ -1028,7 +1209,7 @@ unsigned long long Parser::read_uint(void) {
     int c;
     unsigned shift = 0;
     do {
-        c = file->getc();
+        c = get_byte();
         if (c == -1) {
             break;
         }
@@ -1045,7 +1226,7 @@ unsigned long long Parser::read_uint(void) {
 void Parser::skip_uint(void) {
     int c;
     do {
-        c = file->getc();
+        c = get_byte();
         if (c == -1) {
             break;
         }
@@ -1054,7 +1235,7 @@ void Parser::skip_uint(void) {
 
 
 inline int Parser::read_byte(void) {
-    int c = file->getc();
+    int c = get_byte();
     if (TRACE_VERBOSE) {
         if (c < 0)
             std::cerr << "\tEOF" << "\n";
@@ -1066,7 +1247,53 @@ inline int Parser::read_byte(void) {
 
 
 inline void Parser::skip_byte(void) {
-    file->skip(1);
+    skip_bytes(1);
+}
+
+
+inline int Parser::get_byte(void) {
+    int c = file->getc();
+    if (rawSpan && c != -1) {
+        rawSpan->bytes.push_back(c);
+    }
+    return c;
+}
+
+
+inline size_t Parser::read_bytes(void *buffer, size_t length) {
+    size_t read = file->read(buffer, length);
+    if (rawSpan) {
+        const char *bytes = static_cast<const char *>(buffer);
+        rawSpan->bytes.insert(rawSpan->bytes.end(), bytes, bytes + read);
+    }
+    return read;
+}
+
+
+inline void Parser::skip_bytes(size_t length) {
+    if (rawSpan) {
+        std::vector<char> &bytes = rawSpan->bytes;
+        size_t size = bytes.size();
+        bytes.resize(size + length);
+        bytes.resize(size + file->read(bytes.data() + size, length));
+    } else {
+        file->skip(length);
+    }
+}
+
+
+RawCallRecord::SigRef *
+Parser::record_sig_ref(RawCallRecord::SigRef::Kind kind, size_t offset, bool defined) {
+    if (!rawSpan) {
+        return nullptr;
+    }
+    RawCallRecord::SigRef ref;
+    ref.kind = kind;
+    ref.offset = offset;
+    ref.length = rawSpan->bytes.size() - offset;
+    ref.defined = defined;
+    rawSpan->sigs.push_back(ref);
+    return &rawSpan->sigs.back();
 }
 
 
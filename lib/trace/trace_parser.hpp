@@ -26,6 +26,7 @@
 #pragma once
 
 
+#include <functional>
 #include <iostream>
 #include <list>
 
@@ -80,6 +81,7 @@ protected:
 
     struct FunctionSigFlags : public FunctionSig {
         CallFlags flags;
+        unsigned num_decoded_args;
     };
 
     // Helper template that extends a base signature structure, with additional
@@ -113,6 +115,12 @@ protected:
 
     FunctionSig *glGetErrorSig = nullptr;
 
+    std::function<unsigned (const FunctionSig *)> decodedArgsCallback;
+    std::function<bool (const Call *)> rawCallFilter;
+
+    bool recordRawCalls = false;
+    RawCallRecord::Span *rawSpan = nullptr;
+
     int next_event_type = -1;
     unsigned next_call_no = 0;
 
@@ -143,6 +151,14 @@ public:
 
     void setBookmark(const ParseBookmark &bookmark) override;
 
+    /**
+     * Copy the signatures seen so far by another parser of the same trace,
+     * so that this one can be positioned on any bookmark taken from it
+     * without parsing everything before it.  Meant to be called right
+     * after open().
+     */
+    void copySignatures(const Parser &other);
+
     unsigned long long getVersion(void) const override {
         return semanticVersion;
     }
@@ -176,6 +192,44 @@ public:
         return parse_call(SCAN);
     }
 
+    static constexpr unsigned ALL_ARGS = ~0U;
+
+    /**
+     * Set a callback that is invoked once for every function signature as
+     * it is read, and returns how many leading arguments of the calls to
+     * that function parse_call() must decode.  The remaining arguments and,
+     * unless ALL_ARGS is returned, the return value are skipped as in
+     * scan_call().  This allows consumers that only look at some calls to
+     * avoid decoding the bulk of the trace.
+     */
+    void setDecodedArgsCallback(std::function<unsigned (const FunctionSig *)> callback) {
+        decodedArgsCallback = callback;
+    }
+
+    /**
+     * Have parse_call() and scan_call() attach the encoded bytes of every
+     * call to Call::raw, so that Writer::writeRawCall() can copy them without
+     * the arguments being decoded.  Only traces of version 4 or newer, whose
+     * calls are encoded as the writer does, are recorded.
+     */
+    void setRecordRawCalls(bool enable) {
+        recordRawCalls = enable;
+    }
+
+    /**
+     * Only keep the encoded bytes of the calls accepted by the filter, which
+     * is invoked as soon as the call number, thread and signature are known,
+     * before any argument is read.  Rejected calls are still scanned, but
+     * their bytes aren't retained, and their Call::raw is left null.
+     */
+    void setRawCallFilter(std::function<bool (const Call *)> filter) {
+        rawCallFilter = filter;
+    }
+
+    bool recordsRawCalls(void) const {
+        return recordRawCalls && version >= 4;
+    }
+
 protected:
     Call *parse_call(Mode mode);
 
@@ -198,14 +252,14 @@ protected:
 
     Call *parse_leave(Mode mode);
 
-    bool parse_call_details(Call *call, Mode mode);
+    bool parse_call_details(Call *call, Event event, Mode mode);
 
     bool parse_call_backtrace(Call *call, Mode mode);
     StackFrame * parse_backtrace_frame(Mode mode);
 
     void adjust_call_flags(Call *call);
 
-    void parse_arg(Call *call, Mode mode);
+    void parse_arg(Call *call, Mode mode, unsigned num_decoded_args);
 
     Value *parse_value(void);
     void scan_value(void);
@@ -268,12 +322,25 @@ protected:
 
     inline int read_byte(void);
     inline void skip_byte(void);
+
+    inline int get_byte(void);
+    inline size_t read_bytes(void *buffer, size_t length);
+    inline void skip_bytes(size_t length);
+
+    inline size_t raw_offset(void) const {
+        return rawSpan ? rawSpan->bytes.size() : 0;
+    }
+
+    RawCallRecord::SigRef *record_sig_ref(RawCallRecord::SigRef::Kind kind, size_t offset, bool defined);
 };
 
 
 AbstractParser *
 lastFrameLoopParser(AbstractParser *parser, int loopCount);
 
+AbstractParser *
+preloadParser(AbstractParser *parser);
+
 
 } /* namespace trace */
 
@@ -0,0 +1,121 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <algorithm>
+
+#include "trace_parser.hpp"
+
+
+namespace trace {
+
+
+// Decorator for parser which decodes all calls upfront, so that replaying
+// them doesn't include the decompression and decoding costs
+class PreloadParser : public AbstractParser  {
+public:
+    PreloadParser(AbstractParser *p) {
+        parser = p;
+    }
+
+    ~PreloadParser() {
+        for (auto c : calls)
+            delete c;
+        calls.clear();
+        delete parser;
+    }
+
+    Call *parse_call(void) override;
+
+    void getBookmark(ParseBookmark &bookmark) override;
+    void setBookmark(const ParseBookmark &bookmark) override;
+    bool open(const char *filename) override;
+
+    // Delegate to Parser
+    void close(void) override { parser->close(); }
+    unsigned long long getVersion(void) const override { return parser->getVersion(); }
+    const Properties & getProperties(void) const override { return parser->getProperties(); }
+private:
+    AbstractParser *parser;
+    std::vector<Call *> calls;
+    size_t nextCall = 0;
+};
+
+
+bool
+PreloadParser::open(const char *filename)
+{
+    if (!parser->open(filename)) {
+        return false;
+    }
+
+    Call *call;
+    while ((call = parser->parse_call())) {
+        call->reuse_call = true;
+        calls.push_back(call);
+    }
+    nextCall = 0;
+
+    return true;
+}
+
+
+Call *
+PreloadParser::parse_call(void)
+{
+    if (nextCall < calls.size()) {
+        return calls[nextCall++];
+    }
+    return nullptr;
+}
+
+
+void
+PreloadParser::getBookmark(ParseBookmark &bookmark)
+{
+    bookmark.offset = 0;
+    bookmark.next_call_no = nextCall < calls.size() ? calls[nextCall]->no : ~0U;
+}
+
+
+void
+PreloadParser::setBookmark(const ParseBookmark &bookmark)
+{
+    auto it = std::lower_bound(calls.begin(), calls.end(), bookmark.next_call_no,
+        [](const Call *call, unsigned no) {
+            return call->no < no;
+        });
+    nextCall = it - calls.begin();
+}
+
+
+AbstractParser *
+preloadParser(AbstractParser *parser)
+{
+    return new PreloadParser(parser);
+}
+
+
+} /* namespace trace */
@@ -0,0 +1,958 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Replay plan format.
+ * -------------------
+ *
+ * header {
+ *     char[8]  "apiplan"
+ *     uint32   PLAN_VERSION
+ *     uint32   PLAN_BYTE_ORDER, to reject plans compiled on other machines
+ *     uint64   offset of the tables
+ * }
+ * call {
+ *     uint32   number
+ *     uint32   thread
+ *     uint32   function signature id
+ *     uint32   CallFlags
+ *     uint32   number of arguments
+ *     int64    timestamp, or -1
+ *     int64    duration, or -1
+ *     value    arguments
+ *     value    return value
+ * } ...
+ * tables {
+ *     uint64   trace version
+ *     uint32   API
+ *     uint32   count, then (string name, string value) properties
+ *     uint32   count, then (uint32 id, string name, uint32 count,
+ *              string arg_name...) function signatures
+ *     uint32   count, then (uint32 id, string name, uint32 count,
+ *              string member_name...) struct signatures
+ *     uint32   count, then (uint32 id, uint32 count, (string, int64)...)
+ *              enum signatures
+ *     uint32   count, then (uint32 id, uint32 count, (string, uint64)...)
+ *              bitmask signatures
+ * }
+ *
+ * Strings are a uint32 length followed by the characters and a NUL, so that
+ * they can be used in place.  Values are a uint8 tag followed by:
+ *
+ *     VALUE_NONE, VALUE_NULL, VALUE_FALSE, VALUE_TRUE  nothing
+ *     VALUE_SINT, VALUE_UINT, VALUE_POINTER            64 bit integer
+ *     VALUE_FLOAT, VALUE_DOUBLE                        float, double
+ *     VALUE_STRING                                     string
+ *     VALUE_WSTRING                                    uint32 length, uint32 characters
+ *     VALUE_ENUM, VALUE_BITMASK                        uint32 signature id, 64 bit integer
+ *     VALUE_STRUCT                                     uint32 signature id, member values
+ *     VALUE_ARRAY                                      uint32 length, values
+ *     VALUE_BLOB                                       uint64 size, padding to
+ *                                                      PLAN_BLOB_ALIGNMENT, bytes
+ *     VALUE_REPR                                       human value, machine value
+ *
+ * The signature tables follow the calls because the signatures are only
+ * all known once every call was written.
+ */
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <iostream>
+
+#include "trace_plan.hpp"
+
+
+#define PLAN_MAGIC "apiplan"
+#define PLAN_VERSION 1
+#define PLAN_BYTE_ORDER 0x01020304U
+#define PLAN_BLOB_ALIGNMENT 16
+
+
+namespace trace {
+
+
+enum {
+    VALUE_NONE = 0,
+    VALUE_NULL,
+    VALUE_FALSE,
+    VALUE_TRUE,
+    VALUE_SINT,
+    VALUE_UINT,
+    VALUE_FLOAT,
+    VALUE_DOUBLE,
+    VALUE_STRING,
+    VALUE_WSTRING,
+    VALUE_ENUM,
+    VALUE_BITMASK,
+    VALUE_STRUCT,
+    VALUE_ARRAY,
+    VALUE_BLOB,
+    VALUE_POINTER,
+    VALUE_REPR,
+};
+
+
+struct PlanHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t tablesOffset;
+};
+
+
+/*
+ * Copy-on-write mapping of a whole file, so that the replayer may scribble
+ * over blobs without touching the plan.
+ */
+class MappedFile
+{
+public:
+    char *data = nullptr;
+    size_t size = 0;
+
+    ~MappedFile() {
+        if (data) {
+#ifdef _WIN32
+            UnmapViewOfFile(data);
+#else
+            munmap(data, size);
+#endif
+        }
+    }
+
+    bool
+    open(const char *filename) {
+#ifdef _WIN32
+        HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize) ||
+            fileSize.QuadPart == 0 ||
+            uint64_t(fileSize.QuadPart) > SIZE_MAX) {
+            CloseHandle(hFile);
+            return false;
+        }
+        HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        CloseHandle(hFile);
+        if (!hMapping) {
+            return false;
+        }
+        // The view keeps the mapping alive
+        void *view = MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(hMapping);
+        if (!view) {
+            return false;
+        }
+        size = size_t(fileSize.QuadPart);
+#else
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 ||
+            st.st_size == 0 ||
+            uint64_t(st.st_size) > SIZE_MAX) {
+            ::close(fd);
+            return false;
+        }
+        void *view = mmap(NULL, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+        size = size_t(st.st_size);
+#endif
+        data = static_cast<char *>(view);
+        return true;
+    }
+};
+
+
+PlanParser::PlanParser() {
+}
+
+
+PlanParser::~PlanParser() {
+    close();
+}
+
+
+bool
+PlanParser::open(const char *filename) {
+    assert(!file);
+    file = new MappedFile;
+    if (!file->open(filename)) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        close();
+        return false;
+    }
+
+    PlanHeader header;
+    if (file->size < sizeof header) {
+        std::cerr << "error: " << filename << " is not a replay plan\n";
+        close();
+        return false;
+    }
+    memcpy(&header, file->data, sizeof header);
+    if (memcmp(header.magic, PLAN_MAGIC, sizeof header.magic) != 0) {
+        std::cerr << "error: " << filename << " is not a replay plan\n";
+        close();
+        return false;
+    }
+    if (header.version != PLAN_VERSION ||
+        header.byteOrder != PLAN_BYTE_ORDER) {
+        std::cerr << "error: " << filename << " was compiled by another apitrace version or machine\n";
+        close();
+        return false;
+    }
+    if (header.tablesOffset < sizeof header ||
+        header.tablesOffset > file->size) {
+        std::cerr << "error: " << filename << " is truncated\n";
+        close();
+        return false;
+    }
+
+    callsBegin = file->data + sizeof header;
+    callsEnd = file->data + header.tablesOffset;
+
+    if (!parseTables(callsEnd)) {
+        std::cerr << "error: " << filename << " has invalid signature tables\n";
+        close();
+        return false;
+    }
+
+    ptr = callsBegin;
+    end = callsEnd;
+
+    return true;
+}
+
+
+void
+PlanParser::close(void) {
+    // Signature names point into the file, so only the structures are ours
+    for (auto sig : functions) {
+        if (sig) {
+            delete [] sig->arg_names;
+            delete sig;
+        }
+    }
+    functions.clear();
+
+    for (auto sig : structs) {
+        if (sig) {
+            delete [] sig->member_names;
+            delete sig;
+        }
+    }
+    structs.clear();
+
+    for (auto sig : enums) {
+        if (sig) {
+            delete [] sig->values;
+            delete sig;
+        }
+    }
+    enums.clear();
+
+    for (auto sig : bitmasks) {
+        if (sig) {
+            delete [] sig->flags;
+            delete sig;
+        }
+    }
+    bitmasks.clear();
+
+    properties.clear();
+
+    delete file;
+    file = nullptr;
+
+    ptr = end = nullptr;
+    callsBegin = callsEnd = nullptr;
+    error = false;
+}
+
+
+template< class T >
+inline T
+PlanParser::read(void) {
+    T value = T();
+    if (size_t(end - ptr) < sizeof value) {
+        error = true;
+        ptr = end;
+        return value;
+    }
+    memcpy(&value, ptr, sizeof value);
+    ptr += sizeof value;
+    return value;
+}
+
+
+const char *
+PlanParser::read_string(uint32_t &length) {
+    length = read<uint32_t>();
+    if (error ||
+        size_t(end - ptr) <= length ||
+        ptr[length] != '\0') {
+        error = true;
+        ptr = end;
+        length = 0;
+        return "";
+    }
+    const char *s = ptr;
+    ptr += length + 1;
+    return s;
+}
+
+
+template< class T >
+static inline T *
+lookup(std::vector<T *> &sigs, Id id) {
+    return id < sigs.size() ? sigs[id] : nullptr;
+}
+
+
+template< class T >
+static inline bool
+insert(std::vector<T *> &sigs, T *sig) {
+    if (sig->id >= sigs.size()) {
+        sigs.resize(sig->id + 1);
+    } else if (sigs[sig->id]) {
+        return false;
+    }
+    sigs[sig->id] = sig;
+    return true;
+}
+
+
+bool
+PlanParser::parseTables(const char *tables) {
+    ptr = tables;
+    end = file->data + file->size;
+
+    uint32_t length;
+
+    version = read<uint64_t>();
+    api = static_cast<API>(read<uint32_t>());
+
+    uint32_t num_properties = read<uint32_t>();
+    for (uint32_t i = 0; i < num_properties && !error; ++i) {
+        const char *name = read_string(length);
+        const char *value = read_string(length);
+        properties[name] = value;
+    }
+
+    uint32_t num_functions = read<uint32_t>();
+    for (uint32_t i = 0; i < num_functions && !error; ++i) {
+        FunctionSig *sig = new FunctionSig;
+        sig->id = read<uint32_t>();
+        sig->name = read_string(length);
+        sig->num_args = read<uint32_t>();
+        if (sig->num_args > size_t(end - ptr)) {
+            error = true;
+            sig->num_args = 0;
+        }
+        const char **arg_names = new const char *[sig->num_args];
+        for (unsigned arg = 0; arg < sig->num_args; ++arg) {
+            arg_names[arg] = read_string(length);
+        }
+        sig->arg_names = arg_names;
+        if (!insert(functions, sig)) {
+            delete [] sig->arg_names;
+            delete sig;
+            error = true;
+        }
+    }
+
+    uint32_t num_structs = read<uint32_t>();
+    for (uint32_t i = 0; i < num_structs && !error; ++i) {
+        StructSig *sig = new StructSig;
+        sig->id = read<uint32_t>();
+        sig->name = read_string(length);
+        sig->num_members = read<uint32_t>();
+        if (sig->num_members > size_t(end - ptr)) {
+            error = true;
+            sig->num_members = 0;
+        }
+        const char **member_names = new const char *[sig->num_members];
+        for (unsigned member = 0; member < sig->num_members; ++member) {
+            member_names[member] = read_string(length);
+        }
+        sig->member_names = member_names;
+        if (!insert(structs, sig)) {
+            delete [] sig->member_names;
+            delete sig;
+            error = true;
+        }
+    }
+
+    uint32_t num_enums = read<uint32_t>();
+    for (uint32_t i = 0; i < num_enums && !error; ++i) {
+        EnumSig *sig = new EnumSig;
+        sig->id = read<uint32_t>();
+        sig->num_values = read<uint32_t>();
+        if (sig->num_values > size_t(end - ptr)) {
+            error = true;
+            sig->num_values = 0;
+        }
+        EnumValue *values = new EnumValue[sig->num_values];
+        for (unsigned value = 0; value < sig->num_values; ++value) {
+            values[value].name = read_string(length);
+            values[value].value = read<int64_t>();
+        }
+        sig->values = values;
+        if (!insert(enums, sig)) {
+            delete [] sig->values;
+            delete sig;
+            error = true;
+        }
+    }
+
+    uint32_t num_bitmasks = read<uint32_t>();
+    for (uint32_t i = 0; i < num_bitmasks && !error; ++i) {
+        BitmaskSig *sig = new BitmaskSig;
+        sig->id = read<uint32_t>();
+        sig->num_flags = read<uint32_t>();
+        if (sig->num_flags > size_t(end - ptr)) {
+            error = true;
+            sig->num_flags = 0;
+        }
+        BitmaskFlag *flags = new BitmaskFlag[sig->num_flags];
+        for (unsigned flag = 0; flag < sig->num_flags; ++flag) {
+            flags[flag].name = read_string(length);
+            flags[flag].value = read<uint64_t>();
+        }
+        sig->flags = flags;
+        if (!insert(bitmasks, sig)) {
+            delete [] sig->flags;
+            delete sig;
+            error = true;
+        }
+    }
+
+    return !error;
+}
+
+
+Call *
+PlanParser::parse_call(void) {
+    if (error || ptr >= end) {
+        return nullptr;
+    }
+
+    unsigned no = read<uint32_t>();
+    unsigned thread_id = read<uint32_t>();
+    FunctionSig *sig = lookup(functions, read<uint32_t>());
+    CallFlags flags = read<uint32_t>();
+    uint32_t num_args = read<uint32_t>();
+    long long timestamp = read<int64_t>();
+    long long duration = read<int64_t>();
+    if (error || !sig || num_args > size_t(end - ptr)) {
+        std::cerr << "error: invalid call in replay plan\n";
+        error = true;
+        return nullptr;
+    }
+
+    Call *call = new Call(sig, flags, thread_id);
+    call->no = no;
+    call->timestamp = timestamp;
+    call->duration = duration;
+    call->args.resize(num_args);
+    for (auto & arg : call->args) {
+        arg.value = parse_value();
+    }
+    call->ret = parse_value();
+
+    if (error) {
+        std::cerr << "error: invalid call " << no << " in replay plan\n";
+        delete call;
+        return nullptr;
+    }
+
+    return call;
+}
+
+
+Value *
+PlanParser::parse_value(void) {
+    uint32_t length;
+    uint8_t tag = read<uint8_t>();
+    switch (tag) {
+    case VALUE_NONE:
+        return nullptr;
+    case VALUE_NULL:
+        return new Null;
+    case VALUE_FALSE:
+        return new Bool(false);
+    case VALUE_TRUE:
+        return new Bool(true);
+    case VALUE_SINT:
+        return new SInt(read<int64_t>());
+    case VALUE_UINT:
+        return new UInt(read<uint64_t>());
+    case VALUE_FLOAT:
+        return new Float(read<float>());
+    case VALUE_DOUBLE:
+        return new Double(read<double>());
+    case VALUE_STRING:
+        {
+            const char *s = read_string(length);
+            char *value = new char[length + 1];
+            memcpy(value, s, length + 1);
+            return new String(value);
+        }
+    case VALUE_WSTRING:
+        {
+            length = read<uint32_t>();
+            if (length > size_t(end - ptr) / sizeof(uint32_t)) {
+                error = true;
+                return nullptr;
+            }
+            wchar_t *value = new wchar_t[length + 1];
+            for (uint32_t i = 0; i < length; ++i) {
+                value[i] = static_cast<wchar_t>(read<uint32_t>());
+            }
+            value[length] = 0;
+            return new WString(value);
+        }
+    case VALUE_ENUM:
+        {
+            EnumSig *sig = lookup(enums, read<uint32_t>());
+            signed long long value = read<int64_t>();
+            if (!sig) {
+                error = true;
+                return nullptr;
+            }
+            return new Enum(sig, value);
+        }
+    case VALUE_BITMASK:
+        {
+            BitmaskSig *sig = lookup(bitmasks, read<uint32_t>());
+            unsigned long long value = read<uint64_t>();
+            if (!sig) {
+                error = true;
+                return nullptr;
+            }
+            return new Bitmask(sig, value);
+        }
+    case VALUE_STRUCT:
+        {
+            StructSig *sig = lookup(structs, read<uint32_t>());
+            if (!sig) {
+                error = true;
+                return nullptr;
+            }
+            Struct *value = new Struct(sig);
+            for (auto & member : value->members) {
+                member = parse_value();
+            }
+            return value;
+        }
+    case VALUE_ARRAY:
+        {
+            length = read<uint32_t>();
+            if (length > size_t(end - ptr)) {
+                error = true;
+                return nullptr;
+            }
+            Array *value = new Array(length);
+            for (auto & element : value->values) {
+                element = parse_value();
+            }
+            return value;
+        }
+    case VALUE_BLOB:
+        {
+            uint64_t size = read<uint64_t>();
+            size_t padding = -size_t(ptr - file->data) & (PLAN_BLOB_ALIGNMENT - 1);
+            if (error ||
+                padding > size_t(end - ptr) ||
+                size > size_t(end - ptr) - padding) {
+                error = true;
+                return nullptr;
+            }
+            ptr += padding;
+            Blob *value = new Blob(size_t(size), const_cast<char *>(ptr));
+            ptr += size;
+            return value;
+        }
+    case VALUE_POINTER:
+        return new Pointer(read<uint64_t>());
+    case VALUE_REPR:
+        {
+            Value *human = parse_value();
+            Value *machine = parse_value();
+            return new Repr(human, machine);
+        }
+    default:
+        error = true;
+        return nullptr;
+    }
+}
+
+
+void
+PlanParser::getBookmark(ParseBookmark &bookmark) {
+    bookmark.offset = File::Offset(ptr - callsBegin, 0);
+    bookmark.next_call_no = ~0U;
+    if (size_t(end - ptr) >= sizeof(uint32_t)) {
+        uint32_t no;
+        memcpy(&no, ptr, sizeof no);
+        bookmark.next_call_no = no;
+    }
+}
+
+
+void
+PlanParser::setBookmark(const ParseBookmark &bookmark) {
+    assert(bookmark.offset.chunk <= size_t(callsEnd - callsBegin));
+    ptr = callsBegin + bookmark.offset.chunk;
+    end = callsEnd;
+    error = false;
+}
+
+
+bool
+isPlan(const char *filename) {
+    char magic[sizeof PlanHeader::magic];
+    FILE *stream = fopen(filename, "rb");
+    if (!stream) {
+        return false;
+    }
+    bool result = fread(magic, sizeof magic, 1, stream) == 1 &&
+                  memcmp(magic, PLAN_MAGIC, sizeof magic) == 0;
+    fclose(stream);
+    return result;
+}
+
+
+class PlanWriter : public Visitor
+{
+protected:
+    FILE *stream;
+
+    // Signatures used by the written calls, indexed by id
+    std::vector<const FunctionSig *> functions;
+    std::vector<const StructSig *> structs;
+    std::vector<const EnumSig *> enums;
+    std::vector<const BitmaskSig *> bitmasks;
+
+public:
+    uint64_t offset = 0;
+
+    PlanWriter(FILE *_stream) :
+        stream(_stream) {
+    }
+
+    inline void
+    write(const void *data, size_t size) {
+        fwrite(data, 1, size, stream);
+        offset += size;
+    }
+
+    template< class T >
+    inline void
+    write(T value) {
+        write(&value, sizeof value);
+    }
+
+    inline void
+    writeTag(uint8_t tag) {
+        write(tag);
+    }
+
+    void
+    writeString(const char *s) {
+        if (!s) {
+            s = "";
+        }
+        uint32_t length = strlen(s);
+        write(length);
+        write(s, length + 1);
+    }
+
+    template< class T >
+    inline void
+    use(std::vector<const T *> &sigs, const T *sig) {
+        if (sig->id >= sigs.size()) {
+            sigs.resize(sig->id + 1);
+        }
+        assert(!sigs[sig->id] || sigs[sig->id] == sig);
+        sigs[sig->id] = sig;
+    }
+
+    void
+    writeHeader(uint64_t tablesOffset) {
+        PlanHeader header;
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, PLAN_MAGIC, sizeof header.magic);
+        header.version = PLAN_VERSION;
+        header.byteOrder = PLAN_BYTE_ORDER;
+        header.tablesOffset = tablesOffset;
+        write(&header, sizeof header);
+    }
+
+    void
+    writeValue(Value *value) {
+        if (value) {
+            _visit(value);
+        } else {
+            writeTag(VALUE_NONE);
+        }
+    }
+
+    void visit(Null *) override {
+        writeTag(VALUE_NULL);
+    }
+
+    void visit(Bool *node) override {
+        writeTag(node->value ? VALUE_TRUE : VALUE_FALSE);
+    }
+
+    void visit(SInt *node) override {
+        writeTag(VALUE_SINT);
+        write<int64_t>(node->value);
+    }
+
+    void visit(UInt *node) override {
+        writeTag(VALUE_UINT);
+        write<uint64_t>(node->value);
+    }
+
+    void visit(Float *node) override {
+        writeTag(VALUE_FLOAT);
+        write<float>(node->value);
+    }
+
+    void visit(Double *node) override {
+        writeTag(VALUE_DOUBLE);
+        write<double>(node->value);
+    }
+
+    void visit(String *node) override {
+        writeTag(VALUE_STRING);
+        writeString(node->value);
+    }
+
+    void visit(WString *node) override {
+        writeTag(VALUE_WSTRING);
+        uint32_t length = node->value ? wcslen(node->value) : 0;
+        write(length);
+        for (uint32_t i = 0; i < length; ++i) {
+            write<uint32_t>(node->value[i]);
+        }
+    }
+
+    void visit(Enum *node) override {
+        use(enums, node->sig);
+        writeTag(VALUE_ENUM);
+        write<uint32_t>(node->sig->id);
+        write<int64_t>(node->value);
+    }
+
+    void visit(Bitmask *node) override {
+        use(bitmasks, node->sig);
+        writeTag(VALUE_BITMASK);
+        write<uint32_t>(node->sig->id);
+        write<uint64_t>(node->value);
+    }
+
+    void visit(Struct *node) override {
+        use(structs, node->sig);
+        writeTag(VALUE_STRUCT);
+        write<uint32_t>(node->sig->id);
+        for (unsigned i = 0; i < node->sig->num_members; ++i) {
+            writeValue(node->members[i]);
+        }
+    }
+
+    void visit(Array *node) override {
+        writeTag(VALUE_ARRAY);
+        write<uint32_t>(node->values.size());
+        for (auto & value : node->values) {
+            writeValue(value);
+        }
+    }
+
+    void visit(Blob *node) override {
+        static const char zeros[PLAN_BLOB_ALIGNMENT] = {0};
+        writeTag(VALUE_BLOB);
+        write<uint64_t>(node->size);
+        write(zeros, -offset & (PLAN_BLOB_ALIGNMENT - 1));
+        write(node->buf, node->size);
+    }
+
+    void visit(Pointer *node) override {
+        writeTag(VALUE_POINTER);
+        write<uint64_t>(node->value);
+    }
+
+    void visit(Repr *node) override {
+        writeTag(VALUE_REPR);
+        writeValue(node->humanValue);
+        writeValue(node->machineValue);
+    }
+
+    void visit(Call *call) {
+        use(functions, call->sig);
+        write<uint32_t>(call->no);
+        write<uint32_t>(call->thread_id);
+        write<uint32_t>(call->sig->id);
+        write<uint32_t>(call->flags);
+        write<uint32_t>(call->args.size());
+        write<int64_t>(call->timestamp);
+        write<int64_t>(call->duration);
+        for (auto & arg : call->args) {
+            writeValue(arg.value);
+        }
+        writeValue(call->ret);
+    }
+
+    template< class T >
+    static uint32_t
+    count(const std::vector<const T *> &sigs) {
+        uint32_t n = 0;
+        for (auto sig : sigs) {
+            if (sig) {
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    void
+    writeTables(unsigned long long version, API api, const Properties &properties) {
+        write<uint64_t>(version);
+        write<uint32_t>(api);
+
+        write<uint32_t>(properties.size());
+        for (auto & property : properties) {
+            writeString(property.first.c_str());
+            writeString(property.second.c_str());
+        }
+
+        write(count(functions));
+        for (auto sig : functions) {
+            if (sig) {
+                write<uint32_t>(sig->id);
+                writeString(sig->name);
+                write<uint32_t>(sig->num_args);
+                for (unsigned arg = 0; arg < sig->num_args; ++arg) {
+                    writeString(sig->arg_names[arg]);
+                }
+            }
+        }
+
+        write(count(structs));
+        for (auto sig : structs) {
+            if (sig) {
+                write<uint32_t>(sig->id);
+                writeString(sig->name);
+                write<uint32_t>(sig->num_members);
+                for (unsigned member = 0; member < sig->num_members; ++member) {
+                    writeString(sig->member_names[member]);
+                }
+            }
+        }
+
+        write(count(enums));
+        for (auto sig : enums) {
+            if (sig) {
+                write<uint32_t>(sig->id);
+                write<uint32_t>(sig->num_values);
+                for (unsigned value = 0; value < sig->num_values; ++value) {
+                    writeString(sig->values[value].name);
+                    write<int64_t>(sig->values[value].value);
+                }
+            }
+        }
+
+        write(count(bitmasks));
+        for (auto sig : bitmasks) {
+            if (sig) {
+                write<uint32_t>(sig->id);
+                write<uint32_t>(sig->num_flags);
+                for (unsigned flag = 0; flag < sig->num_flags; ++flag) {
+                    writeString(sig->flags[flag].name);
+                    write<uint64_t>(sig->flags[flag].value);
+                }
+            }
+        }
+    }
+};
+
+
+bool
+compilePlan(Parser &parser, const char *filename) {
+    FILE *stream = fopen(filename, "wb");
+    if (!stream) {
+        std::cerr << "error: could not open " << filename << " for writing\n";
+        return false;
+    }
+
+    PlanWriter writer(stream);
+    writer.writeHeader(0);
+
+    Call *call;
+    while ((call = parser.parse_call())) {
+        writer.visit(call);
+        delete call;
+    }
+
+    // The API is only known once calls were parsed
+    uint64_t tablesOffset = writer.offset;
+    writer.writeTables(parser.getVersion(), parser.api, parser.getProperties());
+
+    fseek(stream, 0, SEEK_SET);
+    writer.writeHeader(tablesOffset);
+
+    bool ok = !ferror(stream);
+    ok = fclose(stream) == 0 && ok;
+    if (!ok) {
+        std::cerr << "error: failed to write " << filename << "\n";
+    }
+    return ok;
+}
+
+
+} /* namespace trace */
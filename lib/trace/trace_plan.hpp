@@ -0,0 +1,127 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Replay plans.
+ *
+ * A replay plan is a trace compiled for replaying it many times on the
+ * machine that compiled it.  Calls are stored uncompressed with fixed-width
+ * fields in native byte order, signatures are referred to by id, and blobs
+ * are aligned so that they can be handed to the driver straight from the
+ * mapped file.  Backtraces are not kept.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "trace_api.hpp"
+#include "trace_parser.hpp"
+
+
+namespace trace {
+
+
+class MappedFile;
+
+
+class PlanParser : public AbstractParser
+{
+protected:
+    MappedFile *file = nullptr;
+
+    // Current position, and end of the section being parsed
+    const char *ptr = nullptr;
+    const char *end = nullptr;
+
+    const char *callsBegin = nullptr;
+    const char *callsEnd = nullptr;
+
+    bool error = false;
+
+    Properties properties;
+
+    // Signatures indexed by id.  Their names point into the mapped file.
+    std::vector<FunctionSig *> functions;
+    std::vector<StructSig *> structs;
+    std::vector<EnumSig *> enums;
+    std::vector<BitmaskSig *> bitmasks;
+
+    unsigned long long version = 0;
+
+public:
+    API api = API_UNKNOWN;
+
+    PlanParser();
+
+    ~PlanParser();
+
+    bool open(const char *filename) override;
+
+    void close(void) override;
+
+    Call *parse_call(void) override;
+
+    void getBookmark(ParseBookmark &bookmark) override;
+
+    void setBookmark(const ParseBookmark &bookmark) override;
+
+    unsigned long long getVersion(void) const override {
+        return version;
+    }
+
+    const Properties & getProperties(void) const override {
+        return properties;
+    }
+
+protected:
+    bool parseTables(const char *tables);
+
+    Value *parse_value(void);
+
+    template< class T >
+    inline T read(void);
+
+    const char *read_string(uint32_t &length);
+};
+
+
+/**
+ * Whether the file starts like a replay plan.
+ */
+bool
+isPlan(const char *filename);
+
+/**
+ * Compile all the calls of an opened trace into a replay plan.
+ */
+bool
+compilePlan(Parser &parser, const char *filename);
+
+
+} /* namespace trace */
@@ -0,0 +1,294 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "os_process.hpp"
+#include "trace_dump.hpp"
+#include "trace_format.hpp"
+#include "trace_parser.hpp"
+#include "trace_plan.hpp"
+#include "trace_writer.hpp"
+
+
+using namespace trace;
+
+
+static const char *glXMakeCurrent_args[] = {"dpy", "drawable", "ctx"};
+static const FunctionSig glXMakeCurrent_sig = {0, "glXMakeCurrent", 3, glXMakeCurrent_args};
+static const char *glBufferData_args[] = {"target", "size", "data", "usage"};
+static const FunctionSig glBufferData_sig = {1, "glBufferData", 4, glBufferData_args};
+static const char *glClear_args[] = {"mask"};
+static const FunctionSig glClear_sig = {2, "glClear", 1, glClear_args};
+static const char *glMisc_args[] = {"str", "wstr", "rect", "values", "repr"};
+static const FunctionSig glMisc_sig = {3, "glMisc", 5, glMisc_args};
+
+static const EnumValue GLenum_values[] = {
+    {"GL_ARRAY_BUFFER", 0x8892},
+    {"GL_STATIC_DRAW", 0x88E4},
+};
+static const EnumSig GLenum_sig = {0, 2, GLenum_values};
+
+static const BitmaskFlag GLbitfield_flags[] = {
+    {"GL_DEPTH_BUFFER_BIT", 0x100},
+    {"GL_COLOR_BUFFER_BIT", 0x4000},
+};
+static const BitmaskSig GLbitfield_sig = {0, 2, GLbitfield_flags};
+
+static const char *RECT_members[] = {"left", "top"};
+static const StructSig RECT_sig = {0, "RECT", 2, RECT_members};
+
+
+class PlanTest : public ::testing::Test
+{
+protected:
+    std::string source = ::testing::TempDir() + "apitrace-plan-" +
+                         std::to_string(os::getCurrentProcessId()) + ".trace";
+    std::string plan = ::testing::TempDir() + "apitrace-plan-" +
+                       std::to_string(os::getCurrentProcessId()) + ".plan";
+
+    void SetUp() override {
+        Properties properties;
+        properties["process.name"] = "test";
+
+        Writer writer;
+        ASSERT_TRUE(writer.open(source.c_str(), TRACE_VERSION, properties));
+
+        unsigned call_no = writer.beginEnter(&glXMakeCurrent_sig, 0);
+        writer.writeFlags(0);
+        writer.beginArg(0);
+        writer.writePointer(0x1234);
+        writer.endArg();
+        // The drawable argument is missing
+        writer.beginArg(2);
+        writer.writeNull();
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(call_no);
+        writer.beginReturn();
+        writer.writeBool(true);
+        writer.endReturn();
+        writer.endLeave();
+
+        // Blobs of odd sizes, to check they are aligned all the same
+        for (unsigned size : {3u, 4096u}) {
+            std::vector<char> data(size);
+            for (unsigned i = 0; i < size; ++i) {
+                data[i] = char(i * 7 + size);
+            }
+            call_no = writer.beginEnter(&glBufferData_sig, 1);
+            writer.writeFlags(0);
+            writer.writeTimestamp(1000 + size);
+            writer.beginArg(0);
+            writer.writeEnum(&GLenum_sig, 0x8892);
+            writer.endArg();
+            writer.beginArg(1);
+            writer.writeSInt(-int(size));
+            writer.endArg();
+            writer.beginArg(2);
+            writer.writeBlob(data.data(), size);
+            writer.endArg();
+            writer.beginArg(3);
+            writer.writeEnum(&GLenum_sig, 0x88E4);
+            writer.endArg();
+            writer.endEnter();
+            writer.beginLeave(call_no);
+            writer.writeTimestamp(42);
+            writer.endLeave();
+        }
+
+        call_no = writer.beginEnter(&glClear_sig, 0);
+        writer.writeFlags(0);
+        writer.beginArg(0);
+        writer.writeBitmask(&GLbitfield_sig, 0x4100);
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(call_no);
+        writer.endLeave();
+
+        call_no = writer.beginEnter(&glMisc_sig, 0);
+        writer.writeFlags(FLAG_FAKE);
+        writer.beginArg(0);
+        writer.writeString("hello");
+        writer.endArg();
+        writer.beginArg(1);
+        writer.writeWString(L"w\u00e9rld");
+        writer.endArg();
+        writer.beginArg(2);
+        writer.beginStruct(&RECT_sig);
+        writer.writeUInt(1);
+        writer.writeSInt(-2);
+        writer.endStruct();
+        writer.endArg();
+        writer.beginArg(3);
+        writer.beginArray(3);
+        writer.writeFloat(0.5f);
+        writer.writeDouble(-1.25);
+        writer.writeBool(false);
+        writer.endArray();
+        writer.endArg();
+        writer.beginArg(4);
+        writer.beginRepr();
+        writer.writeString("GL_ONE");
+        writer.writeUInt(1);
+        writer.endRepr();
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(call_no);
+        writer.beginReturn();
+        writer.writeDouble(3.5);
+        writer.endReturn();
+        writer.endLeave();
+
+        writer.close();
+
+        Parser parser;
+        ASSERT_TRUE(parser.open(source.c_str()));
+        ASSERT_TRUE(compilePlan(parser, plan.c_str()));
+    }
+
+    void TearDown() override {
+        remove(source.c_str());
+        remove(plan.c_str());
+    }
+
+    static std::string
+    dump(Call *call) {
+        std::ostringstream os;
+        trace::dump(*call, os, DUMP_FLAG_NO_COLOR | DUMP_FLAG_THREAD_IDS | DUMP_FLAG_TIMESTAMPS);
+        os << call->flags;
+        return os.str();
+    }
+};
+
+
+TEST_F(PlanTest, calls)
+{
+    EXPECT_TRUE(isPlan(plan.c_str()));
+    EXPECT_FALSE(isPlan(source.c_str()));
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(source.c_str()));
+    PlanParser planParser;
+    ASSERT_TRUE(planParser.open(plan.c_str()));
+
+    EXPECT_EQ(planParser.getVersion(), parser.getVersion());
+    EXPECT_EQ(planParser.getProperties(), parser.getProperties());
+
+    unsigned count = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        Call *planCall = planParser.parse_call();
+        ASSERT_NE(planCall, nullptr);
+
+        EXPECT_EQ(dump(planCall), dump(call));
+        EXPECT_EQ(planCall->sig->id, call->sig->id);
+        EXPECT_EQ(planCall->args.size(), call->args.size());
+        EXPECT_EQ(planCall->duration, call->duration);
+
+        for (unsigned i = 0; i < call->args.size(); ++i) {
+            if (!call->args[i].value) {
+                EXPECT_TRUE(planCall->args[i].value == nullptr);
+                continue;
+            }
+            Blob *blob = call->args[i].value->toBlob();
+            if (blob) {
+                Blob *planBlob = planCall->args[i].value->toBlob();
+                ASSERT_TRUE(planBlob);
+                ASSERT_EQ(planBlob->size, blob->size);
+                EXPECT_EQ(memcmp(planBlob->buf, blob->buf, blob->size), 0);
+                EXPECT_EQ(uintptr_t(planBlob->buf) % 16, 0u);
+            }
+        }
+
+        delete planCall;
+        delete call;
+        ++count;
+    }
+    EXPECT_EQ(count, 5u);
+    EXPECT_EQ(planParser.parse_call(), nullptr);
+    EXPECT_EQ(planParser.api, API_GL);
+}
+
+
+TEST_F(PlanTest, bookmark)
+{
+    PlanParser parser;
+    ASSERT_TRUE(parser.open(plan.c_str()));
+
+    delete parser.parse_call();
+
+    ParseBookmark bookmark;
+    parser.getBookmark(bookmark);
+    EXPECT_EQ(bookmark.next_call_no, 1u);
+
+    std::vector<std::string> calls;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        calls.push_back(dump(call));
+        delete call;
+    }
+    EXPECT_EQ(calls.size(), 4u);
+
+    parser.setBookmark(bookmark);
+    for (auto & expected : calls) {
+        call = parser.parse_call();
+        ASSERT_NE(call, nullptr);
+        EXPECT_EQ(dump(call), expected);
+        delete call;
+    }
+    EXPECT_EQ(parser.parse_call(), nullptr);
+}
+
+
+TEST_F(PlanTest, truncated)
+{
+    std::vector<char> data;
+    FILE *fp = fopen(plan.c_str(), "rb");
+    ASSERT_NE(fp, nullptr);
+    int c;
+    while ((c = fgetc(fp)) != EOF) {
+        data.push_back(char(c));
+    }
+    fclose(fp);
+
+    // Cutting into the tables is noticed when opening
+    fp = fopen(plan.c_str(), "wb");
+    ASSERT_NE(fp, nullptr);
+    fwrite(data.data(), 1, data.size() - 1, fp);
+    fclose(fp);
+
+    PlanParser parser;
+    EXPECT_FALSE(parser.open(plan.c_str()));
+}
@@ -0,0 +1,218 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "trace_policy.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "os.hpp"
+#include "os_backtrace.hpp"
+#include "trace_option.hpp"
+
+
+namespace trace {
+
+
+static bool
+matchPattern(const std::string &pattern, const char *name)
+{
+    size_t length = pattern.length();
+    if (length && pattern[length - 1] == '*') {
+        return strncmp(pattern.c_str(), name, length - 1) == 0;
+    }
+    return pattern == name;
+}
+
+
+bool
+CapturePolicy::parse(const char *text)
+{
+    static const struct {
+        const char *name;
+        Directive directive;
+        bool hasValue;
+    } directives[] = {
+        { "backtrace",   DIRECTIVE_BACKTRACE,   false },
+        { "nobacktrace", DIRECTIVE_NOBACKTRACE, false },
+        { "exclude",     DIRECTIVE_EXCLUDE,     false },
+        { "include",     DIRECTIVE_INCLUDE,     false },
+        { "sample",      DIRECTIVE_SAMPLE,      true },
+        { "blobcap",     DIRECTIVE_BLOBCAP,     true },
+    };
+
+    std::string statements(text);
+    for (char &c : statements) {
+        if (c == ';') {
+            c = '\n';
+        }
+    }
+
+    std::istringstream lines(statements);
+    std::string line;
+    unsigned lineNo = 0;
+    while (std::getline(lines, line)) {
+        ++lineNo;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.resize(comment);
+        }
+
+        std::istringstream tokens(line);
+        std::string name;
+        if (!(tokens >> name)) {
+            continue;
+        }
+
+        Rule rule;
+        bool found = false;
+        for (auto & directive : directives) {
+            if (name == directive.name) {
+                rule.directive = directive.directive;
+                rule.value = 0;
+                if (directive.hasValue) {
+                    std::string value;
+                    if (!(tokens >> value) ||
+                        !sizeOption(value.c_str(), rule.value)) {
+                        os::log("apitrace: error: policy: %u: invalid %s value\n", lineNo, directive.name);
+                        return false;
+                    }
+                }
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            os::log("apitrace: error: policy: %u: unknown directive %s\n", lineNo, name.c_str());
+            return false;
+        }
+
+        unsigned numPatterns = 0;
+        while (tokens >> rule.pattern) {
+            rules.push_back(rule);
+            ++numPatterns;
+        }
+        if (!numPatterns) {
+            os::log("apitrace: error: policy: %u: no function names given\n", lineNo);
+            return false;
+        }
+    }
+
+    // Rules may have changed what was resolved
+    table.clear();
+
+    return true;
+}
+
+
+bool
+CapturePolicy::load(void)
+{
+    useDefaultBacktraces = true;
+
+    const char *policy = getenv("TRACE_POLICY");
+    if (!policy) {
+        return true;
+    }
+
+    std::ifstream file(policy);
+    if (file) {
+        std::stringstream contents;
+        contents << file.rdbuf();
+        os::log("apitrace: capture policy from %s\n", policy);
+        return parse(contents.str().c_str());
+    }
+
+    return parse(policy);
+}
+
+
+bool
+CapturePolicy::mayDiscard(void) const
+{
+    for (auto & rule : rules) {
+        if (rule.directive == DIRECTIVE_EXCLUDE ||
+            (rule.directive == DIRECTIVE_SAMPLE && rule.value > 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+CapturePolicy::Entry &
+CapturePolicy::resolve(const FunctionSig *sig)
+{
+    if (sig->id >= table.size()) {
+        table.resize(sig->id + 1);
+    }
+
+    Entry &entry = table[sig->id];
+    entry = Entry();
+    entry.flags = POLICY_RESOLVED;
+
+    if (useDefaultBacktraces && os::backtrace_is_needed(sig->name)) {
+        entry.flags |= POLICY_BACKTRACE;
+    }
+
+    for (auto & rule : rules) {
+        if (!matchPattern(rule.pattern, sig->name)) {
+            continue;
+        }
+        switch (rule.directive) {
+        case DIRECTIVE_BACKTRACE:
+            entry.flags |= POLICY_BACKTRACE;
+            break;
+        case DIRECTIVE_NOBACKTRACE:
+            entry.flags &= ~POLICY_BACKTRACE;
+            break;
+        case DIRECTIVE_EXCLUDE:
+            entry.flags |= POLICY_EXCLUDE;
+            break;
+        case DIRECTIVE_INCLUDE:
+            entry.flags &= ~POLICY_EXCLUDE;
+            entry.sampleRate = 1;
+            break;
+        case DIRECTIVE_SAMPLE:
+            entry.flags &= ~POLICY_EXCLUDE;
+            entry.sampleRate = rule.value > 1 ? rule.value : 1;
+            break;
+        case DIRECTIVE_BLOBCAP:
+            entry.maxBlobSize = rule.value;
+            break;
+        }
+    }
+
+    return entry;
+}
+
+
+} /* namespace trace */
@@ -0,0 +1,150 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Per-function capture policy, see TRACE_POLICY.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "trace_model.hpp"
+
+
+namespace trace {
+
+
+enum {
+    POLICY_RESOLVED  = 1 << 0,
+    POLICY_BACKTRACE = 1 << 1,
+    POLICY_EXCLUDE   = 1 << 2,
+};
+
+
+/**
+ * Capture policy, made of rules matching function names, which are resolved
+ * once per FunctionSig::id into a dense table.
+ *
+ * Rules are one per line (or separated by semicolons), each a directive
+ * followed by one or more function names, where a trailing `*` matches any
+ * suffix.  Later rules override earlier ones.  The directives are:
+ *
+ *   backtrace              capture a backtrace on every call
+ *   nobacktrace            don't capture backtraces
+ *   exclude                don't record calls
+ *   include                record calls
+ *   sample <N>             record only one every N calls
+ *   blobcap <BYTES>        truncate blob arguments to the given size
+ *
+ * Sizes may have a K, M or G suffix.
+ */
+class CapturePolicy
+{
+public:
+    struct Entry {
+        uint8_t flags = 0;
+        unsigned sampleRate = 1;
+        unsigned sampleCount = 0;
+        size_t maxBlobSize = SIZE_MAX;
+
+        /**
+         * Whether the next call should be recorded.
+         */
+        inline bool
+        sample(void) {
+            if (flags & POLICY_EXCLUDE) {
+                return false;
+            }
+            if (sampleRate > 1) {
+                return sampleCount++ % sampleRate == 0;
+            }
+            return true;
+        }
+    };
+
+private:
+    enum Directive {
+        DIRECTIVE_BACKTRACE,
+        DIRECTIVE_NOBACKTRACE,
+        DIRECTIVE_EXCLUDE,
+        DIRECTIVE_INCLUDE,
+        DIRECTIVE_SAMPLE,
+        DIRECTIVE_BLOBCAP,
+    };
+
+    struct Rule {
+        Directive directive;
+        unsigned long long value;
+        std::string pattern;
+    };
+
+    std::vector<Rule> rules;
+    std::vector<Entry> table;
+
+    bool useDefaultBacktraces = false;
+
+    Entry &
+    resolve(const FunctionSig *sig);
+
+public:
+    /**
+     * Parse the given rules, adding them to the existing ones.  Returns false
+     * on syntax errors, which are logged.
+     */
+    bool
+    parse(const char *text);
+
+    /**
+     * Load the rules from the TRACE_POLICY environment variable, which holds
+     * either the name of a file or the rules themselves, and honour
+     * APITRACE_BACKTRACE.
+     */
+    bool
+    load(void);
+
+    /**
+     * Whether any rule may cause calls not to be recorded.
+     */
+    bool
+    mayDiscard(void) const;
+
+    inline Entry &
+    lookup(const FunctionSig *sig) {
+        if (sig->id < table.size() &&
+            table[sig->id].flags & POLICY_RESOLVED) {
+            return table[sig->id];
+        }
+        return resolve(sig);
+    }
+};
+
+
+} /* namespace trace */
@@ -0,0 +1,99 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "gtest/gtest.h"
+
+#include "trace_policy.hpp"
+
+
+using namespace trace;
+
+
+static const FunctionSig glDrawArrays_sig = {4, "glDrawArrays", 0, NULL};
+static const FunctionSig glGetError_sig = {5, "glGetError", 0, NULL};
+static const FunctionSig glGetIntegerv_sig = {6, "glGetIntegerv", 0, NULL};
+static const FunctionSig glBufferData_sig = {9, "glBufferData", 0, NULL};
+
+
+TEST(trace_policy, defaults)
+{
+    CapturePolicy policy;
+    EXPECT_TRUE(policy.parse(""));
+
+    CapturePolicy::Entry &entry = policy.lookup(&glDrawArrays_sig);
+    EXPECT_EQ(entry.flags, POLICY_RESOLVED);
+    EXPECT_EQ(entry.maxBlobSize, SIZE_MAX);
+    EXPECT_TRUE(entry.sample());
+}
+
+
+TEST(trace_policy, rules)
+{
+    CapturePolicy policy;
+    EXPECT_TRUE(policy.parse(
+        "# comment\n"
+        "backtrace glDraw*\n"
+        "exclude glGet*; include glGetError\n"
+        "blobcap 4K glBufferData\n"
+    ));
+
+    EXPECT_TRUE(policy.lookup(&glDrawArrays_sig).flags & POLICY_BACKTRACE);
+    EXPECT_FALSE(policy.lookup(&glGetError_sig).flags & POLICY_BACKTRACE);
+
+    EXPECT_FALSE(policy.lookup(&glGetIntegerv_sig).sample());
+    EXPECT_TRUE(policy.lookup(&glGetError_sig).sample());
+
+    EXPECT_EQ(policy.lookup(&glBufferData_sig).maxBlobSize, 4096);
+    EXPECT_EQ(policy.lookup(&glGetError_sig).maxBlobSize, SIZE_MAX);
+
+    // Resolved once, then served from the table
+    EXPECT_EQ(&policy.lookup(&glBufferData_sig), &policy.lookup(&glBufferData_sig));
+}
+
+
+TEST(trace_policy, sample)
+{
+    CapturePolicy policy;
+    EXPECT_TRUE(policy.parse("sample 3 glGetError"));
+
+    CapturePolicy::Entry &entry = policy.lookup(&glGetError_sig);
+    unsigned recorded = 0;
+    for (unsigned i = 0; i < 9; ++i) {
+        recorded += entry.sample();
+    }
+    EXPECT_EQ(recorded, 3);
+}
+
+
+TEST(trace_policy, errors)
+{
+    CapturePolicy policy;
+    EXPECT_FALSE(policy.parse("frobnicate glGetError"));
+    EXPECT_FALSE(policy.parse("exclude"));
+    EXPECT_FALSE(policy.parse("sample glGetError"));
+    EXPECT_FALSE(policy.parse("blobcap 1X glBufferData"));
+}
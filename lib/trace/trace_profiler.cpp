@@ -56,7 +56,7 @@ void Profiler::setup(bool cpuTimes_, bool gpuTimes_, bool pixelsDrawn_, bool mem
     memoryUsage = memoryUsage_;
     minCpuTime = minCpuTime_;
 
-    std::cout << "# call no gpu_start gpu_dura cpu_start cpu_dura vsize_start vsize_dura rss_start rss_dura pixels program name" << std::endl;
+    std::cout << "# call no gpu_start gpu_dura cpu_start cpu_dura vsize_start vsize_dura rss_start rss_dura pixels program name orig_start orig_dura" << std::endl;
 }
 
 int64_t Profiler::getBaseCpuTime()
@@ -111,7 +111,8 @@ void Profiler::addCall(unsigned no,
                        int64_t gpuStart, int64_t gpuDuration,
                        int64_t cpuStart, int64_t cpuDuration,
                        int64_t vsizeStart, int64_t vsizeDuration,
-                       int64_t rssStart, int64_t rssDuration)
+                       int64_t rssStart, int64_t rssDuration,
+                       int64_t origStart, int64_t origDuration)
 {
     if (gpuTimes && gpuStart) {
         gpuStart -= baseGpuTime;
@@ -141,6 +142,13 @@ void Profiler::addCall(unsigned no,
         rssDuration = 0;
     }
 
+    if (origStart < 0) {
+        origStart = 0;
+        origDuration = 0;
+    } else if (origDuration < 0) {
+        origDuration = 0;
+    }
+
     std::cout << "call"
               << " " << no
               << " " << gpuStart
@@ -154,6 +162,8 @@ void Profiler::addCall(unsigned no,
               << " " << pixels
               << " " << program
               << " " << name
+              << " " << origStart
+              << " " << origDuration
               << std::endl;
 }
 
@@ -199,6 +209,12 @@ void Profiler::parseLine(const char* in, Profile* profile)
              >> call.program
              >> call.name;
 
+        /* Profiles from older versions lack the original times */
+        if (!(line >> call.origStart >> call.origDuration)) {
+            call.origStart = 0;
+            call.origDuration = 0;
+        }
+
         if (lastGpuTime < call.gpuStart + call.gpuDuration) {
             lastGpuTime = call.gpuStart + call.gpuDuration;
         }
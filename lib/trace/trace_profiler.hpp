@@ -53,6 +53,10 @@ struct Profile {
         int64_t pixels;
 
         std::string name;
+
+        /* As recorded in the trace, see TRACE_TIMESTAMPS */
+        int64_t origStart;
+        int64_t origDuration;
     };
 
     struct Frame {
@@ -109,7 +113,8 @@ public:
                  int64_t gpuStart, int64_t gpuDuration,
                  int64_t cpuStart, int64_t cpuDuration,
                  int64_t vsizeStart, int64_t vsizeDuration,
-                 int64_t rssStart, int64_t rssDuration);
+                 int64_t rssStart, int64_t rssDuration,
+                 int64_t origStart, int64_t origDuration);
 
     void addFrameEnd();
 
@@ -0,0 +1,216 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "os_process.hpp"
+#include "trace_file.hpp"
+#include "trace_format.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+
+
+using namespace trace;
+
+
+static const char *glEnable_args[] = {"cap"};
+static const FunctionSig glEnable_sig = {0, "glEnable", 1, glEnable_args};
+static const FunctionSig glFlush_sig = {1, "glFlush", 0, NULL};
+static const FunctionSig glIsEnabled_sig = {2, "glIsEnabled", 1, glEnable_args};
+
+static const EnumValue GLenum_values[] = {
+    {"GL_BLEND", 0x0BE2},
+    {"GL_DEPTH_TEST", 0x0B71},
+};
+static const EnumSig GLenum_sig = {0, 2, GLenum_values};
+
+static const unsigned GL_BLEND = 0x0BE2;
+
+
+static std::string
+tempFileName(const char *suffix)
+{
+    return ::testing::TempDir() + "apitrace-raw-call-" +
+           std::to_string(os::getCurrentProcessId()) + "-" + suffix + ".trace";
+}
+
+
+static void
+writeCall(Writer &writer, const FunctionSig *sig, bool ret = false)
+{
+    unsigned call_no = writer.beginEnter(sig, 0);
+    writer.writeFlags(0);
+    if (sig->num_args) {
+        writer.beginArg(0);
+        writer.writeEnum(&GLenum_sig, GL_BLEND);
+        writer.endArg();
+    }
+    writer.endEnter();
+    writer.beginLeave(call_no);
+    if (ret) {
+        writer.beginReturn();
+        writer.writeBool(true);
+        writer.endReturn();
+    }
+    writer.endLeave();
+}
+
+
+static std::vector<char>
+readAll(const std::string &filename)
+{
+    std::vector<char> data;
+    std::unique_ptr<File> file(File::createForRead(filename.c_str()));
+    if (file) {
+        char buf[4096];
+        size_t read;
+        while ((read = file->read(buf, sizeof buf)) > 0) {
+            data.insert(data.end(), buf, buf + read);
+        }
+    }
+    return data;
+}
+
+
+/* Calls 0 and 1 define every signature, but only the calls after them are
+ * kept, so the copy has to emit the definitions itself, once. */
+static bool
+keep(const Call *call)
+{
+    return call->no >= 2;
+}
+
+
+class RawCallTest : public ::testing::Test
+{
+protected:
+    std::string source = tempFileName("source");
+    std::string raw = tempFileName("raw");
+    std::string decoded = tempFileName("decoded");
+
+    void SetUp() override {
+        Writer writer;
+        ASSERT_TRUE(writer.open(source.c_str(), TRACE_VERSION, Properties()));
+        writeCall(writer, &glEnable_sig);
+        writeCall(writer, &glFlush_sig);
+        writeCall(writer, &glEnable_sig);
+        writeCall(writer, &glEnable_sig);
+        writeCall(writer, &glFlush_sig);
+        writeCall(writer, &glIsEnabled_sig, true);
+        writer.close();
+    }
+
+    void TearDown() override {
+        remove(source.c_str());
+        remove(raw.c_str());
+        remove(decoded.c_str());
+    }
+
+    /* Copy the kept calls of the source trace, renumbering them */
+    void copy(const std::string &output, bool recordRaw) {
+        Parser parser;
+        parser.setRecordRawCalls(recordRaw);
+        parser.setRawCallFilter(keep);
+        ASSERT_TRUE(parser.open(source.c_str()));
+        ASSERT_EQ(parser.recordsRawCalls(), recordRaw);
+
+        Writer writer;
+        ASSERT_TRUE(writer.open(output.c_str(), parser.getVersion(), parser.getProperties()));
+
+        unsigned call_no = 0;
+        Call *call;
+        while ((call = recordRaw ? parser.scan_call() : parser.parse_call())) {
+            if (keep(call)) {
+                call->no = call_no++;
+                if (recordRaw) {
+                    EXPECT_NE(call->raw, nullptr);
+                    writer.writeRawCall(call);
+                } else {
+                    writer.writeCall(call);
+                }
+            } else {
+                EXPECT_EQ(call->raw, nullptr);
+            }
+            delete call;
+        }
+    }
+};
+
+
+TEST_F(RawCallTest, parse)
+{
+    copy(raw, true);
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(raw.c_str()));
+
+    static const char *names[] = {"glEnable", "glEnable", "glFlush", "glIsEnabled"};
+    unsigned count = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        ASSERT_LT(count, 4u);
+        EXPECT_EQ(call->no, count);
+        EXPECT_STREQ(call->name(), names[count]);
+
+        /* A mismatched leave event leaves the call incomplete */
+        EXPECT_FALSE(call->flags & CALL_FLAG_INCOMPLETE);
+
+        if (call->sig->num_args) {
+            Enum *cap = dynamic_cast<Enum *>(call->args[0].value);
+            ASSERT_NE(cap, nullptr);
+            ASSERT_NE(cap->lookup(), nullptr);
+            EXPECT_STREQ(cap->lookup()->name, "GL_BLEND");
+        }
+        if (call->sig->id == glIsEnabled_sig.id) {
+            ASSERT_NE(call->ret, nullptr);
+            EXPECT_TRUE(call->ret->toBool());
+        }
+
+        ++count;
+        delete call;
+    }
+    EXPECT_EQ(count, 4u);
+}
+
+
+/* Each signature must be defined exactly where a freshly encoded trace of the
+ * same calls would define it. */
+TEST_F(RawCallTest, matchesDecoded)
+{
+    copy(raw, true);
+    copy(decoded, false);
+
+    std::vector<char> rawData = readAll(raw);
+    std::vector<char> decodedData = readAll(decoded);
+    EXPECT_FALSE(rawData.empty());
+    EXPECT_EQ(rawData, decodedData);
+}
@@ -31,4 +31,10 @@
 #define SNAPPY_BYTE1 'a'
 #define SNAPPY_BYTE2 't'
 
+/*
+ * Set in the length of chunks stored uncompressed, because they didn't
+ * compress.
+ */
+#define SNAPPY_CHUNK_UNCOMPRESSED 0x80000000U
+
 
@@ -0,0 +1,455 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "trace_symbolizer.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#ifdef __ELF__
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "os.hpp"
+
+
+namespace trace {
+
+
+struct Location {
+    std::string function;
+    std::string filename;
+    int linenumber = -1;
+};
+
+
+struct Symbolizer::Module {
+    // File given to the symbolizer process, or empty if not symbolizable
+    std::string fileName;
+
+    FILE *in = nullptr;
+    FILE *out = nullptr;
+    int pid = 0;
+
+    std::map<long long, Location> cache;
+
+    // Offsets to resolve on the next symbolize() call
+    std::vector<long long> pending;
+
+    ~Module();
+
+    bool start(void);
+    void resolvePending(void);
+};
+
+
+#ifdef __ELF__
+
+
+static inline size_t
+align4(size_t size) {
+    return (size + 3) & ~size_t(3);
+}
+
+
+template <class Ehdr, class Phdr, class Nhdr>
+static std::string
+readBuildId(FILE *file)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    Ehdr ehdr;
+    if (fseek(file, 0, SEEK_SET) != 0 ||
+        fread(&ehdr, sizeof ehdr, 1, file) != 1) {
+        return std::string();
+    }
+
+    for (unsigned i = 0; i < ehdr.e_phnum; ++i) {
+        Phdr phdr;
+        if (fseek(file, ehdr.e_phoff + i * ehdr.e_phentsize, SEEK_SET) != 0 ||
+            fread(&phdr, sizeof phdr, 1, file) != 1) {
+            break;
+        }
+        if (phdr.p_type != PT_NOTE) {
+            continue;
+        }
+
+        std::vector<char> notes(phdr.p_filesz);
+        if (fseek(file, phdr.p_offset, SEEK_SET) != 0 ||
+            fread(notes.data(), 1, notes.size(), file) != notes.size()) {
+            break;
+        }
+
+        size_t pos = 0;
+        while (pos + sizeof(Nhdr) <= notes.size()) {
+            const Nhdr *note = (const Nhdr *)&notes[pos];
+            size_t name = pos + sizeof *note;
+            size_t desc = name + align4(note->n_namesz);
+            if (desc + note->n_descsz > notes.size()) {
+                break;
+            }
+            if (note->n_type == NT_GNU_BUILD_ID &&
+                note->n_namesz == 4 && memcmp(&notes[name], "GNU", 4) == 0) {
+                std::string buildId;
+                for (size_t j = 0; j < note->n_descsz; ++j) {
+                    unsigned char c = notes[desc + j];
+                    buildId += digits[c >> 4];
+                    buildId += digits[c & 0xf];
+                }
+                return buildId;
+            }
+            pos = desc + align4(note->n_descsz);
+        }
+    }
+
+    return std::string();
+}
+
+
+static std::string
+readBuildId(const char *fileName)
+{
+    FILE *file = fopen(fileName, "rb");
+    if (!file) {
+        return std::string();
+    }
+
+    std::string buildId;
+    unsigned char ident[EI_NIDENT];
+    if (fread(ident, sizeof ident, 1, file) == 1 &&
+        memcmp(ident, ELFMAG, SELFMAG) == 0) {
+        if (ident[EI_CLASS] == ELFCLASS64) {
+            buildId = readBuildId<Elf64_Ehdr, Elf64_Phdr, Elf64_Nhdr>(file);
+        } else if (ident[EI_CLASS] == ELFCLASS32) {
+            buildId = readBuildId<Elf32_Ehdr, Elf32_Phdr, Elf32_Nhdr>(file);
+        }
+    }
+
+    fclose(file);
+    return buildId;
+}
+
+
+/*
+ * Block SIGPIPE in this thread for the guard's lifetime, so that writing to a
+ * symbolizer process that died fails with EPIPE instead of killing us,
+ * without changing how the rest of the process handles the signal.
+ */
+class SigPipeGuard {
+    sigset_t pipeSet;
+    sigset_t oldSet;
+    bool wasPending;
+
+public:
+    SigPipeGuard() {
+        sigemptyset(&pipeSet);
+        sigaddset(&pipeSet, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+
+        sigset_t pendingSet;
+        sigpending(&pendingSet);
+        wasPending = sigismember(&pendingSet, SIGPIPE);
+    }
+
+    ~SigPipeGuard() {
+        // Discard the signal raised by our own writes, if any
+        if (!wasPending) {
+            struct timespec timeout = {0, 0};
+            while (sigtimedwait(&pipeSet, NULL, &timeout) < 0 && errno == EINTR) {
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+    }
+};
+
+
+Symbolizer::Module::~Module() {
+    if (in) {
+        // May write what a failed request left buffered
+        SigPipeGuard guard;
+        fclose(in);
+    }
+    if (out) {
+        fclose(out);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+
+bool
+Symbolizer::Module::start(void) {
+    const char *tool = getenv("APITRACE_ADDR2LINE");
+    if (!tool) {
+        tool = "addr2line";
+    }
+
+    // Close-on-exec, so that other symbolizer processes don't hold them
+    int toChild[2];
+    int fromChild[2];
+    if (pipe2(toChild, O_CLOEXEC) != 0) {
+        return false;
+    }
+    if (pipe2(fromChild, O_CLOEXEC) != 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        return false;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        execlp(tool, tool, "-f", "-C", "-e", fileName.c_str(), (char *)NULL);
+        _exit(127);
+    }
+
+    close(toChild[0]);
+    close(fromChild[1]);
+    if (pid < 0) {
+        close(toChild[1]);
+        close(fromChild[0]);
+        return false;
+    }
+
+    in = fdopen(toChild[1], "w");
+    out = fdopen(fromChild[0], "r");
+    return in && out;
+}
+
+
+static bool
+readLine(FILE *file, std::string &line)
+{
+    char buf[4096];
+    line.clear();
+    while (fgets(buf, sizeof buf, file)) {
+        line += buf;
+        if (!line.empty() && line.back() == '\n') {
+            line.pop_back();
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+
+/*
+ * Ask the symbolizer process for every pending offset, one at a time, as
+ * addr2line flushes its output after each address read from stdin.
+ */
+void
+Symbolizer::Module::resolvePending(void) {
+    SigPipeGuard guard;
+
+    for (long long offset : pending) {
+        Location &location = cache[offset];
+
+        if (!in && !fileName.empty() && !start()) {
+            os::log("warning: failed to start symbolizer for %s\n", fileName.c_str());
+            fileName.clear();
+        }
+        if (fileName.empty()) {
+            continue;
+        }
+
+        std::string function;
+        std::string fileLine;
+        if (fprintf(in, "0x%llx\n", offset) < 0 || fflush(in) != 0 ||
+            !readLine(out, function) ||
+            !readLine(out, fileLine)) {
+            os::log("warning: symbolizer for %s failed\n", fileName.c_str());
+            fileName.clear();
+            continue;
+        }
+
+        if (function != "??") {
+            location.function = function;
+        }
+
+        // file:line, optionally followed by " (discriminator N)"
+        size_t discriminator = fileLine.find(" (discriminator");
+        if (discriminator != std::string::npos) {
+            fileLine.resize(discriminator);
+        }
+        size_t colon = fileLine.rfind(':');
+        if (colon != std::string::npos) {
+            std::string file = fileLine.substr(0, colon);
+            int line = atoi(fileLine.c_str() + colon + 1);
+            if (file != "??") {
+                location.filename = file;
+                if (line > 0) {
+                    location.linenumber = line;
+                }
+            }
+        }
+    }
+    pending.clear();
+}
+
+
+Symbolizer::Symbolizer() {
+}
+
+
+Symbolizer::Module *
+Symbolizer::getModule(const char *path, const char *buildId) {
+    std::string key = std::string(path) + '\n' + buildId;
+    Module *&module = modules[key];
+    if (module) {
+        return module;
+    }
+
+    module = new Module;
+
+    std::string debugFile = "/usr/lib/debug/.build-id/";
+    if (strlen(buildId) > 2) {
+        debugFile += std::string(buildId, 2) + "/" + (buildId + 2) + ".debug";
+        if (access(debugFile.c_str(), R_OK) == 0) {
+            module->fileName = debugFile;
+            return module;
+        }
+    }
+
+    if (readBuildId(path) == buildId) {
+        module->fileName = path;
+    } else {
+        os::log("warning: %s is not the traced build, not symbolizing it\n", path);
+    }
+    return module;
+}
+
+
+std::vector<RawStackFrame>
+Symbolizer::symbolize(const Backtrace &backtrace) {
+    std::lock_guard<std::mutex> guard(mutex);
+
+    std::vector<RawStackFrame> symbolized;
+    symbolized.reserve(backtrace.size());
+    for (auto frame : backtrace) {
+        symbolized.push_back(*frame);
+    }
+
+    // Indices of the frames to symbolize, with their modules
+    std::vector<std::pair<size_t, Module *>> frames;
+    std::vector<Module *> busy;
+    for (size_t i = 0; i < backtrace.size(); ++i) {
+        const StackFrame *frame = backtrace[i];
+        if (!frame->module || !frame->buildId || frame->offset < 0 ||
+            frame->function || frame->filename) {
+            continue;
+        }
+        Module *module = getModule(frame->module, frame->buildId);
+        if (module->fileName.empty()) {
+            continue;
+        }
+        if (!module->cache.count(frame->offset) &&
+            std::find(module->pending.begin(), module->pending.end(),
+                      frame->offset) == module->pending.end()) {
+            if (module->pending.empty()) {
+                busy.push_back(module);
+            }
+            module->pending.push_back(frame->offset);
+        }
+        frames.emplace_back(i, module);
+    }
+
+    if (busy.size() == 1) {
+        busy.front()->resolvePending();
+    } else if (busy.size() > 1) {
+        std::vector<std::thread> threads;
+        for (Module *module : busy) {
+            threads.emplace_back(&Module::resolvePending, module);
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (auto & it : frames) {
+        RawStackFrame &frame = symbolized[it.first];
+        const Location &location = it.second->cache[frame.offset];
+        if (!location.function.empty()) {
+            frame.function = location.function.c_str();
+            // The offset is relative to the module start, not the function
+            frame.offset = -1;
+        }
+        if (!location.filename.empty()) {
+            frame.filename = location.filename.c_str();
+            frame.linenumber = location.linenumber;
+        }
+    }
+
+    return symbolized;
+}
+
+
+#else /* !__ELF__ */
+
+
+Symbolizer::Module::~Module() {
+}
+
+
+Symbolizer::Symbolizer() {
+}
+
+
+std::vector<RawStackFrame>
+Symbolizer::symbolize(const Backtrace &backtrace) {
+    std::vector<RawStackFrame> symbolized;
+    for (auto frame : backtrace) {
+        symbolized.push_back(*frame);
+    }
+    return symbolized;
+}
+
+
+#endif /* !__ELF__ */
+
+
+Symbolizer::~Symbolizer() {
+    for (auto & it : modules) {
+        delete it.second;
+    }
+}
+
+
+} /* namespace trace */
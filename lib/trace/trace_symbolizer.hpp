@@ -0,0 +1,83 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Offline symbolization of backtraces, see APITRACE_BACKTRACE_DEFERRED.
+ */
+
+#pragma once
+
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trace_model.hpp"
+
+
+namespace trace {
+
+
+/**
+ * Resolves the function, source file and line number of stack frames that
+ * were recorded as a module offset only.
+ *
+ * Every module is symbolized by its own addr2line process (or the one named
+ * by APITRACE_ADDR2LINE), which is kept running, and whose answers are
+ * cached.  Frames of different modules are resolved in parallel.  Modules
+ * are looked up by build id in /usr/lib/debug/.build-id first, and are not
+ * symbolized if the file at the recorded path is a different build.
+ */
+class Symbolizer
+{
+public:
+    Symbolizer();
+    ~Symbolizer();
+
+    /**
+     * Copy of the backtrace, with the frames that can be symbolized filled
+     * in.  The frames of the backtrace, which the parser shares between
+     * calls, are left untouched.  The strings of the copy belong to them or
+     * to the symbolizer, and are valid as long as both are.  Thread safe.
+     */
+    std::vector<RawStackFrame>
+    symbolize(const Backtrace &backtrace);
+
+private:
+    struct Module;
+
+    std::mutex mutex;
+
+    // By module path and build id
+    std::map<std::string, Module *> modules;
+
+    Module *
+    getModule(const char *path, const char *buildId);
+};
+
+
+} /* namespace trace */
@@ -41,7 +41,8 @@ namespace trace {
 
 
 Writer::Writer() :
-    call_no(0)
+    call_no(0),
+    bytes_written(0)
 {
     m_file = nullptr;
 }
@@ -70,6 +71,7 @@ Writer::open(const char *filename,
     }
 
     call_no = 0;
+    bytes_written = 0;
     functions.clear();
     structs.clear();
     enums.clear();
@@ -93,6 +95,7 @@ Writer::open(const char *filename,
 void inline
 Writer::_write(const void *sBuffer, size_t dwBytesToWrite) {
     m_file->write(sBuffer, dwBytesToWrite);
+    bytes_written += dwBytesToWrite;
 }
 
 void inline
@@ -157,31 +160,39 @@ void Writer::beginBacktrace(unsigned num_frames) {
 void Writer::writeStackFrame(const RawStackFrame *frame) {
     _writeUInt(frame->id);
     if (!lookup(frames, frame->id)) {
-        if (frame->module != NULL) {
-            _writeByte(trace::BACKTRACE_MODULE);
-            _writeString(frame->module);
-        }
-        if (frame->function != NULL) {
-            _writeByte(trace::BACKTRACE_FUNCTION);
-            _writeString(frame->function);
-        }
-        if (frame->filename != NULL) {
-            _writeByte(trace::BACKTRACE_FILENAME);
-            _writeString(frame->filename);
-        }
-        if (frame->linenumber >= 0) {
-            _writeByte(trace::BACKTRACE_LINENUMBER);
-            _writeUInt(frame->linenumber);
-        }
-        if (frame->offset >= 0) {
-            _writeByte(trace::BACKTRACE_OFFSET);
-            _writeUInt(frame->offset);
-        }
-        _writeByte(trace::BACKTRACE_END);
+        _writeStackFrameDetails(frame);
         frames[frame->id] = true;
     }
 }
 
+void Writer::_writeStackFrameDetails(const RawStackFrame *frame) {
+    if (frame->module != NULL) {
+        _writeByte(trace::BACKTRACE_MODULE);
+        _writeString(frame->module);
+    }
+    if (frame->function != NULL) {
+        _writeByte(trace::BACKTRACE_FUNCTION);
+        _writeString(frame->function);
+    }
+    if (frame->filename != NULL) {
+        _writeByte(trace::BACKTRACE_FILENAME);
+        _writeString(frame->filename);
+    }
+    if (frame->linenumber >= 0) {
+        _writeByte(trace::BACKTRACE_LINENUMBER);
+        _writeUInt(frame->linenumber);
+    }
+    if (frame->offset >= 0) {
+        _writeByte(trace::BACKTRACE_OFFSET);
+        _writeUInt(frame->offset);
+    }
+    if (frame->buildId != NULL) {
+        _writeByte(trace::BACKTRACE_BUILD_ID);
+        _writeString(frame->buildId);
+    }
+    _writeByte(trace::BACKTRACE_END);
+}
+
 void
 Writer::writeFlags(unsigned flags) {
     if (flags) {
@@ -190,6 +201,12 @@ Writer::writeFlags(unsigned flags) {
     }
 }
 
+void
+Writer::writeTimestamp(unsigned long long ns) {
+    _writeByte(trace::CALL_TIMESTAMP);
+    _writeUInt(ns);
+}
+
 void
 Writer::writeProperty(const char *name, const char *value)
 {
@@ -211,17 +228,21 @@ unsigned Writer::beginEnter(const FunctionSig *sig, unsigned thread_id) {
     _writeUInt(thread_id);
     _writeUInt(sig->id);
     if (!lookup(functions, sig->id)) {
-        _writeString(sig->name);
-        _writeUInt(sig->num_args);
-        for (unsigned i = 0; i < sig->num_args; ++i) {
-            _writeString(sig->arg_names[i]);
-        }
+        _writeFunctionSig(sig);
         functions[sig->id] = true;
     }
 
     return call_no++;
 }
 
+void Writer::_writeFunctionSig(const FunctionSig *sig) {
+    _writeString(sig->name);
+    _writeUInt(sig->num_args);
+    for (unsigned i = 0; i < sig->num_args; ++i) {
+        _writeString(sig->arg_names[i]);
+    }
+}
+
 void Writer::endEnter(void) {
     _writeByte(trace::CALL_END);
 }
@@ -253,15 +274,19 @@ void Writer::beginStruct(const StructSig *sig) {
     _writeByte(trace::TYPE_STRUCT);
     _writeUInt(sig->id);
     if (!lookup(structs, sig->id)) {
-        _writeString(sig->name);
-        _writeUInt(sig->num_members);
-        for (unsigned i = 0; i < sig->num_members; ++i) {
-            _writeString(sig->member_names[i]);
-        }
+        _writeStructSig(sig);
         structs[sig->id] = true;
     }
 }
 
+void Writer::_writeStructSig(const StructSig *sig) {
+    _writeString(sig->name);
+    _writeUInt(sig->num_members);
+    for (unsigned i = 0; i < sig->num_members; ++i) {
+        _writeString(sig->member_names[i]);
+    }
+}
+
 void Writer::beginRepr(void) {
     _writeByte(trace::TYPE_REPR);
 }
@@ -351,33 +376,41 @@ void Writer::writeEnum(const EnumSig *sig, signed long long value) {
     _writeByte(trace::TYPE_ENUM);
     _writeUInt(sig->id);
     if (!lookup(enums, sig->id)) {
-        _writeUInt(sig->num_values);
-        for (unsigned i = 0; i < sig->num_values; ++i) {
-            _writeString(sig->values[i].name);
-            writeSInt(sig->values[i].value);
-        }
+        _writeEnumSig(sig);
         enums[sig->id] = true;
     }
     writeSInt(value);
 }
 
+void Writer::_writeEnumSig(const EnumSig *sig) {
+    _writeUInt(sig->num_values);
+    for (unsigned i = 0; i < sig->num_values; ++i) {
+        _writeString(sig->values[i].name);
+        writeSInt(sig->values[i].value);
+    }
+}
+
 void Writer::writeBitmask(const BitmaskSig *sig, unsigned long long value) {
     _writeByte(trace::TYPE_BITMASK);
     _writeUInt(sig->id);
     if (!lookup(bitmasks, sig->id)) {
-        _writeUInt(sig->num_flags);
-        for (unsigned i = 0; i < sig->num_flags; ++i) {
-            if (i != 0 && sig->flags[i].value == 0) {
-                os::log("apitrace: warning: sig %s is zero but is not first flag\n", sig->flags[i].name);
-            }
-            _writeString(sig->flags[i].name);
-            _writeUInt(sig->flags[i].value);
-        }
+        _writeBitmaskSig(sig);
         bitmasks[sig->id] = true;
     }
     _writeUInt(value);
 }
 
+void Writer::_writeBitmaskSig(const BitmaskSig *sig) {
+    _writeUInt(sig->num_flags);
+    for (unsigned i = 0; i < sig->num_flags; ++i) {
+        if (i != 0 && sig->flags[i].value == 0) {
+            os::log("apitrace: warning: sig %s is zero but is not first flag\n", sig->flags[i].name);
+        }
+        _writeString(sig->flags[i].name);
+        _writeUInt(sig->flags[i].value);
+    }
+}
+
 void Writer::writeNull(void) {
     _writeByte(trace::TYPE_NULL);
 }
@@ -391,6 +424,99 @@ void Writer::writePointer(unsigned long long addr) {
     _writeUInt(addr);
 }
 
+void Writer::writeRawCall(const Call *call) {
+    assert(call->raw);
+
+    _writeByte(trace::EVENT_ENTER);
+    _writeRawSpan(call->raw->enter);
+
+    /* The call number is the only thing in the leave event that depends on
+     * the calls written before. */
+    beginLeave(call_no++);
+    if (call->raw->leave.bytes.empty()) {
+        /* Incomplete call */
+        endLeave();
+    } else {
+        _writeRawSpan(call->raw->leave);
+    }
+}
+
+/*
+ * Copy the span, adding or dropping signature definitions so that each
+ * signature is defined exactly the first time it is referenced in this
+ * trace, which isn't necessarily where it was first referenced in the trace
+ * the span was read from.
+ */
+void Writer::_writeRawSpan(const RawCallRecord::Span &span) {
+    const char *bytes = span.bytes.data();
+    size_t pos = 0;
+
+    for (auto & ref : span.sigs) {
+        assert(ref.offset >= pos);
+        _write(bytes + pos, ref.offset - pos);
+        pos = ref.offset;
+
+        std::vector<bool> *map;
+        Id id;
+        switch (ref.kind) {
+        case RawCallRecord::SigRef::FUNCTION:
+            map = &functions;
+            id = ref.function->id;
+            break;
+        case RawCallRecord::SigRef::STRUCT:
+            map = &structs;
+            id = ref.structSig->id;
+            break;
+        case RawCallRecord::SigRef::ENUM:
+            map = &enums;
+            id = ref.enumSig->id;
+            break;
+        case RawCallRecord::SigRef::BITMASK:
+            map = &bitmasks;
+            id = ref.bitmaskSig->id;
+            break;
+        case RawCallRecord::SigRef::FRAME:
+            map = &frames;
+            id = ref.frame->id;
+            break;
+        default:
+            assert(0);
+            continue;
+        }
+
+        if (!lookup(*map, id)) {
+            if (ref.defined) {
+                _write(bytes + pos, ref.length);
+            } else {
+                switch (ref.kind) {
+                case RawCallRecord::SigRef::FUNCTION:
+                    _writeFunctionSig(ref.function);
+                    break;
+                case RawCallRecord::SigRef::STRUCT:
+                    _writeStructSig(ref.structSig);
+                    break;
+                case RawCallRecord::SigRef::ENUM:
+                    _writeEnumSig(ref.enumSig);
+                    break;
+                case RawCallRecord::SigRef::BITMASK:
+                    _writeBitmaskSig(ref.bitmaskSig);
+                    break;
+                case RawCallRecord::SigRef::FRAME:
+                    _writeStackFrameDetails(ref.frame);
+                    break;
+                }
+            }
+            (*map)[id] = true;
+        }
+
+        if (ref.defined) {
+            pos += ref.length;
+        }
+    }
+
+    _write(bytes + pos, span.bytes.size() - pos);
+}
+
 
 } /* namespace trace */
 
@@ -44,6 +44,9 @@ namespace trace {
         OutStream *m_file;
         unsigned call_no;
 
+        /// Uncompressed bytes written since the file was opened
+        unsigned long long bytes_written;
+
         std::vector<bool> functions;
         std::vector<bool> structs;
         std::vector<bool> enums;
@@ -77,6 +80,12 @@ namespace trace {
 
         void writeFlags(unsigned flags);
 
+        /**
+         * In enter events, nanoseconds since the trace started; in leave
+         * events, nanoseconds spent in the call.
+         */
+        void writeTimestamp(unsigned long long ns);
+
         void beginArray(size_t length);
         inline void endArray(void) {}
 
@@ -106,6 +115,14 @@ namespace trace {
 
         void writeCall(Call *call);
 
+        /**
+         * Write a call as it was encoded in the trace it was parsed from,
+         * see Parser::setRecordRawCalls().  Only the call number and
+         * signature definitions are adjusted, so any changes made to the
+         * call's values are ignored.
+         */
+        void writeRawCall(const Call *call);
+
     private:
         inline void beginProperties(void) {}
         void writeProperty(const char *name, const char *value);
@@ -119,6 +136,13 @@ namespace trace {
         void inline _writeDouble(double value);
         void inline _writeString(const char *str);
 
+        void _writeFunctionSig(const FunctionSig *sig);
+        void _writeStructSig(const StructSig *sig);
+        void _writeEnumSig(const EnumSig *sig);
+        void _writeBitmaskSig(const BitmaskSig *sig);
+        void _writeStackFrameDetails(const RawStackFrame *frame);
+        void _writeRawSpan(const RawCallRecord::Span &span);
+
     };
 
 } /* namespace trace */
@@ -30,9 +30,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <string>
+
 #include "os.hpp"
 #include "os_thread.hpp"
 #include "os_string.hpp"
+#include "os_time.hpp"
 #include "os_version.hpp"
 #include "trace_option.hpp"
 #include "trace_ostream.hpp"
@@ -42,6 +46,8 @@
 
 #ifdef _WIN32
 #include <shlobj.h>
+#else
+#include <signal.h>
 #endif
 
 
@@ -60,6 +66,19 @@ const FunctionSig free_sig = {2, "free", 1, free_args};
 static const char *realloc_args[2] = {"ptr", "size"};
 const FunctionSig realloc_sig = {3, "realloc", 2, realloc_args};
 
+static const char *stats_args[9] = {
+    "calls",
+    "uncompressed_bytes",
+    "compressed_bytes",
+    "wait_ns",
+    "writer_ns",
+    "compression_ns",
+    "write_ns",
+    "max_stall_ns",
+    "blob_bytes",
+};
+const FunctionSig stats_sig = {4, "apitrace_stats", 9, stats_args};
+
 
 static void exceptionCallback(void)
 {
@@ -67,9 +86,129 @@ static void exceptionCallback(void)
 }
 
 
+/*
+ * Calls entered on the current thread and not left yet, innermost last.
+ *
+ * Whether a call was recorded (as opposed to discarded because capture is
+ * deferred, or the capture policy excludes it), and in which rolling file,
+ * is remembered here, so that its leave event is discarded too, even if
+ * capture started or a new file was rolled meanwhile.  Deeper nesting only
+ * forgets about the outermost calls.
+ */
+struct PendingCall {
+    unsigned no;
+    bool discarded;
+    unsigned rollIndex;
+};
+
+static const unsigned MAX_PENDING_CALLS = 16;
+
+static OS_THREAD_LOCAL PendingCall pendingCalls[MAX_PENDING_CALLS];
+static OS_THREAD_LOCAL unsigned numPendingCalls;
+
+static void
+pushPendingCall(unsigned no, bool discarded, unsigned rollIndex)
+{
+    if (numPendingCalls == MAX_PENDING_CALLS) {
+        memmove(pendingCalls, pendingCalls + 1,
+                (MAX_PENDING_CALLS - 1) * sizeof pendingCalls[0]);
+        --numPendingCalls;
+    }
+    pendingCalls[numPendingCalls++] = {no, discarded, rollIndex};
+}
+
+/*
+ * Look up the given call, forgetting about it, and about any calls entered
+ * after it which never returned.
+ */
+static const PendingCall *
+popPendingCall(unsigned no)
+{
+    unsigned i = numPendingCalls;
+    while (i > 0) {
+        --i;
+        if (pendingCalls[i].no == no) {
+            numPendingCalls = i;
+            return &pendingCalls[i];
+        }
+    }
+    return nullptr;
+}
+
+
+/*
+ * Number of calls that may be in flight at once while keeping their enter
+ * times, see TRACE_TIMESTAMPS.
+ */
+static const unsigned ENTER_TIMES_SIZE = 4096;
+
+
+/**
+ * Stream that discards everything, used for calls that are not recorded.
+ */
+class NullOutStream : public OutStream {
+public:
+    bool write(const void *buffer, size_t length) override {
+        return true;
+    }
+
+    void flush(void) override {
+    }
+};
+
+
+static std::atomic<bool> startRequested(false);
+
+#ifndef _WIN32
+static void startSignalHandler(int sig)
+{
+    startRequested = true;
+}
+#endif
+
+
+/*
+ * Name of the index-th rolling file, e.g. foo.trace -> foo-part3.trace
+ */
+static os::String
+getRollFileName(const os::String &baseName, unsigned index)
+{
+    os::String name(baseName);
+    const char *ext = strrchr(name.str(), '.');
+    if (ext && strcmp(ext, ".trace") == 0) {
+        name.truncate(ext - name.str());
+    }
+    return os::String::format("%s-part%u.trace", name.str(), index);
+}
+
+
 LocalWriter::LocalWriter() :
     acquired(0),
-    sharedPtrThis(std::make_shared<LocalWriter*>(this))
+    sharedPtrThis(std::make_shared<LocalWriter*>(this)),
+    recording(true),
+    frameNo(0),
+    startFrame(0),
+    switched(false),
+    trackCalls(false),
+    discarding(false),
+    recreatingState(false),
+    rollFrames(0),
+    rollBytes(0),
+    rollKeep(0),
+    rollFrameNo(0),
+    rollIndex(0),
+    blobLimit(SIZE_MAX),
+    blobTruncated(false),
+    statsEnabled(false),
+    statsInterval(0),
+    lastStatsTime(0),
+    sectionWaitStart(0),
+    sectionStart(0),
+    enterSig(nullptr),
+    timestamps(false),
+    timeBase(0),
+    enterCallNo(0),
+    deferredBacktraces(false)
 {
     os::String process = os::getProcessName();
     os::log("apitrace: loaded into %s\n", process.str());
@@ -77,6 +216,97 @@ LocalWriter::LocalWriter() :
     // Install the signal handlers as early as possible, to prevent
     // interfering with the application's signal handling.
     os::setExceptionCallback(exceptionCallback);
+
+    const char *startFrameStr = getenv("TRACE_START_FRAME");
+    if (startFrameStr) {
+        int value = atoi(startFrameStr);
+        if (value < 0) {
+            os::log("apitrace: error: invalid TRACE_START_FRAME: %s\n", startFrameStr);
+            os::abort();
+        }
+        if (value > 0) {
+            startFrame = value;
+            recording = false;
+        }
+    }
+
+    const char *startOnSignalStr = getenv("TRACE_START_ON_SIGNAL");
+    if (startOnSignalStr && boolOption(startOnSignalStr)) {
+#ifdef _WIN32
+        os::log("apitrace: warning: TRACE_START_ON_SIGNAL is not supported on Windows\n");
+#else
+        struct sigaction action;
+        memset(&action, 0, sizeof action);
+        action.sa_handler = startSignalHandler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR2, &action, NULL);
+        if (recording) {
+            startFrame = ~0U;
+            recording = false;
+        }
+#endif
+    }
+
+    if (!recording) {
+        os::log("apitrace: capture deferred until frame %u or SIGUSR2\n", startFrame);
+    }
+
+    const char *rollFramesStr = getenv("TRACE_ROLL_FRAMES");
+    if (rollFramesStr) {
+        int value = atoi(rollFramesStr);
+        if (value < 0) {
+            os::log("apitrace: error: invalid TRACE_ROLL_FRAMES: %s\n", rollFramesStr);
+            os::abort();
+        }
+        rollFrames = value;
+    }
+
+    const char *rollSizeStr = getenv("TRACE_ROLL_SIZE");
+    if (rollSizeStr && !sizeOption(rollSizeStr, rollBytes)) {
+        os::log("apitrace: error: invalid TRACE_ROLL_SIZE: %s\n", rollSizeStr);
+        os::abort();
+    }
+
+    const char *rollKeepStr = getenv("TRACE_ROLL_KEEP");
+    if (rollKeepStr) {
+        int value = atoi(rollKeepStr);
+        if (value < 0) {
+            os::log("apitrace: error: invalid TRACE_ROLL_KEEP: %s\n", rollKeepStr);
+            os::abort();
+        }
+        rollKeep = value;
+    }
+
+    if (!policy.load()) {
+        os::log("apitrace: error: invalid TRACE_POLICY\n");
+        os::abort();
+    }
+
+    trackCalls = !recording || policy.mayDiscard() || isRolling();
+
+    const char *timestampsStr = getenv("TRACE_TIMESTAMPS");
+    if (timestampsStr && boolOption(timestampsStr)) {
+        timestamps = true;
+        enterTimes.resize(ENTER_TIMES_SIZE);
+    }
+
+    deferredBacktraces = boolOption(getenv("APITRACE_BACKTRACE_DEFERRED"), false);
+
+    // Log the overhead counters every given number of seconds
+    const char *statsStr = getenv("TRACE_STATS");
+    if (statsStr) {
+        int value = atoi(statsStr);
+        if (value < 0) {
+            os::log("apitrace: error: invalid TRACE_STATS: %s\n", statsStr);
+            os::abort();
+        }
+        if (value > 0) {
+            statsEnabled = true;
+            statsInterval = value * os::timeFrequency;
+            lastStatsTime = os::getTime();
+        }
+    }
 }
 
 static void FlushLocalWriterThread(const std::weak_ptr<LocalWriter*> writerWeakPtr,
@@ -99,6 +329,15 @@ LocalWriter::~LocalWriter()
     os::resetExceptionCallback();
     checkProcessId();
 
+    if (statsEnabled) {
+        logStats();
+        writeStats();
+    }
+
+    // The trace file if capture never started, otherwise the null stream
+    delete parked.file;
+    parked.file = nullptr;
+
     os::String process = os::getProcessName();
     os::log("apitrace: unloaded from %s\n", process.str());
 }
@@ -147,7 +386,13 @@ LocalWriter::open(void) {
                 szFileName = os::String::format("%s%s.trace", prefix.str(), suffix);
 
             lpFileName = szFileName;
-            file = fopen(lpFileName, "rb");
+            if (isRolling()) {
+                // Don't overwrite the files of a previous rolling trace
+                os::String firstFileName = getRollFileName(szFileName, 0);
+                file = fopen(firstFileName, "rb");
+            } else {
+                file = fopen(lpFileName, "rb");
+            }
             if (file == NULL)
                 break;
 
@@ -157,21 +402,30 @@ LocalWriter::open(void) {
         }
     }
 
-    os::log("apitrace: tracing to %s\n", lpFileName);
-
-    Properties properties;
-    os::String processName = os::getProcessName();
-    properties["process.name"] = processName;
-    os::String processCommandLine = os::getProcessCommandLine();
-    properties["process.commandLine"] = processCommandLine;
-
-    if (!Writer::open(lpFileName, TRACE_VERSION, properties)) {
-        os::log("apitrace: error: failed to open %s\n", lpFileName);
-        os::abort();
+    if (isRolling()) {
+        rollBaseName = lpFileName;
+        rollFileNames.clear();
+        rollIndex = 0;
+        rollFrameNo = 0;
+        szFileName = getRollFileName(rollBaseName, rollIndex);
+        lpFileName = szFileName;
+        rollFileNames.push_back(szFileName);
     }
 
+    openFile(lpFileName);
+
     pid = os::getCurrentProcessId();
 
+    // Rolled files share the same time base
+    timeBase = os::getTime();
+
+    if (!parked.file) {
+        parked.file = new NullOutStream;
+    }
+    if (!isRecording()) {
+        swapOutput();
+    }
+
     const auto flushIntervalStr = getenv("FLUSH_EVERY_MS");
     if (flushIntervalStr) {
         const auto intervalMs = atoi(flushIntervalStr);
@@ -188,10 +442,59 @@ LocalWriter::open(void) {
 #endif
 }
 
+void
+LocalWriter::openFile(const char *filename) {
+    os::log("apitrace: tracing to %s\n", filename);
+
+    Properties properties;
+    os::String processName = os::getProcessName();
+    properties["process.name"] = processName;
+    os::String processCommandLine = os::getProcessCommandLine();
+    properties["process.commandLine"] = processCommandLine;
+
+    if (!Writer::open(filename, TRACE_VERSION, properties)) {
+        os::log("apitrace: error: failed to open %s\n", filename);
+        os::abort();
+    }
+}
+
+void
+LocalWriter::rollFile(void) {
+    ++rollFrameNo;
+    if ((rollFrames && rollFrameNo >= rollFrames) ||
+        (rollBytes && bytes_written >= rollBytes)) {
+        rollFrameNo = 0;
+
+        if (statsEnabled) {
+            writeStats();
+            const OutStream::Stats &streamStats = m_file->getStats();
+            closedStreamStats.uncompressedBytes += streamStats.uncompressedBytes;
+            closedStreamStats.compressedBytes += streamStats.compressedBytes;
+            closedStreamStats.compressionTime += streamStats.compressionTime;
+            closedStreamStats.writeTime += streamStats.writeTime;
+        }
+
+        // Calls still in flight on other threads will have their leave
+        // events discarded, as their call numbers mean nothing in the new
+        // file, and are left incomplete in the old one.
+        os::String fileName = getRollFileName(rollBaseName, ++rollIndex);
+        openFile(fileName);
+        rollFileNames.push_back(fileName);
+
+        while (rollKeep && rollFileNames.size() > rollKeep) {
+            os::removeFile(rollFileNames.front());
+            rollFileNames.pop_front();
+        }
+    }
+}
+
 static uintptr_t next_thread_num = 1;
 
 static OS_THREAD_LOCAL uintptr_t thread_num;
 
+/// Whether this thread is the one recreating the state
+static OS_THREAD_LOCAL bool recreating_state;
+
 void LocalWriter::checkProcessId(void) {
     if (m_file &&
         os::getCurrentProcessId() != pid) {
@@ -200,21 +503,234 @@ void LocalWriter::checkProcessId(void) {
         // file, as it may cause it to flush and corrupt the parent's
         // trace, so we effectively leak the old file object.
         close();
+        if (!isRecording()) {
+            // The parent's trace file is parked, so leak it as well
+            parked = Output();
+        }
         // Don't want to open the same file again
         os::unsetEnvironment("TRACE_FILE");
         open();
     }
 }
 
-unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
+void LocalWriter::swapOutput(void) {
+    std::swap(m_file, parked.file);
+    std::swap(call_no, parked.call_no);
+    std::swap(bytes_written, parked.bytes_written);
+    functions.swap(parked.functions);
+    structs.swap(parked.structs);
+    enums.swap(parked.enums);
+    bitmasks.swap(parked.bitmasks);
+    frames.swap(parked.frames);
+}
+
+void LocalWriter::lock(void) {
+    if (!statsEnabled) {
+        mutex.lock();
+        waitForStateRecreation();
+        ++acquired;
+        return;
+    }
+
+    long long waitStart = os::getTime();
     mutex.lock();
-    ++acquired;
+    waitForStateRecreation();
+    if (acquired++ == 0) {
+        sectionWaitStart = waitStart;
+        sectionStart = os::getTime();
+        stats.waitTime += sectionStart - waitStart;
+    }
+}
+
+/*
+ * Called with the mutex just locked.  It is only released while waiting if
+ * it isn't held further up the stack, as by the signal handler.
+ */
+void LocalWriter::waitForStateRecreation(void) {
+    while (recreatingState && !recreating_state && acquired == 0) {
+        stateRecreated.wait(mutex);
+    }
+}
+
+void LocalWriter::unlock(void) {
+    if (statsEnabled && acquired == 1) {
+        long long now = os::getTime();
+        stats.holdTime += now - sectionStart;
+        stats.maxStall = std::max(stats.maxStall, now - sectionWaitStart);
+        if (now - lastStatsTime >= statsInterval) {
+            lastStatsTime = now;
+            logStats();
+        }
+    }
+
+    --acquired;
+    mutex.unlock();
+}
+
+void LocalWriter::countBlob(size_t size) {
+    if (!enterSig) {
+        // Output parameters and return values
+        stats.outputBlobBytes += size;
+        return;
+    }
+    if (enterSig->id >= stats.blobBytes.size()) {
+        stats.blobBytes.resize(enterSig->id + 1);
+        stats.blobNames.resize(enterSig->id + 1);
+    }
+    stats.blobBytes[enterSig->id] += size;
+    stats.blobNames[enterSig->id] = enterSig->name;
+}
+
+static inline double
+toMilliseconds(long long time) {
+    return time * 1000.0 / os::timeFrequency;
+}
+
+static inline unsigned long long
+toNanoseconds(long long time) {
+    return time * (1000000000.0 / os::timeFrequency);
+}
+
+static inline double
+toMegabytes(unsigned long long bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+/*
+ * Signatures with the most blob bytes, largest first.
+ */
+static std::vector<Id>
+getTopBlobs(const std::vector<unsigned long long> &blobBytes, size_t count) {
+    std::vector<Id> ids;
+    for (Id id = 0; id < blobBytes.size(); ++id) {
+        if (blobBytes[id]) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end(), [&](Id a, Id b) {
+        return blobBytes[a] > blobBytes[b];
+    });
+    if (ids.size() > count) {
+        ids.resize(count);
+    }
+    return ids;
+}
+
+void LocalWriter::logStats(void) {
+    OutStream::Stats streamStats = closedStreamStats;
+    if (m_file) {
+        const OutStream::Stats &current = m_file->getStats();
+        streamStats.uncompressedBytes += current.uncompressedBytes;
+        streamStats.compressedBytes += current.compressedBytes;
+        streamStats.compressionTime += current.compressionTime;
+        streamStats.writeTime += current.writeTime;
+    }
+
+    os::log("apitrace: stats: %llu calls, %.1f MB serialized, %.1f MB compressed\n",
+            stats.calls,
+            toMegabytes(streamStats.uncompressedBytes),
+            toMegabytes(streamStats.compressedBytes));
+    os::log("apitrace: stats: %.1f ms waiting for the writer, %.1f ms in the writer "
+            "(%.1f ms compressing, %.1f ms writing), largest stall %.3f ms\n",
+            toMilliseconds(stats.waitTime),
+            toMilliseconds(stats.holdTime),
+            toMilliseconds(streamStats.compressionTime),
+            toMilliseconds(streamStats.writeTime),
+            toMilliseconds(stats.maxStall));
+
+    for (Id id : getTopBlobs(stats.blobBytes, 5)) {
+        os::log("apitrace: stats: %.1f MB of blobs in %s\n",
+                toMegabytes(stats.blobBytes[id]), stats.blobNames[id]);
+    }
+    if (stats.outputBlobBytes) {
+        os::log("apitrace: stats: %.1f MB of blobs in outputs\n",
+                toMegabytes(stats.outputBlobBytes));
+    }
+}
+
+/*
+ * Record the counters so far as a trailing fake call, which retracers
+ * ignore.
+ */
+void LocalWriter::writeStats(void) {
+    if (!m_file || !isRecording() ||
+        os::getCurrentProcessId() != pid) {
+        return;
+    }
+
+    const OutStream::Stats &streamStats = m_file->getStats();
+
+    std::string blobs;
+    for (Id id : getTopBlobs(stats.blobBytes, 16)) {
+        blobs += os::String::format("%s%s=%llu", blobs.empty() ? "" : " ",
+                                    stats.blobNames[id], stats.blobBytes[id]).str();
+    }
+
+    unsigned _call = beginEnter(&stats_sig, true);
+    beginArg(0);
+    writeUInt(stats.calls);
+    endArg();
+    beginArg(1);
+    writeUInt(closedStreamStats.uncompressedBytes + streamStats.uncompressedBytes);
+    endArg();
+    beginArg(2);
+    writeUInt(closedStreamStats.compressedBytes + streamStats.compressedBytes);
+    endArg();
+    beginArg(3);
+    writeUInt(toNanoseconds(stats.waitTime));
+    endArg();
+    beginArg(4);
+    writeUInt(toNanoseconds(stats.holdTime));
+    endArg();
+    beginArg(5);
+    writeUInt(toNanoseconds(closedStreamStats.compressionTime + streamStats.compressionTime));
+    endArg();
+    beginArg(6);
+    writeUInt(toNanoseconds(closedStreamStats.writeTime + streamStats.writeTime));
+    endArg();
+    beginArg(7);
+    writeUInt(toNanoseconds(stats.maxStall));
+    endArg();
+    beginArg(8);
+    writeString(blobs.c_str());
+    endArg();
+    endEnter();
+    beginLeave(_call);
+    endLeave();
+}
+
+unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake, bool always) {
+    long long now = timestamps ? os::getTime() : 0;
+
+    lock();
 
     checkProcessId();
     if (!m_file) {
         open();
     }
 
+    if (statsEnabled) {
+        ++stats.calls;
+        enterSig = sig;
+    }
+
+    bool backtrace = false;
+    bool discard = !isRecording() && !always;
+    if (!fake) {
+        CapturePolicy::Entry &entry = policy.lookup(sig);
+        if (!entry.sample()) {
+            discard = true;
+        }
+        backtrace = entry.flags & POLICY_BACKTRACE;
+        blobLimit = entry.maxBlobSize;
+    }
+
+    // Select the discarding stream or the trace file, whichever is parked
+    if (discard == isRecording()) {
+        swapOutput();
+        switched = true;
+    }
+
     uintptr_t this_thread_num = thread_num;
     if (!this_thread_num) {
         this_thread_num = next_thread_num++;
@@ -224,35 +740,124 @@ unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
     assert(this_thread_num);
     unsigned thread_id = this_thread_num - 1;
     unsigned call_no = Writer::beginEnter(sig, thread_id);
+    if (timestamps && !discard) {
+        writeTimestamp(now > timeBase ? toNanoseconds(now - timeBase) : 0);
+    }
     if (fake) {
         writeFlags(FLAG_FAKE);
-    } else if (os::backtrace_is_needed(sig->name)) {
-        std::vector<RawStackFrame> backtrace = os::get_backtrace();
+    } else if (!discard && backtrace) {
+        std::vector<RawStackFrame> backtrace = os::get_backtrace(deferredBacktraces);
         beginBacktrace(backtrace.size());
         for (auto & frame : backtrace) {
             writeStackFrame(&frame);
         }
         endBacktrace();
     }
+    if (trackCalls) {
+        pushPendingCall(call_no, discard, rollIndex);
+    }
+    enterCallNo = call_no;
+    discarding = discard;
     return call_no;
 }
 
 void LocalWriter::endEnter(void) {
+    if (blobTruncated) {
+        writeFlags(FLAG_TRUNCATED);
+        blobTruncated = false;
+    }
     Writer::endEnter();
-    --acquired;
-    mutex.unlock();
+    if (timestamps && !discarding) {
+        enterTimes[enterCallNo % ENTER_TIMES_SIZE] = os::getTime();
+    }
+    blobLimit = SIZE_MAX;
+    enterSig = nullptr;
+    if (switched) {
+        swapOutput();
+        switched = false;
+    }
+    unlock();
 }
 
 void LocalWriter::beginLeave(unsigned call) {
-    mutex.lock();
-    ++acquired;
+    long long now = timestamps ? os::getTime() : 0;
+
+    lock();
+    // Write the leave event to the same output as the enter event
+    bool discard = false;
+    if (trackCalls) {
+        const PendingCall *pending = popPendingCall(call);
+        if (pending) {
+            discard = pending->discarded || pending->rollIndex != rollIndex;
+        }
+        if (discard == isRecording()) {
+            swapOutput();
+            switched = true;
+        }
+    }
+    discarding = discard;
     Writer::beginLeave(call);
+    if (timestamps && !discard) {
+        long long enterTime = enterTimes[call % ENTER_TIMES_SIZE];
+        writeTimestamp(now > enterTime ? toNanoseconds(now - enterTime) : 0);
+    }
 }
 
 void LocalWriter::endLeave(void) {
     Writer::endLeave();
+    if (switched) {
+        swapOutput();
+        switched = false;
+    }
+    unlock();
+}
+
+void LocalWriter::endFrame(void (*recreateState)(void)) {
+    if (isRecording() && !isRolling()) {
+        return;
+    }
+
+    bool started = false;
+
+    mutex.lock();
+    ++acquired;
+
+    if (isRecording()) {
+        checkProcessId();
+        if (m_file) {
+            rollFile();
+        }
+    } else if (++frameNo >= startFrame || startRequested) {
+        os::log("apitrace: starting capture at frame %u\n", frameNo);
+
+        checkProcessId();
+        if (!m_file) {
+            open();
+        }
+
+        // The discarding stream stays parked, for calls still in flight
+        swapOutput();
+        recording = true;
+        started = true;
+        recreatingState = true;
+        recreating_state = true;
+    }
+
     --acquired;
     mutex.unlock();
+
+    // Recreating the state calls into the real API, which must not be done
+    // with the mutex held.  The fake calls lock it as any other call, while
+    // the other threads wait in lock() until it is done.
+    if (started) {
+        recreateState();
+
+        mutex.lock();
+        recreatingState = false;
+        recreating_state = false;
+        mutex.unlock();
+        stateRecreated.notify_all();
+    }
 }
 
 void LocalWriter::flush(void) {
@@ -273,6 +878,9 @@ void LocalWriter::flush(void) {
             } else {
                 os::log("apitrace: flushing trace\n");
                 m_file->flush();
+                if (parked.file) {
+                    parked.file->flush();
+                }
             }
         }
         --acquired;
@@ -305,15 +913,17 @@ void fakeMemcpy(const void *ptr, size_t size) {
     }
 #endif
 
-    localWriter.beginArg(0);
-    localWriter.writePointer((uintptr_t)ptr);
-    localWriter.endArg();
-    localWriter.beginArg(1);
-    localWriter.writeBlob(ptr, size);
-    localWriter.endArg();
-    localWriter.beginArg(2);
-    localWriter.writeUInt(size);
-    localWriter.endArg();
+    if (!localWriter.isDiscarding()) {
+        localWriter.beginArg(0);
+        localWriter.writePointer((uintptr_t)ptr);
+        localWriter.endArg();
+        localWriter.beginArg(1);
+        localWriter.writeBlob(ptr, size);
+        localWriter.endArg();
+        localWriter.beginArg(2);
+        localWriter.writeUInt(size);
+        localWriter.endArg();
+    }
     localWriter.endEnter();
     localWriter.beginLeave(_call);
     localWriter.endLeave();
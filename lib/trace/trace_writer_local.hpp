@@ -31,10 +31,17 @@
 
 
 #include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <vector>
 
+#include "os_string.hpp"
 #include "os_thread.hpp"
 #include "os_process.hpp"
+#include "trace_ostream.hpp"
+#include "trace_policy.hpp"
 #include "trace_writer.hpp"
 
 
@@ -44,6 +51,7 @@ namespace trace {
     extern const FunctionSig malloc_sig;
     extern const FunctionSig free_sig;
     extern const FunctionSig realloc_sig;
+    extern const FunctionSig stats_sig;
 
     /**
      * A specialized Writer class, mean to trace the current process.
@@ -81,6 +89,132 @@ namespace trace {
 
         void checkProcessId();
 
+        /**
+         * Deferred capture (TRACE_START_FRAME / TRACE_START_ON_SIGNAL).
+         *
+         * Until capture starts, calls are serialized into a stream that
+         * discards everything, so that the wrappers keep tracking state
+         * without paying for compression and I/O.  The output that is not
+         * selected is parked here, with the call numbering and signature
+         * tables that go with it.
+         */
+        struct Output {
+            OutStream *file = nullptr;
+            unsigned call_no = 0;
+            unsigned long long bytes_written = 0;
+            std::vector<bool> functions;
+            std::vector<bool> structs;
+            std::vector<bool> enums;
+            std::vector<bool> bitmasks;
+            std::vector<bool> frames;
+        };
+        Output parked;
+        std::atomic<bool> recording;
+        unsigned frameNo;
+        unsigned startFrame;
+
+        /**
+         * Whether the current enter/leave event was redirected to the parked
+         * output, and must be switched back when it ends.
+         */
+        bool switched;
+
+        /**
+         * Whether calls may be discarded or outlive their trace file at all,
+         * in which case every thread keeps track of the calls it has entered,
+         * so that leave events go to the same output as their enter events.
+         */
+        bool trackCalls;
+
+        /// Whether the enter/leave event being written is discarded
+        bool discarding;
+
+        /**
+         * Whether a thread is recreating the state at the start of a
+         * capture.  The calls of the other threads wait for it to finish, so
+         * that none of them gets between the fake calls.
+         */
+        bool recreatingState;
+        std::condition_variable_any stateRecreated;
+
+        void swapOutput(void);
+
+        /**
+         * Rolling trace files (TRACE_ROLL_FRAMES / TRACE_ROLL_SIZE).
+         *
+         * A new file is started at the first frame boundary after the
+         * current one holds rollFrames frames or rollBytes uncompressed
+         * bytes, and only the last rollKeep files are kept.  Each file
+         * starts with empty signature tables, so it parses standalone.
+         */
+        unsigned rollFrames;
+        unsigned long long rollBytes;
+        unsigned rollKeep;
+        unsigned rollFrameNo;
+        unsigned rollIndex;
+        os::String rollBaseName;
+        std::deque<os::String> rollFileNames;
+
+        inline bool isRolling(void) const {
+            return rollFrames || rollBytes;
+        }
+
+        void openFile(const char *filename);
+        void rollFile(void);
+
+        /**
+         * Capture policy (TRACE_POLICY), resolved per function signature.
+         */
+        CapturePolicy policy;
+
+        /// Blob size cap for the call being entered
+        size_t blobLimit;
+
+        /// Whether blobs of the call being entered were truncated
+        bool blobTruncated;
+
+        /**
+         * Tracing overhead counters (TRACE_STATS), with times in
+         * os::timeFrequency units.
+         */
+        struct Stats {
+            unsigned long long calls = 0;
+            long long waitTime = 0;
+            long long holdTime = 0;
+            long long maxStall = 0;
+            unsigned long long outputBlobBytes = 0;
+            std::vector<unsigned long long> blobBytes;  // by FunctionSig::id
+            std::vector<const char *> blobNames;
+        };
+        bool statsEnabled;
+        Stats stats;
+        OutStream::Stats closedStreamStats;
+        long long statsInterval;
+        long long lastStatsTime;
+        long long sectionWaitStart;
+        long long sectionStart;
+        const FunctionSig *enterSig;
+
+        /**
+         * Call timestamps (TRACE_TIMESTAMPS), relative to timeBase.  The end
+         * of every enter event is kept in a ring indexed by call number, to
+         * compute the duration when the leave event is written.
+         */
+        bool timestamps;
+        long long timeBase;
+        unsigned enterCallNo;
+        std::vector<long long> enterTimes;
+
+        /// Record backtraces unsymbolized (APITRACE_BACKTRACE_DEFERRED)
+        bool deferredBacktraces;
+
+        void lock(void);
+        void waitForStateRecreation(void);
+        void unlock(void);
+        void countBlob(size_t size);
+        void logStats(void);
+        void writeStats(void);
+
     public:
         /**
          * Should never called directly -- use localWriter singleton below
@@ -93,8 +227,11 @@ namespace trace {
 
         /**
          * It will acquire the mutex.
+         *
+         * Calls marked always are written to the trace file even while
+         * capture is deferred.
          */
-        unsigned beginEnter(const FunctionSig *sig, bool fake = false);
+        unsigned beginEnter(const FunctionSig *sig, bool fake = false, bool always = false);
 
         /**
          * It will release the mutex.
@@ -112,6 +249,50 @@ namespace trace {
         void endLeave(void);
 
         void flush(void);
+
+        /**
+         * Blobs passed to functions with a blobcap policy are truncated, and
+         * the call flagged so that it is not replayed.
+         */
+        inline void writeBlob(const void *data, size_t size) {
+            if (size > blobLimit) {
+                size = blobLimit;
+                blobTruncated = true;
+            }
+            if (statsEnabled) {
+                countBlob(size);
+            }
+            Writer::writeBlob(data, size);
+        }
+
+        /**
+         * Whether the current enter/leave event is discarded, because capture
+         * is deferred or the capture policy excludes the call, so that the
+         * wrappers can skip serializing its arguments.  Only meaningful with
+         * the mutex held, i.e., between beginEnter/endEnter or
+         * beginLeave/endLeave.
+         */
+        inline bool isDiscarding(void) const {
+            return discarding;
+        }
+
+        /**
+         * Whether calls are being written to the trace file, as opposed to
+         * being discarded while capture is deferred.
+         */
+        inline bool isRecording(void) const {
+            return recording.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * To be called after every frame boundary.  When a deferred capture
+         * is due, it starts writing to the trace file and then invokes the
+         * given callback, without holding the mutex, which must emit fake
+         * calls recreating the current state.  Other threads are held back
+         * until it returns.
+         * When rolling, it also starts a new trace file when due.
+         */
+        void endFrame(void (*recreateState)(void));
     };
 
     /**
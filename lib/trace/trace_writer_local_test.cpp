@@ -0,0 +1,130 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "os.hpp"
+#include "os_process.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer_local.hpp"
+
+
+using namespace trace;
+
+
+static const FunctionSig glDraw_sig = {0, "glDraw", 0, NULL};
+static const FunctionSig glSwap_sig = {1, "glSwap", 0, NULL};
+static const FunctionSig glRecreate_sig = {2, "glRecreate", 0, NULL};
+static const FunctionSig glOther_sig = {3, "glOther", 0, NULL};
+
+
+static LocalWriter *writer;
+static std::thread otherThread;
+
+
+static void
+writeCall(const FunctionSig *sig, bool fake = false)
+{
+    unsigned call = writer->beginEnter(sig, fake);
+    writer->endEnter();
+    writer->beginLeave(call);
+    writer->endLeave();
+}
+
+
+/*
+ * Another thread makes a call while the state is being recreated, which must
+ * only be written once the recreation is done.
+ */
+static void
+recreateState(void)
+{
+    otherThread = std::thread(writeCall, &glOther_sig, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    writeCall(&glRecreate_sig, true);
+}
+
+
+TEST(trace_writer_local, deferredCapture)
+{
+    std::string filename = ::testing::TempDir() + "apitrace-writer-local-" +
+                           std::to_string(os::getCurrentProcessId()) + ".trace";
+    os::setEnvironment("TRACE_FILE", filename.c_str());
+    os::setEnvironment("TRACE_START_FRAME", "2");
+
+    // Only one writer may handle exceptions, and the singleton is idle
+    os::resetExceptionCallback();
+
+    {
+        LocalWriter localWriter;
+        writer = &localWriter;
+        EXPECT_FALSE(localWriter.isRecording());
+
+        writeCall(&glDraw_sig);
+        writeCall(&glSwap_sig);
+        localWriter.endFrame(recreateState);
+        EXPECT_FALSE(localWriter.isRecording());
+        EXPECT_FALSE(otherThread.joinable());
+
+        writeCall(&glDraw_sig);
+        writeCall(&glSwap_sig);
+        localWriter.endFrame(recreateState);
+        EXPECT_TRUE(localWriter.isRecording());
+        ASSERT_TRUE(otherThread.joinable());
+        otherThread.join();
+
+        writeCall(&glDraw_sig);
+        writer = nullptr;
+    }
+
+    os::unsetEnvironment("TRACE_FILE");
+    os::unsetEnvironment("TRACE_START_FRAME");
+
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename.c_str()));
+
+    static const char *names[] = {"glRecreate", "glOther", "glDraw"};
+    unsigned count = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        ASSERT_LT(count, 3u);
+        EXPECT_EQ(call->no, count);
+        EXPECT_STREQ(call->name(), names[count]);
+        EXPECT_EQ(bool(call->flags & CALL_FLAG_FAKE), count == 0);
+        ++count;
+        delete call;
+    }
+    EXPECT_EQ(count, 3u);
+
+    parser.close();
+    remove(filename.c_str());
+}
@@ -114,8 +114,16 @@ public:
 
     void visit(Call *call) {
         unsigned call_no = writer.beginEnter(call->sig, call->thread_id);
+        unsigned flags = 0;
         if (call->flags & CALL_FLAG_FAKE) {
-            writer.writeFlags(FLAG_FAKE);
+            flags |= FLAG_FAKE;
+        }
+        if (call->flags & CALL_FLAG_TRUNCATED) {
+            flags |= FLAG_TRUNCATED;
+        }
+        writer.writeFlags(flags);
+        if (call->timestamp >= 0) {
+            writer.writeTimestamp(call->timestamp);
         }
         if (call->backtrace != NULL) {
             writer.beginBacktrace(call->backtrace->size());
@@ -133,6 +141,9 @@ public:
         }
         writer.endEnter();
         writer.beginLeave(call_no);
+        if (call->duration >= 0) {
+            writer.writeTimestamp(call->duration);
+        }
         if (call->ret) {
             writer.beginReturn();
             _visit(call->ret);
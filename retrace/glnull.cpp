@@ -0,0 +1,505 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Null GL entry-points which need some state: strings and versions matching
+ * the current context, the current program, and buffer objects, whose sizes
+ * are tracked so that they can be mapped.
+ */
+
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "os_thread.hpp"
+#include "os_time.hpp"
+#include "glnull.hpp"
+#include "glws.hpp"
+
+
+namespace glnull {
+
+
+static std::atomic<GLuint>
+nextName(1);
+
+
+GLuint
+allocNames(GLsizei count)
+{
+    if (count <= 0) {
+        return 0;
+    }
+    return nextName.fetch_add(count);
+}
+
+
+void
+allocNames(GLsizei n, GLuint *names)
+{
+    if (n <= 0 || !names) {
+        return;
+    }
+    GLuint first = nextName.fetch_add(n);
+    for (GLsizei i = 0; i < n; ++i) {
+        names[i] = first + i;
+    }
+}
+
+
+static const char *
+extensions[] = {
+    "GL_ARB_buffer_storage",
+    "GL_ARB_direct_state_access",
+    "GL_ARB_map_buffer_range",
+    "GL_ARB_pixel_buffer_object",
+    "GL_ARB_query_buffer_object",
+    "GL_ARB_vertex_buffer_object",
+};
+
+static const char *
+extensionsString =
+    "GL_ARB_buffer_storage "
+    "GL_ARB_direct_state_access "
+    "GL_ARB_map_buffer_range "
+    "GL_ARB_pixel_buffer_object "
+    "GL_ARB_query_buffer_object "
+    "GL_ARB_vertex_buffer_object";
+
+static const GLint
+numExtensions = sizeof extensions / sizeof extensions[0];
+
+
+/*
+ * The highest version of the requested API is reported, so that the context
+ * matches whatever the trace asked for.
+ */
+static glfeatures::Profile
+getCurrentProfile(void)
+{
+    const glws::Context *context = glws::null::getCurrentContext();
+    glfeatures::Profile profile(glfeatures::API_GL, 4, 6);
+    if (context) {
+        profile.api = context->profile.api;
+        profile.core = context->profile.core;
+        profile.forwardCompatible = context->profile.forwardCompatible;
+        if (profile.api == glfeatures::API_GLES) {
+            if (context->profile.major < 2) {
+                profile.major = 1;
+                profile.minor = 1;
+            } else {
+                profile.major = 3;
+                profile.minor = 2;
+            }
+        }
+    }
+    return profile;
+}
+
+
+/*
+ * Buffer bindings are tracked per thread rather than per context, which is
+ * good enough for mapping.
+ */
+enum {
+    BINDING_ARRAY,
+    BINDING_ELEMENT_ARRAY,
+    BINDING_PIXEL_PACK,
+    BINDING_PIXEL_UNPACK,
+    BINDING_QUERY,
+    BINDING_OTHER,
+    BINDING_COUNT
+};
+
+static OS_THREAD_LOCAL GLuint
+bufferBindings[BINDING_COUNT];
+
+static OS_THREAD_LOCAL GLenum
+otherBindingTarget;
+
+static OS_THREAD_LOCAL GLuint
+currentProgram;
+
+
+static GLuint *
+lookupBinding(GLenum target)
+{
+    switch (target) {
+    case GL_ARRAY_BUFFER:
+        return &bufferBindings[BINDING_ARRAY];
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return &bufferBindings[BINDING_ELEMENT_ARRAY];
+    case GL_PIXEL_PACK_BUFFER:
+        return &bufferBindings[BINDING_PIXEL_PACK];
+    case GL_PIXEL_UNPACK_BUFFER:
+        return &bufferBindings[BINDING_PIXEL_UNPACK];
+    case GL_QUERY_BUFFER:
+        return &bufferBindings[BINDING_QUERY];
+    default:
+        // Remember only the last of the remaining targets, which is the one
+        // mapped right after binding in practice
+        if (target != otherBindingTarget) {
+            otherBindingTarget = target;
+            bufferBindings[BINDING_OTHER] = 0;
+        }
+        return &bufferBindings[BINDING_OTHER];
+    }
+}
+
+
+struct Buffer
+{
+    GLsizeiptr size = 0;
+
+    // Backing memory for mappings, allocated on demand
+    std::vector<char> storage;
+    void *mapPointer = nullptr;
+};
+
+static std::mutex
+buffersMutex;
+
+static std::map<GLuint, Buffer>
+buffers;
+
+
+static void
+bufferData(GLuint buffer, GLsizeiptr size)
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    Buffer &obj = buffers[buffer];
+    obj.size = size;
+    obj.mapPointer = nullptr;
+}
+
+
+static void *
+mapBuffer(GLuint buffer, GLintptr offset, GLsizeiptr length)
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    Buffer &obj = buffers[buffer];
+    if (length < 0) {
+        length = obj.size - offset;
+    }
+    if (offset < 0 || length <= 0) {
+        return nullptr;
+    }
+    size_t end = offset + length;
+    if (obj.storage.size() < end) {
+        obj.storage.resize(end);
+    }
+    obj.mapPointer = &obj.storage[offset];
+    return obj.mapPointer;
+}
+
+
+static GLboolean
+unmapBuffer(GLuint buffer)
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    Buffer &obj = buffers[buffer];
+    obj.mapPointer = nullptr;
+    return GL_TRUE;
+}
+
+
+static void
+getBufferParameteriv(GLuint buffer, GLenum pname, GLint *params)
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    const Buffer &obj = buffers[buffer];
+    switch (pname) {
+    case GL_BUFFER_SIZE:
+        *params = static_cast<GLint>(obj.size);
+        break;
+    case GL_BUFFER_MAPPED:
+        *params = obj.mapPointer != nullptr;
+        break;
+    default:
+        *params = 0;
+        break;
+    }
+}
+
+
+static void
+getBufferPointerv(GLuint buffer, GLenum pname, void **params)
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    const Buffer &obj = buffers[buffer];
+    *params = pname == GL_BUFFER_MAP_POINTER ? obj.mapPointer : nullptr;
+}
+
+
+} /* namespace glnull */
+
+
+using namespace glnull;
+
+
+const GLubyte * APIENTRY
+_null_glGetString(GLenum name)
+{
+    if (!glws::null::getCurrentContext()) {
+        return nullptr;
+    }
+
+    glfeatures::Profile profile = getCurrentProfile();
+    const char *string;
+    switch (name) {
+    case GL_VENDOR:
+        string = "apitrace";
+        break;
+    case GL_RENDERER:
+        string = "null";
+        break;
+    case GL_VERSION:
+        if (profile.api == glfeatures::API_GLES) {
+            string = profile.major < 2 ? "OpenGL ES-CM 1.1 null" : "OpenGL ES 3.2 null";
+        } else {
+            string = profile.core ? "4.6 (Core Profile) null" : "4.6 (Compatibility Profile) null";
+        }
+        break;
+    case GL_SHADING_LANGUAGE_VERSION:
+        string = profile.api == glfeatures::API_GLES ? "OpenGL ES GLSL ES 3.20" : "4.60";
+        break;
+    case GL_EXTENSIONS:
+        string = extensionsString;
+        break;
+    default:
+        return nullptr;
+    }
+    return reinterpret_cast<const GLubyte *>(string);
+}
+
+
+const GLubyte * APIENTRY
+_null_glGetStringi(GLenum name, GLuint index)
+{
+    if (name != GL_EXTENSIONS || index >= static_cast<GLuint>(numExtensions)) {
+        return nullptr;
+    }
+    return reinterpret_cast<const GLubyte *>(extensions[index]);
+}
+
+
+void APIENTRY
+_null_glGetIntegerv(GLenum pname, GLint *params)
+{
+    if (!params) {
+        return;
+    }
+
+    glfeatures::Profile profile = getCurrentProfile();
+    switch (pname) {
+    case GL_MAJOR_VERSION:
+        *params = profile.major;
+        break;
+    case GL_MINOR_VERSION:
+        *params = profile.minor;
+        break;
+    case GL_CONTEXT_FLAGS:
+        *params = profile.forwardCompatible ? GL_CONTEXT_FLAG_FORWARD_COMPATIBLE_BIT : 0;
+        break;
+    case GL_CONTEXT_PROFILE_MASK:
+        *params = profile.core ? GL_CONTEXT_CORE_PROFILE_BIT : GL_CONTEXT_COMPATIBILITY_PROFILE_BIT;
+        break;
+    case GL_NUM_EXTENSIONS:
+        *params = numExtensions;
+        break;
+    case GL_MAX_SAMPLES:
+    case GL_MAX_RASTER_SAMPLES_EXT:
+        *params = 16;
+        break;
+    case GL_CURRENT_PROGRAM:
+        *params = currentProgram;
+        break;
+    case GL_ARRAY_BUFFER_BINDING:
+        *params = *lookupBinding(GL_ARRAY_BUFFER);
+        break;
+    case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+        *params = *lookupBinding(GL_ELEMENT_ARRAY_BUFFER);
+        break;
+    case GL_PIXEL_PACK_BUFFER_BINDING:
+        *params = *lookupBinding(GL_PIXEL_PACK_BUFFER);
+        break;
+    case GL_PIXEL_UNPACK_BUFFER_BINDING:
+        *params = *lookupBinding(GL_PIXEL_UNPACK_BUFFER);
+        break;
+    case GL_QUERY_BUFFER_BINDING:
+        *params = *lookupBinding(GL_QUERY_BUFFER);
+        break;
+    default:
+        *params = 0;
+        break;
+    }
+}
+
+
+void APIENTRY
+_null_glGetInteger64v(GLenum pname, GLint64 *params)
+{
+    if (!params) {
+        return;
+    }
+
+    if (pname == GL_TIMESTAMP) {
+        *params = os::getTime() * (1.0e9 / os::timeFrequency);
+        return;
+    }
+
+    GLint value = 0;
+    _null_glGetIntegerv(pname, &value);
+    *params = value;
+}
+
+
+void APIENTRY
+_null_glUseProgram(GLuint program)
+{
+    currentProgram = program;
+}
+
+
+void APIENTRY
+_null_glBindBuffer(GLenum target, GLuint buffer)
+{
+    *lookupBinding(target) = buffer;
+}
+
+
+void APIENTRY
+_null_glDeleteBuffers(GLsizei n, const GLuint *names)
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (GLsizei i = 0; i < n; ++i) {
+        buffers.erase(names[i]);
+        for (GLuint &binding : bufferBindings) {
+            if (binding == names[i]) {
+                binding = 0;
+            }
+        }
+    }
+}
+
+
+void APIENTRY
+_null_glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+    bufferData(*lookupBinding(target), size);
+}
+
+
+void APIENTRY
+_null_glBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+{
+    bufferData(*lookupBinding(target), size);
+}
+
+
+void APIENTRY
+_null_glNamedBufferData(GLuint buffer, GLsizeiptr size, const void *data, GLenum usage)
+{
+    bufferData(buffer, size);
+}
+
+
+void APIENTRY
+_null_glNamedBufferStorage(GLuint buffer, GLsizeiptr size, const void *data, GLbitfield flags)
+{
+    bufferData(buffer, size);
+}
+
+
+void * APIENTRY
+_null_glMapBuffer(GLenum target, GLenum access)
+{
+    return mapBuffer(*lookupBinding(target), 0, -1);
+}
+
+
+void * APIENTRY
+_null_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    return mapBuffer(*lookupBinding(target), offset, length);
+}
+
+
+void * APIENTRY
+_null_glMapNamedBuffer(GLuint buffer, GLenum access)
+{
+    return mapBuffer(buffer, 0, -1);
+}
+
+
+void * APIENTRY
+_null_glMapNamedBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    return mapBuffer(buffer, offset, length);
+}
+
+
+GLboolean APIENTRY
+_null_glUnmapBuffer(GLenum target)
+{
+    return unmapBuffer(*lookupBinding(target));
+}
+
+
+GLboolean APIENTRY
+_null_glUnmapNamedBuffer(GLuint buffer)
+{
+    return unmapBuffer(buffer);
+}
+
+
+void APIENTRY
+_null_glGetBufferParameteriv(GLenum target, GLenum pname, GLint *params)
+{
+    getBufferParameteriv(*lookupBinding(target), pname, params);
+}
+
+
+void APIENTRY
+_null_glGetNamedBufferParameteriv(GLuint buffer, GLenum pname, GLint *params)
+{
+    getBufferParameteriv(buffer, pname, params);
+}
+
+
+void APIENTRY
+_null_glGetBufferPointerv(GLenum target, GLenum pname, void **params)
+{
+    getBufferPointerv(*lookupBinding(target), pname, params);
+}
+
+
+void APIENTRY
+_null_glGetNamedBufferPointerv(GLuint buffer, GLenum pname, void **params)
+{
+    getBufferPointerv(buffer, pname, params);
+}
@@ -0,0 +1,61 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Null GL driver, used with `--driver=null` to measure glretrace's own CPU
+ * overhead (parsing, swizzling, dispatch) without a GPU.
+ *
+ * Every GL entry-point resolves to a stub which renders nothing but returns
+ * plausible values.  See glnull.py for the generated stubs, and glws_null.cpp
+ * for the matching window system.
+ */
+
+#pragma once
+
+
+#include "glimports.hpp"
+
+
+/*
+ * Lookup the stub for the given GL entry-point, or NULL if there is none.
+ */
+void *
+_getNullProcAddress(const char *procName);
+
+
+namespace glnull {
+
+
+/*
+ * Allocate `count` consecutive object names, returning the first.
+ */
+GLuint
+allocNames(GLsizei count);
+
+void
+allocNames(GLsizei n, GLuint *names);
+
+
+} /* namespace glnull */
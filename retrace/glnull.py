@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+##########################################################################
+#
+# Copyright 2026 The apitrace authors
+# All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+##########################################################################/
+
+
+"""Generate stub GL entry-points for the null driver (glretrace --driver=null).
+
+Stubs don't render anything, but return plausible values: fresh object names
+from glGen*/glCreate*, GL_NO_ERROR, complete framebuffers, signaled syncs,
+available queries, and zero elsewhere.  Entry-points which need some state,
+like the current program and buffer mappings, are implemented by hand in
+glnull.cpp.
+"""
+
+
+import re
+
+import retrace # to adjust sys.path
+
+import specs.stdapi as stdapi
+from specs.glapi import glapi
+
+
+# Entry-points implemented in glnull.cpp, and the aliases which share them
+overrides = {
+    'glGetString': 'glGetString',
+    'glGetStringi': 'glGetStringi',
+    'glGetIntegerv': 'glGetIntegerv',
+    'glGetInteger64v': 'glGetInteger64v',
+    'glUseProgram': 'glUseProgram',
+    'glUseProgramObjectARB': 'glUseProgram',
+    'glBindBuffer': 'glBindBuffer',
+    'glBindBufferARB': 'glBindBuffer',
+    'glDeleteBuffers': 'glDeleteBuffers',
+    'glDeleteBuffersARB': 'glDeleteBuffers',
+    'glBufferData': 'glBufferData',
+    'glBufferDataARB': 'glBufferData',
+    'glBufferStorage': 'glBufferStorage',
+    'glBufferStorageEXT': 'glBufferStorage',
+    'glNamedBufferData': 'glNamedBufferData',
+    'glNamedBufferDataEXT': 'glNamedBufferData',
+    'glNamedBufferStorage': 'glNamedBufferStorage',
+    'glNamedBufferStorageEXT': 'glNamedBufferStorage',
+    'glMapBuffer': 'glMapBuffer',
+    'glMapBufferARB': 'glMapBuffer',
+    'glMapBufferOES': 'glMapBuffer',
+    'glMapBufferRange': 'glMapBufferRange',
+    'glMapBufferRangeEXT': 'glMapBufferRange',
+    'glMapNamedBuffer': 'glMapNamedBuffer',
+    'glMapNamedBufferEXT': 'glMapNamedBuffer',
+    'glMapNamedBufferRange': 'glMapNamedBufferRange',
+    'glMapNamedBufferRangeEXT': 'glMapNamedBufferRange',
+    'glUnmapBuffer': 'glUnmapBuffer',
+    'glUnmapBufferARB': 'glUnmapBuffer',
+    'glUnmapBufferOES': 'glUnmapBuffer',
+    'glUnmapNamedBuffer': 'glUnmapNamedBuffer',
+    'glUnmapNamedBufferEXT': 'glUnmapNamedBuffer',
+    'glGetBufferParameteriv': 'glGetBufferParameteriv',
+    'glGetBufferParameterivARB': 'glGetBufferParameteriv',
+    'glGetNamedBufferParameteriv': 'glGetNamedBufferParameteriv',
+    'glGetNamedBufferParameterivEXT': 'glGetNamedBufferParameteriv',
+    'glGetBufferPointerv': 'glGetBufferPointerv',
+    'glGetBufferPointervARB': 'glGetBufferPointerv',
+    'glGetBufferPointervOES': 'glGetBufferPointerv',
+    'glGetNamedBufferPointerv': 'glGetNamedBufferPointerv',
+    'glGetNamedBufferPointervEXT': 'glGetNamedBufferPointerv',
+}
+
+
+class NullDispatcher:
+
+    gen_function_regex = re.compile(r'^gl(Gen|Create)[A-Z]\w*s(ARB|EXT|OES|NV|AMD|APPLE|ATI|INTEL)?$')
+    status_function_regex = re.compile(r'^glGet(Shader|Program|ObjectParameter)iv(ARB)?$')
+
+    def __init__(self):
+        self.functions = {}
+        for function in glapi.functions:
+            self.functions[function.name] = function
+
+    def stubName(self, name):
+        return '_null_' + name
+
+    def declareOverride(self, function):
+        print(function.prototype(self.stubName(function.name)) + ';')
+
+    def stubFunction(self, function):
+        print('static ' + function.prototype(self.stubName(function.name)) + ' {')
+        for arg in function.args:
+            if arg.output:
+                self.stubOutArg(function, arg)
+        self.stubReturn(function)
+        print('}')
+        print()
+
+    def stubOutArg(self, function, arg):
+        arg_type = arg.type
+        if isinstance(arg_type, stdapi.Array) and \
+           isinstance(arg_type.type, stdapi.Handle) and \
+           self.gen_function_regex.match(function.name):
+            print('    glnull::allocNames(%s, %s);' % (arg_type.length, arg.name))
+            return
+
+        if function.name.startswith('glGetQueryObject'):
+            print('    if (%s) {' % arg.name)
+            print('        *%s = pname == GL_QUERY_RESULT_AVAILABLE;' % arg.name)
+            print('    }')
+            return
+
+        if self.status_function_regex.match(function.name):
+            print('    if (%s) {' % arg.name)
+            indent = ' ' * (len(arg.name) + 12)
+            print('        *%s = pname == GL_COMPILE_STATUS ||' % arg.name)
+            print(indent + 'pname == GL_LINK_STATUS ||')
+            print(indent + 'pname == GL_VALIDATE_STATUS;')
+            print('    }')
+            return
+
+        # Zero the first element of other outputs, as far as it is known to
+        # be there
+        if isinstance(arg_type, (stdapi.Array, stdapi.Pointer)):
+            elem_type = arg_type.type
+            if isinstance(elem_type, (stdapi.Const, stdapi.Struct, stdapi.String)) or \
+               elem_type is stdapi.Void:
+                return
+            condition = arg.name
+            if isinstance(arg_type, stdapi.Array) and \
+               arg_type.length in function.argNames():
+                condition += ' && %s > 0' % arg_type.length
+            print('    if (%s) {' % condition)
+            print('        *%s = 0;' % arg.name)
+            print('    }')
+
+    def stubReturn(self, function):
+        if function.type is stdapi.Void:
+            return
+
+        name = function.name
+        if name.startswith('glCheck') and name.find('FramebufferStatus') >= 0:
+            print('    return GL_FRAMEBUFFER_COMPLETE;')
+        elif name.startswith('glClientWaitSync'):
+            print('    return GL_ALREADY_SIGNALED;')
+        elif name.startswith('glIs'):
+            print('    return GL_TRUE;')
+        elif name.startswith(('glGen', 'glCreate', 'glFenceSync', 'glImportSync')) and \
+             isinstance(function.type, stdapi.Handle) or \
+             name.startswith('glGen') and 'range' in function.argNames():
+            count = '1'
+            if 'range' in function.argNames():
+                count = 'range'
+            if isinstance(function.type, stdapi.Handle) and \
+               isinstance(function.type.type, stdapi.IntPointer):
+                print('    return reinterpret_cast<%s>(static_cast<uintptr_t>(glnull::allocNames(%s)));' % (function.type, count))
+            else:
+                print('    return glnull::allocNames(%s);' % count)
+        else:
+            print('    return 0;')
+
+    def dispatchApi(self):
+        print('#include <stdint.h>')
+        print('#include <string.h>')
+        print()
+        print('#include <algorithm>')
+        print()
+        print('#include "glnull.hpp"')
+        print()
+        print()
+
+        for name in sorted(set(overrides.values())):
+            self.declareOverride(self.functions[name])
+        print()
+        print()
+
+        names = sorted(self.functions.keys())
+        for name in names:
+            if name not in overrides:
+                self.stubFunction(self.functions[name])
+
+        print('struct NullProc {')
+        print('    const char *name;')
+        print('    void *proc;')
+        print('};')
+        print()
+        print('// Sorted by name')
+        print('static const NullProc')
+        print('_nullProcs[] = {')
+        for name in names:
+            stub = self.stubName(overrides.get(name, name))
+            print('    { "%s", (void *)&%s },' % (name, stub))
+        print('};')
+        print()
+        print('void *')
+        print('_getNullProcAddress(const char *procName)')
+        print('{')
+        print('    const NullProc *begin = _nullProcs;')
+        print('    const NullProc *end = _nullProcs + sizeof _nullProcs / sizeof _nullProcs[0];')
+        print('    const NullProc *it = std::lower_bound(begin, end, procName,')
+        print('        [](const NullProc &entry, const char *name) {')
+        print('            return strcmp(entry.name, name) < 0;')
+        print('        });')
+        print('    if (it != end && strcmp(it->name, procName) == 0) {')
+        print('        return it->proc;')
+        print('    }')
+        print('    return nullptr;')
+        print('}')
+
+
+if __name__ == '__main__':
+    print()
+    print('/* Generated by glnull.py -- do not edit */')
+    print()
+
+    dispatcher = NullDispatcher()
+    dispatcher.dispatchApi()
@@ -25,6 +25,8 @@
 
 
 #include "glproc.hpp"
+#include "glnull.hpp"
+#include "glws.hpp"
 
 #include <string.h>
 
@@ -66,6 +68,10 @@ void *_libGlHandle = NULL;
 void *
 _getPublicProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     void *proc;
 
     /*
@@ -171,6 +177,10 @@ _getPublicProcAddress(const char *procName)
 void *
 _getPrivateProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     void *proc;
     proc = _getPublicProcAddress(procName);
     if (!proc &&
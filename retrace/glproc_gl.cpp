@@ -25,6 +25,8 @@
 
 
 #include "glproc.hpp"
+#include "glnull.hpp"
+#include "glws.hpp"
 #include "os.hpp"
 #include "os_string.hpp"
 
@@ -50,6 +52,10 @@ void *_libGlHandle = NULL;
 void *
 _getPublicProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     if (!_libGlHandle) {
         const char *szDll = "opengl32.dll";
         
@@ -66,6 +72,10 @@ _getPublicProcAddress(const char *procName)
 
 void *
 _getPrivateProcAddress(const char *procName) {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     return (void *)_wglGetProcAddress(procName);
 }
 
@@ -101,12 +111,20 @@ void * _libgl_sym(const char *symbol)
 void *
 _getPublicProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     return _libgl_sym(procName);
 }
 
 void *
 _getPrivateProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     return _libgl_sym(procName);
 }
 
@@ -136,12 +154,20 @@ void * _libgl_sym(const char *symbol)
 void *
 _getPublicProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     return _libgl_sym(procName);
 }
 
 void *
 _getPrivateProcAddress(const char *procName)
 {
+    if (glws::useNull()) {
+        return _getNullProcAddress(procName);
+    }
+
     return (void *)_glXGetProcAddressARB((const GLubyte *)procName);
 }
 
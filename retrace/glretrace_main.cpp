@@ -74,6 +74,8 @@ struct CallQuery
     int64_t vsizeEnd;
     int64_t rssStart;
     int64_t rssEnd;
+    int64_t origStart;
+    int64_t origDuration;
 };
 
 static bool supportsElapsed = true;
@@ -259,7 +261,7 @@ completeCallQuery(CallQuery& query) {
     glDeleteQueries(NUM_QUERIES, query.ids);
 
     /* Add call to profile */
-    retrace::profiler.addCall(query.call, query.sig->name, query.program, pixels, gpuStart, gpuDuration, query.cpuStart, cpuDuration, query.vsizeStart, vsizeDuration, query.rssStart, rssDuration);
+    retrace::profiler.addCall(query.call, query.sig->name, query.program, pixels, gpuStart, gpuDuration, query.cpuStart, cpuDuration, query.vsizeStart, vsizeDuration, query.rssStart, rssDuration, query.origStart, query.origDuration);
 }
 
 void
@@ -307,6 +309,8 @@ beginProfile(trace::Call &call, bool isDraw) {
     query.call = call.no;
     query.sig = call.sig;
     query.program = currentContext ? currentContext->currentUserProgram : 0;
+    query.origStart = call.timestamp;
+    query.origDuration = call.duration;
 
     glGenQueries(NUM_QUERIES, query.ids);
 
@@ -851,7 +855,9 @@ retrace::setFeatureLevel(const char *featureLevel)
 
 void
 retrace::setUp(void) {
-    glws::init();
+    if (!glws::useNull()) {
+        glws::init();
+    }
     dumper = &glDumper;
 }
 
@@ -919,14 +925,16 @@ retrace::finishRendering(void) {
 void
 retrace::waitForInput(void) {
     flushRendering();
-    while (glws::processEvents()) {
+    while (!glws::useNull() && glws::processEvents()) {
         os::sleep(100*1000);
     }
 }
 
 void
 retrace::cleanUp(void) {
-    glws::cleanup();
+    if (!glws::useNull()) {
+        glws::cleanup();
+    }
 }
 
 static GLint
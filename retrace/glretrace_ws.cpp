@@ -58,7 +58,11 @@ getVisual(glfeatures::Profile profile) {
         unsigned samples = requested_samples;
         /* The requested number of samples might not be available, try fewer until we succeed */
         while (!visual && samples > 0) {
-            visual = glws::createVisual(retrace::doubleBuffer, samples, profile);
+            if (glws::useNull()) {
+                visual = glws::null::createVisual(retrace::doubleBuffer, samples, profile);
+            } else {
+                visual = glws::createVisual(retrace::doubleBuffer, samples, profile);
+            }
             if (!visual) {
                 samples--;
             }
@@ -81,7 +85,9 @@ static glws::Drawable *
 createDrawableHelper(glfeatures::Profile profile, int width = 32, int height = 32,
                      const glws::pbuffer_info *pbInfo = NULL) {
     glws::Visual *visual = getVisual(profile);
-    glws::Drawable *draw = glws::createDrawable(visual, width, height, pbInfo);
+    glws::Drawable *draw = glws::useNull()
+        ? glws::null::createDrawable(visual, width, height, pbInfo)
+        : glws::createDrawable(visual, width, height, pbInfo);
     if (!draw) {
         std::cerr << "error: failed to create OpenGL drawable\n";
         exit(1);
@@ -121,7 +127,9 @@ Context *
 createContext(Context *shareContext, glfeatures::Profile profile) {
     glws::Visual *visual = getVisual(profile);
     glws::Context *shareWsContext = shareContext ? shareContext->wsContext : NULL;
-    glws::Context *ctx = glws::createContext(visual, shareWsContext, retrace::debug > 0);
+    glws::Context *ctx = glws::useNull()
+        ? glws::null::createContext(visual, shareWsContext, retrace::debug > 0)
+        : glws::createContext(visual, shareWsContext, retrace::debug > 0);
     if (!ctx) {
         std::cerr << "error: failed to create " << profile << " context.\n";
         exit(1);
@@ -382,18 +390,27 @@ parseContextAttribList(const trace::Value *attribs)
 // WGL_ARB_render_texture / wglBindTexImageARB()
 bool
 bindTexImage(glws::Drawable *pBuffer, int iBuffer) {
+    if (glws::useNull()) {
+        return true;
+    }
     return glws::bindTexImage(pBuffer, iBuffer);
 }
 
 // WGL_ARB_render_texture / wglReleaseTexImageARB()
 bool
 releaseTexImage(glws::Drawable *pBuffer, int iBuffer) {
+    if (glws::useNull()) {
+        return true;
+    }
     return glws::releaseTexImage(pBuffer, iBuffer);
 }
 
 // WGL_ARB_render_texture / wglSetPbufferAttribARB()
 bool
 setPbufferAttrib(glws::Drawable *pBuffer, const int *attribs) {
+    if (glws::useNull()) {
+        return true;
+    }
     return glws::setPbufferAttrib(pBuffer, attribs);
 }
 
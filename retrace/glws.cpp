@@ -69,6 +69,13 @@ checkExtension(const char *extName, const char *extString)
 }
 
 
+bool
+useNull(void)
+{
+    return retrace::driver == retrace::DRIVER_NULL;
+}
+
+
 void
 Drawable::copySubBuffer(int x, int y, int width, int height) {
     std::cerr << "warning: copySubBuffer not yet implemented\n";
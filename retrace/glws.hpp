@@ -217,10 +217,43 @@ createContext(const Visual *visual, Context *shareContext = 0, bool debug = fals
 bool
 makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context);
 
+
+/*
+ * Null window system, which only pretends to create visuals, drawables and
+ * contexts, and needs no display.  It's used instead of the native one with
+ * `--driver=null`, together with the null GL entry-points of glnull.hpp.
+ */
+namespace null {
+
+Visual *
+createVisual(bool doubleBuffer, unsigned samples, Profile profile);
+
+Drawable *
+createDrawable(const Visual *visual, int width, int height,
+               const glws::pbuffer_info *pbInfo = NULL);
+
+Context *
+createContext(const Visual *visual, Context *shareContext = 0, bool debug = false);
+
+bool
+makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context);
+
+const Context *
+getCurrentContext(void);
+
+} /* namespace null */
+
+// Whether the null window system is in use
+bool
+useNull(void);
+
+
 inline bool
 makeCurrent(Drawable *drawable, Drawable *readable, Context *context)
 {
-    bool success = makeCurrentInternal(drawable, readable, context);
+    bool success = useNull()
+        ? null::makeCurrentInternal(drawable, readable, context)
+        : makeCurrentInternal(drawable, readable, context);
     if (success && context && !context->initialized) {
         context->initialize();
     }
@@ -0,0 +1,103 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "os_thread.hpp"
+#include "glws.hpp"
+
+
+namespace glws {
+
+namespace null {
+
+
+class NullVisual : public Visual
+{
+public:
+    NullVisual(Profile prof, bool db) :
+        Visual(prof)
+    {
+        doubleBuffer = db;
+    }
+};
+
+
+class NullDrawable : public Drawable
+{
+public:
+    NullDrawable(const Visual *vis, int w, int h, bool pb) :
+        Drawable(vis, w, h, pb)
+    {}
+
+    void
+    swapBuffers(void) override {
+    }
+};
+
+
+static OS_THREAD_LOCAL const Context *
+currentContext = nullptr;
+
+
+Visual *
+createVisual(bool doubleBuffer, unsigned samples, Profile profile)
+{
+    return new NullVisual(profile, doubleBuffer);
+}
+
+
+Drawable *
+createDrawable(const Visual *visual, int width, int height,
+               const glws::pbuffer_info *pbInfo)
+{
+    return new NullDrawable(visual, width, height, pbInfo != nullptr);
+}
+
+
+Context *
+createContext(const Visual *visual, Context *shareContext, bool debug)
+{
+    return new Context(visual);
+}
+
+
+bool
+makeCurrentInternal(Drawable *drawable, Drawable *readable, Context *context)
+{
+    currentContext = context;
+    return true;
+}
+
+
+const Context *
+getCurrentContext(void)
+{
+    return currentContext;
+}
+
+
+} /* namespace null */
+
+} /* namespace glws */
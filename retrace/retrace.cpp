@@ -156,6 +156,14 @@ void Retracer::retrace(trace::Call &call) {
         }
     }
 
+    // Replaying truncated blobs would read past their end
+    if (call.flags & trace::CALL_FLAG_TRUNCATED) {
+        if (verbosity >= 0) {
+            warning(call) << "skipping call with truncated blobs\n";
+        }
+        return;
+    }
+
     callback(call);
 }
 
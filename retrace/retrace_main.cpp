@@ -29,6 +29,8 @@
 #include <string.h>
 #include <atomic>
 #include <limits.h> // for CHAR_MAX
+#include <fstream>
+#include <map>
 #include <memory> // for unique_ptr
 #include <iostream>
 #include <regex>
@@ -53,6 +55,7 @@
 #include "trace_callset.hpp"
 #include "trace_dump.hpp"
 #include "trace_option.hpp"
+#include "trace_plan.hpp"
 #include "retrace.hpp"
 #include "state_writer.hpp"
 #include "ws.hpp"
@@ -66,9 +69,18 @@ static const char *snapshotPrefix = "";
 static enum {
     PNM_FMT,
     RAW_RGB,
-    RAW_MD5
+    RAW_MD5,
+    RAW_HASH
 } snapshotFormat = PNM_FMT;
 
+static enum {
+    DEDUP_NONE,
+    DEDUP_SKIP,
+    DEDUP_LINK
+} snapshotDedup = DEDUP_NONE;
+
+static std::ofstream snapshotManifest;
+
 static trace::CallSet snapshotFrequency;
 static unsigned snapshotInterval = 0;
 
@@ -136,6 +148,16 @@ long long lastFrameTime = 0;
 long long perFrameDelayUsec = 0;
 long long minFrameDurationUsec = 0;
 
+/*
+ * Pacing state (--pace), shared by all retrace threads.
+ */
+static bool pacing = false;
+static std::mutex paceMutex;
+static long long paceStartTime = 0;
+static long long paceStartTimestamp = -1;
+static unsigned paceFrameStartCallNo = 0;
+static bool paceFrameEnded = true;
+
 static void
 takeSnapshot(unsigned call_no, bool backBuffer);
 
@@ -296,11 +318,38 @@ Dumper *dumper = &defaultDumper;
 
 typedef StateWriter *(*StateWriterFactory)(std::ostream &);
 static StateWriterFactory stateWriterFactory = createJSONStateWriter;
+static StateWriter::ImageFormat dumpImageFormat = StateWriter::IMAGE_FORMAT_PNG;
 
 
 static Snapshotter *snapshotter;
 
 
+/**
+ * Last snapshot written for each render target, to detect duplicates.
+ */
+struct LastSnapshot {
+    image::Digest digest;
+    os::String filename;
+};
+
+static std::map<int, LastSnapshot> lastSnapshots;
+
+
+/**
+ * Wait for pending snapshots, before exiting.
+ */
+static void
+finishSnapshots(void)
+{
+    delete snapshotter;
+    snapshotter = nullptr;
+
+    if (snapshotManifest.is_open()) {
+        snapshotManifest.close();
+    }
+}
+
+
 /**
  * Take snapshots.
  */
@@ -335,6 +384,9 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no, bool backBuffer) {
             case RAW_MD5:
                 src->writeMD5(std::cout);
                 break;
+            case RAW_HASH:
+                src->writeHash(std::cout);
+                break;
             default:
                 assert(0);
                 break;
@@ -356,6 +408,30 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no, bool backBuffer) {
                 filename = os::String::format("%s%010u-mrt%u.png", snapshotPrefix, no, mrt);
             }
 
+            if (snapshotDedup != DEDUP_NONE || snapshotManifest.is_open()) {
+                image::Digest digest = src->hash();
+                LastSnapshot &last = lastSnapshots[mrt];
+                bool duplicate = snapshotDedup != DEDUP_NONE &&
+                                 last.filename.length() &&
+                                 last.digest == digest;
+
+                if (snapshotManifest.is_open()) {
+                    const os::String &pixels =
+                        duplicate && snapshotDedup == DEDUP_SKIP ? last.filename : filename;
+                    snapshotManifest << no << " " << digest.str() << " " << pixels << "\n";
+                }
+
+                if (duplicate) {
+                    if (snapshotDedup == DEDUP_LINK) {
+                        snapshotter->linkPNG(filename, last.filename);
+                    }
+                    return;
+                }
+
+                last.digest = digest;
+                last.filename = filename;
+            }
+
             // Here we release our ownership on the Image, it is now the
             // responsibility of the snapshotter to delete it.
             snapshotter->writePNG(filename, src.release());
@@ -389,6 +465,50 @@ takeSnapshot(unsigned call_no, bool backBuffer)
 }
 
 
+/**
+ * Wait until the call is due, according to the timestamps recorded in the
+ * trace, relative to the first call.  Calls that are already late are not
+ * waited for, so a replay slower than the application just runs flat out.
+ *
+ * Timestamps of calls from different threads are not strictly ordered, so
+ * pacing only starts over when the last frame is looped (--loop), which is
+ * told apart by the first call of a frame not being newer than the first
+ * call of the previous one.
+ */
+static void
+paceCall(const trace::Call *call) {
+    if (call->timestamp < 0) {
+        return;
+    }
+
+    long long now = os::getTime();
+    long long due;
+    {
+        std::lock_guard<std::mutex> lock(paceMutex);
+
+        bool frameStart = paceFrameEnded;
+        paceFrameEnded = call->flags & trace::CALL_FLAG_END_FRAME;
+        if (frameStart) {
+            bool looping = paceStartTimestamp >= 0 &&
+                           call->no <= paceFrameStartCallNo;
+            paceFrameStartCallNo = call->no;
+            if (paceStartTimestamp < 0 || looping) {
+                paceStartTimestamp = call->timestamp;
+                paceStartTime = now;
+                return;
+            }
+        }
+
+        due = paceStartTime +
+            (call->timestamp - paceStartTimestamp) * (os::timeFrequency / 1.0e9);
+    }
+
+    if (due > now) {
+        os::sleep((due - now) * 1000 * 1000 / os::timeFrequency);
+    }
+}
+
+
 /**
  * Retrace one call.
  *
@@ -403,11 +523,16 @@ retraceCall(trace::Call *call) {
         return;
     }
 
+    if (pacing) {
+        paceCall(call);
+    }
+
     retracer.retrace(*call);
 
     if (snapshotFrequency.contains(*call)) {
         takeSnapshot(call->no, snapshotForceBackbuffer);
         if (call->no >= snapshotFrequency.getLast()) {
+            finishSnapshots();
             exit(0);
         }
     }
@@ -416,6 +541,7 @@ retraceCall(trace::Call *call) {
     if (call->no == dumpStateCallNo || dumpStateCallNo == 0) {
         if (dumper->canDump()) {
             StateWriter *writer = stateWriterFactory(std::cout);
+            writer->imageFormat = dumpImageFormat;
             dumper->dumpState(*writer);
             delete writer;
             exit(0);
@@ -800,7 +926,9 @@ usage(const char *argv0) {
         "      --msaa-no-resolve   dump raw sample images of multisampled texture instead of resolved texture\n"
         "  -s, --snapshot-prefix=PREFIX    take snapshots; `-` for PNM stdout output\n"
         "      --snapshot-alpha    Include alpha channel in snapshots.\n"
-        "      --snapshot-format=FMT       use (PNM, RGB, or MD5; default is PNM) when writing to stdout output\n"
+        "      --snapshot-format=FMT       use (PNM, RGB, MD5, or HASH; default is PNM) when writing to stdout output\n"
+        "      --snapshot-dedup=MODE       `skip` or `link` snapshots identical to the previous one (default is `none`)\n"
+        "      --snapshot-manifest=FILE    write the number, hash, and filename of each snapshot to FILE\n"
         "  -S, --snapshot=CALLSET  calls to snapshot (default is every frame)\n"
         "      --snapshot-interval=N    specify a frame interval when generating snaphots (default is 0)\n"
         "  -t, --snapshot-threaded encode screenshots on multiple threads\n"
@@ -808,10 +936,13 @@ usage(const char *argv0) {
         "  -v, --verbose           increase output verbosity\n"
         "  -D, --dump-state=CALL   dump state at specific call no\n"
         "      --dump-format=FORMAT dump state format (`json` or `ubjson`)\n"
+        "      --dump-image-format=FORMAT dump state images format (`png` or `raw`; default is png)\n"
         "      --min-frame-duration=MICROSECONDS   specify minimum frame rendering duration\n"
         "      --per-frame-delay=MICROSECONDS   add extra delay after each frame (in addition to min-frame-duration)\n"
+        "      --pace              replay calls no sooner than the application made them, for traces recorded with TRACE_TIMESTAMPS\n"
         "  -w, --wait              waitOnFinish on final frame\n"
         "      --loop[=N]          loop N times (N<0 continuously) replaying final frame.\n"
+        "      --preload           decode the whole trace into memory before replaying, so replay times exclude decoding\n"
         "      --watchdog          invokes abort() if retrace of a single api call will take more than " << retrace::RetraceWatchdog::TimeoutInSec << " seconds\n"
         "      --singlethread      use a single thread to replay command stream\n"
         "      --ignore-retvals    ignore return values in wglMakeCurrent, etc\n"
@@ -845,15 +976,20 @@ enum {
     WATCHDOG_OPT,
     MIN_FRAME_DURATION_OPT,
     PER_FRAME_DELAY_OPT,
+    PACE_OPT,
     LOOP_OPT,
+    PRELOAD_OPT,
     SINGLETHREAD_OPT,
     IGNORE_RETVALS_OPT,
     NO_CONTEXT_CHECK,
     SNAPSHOT_ALPHA_OPT,
     SNAPSHOT_FORMAT_OPT,
+    SNAPSHOT_DEDUP_OPT,
+    SNAPSHOT_MANIFEST_OPT,
     SNAPSHOT_INTERVAL_OPT,
     SNAPSHOT_FORCE_BACKBUFFER_OPT,
     DUMP_FORMAT_OPT,
+    DUMP_IMAGE_FORMAT_OPT,
     MARKERS_OPT,
     MIN_CPU_TIME_OPT,
     QUERY_HANDLING_OPT,
@@ -877,6 +1013,7 @@ longOptions[] = {
     {"driver", required_argument, 0, DRIVER_OPT},
     {"dump-state", required_argument, 0, 'D'},
     {"dump-format", required_argument, 0, DUMP_FORMAT_OPT},
+    {"dump-image-format", required_argument, 0, DUMP_IMAGE_FORMAT_OPT},
     {"fullscreen", no_argument, 0, FULLSCREEN_OPT},
     {"headless", no_argument, 0, HEADLESS_OPT},
     {"help", no_argument, 0, 'h'},
@@ -898,6 +1035,8 @@ longOptions[] = {
     {"snapshot", required_argument, 0, 'S'},
     {"snapshot-alpha", no_argument, 0, SNAPSHOT_ALPHA_OPT},
     {"snapshot-format", required_argument, 0, SNAPSHOT_FORMAT_OPT},
+    {"snapshot-dedup", required_argument, 0, SNAPSHOT_DEDUP_OPT},
+    {"snapshot-manifest", required_argument, 0, SNAPSHOT_MANIFEST_OPT},
     {"snapshot-interval", required_argument, 0, SNAPSHOT_INTERVAL_OPT},
     {"snapshot-force-backbuffer", no_argument, 0, SNAPSHOT_FORCE_BACKBUFFER_OPT},
     {"snapshot-prefix", required_argument, 0, 's'},
@@ -907,7 +1046,9 @@ longOptions[] = {
     {"watchdog", no_argument, 0, WATCHDOG_OPT},
     {"min-frame-duration", required_argument, 0, MIN_FRAME_DURATION_OPT},
     {"per-frame-delay", required_argument, 0, PER_FRAME_DELAY_OPT},
+    {"pace", no_argument, 0, PACE_OPT},
     {"loop", optional_argument, 0, LOOP_OPT},
+    {"preload", no_argument, 0, PRELOAD_OPT},
     {"singlethread", no_argument, 0, SINGLETHREAD_OPT},
     {"ignore-retvals", no_argument, 0, IGNORE_RETVALS_OPT},
     {"no-context-check", no_argument, 0, NO_CONTEXT_CHECK},
@@ -1121,6 +1262,7 @@ int main(int argc, char **argv)
 {
     using namespace retrace;
     int loopCount = 0;
+    bool preload = false;
     int i;
     bool snapshotThreaded = false;
 
@@ -1177,6 +1319,16 @@ int main(int argc, char **argv)
                 return EXIT_FAILURE;
             }
             break;
+        case DUMP_IMAGE_FORMAT_OPT:
+            if (strcasecmp(optarg, "png") == 0) {
+                dumpImageFormat = StateWriter::IMAGE_FORMAT_PNG;
+            } else if (strcasecmp(optarg, "raw") == 0) {
+                dumpImageFormat = StateWriter::IMAGE_FORMAT_RAW;
+            } else {
+                std::cerr << "error: unsupported dump image format `" << optarg << "`\n";
+                return EXIT_FAILURE;
+            }
+            break;
         case CORE_OPT:
             retrace::setFeatureLevel("3_2_core");
             break;
@@ -1264,9 +1416,30 @@ int main(int argc, char **argv)
                 snapshotFormat = RAW_RGB;
             else if (strcmp(optarg, "MD5") == 0)
                 snapshotFormat = RAW_MD5;
+            else if (strcmp(optarg, "HASH") == 0)
+                snapshotFormat = RAW_HASH;
             else
                 snapshotFormat = PNM_FMT;
             break;
+        case SNAPSHOT_DEDUP_OPT:
+            if (strcmp(optarg, "none") == 0) {
+                snapshotDedup = DEDUP_NONE;
+            } else if (strcmp(optarg, "skip") == 0) {
+                snapshotDedup = DEDUP_SKIP;
+            } else if (strcmp(optarg, "link") == 0) {
+                snapshotDedup = DEDUP_LINK;
+            } else {
+                std::cerr << "error: unsupported snapshot dedup mode `" << optarg << "`\n";
+                return EXIT_FAILURE;
+            }
+            break;
+        case SNAPSHOT_MANIFEST_OPT:
+            snapshotManifest.open(optarg);
+            if (!snapshotManifest) {
+                std::cerr << "error: failed to open " << optarg << "\n";
+                return EXIT_FAILURE;
+            }
+            break;
         case 'S':
             dumpingSnapshots = true;
             snapshotFrequency.merge(optarg);
@@ -1295,9 +1468,15 @@ int main(int argc, char **argv)
         case PER_FRAME_DELAY_OPT:
             perFrameDelayUsec = trace::intOption(optarg, 0);
             break;
+        case PACE_OPT:
+            retrace::pacing = true;
+            break;
         case LOOP_OPT:
             loopCount = trace::intOption(optarg, -1);
             break;
+        case PRELOAD_OPT:
+            preload = true;
+            break;
         case PFRAMETIMES_OPT:
             retrace::debug = 0;
             retrace::profiling = true;
@@ -1401,6 +1580,11 @@ int main(int argc, char **argv)
         }
     }
 
+    if (loopCount && preload) {
+        std::cerr << "error: --loop and --preload are mutually exclusive\n";
+        return 1;
+    }
+
     if (loopCount) {
         std::cerr << "warning: --loop blindly repeats the last frame calls, therefore frames might not necessarily render correctly (https://github.com/apitrace/apitrace/issues/800)" << std::endl;
     }
@@ -1442,15 +1626,28 @@ int main(int argc, char **argv)
          retrace::curPass++)
     {
         for (i = optind; i < argc; ++i) {
-            parser = new trace::Parser;
+            if (trace::isPlan(argv[i])) {
+                parser = new trace::PlanParser;
+            } else {
+                parser = new trace::Parser;
+            }
             if (loopCount) {
                 parser = lastFrameLoopParser(parser, loopCount);
             }
+            if (preload) {
+                parser = preloadParser(parser);
+            }
 
+            long long openTime = os::getTime();
             if (!parser->open(argv[i])) {
                 return 1;
             }
 
+            if (preload && retrace::verbosity >= -1) {
+                float timeInterval = (os::getTime() - openTime) * (1.0 / os::timeFrequency);
+                std::cout << "Decoded trace in " << timeInterval << " secs\n";
+            }
+
             auto &properties = parser->getProperties();
             auto processNameIt = properties.find("process.name");
             if (processNameIt != properties.end()) {
@@ -1472,7 +1669,7 @@ int main(int argc, char **argv)
 
     os::resetExceptionCallback();
 
-    delete snapshotter;
+    finishSnapshots();
 
     // XXX: X often hangs on XCloseDisplay
     //retrace::cleanUp();
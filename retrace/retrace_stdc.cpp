@@ -118,6 +118,7 @@ retrace_memcpy(trace::Call &call)
 
 
 const retrace::Entry retrace::stdc_callbacks[] = {
+    {"apitrace_stats", &retrace::ignore},
     {"malloc", &retrace_malloc},
     {"memcpy", &retrace_memcpy},
     {NULL, NULL}
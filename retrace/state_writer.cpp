@@ -67,10 +67,11 @@ StateWriter::writeImage(image::Image *image,
     beginMember("__data__");
     std::stringstream ss;
 
-    if (image->channelType == image::TYPE_UNORM8) {
+    if (image->channelType == image::TYPE_UNORM8 &&
+        imageFormat == IMAGE_FORMAT_PNG) {
         image->writePNG(ss);
     } else {
-        image->writePNM(ss);
+        image->writePNM(ss, NULL, false);
     }
 
     const std::string & s = ss.str();
@@ -47,6 +47,18 @@ namespace image {
 class StateWriter
 {
 public:
+    /*
+     * How image payloads get encoded.  PNG keeps dumps small, whereas RAW
+     * writes the pixels uncompressed behind a PNM header, which is much
+     * cheaper when the consumer sits at the other end of a local pipe.
+     */
+    enum ImageFormat {
+        IMAGE_FORMAT_PNG = 0,
+        IMAGE_FORMAT_RAW,
+    };
+
+    ImageFormat imageFormat = IMAGE_FORMAT_PNG;
+
     virtual ~StateWriter();
 
     virtual void
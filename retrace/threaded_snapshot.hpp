@@ -26,6 +26,9 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "image.hpp"
 #include "os_string.hpp"
@@ -49,6 +52,20 @@ actuallyWritePNG(const os::String& filename, image::Image *image)
 }
 
 
+static void
+actuallyLinkPNG(const os::String& filename, const os::String& target)
+{
+    if (!os::linkFile(target, filename)) {
+        std::cerr << "warning: failed to link " << filename << " to " << target << "\n";
+        return;
+    }
+
+    if (retrace::verbosity >= 0) {
+        std::cout << "Linked " << filename << " to " << target << "\n";
+    }
+}
+
+
 /**
  * Write one snapshot at a time, blocking until it is finished.
  */
@@ -62,6 +79,14 @@ public:
     writePNG(const os::String& filename, image::Image *image) {
         actuallyWritePNG(filename, image);
     }
+
+    /**
+     * Make filename a link to a snapshot previously passed to writePNG.
+     */
+    virtual void
+    linkPNG(const os::String& filename, const os::String& target) {
+        actuallyLinkPNG(filename, target);
+    }
 };
 
 
@@ -71,14 +96,28 @@ public:
 class ThreadedSnapshotter : public Snapshotter
 {
 private:
-    ThreadPool pool;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<std::pair<os::String, os::String>> links;
     ThreadedSnapshotter() = delete;
 
 public:
-    ThreadedSnapshotter(size_t nb_threads) : pool(nb_threads) {}
+    ThreadedSnapshotter(size_t nb_threads) : pool(new ThreadPool(nb_threads)) {}
+
+    ~ThreadedSnapshotter() {
+        // Link targets might still be queued, so wait for them first
+        pool.reset();
+        for (auto & link : links) {
+            actuallyLinkPNG(link.first, link.second);
+        }
+    }
 
     virtual void
     writePNG(const os::String& filename, image::Image *image) override {
-        pool.enqueue(actuallyWritePNG, filename, image);
+        pool->enqueue(actuallyWritePNG, filename, image);
+    }
+
+    virtual void
+    linkPNG(const os::String& filename, const os::String& target) override {
+        links.emplace_back(filename, target);
     }
 };
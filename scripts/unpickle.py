@@ -52,6 +52,7 @@ CALL_FLAG_VERBOSE           = (1 << 7)
 CALL_FLAG_MARKER            = (1 << 8)
 CALL_FLAG_MARKER_PUSH       = (1 << 9)
 CALL_FLAG_MARKER_POP        = (1 << 10)
+CALL_FLAG_TRUNCATED         = (1 << 11)
 
 
 class Pointer(int):
@@ -27,6 +27,7 @@
 #include <algorithm>
 
 #include <assert.h>
+#include <errno.h>
 
 #ifdef _WIN32
 
@@ -34,18 +35,46 @@
 
 #else
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/mman.h>
 
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <linux/userfaultfd.h>
+#endif
+
+#endif
+
+#if \
+    (defined(__i386__) && defined(__SSE2__)) /* gcc */ || \
+    defined(_M_IX86) /* msvc */ || \
+    defined(__x86_64__) /* gcc */ || \
+    defined(_M_AMD64) /* msvc */
+
+#  define HAVE_SSE2
+#  include <emmintrin.h>
+
 #endif
 
 #include "gltrace.hpp"
 #include "os_thread.hpp"
 #include "os.hpp"
+#include "trace_option.hpp"
 
 static bool sInitialized = false;
 
+static bool sDiffWrites = false;
+
+/*
+ * Equal runs shorter than this are recorded along with the changed bytes
+ * around them, as each fake memcpy call costs some tens of bytes anyway.
+ */
+static const size_t sDiffCoalesceGap = 64;
+
 static std::unordered_map<size_t, GLMemoryShadow*> sPages;
 static size_t sPageSize;
 
@@ -97,6 +126,156 @@ auto divRoundUp(T a, U b) -> decltype(a / b) {
     return (a + b - 1) / b;
 }
 
+#ifdef __linux__
+
+/*
+ * Asynchronous userfaultfd write protection (Linux 6.7+): writes to
+ * protected pages are resolved by the kernel without notifying us, and
+ * PAGEMAP_SCAN reports the written pages and protects them again.  This
+ * avoids taking a signal on the first write to every page.
+ *
+ * Older kernel headers lack the definitions, but the ABI is stable.
+ */
+
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+
+#ifndef PAGEMAP_SCAN
+struct page_region {
+    __u64 start;
+    __u64 end;
+    __u64 categories;
+};
+
+struct pm_scan_arg {
+    __u64 size;
+    __u64 flags;
+    __u64 start;
+    __u64 end;
+    __u64 walk_end;
+    __u64 vec;
+    __u64 vec_len;
+    __u64 max_pages;
+    __u64 category_inverted;
+    __u64 category_mask;
+    __u64 category_anyof_mask;
+    __u64 return_mask;
+};
+
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#define PM_SCAN_WP_MATCHING (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC (1 << 1)
+#define PAGE_IS_WRITTEN (1 << 1)
+#endif
+
+static int sUffd = -1;
+static int sPagemapFd = -1;
+
+static bool initAsyncWriteTracking()
+{
+    sUffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+    if (sUffd < 0) {
+        return false;
+    }
+
+    struct uffdio_api api;
+    memset(&api, 0, sizeof api);
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    if (ioctl(sUffd, UFFDIO_API, &api) != 0) {
+        close(sUffd);
+        sUffd = -1;
+        return false;
+    }
+
+    sPagemapFd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (sPagemapFd < 0) {
+        close(sUffd);
+        sUffd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+static bool asyncWriteRegister(void *addr, size_t size)
+{
+    struct uffdio_register reg;
+    memset(&reg, 0, sizeof reg);
+    reg.range.start = reinterpret_cast<uintptr_t>(addr);
+    reg.range.len = size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    return ioctl(sUffd, UFFDIO_REGISTER, &reg) == 0;
+}
+
+static void asyncWriteProtect(void *addr, size_t size)
+{
+    struct uffdio_writeprotect wp;
+    memset(&wp, 0, sizeof wp);
+    wp.range.start = reinterpret_cast<uintptr_t>(addr);
+    wp.range.len = size;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    if (ioctl(sUffd, UFFDIO_WRITEPROTECT, &wp) != 0) {
+        os::log("apitrace: error: %s: UFFDIO_WRITEPROTECT failed with error \"%s\"\n", __FUNCTION__, strerror(errno));
+        os::abort();
+    }
+}
+
+#endif /* __linux__ */
+
+/*
+ * Find the first offset in [begin, end) at which a and b are equal, or
+ * differ, as requested.
+ */
+static size_t findMismatch(const uint8_t *a, const uint8_t *b, size_t begin, size_t end, bool equal)
+{
+    size_t i = begin;
+
+#ifdef HAVE_SSE2
+    for (; i + 16 <= end; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (!equal) {
+            mask ^= 0xffff;
+        }
+        if (mask) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                ++i;
+            }
+            return i;
+        }
+    }
+#else
+    if (!equal) {
+        // Skip identical words
+        for (; i + sizeof(uint64_t) <= end; i += sizeof(uint64_t)) {
+            uint64_t wa, wb;
+            memcpy(&wa, a + i, sizeof wa);
+            memcpy(&wb, b + i, sizeof wb);
+            if (wa != wb) {
+                break;
+            }
+        }
+    }
+#endif
+
+    for (; i < end; ++i) {
+        if ((a[i] == b[i]) == equal) {
+            return i;
+        }
+    }
+    return end;
+}
+
 #ifdef _WIN32
 static LONG CALLBACK
 VectoredHandler(PEXCEPTION_POINTERS pExceptionInfo)
@@ -162,6 +341,21 @@ void initializeGlobals()
 {
     sPageSize = getSystemPageSize();
 
+    sDiffWrites = trace::boolOption(getenv("TRACE_SHADOW_DIFF"), false);
+
+    const char *tracking = getenv("TRACE_SHADOW_TRACKING");
+    if (tracking && strcmp(tracking, "mprotect") != 0) {
+#ifdef __linux__
+        if (strcmp(tracking, "userfaultfd") != 0) {
+            os::log("apitrace: warning: %s: unknown TRACE_SHADOW_TRACKING %s\n", __FUNCTION__, tracking);
+        } else if (!initAsyncWriteTracking()) {
+            os::log("apitrace: warning: %s: userfaultfd write protection unavailable, falling back to mprotect\n", __FUNCTION__);
+        }
+#else
+        os::log("apitrace: warning: %s: TRACE_SHADOW_TRACKING %s not supported\n", __FUNCTION__, tracking);
+#endif
+    }
+
 #ifdef _WIN32
     if (AddVectoredExceptionHandler(1, VectoredHandler) == NULL) {
         os::log("apitrace: error: %s: add vectored exception handler failed\n", __FUNCTION__);
@@ -177,10 +371,26 @@ void initializeGlobals()
 #endif
 }
 
+static void
+removeShadow(std::vector<GLMemoryShadow*> &shadows, GLMemoryShadow *shadow)
+{
+    auto it = std::find(shadows.begin(), shadows.end(), shadow);
+    if (it != shadows.end()) {
+        shadows.erase(it);
+    }
+}
+
 GLMemoryShadow::~GLMemoryShadow()
 {
     std::unique_lock<std::mutex> lock(mutex);
 
+    if (asyncWriteTracking) {
+        shared_context_res_ptr_t res = sharedRes.lock();
+        if (res) {
+            removeShadow(res->asyncWriteShadows, this);
+        }
+    }
+
     const size_t startPage = reinterpret_cast<uintptr_t>(shadowMemory) / sPageSize;
     for (size_t i = 0; i < nPages; i++) {
         sPages.erase(startPage + i);
@@ -218,6 +428,19 @@ bool GLMemoryShadow::init(const void *data, size_t size)
         memcpy(shadowMemory, data, size);
     }
 
+    if (sDiffWrites) {
+        committedMemory.assign(shadowMemory, shadowMemory + adjustedSize);
+    }
+
+#ifdef __linux__
+    if (sUffd >= 0) {
+        asyncWriteTracking = asyncWriteRegister(shadowMemory, adjustedSize);
+        if (!asyncWriteTracking) {
+            os::log("apitrace: warning: %s: UFFDIO_REGISTER failed with error \"%s\"\n", __FUNCTION__, strerror(errno));
+        }
+    }
+#endif
+
     memProtect(shadowMemory, adjustedSize, MemProtection::NO_ACCESS);
 
     {
@@ -253,15 +476,28 @@ void *GLMemoryShadow::map(gltrace::Context *_ctx, void *_glMemory, GLbitfield _f
     if (flags & GL_MAP_READ_BIT) {
         memProtect(protectStart, protectSize, MemProtection::READ_WRITE);
         memcpy(shadowMemory + start, glMemory, size);
+        if (!committedMemory.empty()) {
+            memcpy(committedMemory.data() + start, glMemory, size);
+        }
     }
 
-    memProtect(protectStart, protectSize, MemProtection::READ_ONLY);
+    protectForWrites(protectStart, protectSize);
+
+    if (asyncWriteTracking && (flags & GL_MAP_WRITE_BIT)) {
+        std::unique_lock<std::mutex> lock(mutex);
+        _ctx->sharedRes->asyncWriteShadows.push_back(this);
+    }
 
     return shadowMemory + start;
 }
 
 void GLMemoryShadow::unmap(Callback callback)
 {
+    if (asyncWriteTracking) {
+        std::unique_lock<std::mutex> lock(mutex);
+        collectWrittenPages();
+    }
+
     if (isDirty) {
         std::unique_lock<std::mutex> lock(mutex);
         commitWrites(callback);
@@ -272,10 +508,8 @@ void GLMemoryShadow::unmap(Callback callback)
 
         shared_context_res_ptr_t res = sharedRes.lock();
         if (res) {
-            auto it = std::find(res->dirtyShadows.begin(), res->dirtyShadows.end(), this);
-            if (it != res->dirtyShadows.end()) {
-                res->dirtyShadows.erase(it);
-            }
+            removeShadow(res->dirtyShadows, this);
+            removeShadow(res->asyncWriteShadows, this);
         } else {
             os::log("apitrace: error: %s: context(s) are destroyed!\n", __FUNCTION__);
         }
@@ -324,6 +558,11 @@ GLbitfield GLMemoryShadow::getMapFlags() const
     return flags;
 }
 
+void *GLMemoryShadow::getMappedPointer() const
+{
+    return shadowMemory + mappedStart;
+}
+
 void GLMemoryShadow::setPageDirty(size_t relativePage)
 {
     assert(relativePage < nPages);
@@ -346,42 +585,128 @@ bool GLMemoryShadow::isPageDirty(size_t relativePage)
     return dirtyPages[relativePage / 32] & (1U << (relativePage % 32));
 }
 
+void GLMemoryShadow::protectForWrites(uint8_t *start, size_t size)
+{
+#ifdef __linux__
+    if (asyncWriteTracking) {
+        memProtect(start, size, MemProtection::READ_WRITE);
+        asyncWriteProtect(start, size);
+        return;
+    }
+#endif
+
+    memProtect(start, size, MemProtection::READ_ONLY);
+}
+
+void GLMemoryShadow::collectWrittenPages()
+{
+#ifdef __linux__
+    if (!asyncWriteTracking || !glMemory) {
+        return;
+    }
+
+    const uintptr_t base = reinterpret_cast<uintptr_t>(shadowMemory);
+
+    struct page_region regions[32];
+    struct pm_scan_arg arg;
+    memset(&arg, 0, sizeof arg);
+    arg.size = sizeof arg;
+    arg.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+    arg.start = base + mappedStartPage * sPageSize;
+    arg.end = base + mappedEndPage * sPageSize;
+    arg.vec = reinterpret_cast<uintptr_t>(regions);
+    arg.vec_len = sizeof regions / sizeof regions[0];
+    arg.category_mask = PAGE_IS_WRITTEN;
+    arg.return_mask = PAGE_IS_WRITTEN;
+
+    // Written pages are protected again as they are reported
+    for (;;) {
+        long count = ioctl(sPagemapFd, PAGEMAP_SCAN, &arg);
+        if (count < 0) {
+            os::log("apitrace: error: %s: PAGEMAP_SCAN failed with error \"%s\"\n", __FUNCTION__, strerror(errno));
+            os::abort();
+        }
+        for (long i = 0; i < count; ++i) {
+            const size_t endPage = (regions[i].end - base) / sPageSize;
+            for (size_t page = (regions[i].start - base) / sPageSize; page < endPage; ++page) {
+                setPageDirty(page);
+            }
+        }
+        if (arg.walk_end >= arg.end) {
+            break;
+        }
+        arg.start = arg.walk_end;
+    }
+#endif
+}
+
+void GLMemoryShadow::commitRange(size_t begin, size_t end, Callback callback)
+{
+    const size_t size = end - begin;
+
+    memcpy(glMemory + (begin - mappedStart), shadowMemory + begin, size);
+    if (!committedMemory.empty()) {
+        memcpy(committedMemory.data() + begin, shadowMemory + begin, size);
+    }
+    callback(shadowMemory + begin, size);
+}
+
+void GLMemoryShadow::commitChangedRanges(size_t begin, size_t end, Callback callback)
+{
+    const uint8_t *committed = committedMemory.data();
+
+    size_t pos = begin;
+    while (pos < end) {
+        const size_t changedStart = findMismatch(shadowMemory, committed, pos, end, false);
+        if (changedStart == end) {
+            break;
+        }
+
+        // Extend the range over short equal runs
+        size_t changedEnd = findMismatch(shadowMemory, committed, changedStart, end, true);
+        pos = findMismatch(shadowMemory, committed, changedEnd, end, false);
+        while (pos < end && pos - changedEnd < sDiffCoalesceGap) {
+            changedEnd = findMismatch(shadowMemory, committed, pos, end, true);
+            pos = findMismatch(shadowMemory, committed, changedEnd, end, false);
+        }
+
+        commitRange(changedStart, changedEnd, callback);
+    }
+}
+
 void GLMemoryShadow::commitWrites(Callback callback)
 {
     assert(isDirty);
 
-    uint8_t *shadowSlice = shadowMemory + mappedStartPage * sPageSize;
-    const size_t glStartOffset = mappedStart % sPageSize;
-
     /* Other thread may write to the buffers at this very moment
      * so we need to protect pages before we read from them.
      * The other thread will have to wait until we commit all writes we want.
+     * With asynchronous write protection, the pages were protected again when
+     * collected, and later writes will be collected next time.
      */
-    for (size_t i = mappedStartPage; i < mappedEndPage; i++) {
-        if (isPageDirty(i)) {
-            memProtect(shadowMemory + i * sPageSize, sPageSize, MemProtection::READ_ONLY);
+    if (!asyncWriteTracking) {
+        for (size_t i = mappedStartPage; i < mappedEndPage; i++) {
+            if (isPageDirty(i)) {
+                memProtect(shadowMemory + i * sPageSize, sPageSize, MemProtection::READ_ONLY);
+            }
         }
     }
 
+    const size_t mappedEnd = mappedStart + mappedSize;
+
     for (size_t i = mappedStartPage; i < mappedEndPage; i++) {
         if (isPageDirty(i)) {
             // We coalesce consecutive writes into one
             size_t firstDirty = i;
             while (++i < mappedEndPage && isPageDirty(i)) { }
 
-            const size_t pages = i - firstDirty;
-            if (firstDirty != mappedStartPage) {
-                const size_t shadowOffset = (firstDirty - mappedStartPage) * sPageSize;
-                const size_t glOffset = shadowOffset - glStartOffset;
-                const size_t size = std::min(glStartOffset + mappedSize - shadowOffset, sPageSize * pages);
+            const size_t begin = std::max(firstDirty * sPageSize, mappedStart);
+            const size_t end = std::min(i * sPageSize, mappedEnd);
 
-                memcpy(glMemory + glOffset, shadowSlice + shadowOffset, size);
-                callback(shadowSlice + shadowOffset, size);
+            if (committedMemory.empty()) {
+                commitRange(begin, end, callback);
             } else {
-                const size_t size = std::min(sPageSize * pages - glStartOffset, mappedSize);
-
-                memcpy(glMemory, shadowSlice + glStartOffset, size);
-                callback(shadowSlice + glStartOffset, size);
+                commitChangedRanges(begin, end, callback);
             }
         }
     }
@@ -400,12 +725,24 @@ void GLMemoryShadow::updateForReads()
     memProtect(protectStart, protectSize, MemProtection::READ_WRITE);
 
     memcpy(shadowMemory + mappedStart, glMemory, mappedSize);
+    if (!committedMemory.empty()) {
+        memcpy(committedMemory.data() + mappedStart, glMemory, mappedSize);
+    }
 
-    memProtect(protectStart, protectSize, MemProtection::READ_ONLY);
+    protectForWrites(protectStart, protectSize);
 }
 
 void GLMemoryShadow::commitAllWrites(gltrace::Context *_ctx, Callback callback)
 {
+    // Only scan the buffers which are currently mapped for writing
+    if (!_ctx->sharedRes->asyncWriteShadows.empty()) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (GLMemoryShadow *memoryShadow : _ctx->sharedRes->asyncWriteShadows) {
+            memoryShadow->collectWrittenPages();
+        }
+    }
+
     if (!_ctx->sharedRes->dirtyShadows.empty()) {
         std::unique_lock<std::mutex> lock(mutex);
 
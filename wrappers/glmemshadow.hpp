@@ -58,6 +58,20 @@ private:
     size_t mappedStartPage = 0;
     size_t mappedEndPage = 0;
 
+    /*
+     * Contents of the shadow memory as last seen by the trace, kept only
+     * when writes are diffed (TRACE_SHADOW_DIFF), so that just the bytes
+     * that changed are recorded.
+     */
+    std::vector<uint8_t> committedMemory;
+
+    /*
+     * Whether writes are tracked with asynchronous userfaultfd write
+     * protection (TRACE_SHADOW_TRACKING=userfaultfd), rather than page
+     * faults.
+     */
+    bool asyncWriteTracking = false;
+
     bool isDirty = false;
     std::vector<uint32_t> dirtyPages;
     uint32_t pagesToDirtyOnConsecutiveWrites = 1;
@@ -80,6 +94,7 @@ public:
     void onAddressWrite(uintptr_t addr, size_t page);
 
     GLbitfield getMapFlags() const;
+    void *getMappedPointer() const;
 
     static void commitAllWrites(gltrace::Context *_ctx, Callback callback);
     static void syncAllForReads(gltrace::Context *_ctx);
@@ -88,4 +103,10 @@ private:
 
     void setPageDirty(size_t relativePage);
     bool isPageDirty(size_t relativePage);
+
+    void protectForWrites(uint8_t *start, size_t size);
+    void collectWrittenPages();
+
+    void commitRange(size_t begin, size_t end, Callback callback);
+    void commitChangedRanges(size_t begin, size_t end, Callback callback);
 };
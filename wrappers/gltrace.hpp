@@ -33,6 +33,7 @@
 #include "glmemshadow.hpp"
 
 #include <map>
+#include <set>
 #include <vector>
 #include <memory>
 
@@ -46,6 +47,16 @@ public:
     std::map<GLint, std::unique_ptr<GLMemoryShadow>> bufferToShadowMemory;
 
     std::vector<GLMemoryShadow*> dirtyShadows;
+
+    // Shadows mapped for writing whose written pages the kernel tracks
+    std::vector<GLMemoryShadow*> asyncWriteShadows;
+
+    // Objects alive while capture is deferred, see recreateState
+    std::set<GLuint> buffers;
+    std::map<GLuint, GLenum> textures;  // name -> target
+    std::set<GLuint> renderbuffers;
+    std::set<GLuint> programs;
+    std::set<GLuint> shaders;
 };
 
 class Context {
@@ -69,6 +80,10 @@ public:
     // the data which can be shared between shared contexts
     std::shared_ptr<ShareableContextResources> sharedRes;
 
+    // Container objects alive while capture is deferred, see recreateState
+    std::set<GLuint> framebuffers;
+    std::set<GLuint> vertexArrays;
+
     Context(void) :
         profile(glfeatures::API_GL, 1, 0),
         sharedRes(std::make_shared<ShareableContextResources>())
@@ -103,6 +118,26 @@ const GLubyte *
 _glGetStringi_override(GLenum name, GLuint index);
 
 
+void
+trackObjects(std::set<GLuint> &objects, GLsizei n, const GLuint *names);
+
+void
+trackTextures(std::map<GLuint, GLenum> &textures, GLenum target, GLsizei n, const GLuint *names);
+
+void
+untrackObjects(std::set<GLuint> &objects, GLsizei n, const GLuint *names);
+
+void
+untrackObjects(std::map<GLuint, GLenum> &textures, GLsizei n, const GLuint *names);
+
+/*
+ * Emit fake calls recreating the objects and state of the current context,
+ * when a deferred capture starts.
+ */
+void
+recreateState(void);
+
+
 static inline bool
 is_coherent_write_map(GLbitfield access)
 {
@@ -208,7 +208,7 @@ class GlTracer(Tracer):
         # Declare helper functions to emit fake function calls into the trace
         for function in api.getAllFunctions():
             if function.name in self.fake_function_names:
-                print(function.prototype('_fake_' + function.name) + ';')
+                print(self.fakePrototype(function) + ';')
         print()
         print(r'inline void')
         print(r'_fakeStringMarker(const std::string &s) {')
@@ -796,6 +796,28 @@ class GlTracer(Tracer):
 
         Tracer.traceFunctionImplBody(self, function)
 
+        if function.name in self.frame_terminator_function_names:
+            print('    trace::localWriter.endFrame(gltrace::recreateState);')
+
+    # Calls ending a frame, where a deferred capture may start
+    frame_terminator_function_names = [
+        'CGLFlushDrawable',
+        'eglSwapBuffers',
+        'eglSwapBuffersWithDamageEXT',
+        'eglSwapBuffersWithDamageKHR',
+        'glFrameTerminatorGREMEDY',
+        'glXSwapBuffers',
+        'glXSwapBuffersMscOML',
+        'wglSwapBuffers',
+        'wglSwapLayerBuffers',
+    ]
+
+    def isFunctionAlwaysRecorded(self, function):
+        # Window system calls are few, and glretrace needs them to recreate
+        # contexts and drawables, so keep them while capture is deferred
+        return function.name.startswith(('glX', 'egl', 'wgl', 'CGL')) \
+            and function.name not in self.frame_terminator_function_names
+
     # These entrypoints are only expected to be implemented by tools;
     # drivers will probably not implement them.
     marker_functions = [
@@ -956,6 +978,64 @@ class GlTracer(Tracer):
             print(r'        *length = 0;')
             print(r'    }')
 
+        # Keep track of the objects alive while capture is deferred, so that
+        # gltrace::recreateState can recreate them when it starts
+        self.trackObjects(function)
+
+    # Where the names of each kind of object are tracked
+    tracked_objects = {
+        'Buffer': '_ctx->sharedRes->buffers',
+        'Renderbuffer': '_ctx->sharedRes->renderbuffers',
+        'Framebuffer': '_ctx->framebuffers',
+        'VertexArray': '_ctx->vertexArrays',
+    }
+
+    object_function_regex = re.compile(r'^gl(Gen|Create|Delete)(Buffer|Texture|Framebuffer|Renderbuffer|VertexArray)s(ARB|EXT|OES|APPLE)?$')
+    bind_object_function_regex = re.compile(r'^glBind(Buffer|Texture|Framebuffer|Renderbuffer|VertexArray)(ARB|EXT|OES|APPLE)?$')
+
+    def trackObjects(self, function):
+        if function.name in ('glCreateProgram', 'glCreateShader'):
+            container = '_ctx->sharedRes->%ss' % function.name[len('glCreate'):].lower()
+            statement = 'gltrace::trackObjects(%s, 1, &_result)' % container
+        elif function.name in ('glDeleteProgram', 'glDeleteShader'):
+            kind = function.name[len('glDelete'):].lower()
+            statement = 'gltrace::untrackObjects(_ctx->sharedRes->%ss, 1, &%s)' % (kind, kind)
+        else:
+            mo = self.object_function_regex.match(function.name)
+            if mo:
+                verb, kind = mo.group(1), mo.group(2)
+                count = 'n'
+                names = function.args[-1].name
+            else:
+                mo = self.bind_object_function_regex.match(function.name)
+                if not mo:
+                    return
+                verb, kind = 'Bind', mo.group(1)
+                count = '1'
+                names = '&' + function.args[-1].name
+
+            if verb == 'Delete':
+                if kind == 'Texture':
+                    container = '_ctx->sharedRes->textures'
+                else:
+                    container = self.tracked_objects[kind]
+                statement = 'gltrace::untrackObjects(%s, %s, %s)' % (container, count, names)
+            elif kind == 'Texture':
+                # Textures are recreated according to the target they were
+                # first bound to
+                if verb == 'Gen':
+                    target = 'GL_NONE'
+                else:
+                    target = 'target'
+                statement = 'gltrace::trackTextures(_ctx->sharedRes->textures, %s, %s, %s)' % (target, count, names)
+            else:
+                statement = 'gltrace::trackObjects(%s, %s, %s)' % (self.tracked_objects[kind], count, names)
+
+        print(r'    if (!trace::localWriter.isRecording()) {')
+        print(r'        gltrace::Context *_ctx = gltrace::getContext();')
+        print(r'        %s;' % statement)
+        print(r'    }')
+
     def wrapRet(self, function, instance):
         Tracer.wrapRet(self, function, instance)
 
@@ -987,6 +1067,15 @@ class GlTracer(Tracer):
 
     compressed_image_function_regex = re.compile(r'^glCompressedTex(ture)?(Sub)?Image[1-4]D[0-9A-Z]*$')
 
+    def serializeFakeArgValue(self, function, arg, instance):
+        # The size of compressed images is only known to a callback
+        if self.compressed_image_function_regex.match(function.name) \
+           and isinstance(arg.type, stdapi.Blob):
+            print('            %s;' % arg.type.size.format('[](const void* data, GLsizei size){ trace::localWriter.writeBlob(data, size); }'))
+            return
+
+        Tracer.serializeFakeArgValue(self, function, arg, instance)
+
     def serializeArgValue(self, function, arg):
         # Recognize offsets instead of blobs when a PBO is bound
         if self.unpack_function_regex.match(function.name) \
@@ -1054,15 +1143,95 @@ class GlTracer(Tracer):
         'glStringMarkerGREMEDY',
         'glTexImage2D',
         'glViewport',
+
+        # Used by gltrace::recreateState
+        'glActiveTexture',
+        'glAttachShader',
+        'glBindBufferBase',
+        'glBindBufferRange',
+        'glBindFramebuffer',
+        'glBindRenderbuffer',
+        'glBindTexture',
+        'glBindVertexArray',
+        'glBlendEquationSeparate',
+        'glBlendFuncSeparate',
+        'glBufferData',
+        'glBufferStorage',
+        'glClearColor',
+        'glClearDepth',
+        'glClearStencil',
+        'glColorMask',
+        'glCompileShader',
+        'glCompressedTexImage2D',
+        'glCompressedTexImage3D',
+        'glCreateProgram',
+        'glCreateShader',
+        'glCullFace',
+        'glDepthFunc',
+        'glDepthMask',
+        'glDisable',
+        'glDrawBuffers',
+        'glEnable',
+        'glEnableVertexAttribArray',
+        'glFramebufferRenderbuffer',
+        'glFramebufferTexture2D',
+        'glFramebufferTextureLayer',
+        'glFrontFace',
+        'glGenBuffers',
+        'glGenFramebuffers',
+        'glGenRenderbuffers',
+        'glGenTextures',
+        'glGenVertexArrays',
+        'glGetUniformLocation',
+        'glLinkProgram',
+        'glMapBufferRange',
+        'glPixelStorei',
+        'glPolygonOffset',
+        'glReadBuffer',
+        'glRenderbufferStorageMultisample',
+        'glShaderSource',
+        'glStencilFuncSeparate',
+        'glStencilMaskSeparate',
+        'glStencilOpSeparate',
+        'glTexImage3D',
+        'glTexParameteri',
+        'glUniform1fv',
+        'glUniform1iv',
+        'glUniform1uiv',
+        'glUniform2fv',
+        'glUniform2iv',
+        'glUniform2uiv',
+        'glUniform3fv',
+        'glUniform3iv',
+        'glUniform3uiv',
+        'glUniform4fv',
+        'glUniform4iv',
+        'glUniform4uiv',
+        'glUniformBlockBinding',
+        'glUniformMatrix2fv',
+        'glUniformMatrix3fv',
+        'glUniformMatrix4fv',
+        'glUseProgram',
+        'glVertexAttribDivisor',
+        'glVertexAttribIPointer',
+        'glVertexAttribPointer',
     ]
 
+    def fakePrototype(self, function):
+        # Fake calls of functions that return something take the value to
+        # record as an extra _result argument
+        args = ['%s %s' % (arg.type, arg.name) for arg in function.args]
+        if function.type is not stdapi.Void:
+            args.append('%s _result' % (function.type,))
+        return 'void %s _fake_%s(%s)' % (function.call, function.name, ', '.join(args) or 'void')
+
     def footer(self, api):
         Tracer.footer(self, api)
 
         # Generate helper functions to emit fake function calls into the trace
         for function in api.getAllFunctions():
             if function.name in self.fake_function_names:
-                print(function.prototype('_fake_' + function.name))
+                print(self.fakePrototype(function))
                 print(r'{')
                 self.fake_call(function, function.argNames())
                 print(r'}')
@@ -1265,3 +1434,21 @@ class GlTracer(Tracer):
     def emitFakeTexture2D(self):
         print(r'    _fake_glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);')
 
+
+
+if __name__ == '__main__':
+    # Declare the helpers emitting fake calls, for hand-written code like
+    # gltrace_capture.cpp
+    print()
+    print('/* Generated by gltrace.py -- do not edit */')
+    print()
+    print('#pragma once')
+    print()
+    print('#include "glimports.hpp"')
+    print()
+    print()
+
+    tracer = GlTracer()
+    for function in glapi.glapi.functions:
+        if function.name in tracer.fake_function_names:
+            print(tracer.fakePrototype(function) + ';')
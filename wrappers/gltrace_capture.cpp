@@ -0,0 +1,1075 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The apitrace authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Recreation of the GL state when a deferred capture starts.
+ *
+ * While capture is deferred (TRACE_START_FRAME) calls are not recorded, so
+ * when it starts the objects alive in the current context, and the state
+ * that refers to them, are recreated with fake calls.  Only the current
+ * context is considered, and only OpenGL 3.2 or newer desktop contexts are
+ * supported.  Not recreated are: fixed function state, display lists, sampler
+ * and query objects, transform feedback, and the contents of renderbuffers
+ * and multisample textures.  Immutable textures are recreated as mutable, and
+ * the contents of buffers mapped for reading only within the mapped range.
+ */
+
+
+#include <assert.h>
+#include <string.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "os.hpp"
+#include "glproc.hpp"
+#include "glsize.hpp"
+#include "gltrace.hpp"
+#include "gltrace_fake.hpp"
+
+
+namespace gltrace {
+
+
+/*
+ * Shared contexts may create and delete objects from several threads.
+ */
+static std::mutex objectsMutex;
+
+
+void
+trackObjects(std::set<GLuint> &objects, GLsizei n, const GLuint *names)
+{
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    for (GLsizei i = 0; i < n; ++i) {
+        if (names[i]) {
+            objects.insert(names[i]);
+        }
+    }
+}
+
+
+void
+trackTextures(std::map<GLuint, GLenum> &textures, GLenum target, GLsizei n, const GLuint *names)
+{
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    for (GLsizei i = 0; i < n; ++i) {
+        if (names[i]) {
+            GLenum &textureTarget = textures[names[i]];
+            if (target != GL_NONE) {
+                textureTarget = target;
+            }
+        }
+    }
+}
+
+
+void
+untrackObjects(std::set<GLuint> &objects, GLsizei n, const GLuint *names)
+{
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    for (GLsizei i = 0; i < n; ++i) {
+        objects.erase(names[i]);
+    }
+}
+
+
+void
+untrackObjects(std::map<GLuint, GLenum> &textures, GLsizei n, const GLuint *names)
+{
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    for (GLsizei i = 0; i < n; ++i) {
+        textures.erase(names[i]);
+    }
+}
+
+
+static void
+discardWrites(const void *ptr, size_t size)
+{
+}
+
+
+/*
+ * Pixel storage state, which is reset to the defaults while images are read
+ * back and recorded, and restored afterwards.
+ */
+static const GLenum pixelStoreParams[] = {
+    GL_UNPACK_SWAP_BYTES,
+    GL_UNPACK_LSB_FIRST,
+    GL_UNPACK_ROW_LENGTH,
+    GL_UNPACK_IMAGE_HEIGHT,
+    GL_UNPACK_SKIP_ROWS,
+    GL_UNPACK_SKIP_PIXELS,
+    GL_UNPACK_SKIP_IMAGES,
+    GL_UNPACK_ALIGNMENT,
+    GL_PACK_SWAP_BYTES,
+    GL_PACK_LSB_FIRST,
+    GL_PACK_ROW_LENGTH,
+    GL_PACK_IMAGE_HEIGHT,
+    GL_PACK_SKIP_ROWS,
+    GL_PACK_SKIP_PIXELS,
+    GL_PACK_SKIP_IMAGES,
+    GL_PACK_ALIGNMENT,
+};
+
+#define NUM_PIXEL_STORE_PARAMS (sizeof pixelStoreParams / sizeof pixelStoreParams[0])
+
+
+static inline GLint
+defaultPixelStoreValue(GLenum pname)
+{
+    // Tightly packed rows, so that image sizes need no padding
+    return pname == GL_UNPACK_ALIGNMENT || pname == GL_PACK_ALIGNMENT ? 1 : 0;
+}
+
+
+static void
+recreateBuffers(Context *ctx)
+{
+    // Make pending writes to coherent mappings visible, without recording them
+    GLMemoryShadow::commitAllWrites(ctx, discardWrites);
+
+    bool bufferStorage = ctx->profile.versionGreaterOrEqual(4, 4) ||
+                         ctx->extensions.has("GL_ARB_buffer_storage");
+
+    GLint prevBuffer = _glGetInteger(GL_COPY_READ_BUFFER_BINDING);
+
+    for (GLuint buffer : ctx->sharedRes->buffers) {
+        _fake_glGenBuffers(1, &buffer);
+        if (!_glIsBuffer(buffer)) {
+            continue;
+        }
+
+        _glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+        GLint64 size = 0;
+        GLint usage = GL_STATIC_DRAW;
+        GLint immutable = GL_FALSE;
+        GLint storageFlags = 0;
+        GLint mapped = GL_FALSE;
+        _glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+        _glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &usage);
+        _glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_MAPPED, &mapped);
+        if (bufferStorage) {
+            _glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_IMMUTABLE_STORAGE, &immutable);
+            _glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_STORAGE_FLAGS, &storageFlags);
+        }
+
+        GLint mapAccess = 0;
+        GLint64 mapOffset = 0;
+        GLint64 mapLength = 0;
+        GLvoid *mapPointer = NULL;
+        if (mapped) {
+            _glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_ACCESS_FLAGS, &mapAccess);
+            _glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_MAP_OFFSET, &mapOffset);
+            _glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_MAP_LENGTH, &mapLength);
+            _glGetBufferPointerv(GL_COPY_READ_BUFFER, GL_BUFFER_MAP_POINTER, &mapPointer);
+        }
+
+        std::vector<char> data(size);
+        if (size > 0) {
+            if (!mapped || (mapAccess & GL_MAP_PERSISTENT_BIT)) {
+                _glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, data.data());
+            } else if (mapAccess & GL_MAP_READ_BIT) {
+                // The rest can't be read back while the buffer is mapped
+                memcpy(data.data() + mapOffset, mapPointer, mapLength);
+                if (mapOffset > 0 || mapLength < size) {
+                    os::log("apitrace: warning: %s: contents of mapped buffer %u outside the mapped range recreated as zeros\n", __FUNCTION__, buffer);
+                }
+            } else {
+                os::log("apitrace: warning: %s: contents of mapped buffer %u not recreated\n", __FUNCTION__, buffer);
+            }
+        }
+
+        const GLvoid *contents = size > 0 ? data.data() : NULL;
+        _fake_glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (immutable) {
+            _fake_glBufferStorage(GL_ARRAY_BUFFER, size, contents, storageFlags);
+        } else {
+            _fake_glBufferData(GL_ARRAY_BUFFER, size, contents, usage);
+        }
+
+        if (mapped) {
+            // Map again at the same address the application writes to, which
+            // for coherent mappings is the shadow memory
+            auto it = ctx->sharedRes->bufferToShadowMemory.find(buffer);
+            if (it != ctx->sharedRes->bufferToShadowMemory.end()) {
+                mapPointer = it->second->getMappedPointer();
+            }
+            GLbitfield access = mapAccess & ~(GL_MAP_INVALIDATE_RANGE_BIT |
+                                              GL_MAP_INVALIDATE_BUFFER_BIT);
+            _fake_glMapBufferRange(GL_ARRAY_BUFFER, mapOffset, mapLength, access, mapPointer);
+        }
+    }
+
+    _glBindBuffer(GL_COPY_READ_BUFFER, prevBuffer);
+}
+
+
+static GLenum
+getTextureBinding(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_1D:
+        return GL_TEXTURE_BINDING_1D;
+    case GL_TEXTURE_1D_ARRAY:
+        return GL_TEXTURE_BINDING_1D_ARRAY;
+    case GL_TEXTURE_2D:
+        return GL_TEXTURE_BINDING_2D;
+    case GL_TEXTURE_2D_ARRAY:
+        return GL_TEXTURE_BINDING_2D_ARRAY;
+    case GL_TEXTURE_2D_MULTISAMPLE:
+        return GL_TEXTURE_BINDING_2D_MULTISAMPLE;
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        return GL_TEXTURE_BINDING_2D_MULTISAMPLE_ARRAY;
+    case GL_TEXTURE_3D:
+        return GL_TEXTURE_BINDING_3D;
+    case GL_TEXTURE_RECTANGLE:
+        return GL_TEXTURE_BINDING_RECTANGLE;
+    case GL_TEXTURE_CUBE_MAP:
+        return GL_TEXTURE_BINDING_CUBE_MAP;
+    case GL_TEXTURE_CUBE_MAP_ARRAY:
+        return GL_TEXTURE_BINDING_CUBE_MAP_ARRAY;
+    case GL_TEXTURE_BUFFER:
+        return GL_TEXTURE_BINDING_BUFFER;
+    default:
+        return GL_NONE;
+    }
+}
+
+
+/*
+ * Choose a format and type to read back a texture image in, that loses no
+ * information when the image is specified again.
+ */
+static void
+getReadbackFormat(GLenum target, GLint level, GLenum &format, GLenum &type)
+{
+    GLint depthSize = 0;
+    GLint stencilSize = 0;
+    GLint redSize = 0;
+    GLint componentType = GL_NONE;
+    _glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH_SIZE, &depthSize);
+    _glGetTexLevelParameteriv(target, level, GL_TEXTURE_STENCIL_SIZE, &stencilSize);
+    _glGetTexLevelParameteriv(target, level, GL_TEXTURE_RED_SIZE, &redSize);
+
+    if (depthSize) {
+        _glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH_TYPE, &componentType);
+        if (stencilSize) {
+            format = GL_DEPTH_STENCIL;
+            type = componentType == GL_FLOAT ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_UNSIGNED_INT_24_8;
+        } else {
+            format = GL_DEPTH_COMPONENT;
+            type = GL_FLOAT;
+        }
+        return;
+    }
+
+    if (stencilSize) {
+        format = GL_STENCIL_INDEX;
+        type = GL_UNSIGNED_BYTE;
+        return;
+    }
+
+    _glGetTexLevelParameteriv(target, level, GL_TEXTURE_RED_TYPE, &componentType);
+    if (componentType == GL_NONE) {
+        // Alpha, luminance and intensity formats
+        _glGetTexLevelParameteriv(target, level, GL_TEXTURE_ALPHA_TYPE, &componentType);
+    }
+
+    switch (componentType) {
+    case GL_INT:
+        format = GL_RGBA_INTEGER;
+        type = GL_INT;
+        break;
+    case GL_UNSIGNED_INT:
+        format = GL_RGBA_INTEGER;
+        type = GL_UNSIGNED_INT;
+        break;
+    case GL_FLOAT:
+    case GL_SIGNED_NORMALIZED:
+        format = GL_RGBA;
+        type = GL_FLOAT;
+        break;
+    default:
+        format = GL_RGBA;
+        type = redSize > 8 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+        break;
+    }
+}
+
+
+static void
+recreateTextureImage(GLenum target, GLenum imageTarget, GLint level, bool layered)
+{
+    GLint width = 0;
+    GLint height = 0;
+    GLint depth = 0;
+    GLint internalFormat = GL_NONE;
+    GLint compressed = GL_FALSE;
+    _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_WIDTH, &width);
+    _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_HEIGHT, &height);
+    _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_DEPTH, &depth);
+    _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_COMPRESSED, &compressed);
+
+    std::vector<char> pixels;
+
+    if (compressed) {
+        GLint imageSize = 0;
+        _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &imageSize);
+        pixels.resize(imageSize);
+        _glGetCompressedTexImage(imageTarget, level, pixels.data());
+        if (layered) {
+            _fake_glCompressedTexImage3D(imageTarget, level, internalFormat, width, height, depth, 0, imageSize, pixels.data());
+        } else {
+            _fake_glCompressedTexImage2D(imageTarget, level, internalFormat, width, height, 0, imageSize, pixels.data());
+        }
+        return;
+    }
+
+    GLenum format;
+    GLenum type;
+    getReadbackFormat(imageTarget, level, format, type);
+
+    pixels.resize(_gl_image_size(format, type, width, height, layered ? depth : 1, GL_TRUE));
+    _glGetTexImage(imageTarget, level, format, type, pixels.data());
+    if (layered) {
+        _fake_glTexImage3D(imageTarget, level, internalFormat, width, height, depth, 0, format, type, pixels.data());
+    } else {
+        _fake_glTexImage2D(imageTarget, level, internalFormat, width, height, 0, format, type, pixels.data());
+    }
+}
+
+
+static void
+recreateTextures(Context *ctx)
+{
+    static const GLenum texParams[] = {
+        GL_TEXTURE_MIN_FILTER,
+        GL_TEXTURE_MAG_FILTER,
+        GL_TEXTURE_WRAP_S,
+        GL_TEXTURE_WRAP_T,
+        GL_TEXTURE_WRAP_R,
+        GL_TEXTURE_BASE_LEVEL,
+        GL_TEXTURE_MAX_LEVEL,
+        GL_TEXTURE_COMPARE_MODE,
+        GL_TEXTURE_COMPARE_FUNC,
+    };
+
+    bool textureStorage = ctx->profile.versionGreaterOrEqual(4, 2) ||
+                          ctx->extensions.has("GL_ARB_texture_storage");
+
+    for (auto & entry : ctx->sharedRes->textures) {
+        GLuint texture = entry.first;
+        GLenum target = entry.second;
+
+        _fake_glGenTextures(1, &texture);
+        if (target == GL_NONE || !_glIsTexture(texture)) {
+            continue;
+        }
+
+        GLenum binding = getTextureBinding(target);
+        if (binding == GL_NONE) {
+            os::log("apitrace: warning: %s: unsupported texture target 0x%04X\n", __FUNCTION__, target);
+            continue;
+        }
+
+        GLint prevTexture = _glGetInteger(binding);
+        _glBindTexture(target, texture);
+        _fake_glBindTexture(target, texture);
+
+        if (textureStorage) {
+            GLint immutable = GL_FALSE;
+            _glGetTexParameteriv(target, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+            if (immutable) {
+                os::log("apitrace: warning: %s: immutable texture %u recreated as mutable\n", __FUNCTION__, texture);
+            }
+        }
+
+        bool layered = false;
+        bool readable = true;
+        switch (target) {
+        case GL_TEXTURE_3D:
+        case GL_TEXTURE_2D_ARRAY:
+        case GL_TEXTURE_CUBE_MAP_ARRAY:
+            layered = true;
+            break;
+        case GL_TEXTURE_2D_MULTISAMPLE:
+        case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+        case GL_TEXTURE_BUFFER:
+        case GL_TEXTURE_1D:
+            os::log("apitrace: warning: %s: contents of texture %u not recreated\n", __FUNCTION__, texture);
+            readable = false;
+            break;
+        }
+
+        for (GLint level = 0; readable; ++level) {
+            GLenum imageTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+            GLint width = 0;
+            _glGetTexLevelParameteriv(imageTarget, level, GL_TEXTURE_WIDTH, &width);
+            if (width == 0) {
+                break;
+            }
+
+            if (target == GL_TEXTURE_CUBE_MAP) {
+                for (GLenum face = 0; face < 6; ++face) {
+                    recreateTextureImage(target, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, false);
+                }
+            } else {
+                recreateTextureImage(target, target, level, layered);
+            }
+        }
+
+        if (readable) {
+            for (GLenum pname : texParams) {
+                if (target == GL_TEXTURE_RECTANGLE &&
+                    (pname == GL_TEXTURE_BASE_LEVEL || pname == GL_TEXTURE_MAX_LEVEL)) {
+                    continue;
+                }
+                GLint param = 0;
+                _glGetTexParameteriv(target, pname, &param);
+                _fake_glTexParameteri(target, pname, param);
+            }
+        }
+
+        _glBindTexture(target, prevTexture);
+    }
+}
+
+
+static void
+recreateRenderbuffers(Context *ctx)
+{
+    GLint prevRenderbuffer = _glGetInteger(GL_RENDERBUFFER_BINDING);
+
+    for (GLuint renderbuffer : ctx->sharedRes->renderbuffers) {
+        _fake_glGenRenderbuffers(1, &renderbuffer);
+        if (!_glIsRenderbuffer(renderbuffer)) {
+            continue;
+        }
+
+        _glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+
+        GLint internalFormat = GL_RGBA;
+        GLint width = 0;
+        GLint height = 0;
+        GLint samples = 0;
+        _glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &internalFormat);
+        _glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &width);
+        _glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &height);
+        _glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_SAMPLES, &samples);
+
+        _fake_glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        if (width && height) {
+            _fake_glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internalFormat, width, height);
+        }
+    }
+
+    _glBindRenderbuffer(GL_RENDERBUFFER, prevRenderbuffer);
+}
+
+
+static void
+recreateShader(GLuint shader)
+{
+    GLint type = GL_NONE;
+    GLint length = 0;
+    _glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+    _glGetShaderiv(shader, GL_SHADER_SOURCE_LENGTH, &length);
+
+    std::vector<GLchar> source(length + 1);
+    _glGetShaderSource(shader, length + 1, NULL, source.data());
+    const GLchar *string = source.data();
+
+    _fake_glCreateShader(type, shader);
+    _fake_glShaderSource(shader, 1, &string, NULL);
+    _fake_glCompileShader(shader);
+}
+
+
+static void
+recreateUniform(GLint location, GLenum type)
+{
+    GLenum elemType;
+    GLint numCols;
+    GLint numRows;
+    _gl_uniform_size(type, elemType, numCols, numRows);
+
+    union {
+        GLfloat f[16];
+        GLint i[16];
+        GLuint u[16];
+    } value;
+
+    GLint program = _glGetInteger(GL_CURRENT_PROGRAM);
+
+    if (numRows > 1) {
+        if (elemType != GL_FLOAT || numCols != numRows) {
+            os::log("apitrace: warning: %s: uniform type 0x%04X not recreated\n", __FUNCTION__, type);
+            return;
+        }
+        _glGetUniformfv(program, location, value.f);
+        switch (numCols) {
+        case 2:
+            _fake_glUniformMatrix2fv(location, 1, GL_FALSE, value.f);
+            break;
+        case 3:
+            _fake_glUniformMatrix3fv(location, 1, GL_FALSE, value.f);
+            break;
+        case 4:
+            _fake_glUniformMatrix4fv(location, 1, GL_FALSE, value.f);
+            break;
+        }
+        return;
+    }
+
+    switch (elemType) {
+    case GL_FLOAT:
+        _glGetUniformfv(program, location, value.f);
+        switch (numCols) {
+        case 1: _fake_glUniform1fv(location, 1, value.f); break;
+        case 2: _fake_glUniform2fv(location, 1, value.f); break;
+        case 3: _fake_glUniform3fv(location, 1, value.f); break;
+        case 4: _fake_glUniform4fv(location, 1, value.f); break;
+        }
+        break;
+    case GL_INT:
+    case GL_BOOL:
+        _glGetUniformiv(program, location, value.i);
+        switch (numCols) {
+        case 1: _fake_glUniform1iv(location, 1, value.i); break;
+        case 2: _fake_glUniform2iv(location, 1, value.i); break;
+        case 3: _fake_glUniform3iv(location, 1, value.i); break;
+        case 4: _fake_glUniform4iv(location, 1, value.i); break;
+        }
+        break;
+    case GL_UNSIGNED_INT:
+        _glGetUniformuiv(program, location, value.u);
+        switch (numCols) {
+        case 1: _fake_glUniform1uiv(location, 1, value.u); break;
+        case 2: _fake_glUniform2uiv(location, 1, value.u); break;
+        case 3: _fake_glUniform3uiv(location, 1, value.u); break;
+        case 4: _fake_glUniform4uiv(location, 1, value.u); break;
+        }
+        break;
+    default:
+        os::log("apitrace: warning: %s: uniform type 0x%04X not recreated\n", __FUNCTION__, type);
+        break;
+    }
+}
+
+
+static void
+recreateUniforms(GLuint program)
+{
+    GLint prevProgram = _glGetInteger(GL_CURRENT_PROGRAM);
+    _glUseProgram(program);
+    _fake_glUseProgram(program);
+
+    GLint activeUniforms = 0;
+    GLint maxLength = 0;
+    _glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &activeUniforms);
+    _glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> name(maxLength + 1);
+    for (GLint index = 0; index < activeUniforms; ++index) {
+        GLint size = 0;
+        GLenum type = GL_NONE;
+        _glGetActiveUniform(program, index, maxLength + 1, NULL, &size, &type, name.data());
+        if (strncmp(name.data(), "gl_", 3) == 0) {
+            continue;
+        }
+
+        std::string baseName(name.data());
+        size_t bracket = baseName.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == baseName.size()) {
+            baseName.resize(bracket);
+        }
+
+        for (GLint element = 0; element < size; ++element) {
+            std::string elementName = size > 1
+                ? baseName + "[" + std::to_string(element) + "]"
+                : std::string(name.data());
+
+            // Members of uniform blocks have no location
+            GLint location = _glGetUniformLocation(program, elementName.c_str());
+            if (location < 0) {
+                continue;
+            }
+
+            _fake_glGetUniformLocation(program, elementName.c_str(), location);
+            recreateUniform(location, type);
+        }
+    }
+
+    GLint activeBlocks = 0;
+    _glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &activeBlocks);
+    for (GLint index = 0; index < activeBlocks; ++index) {
+        GLint binding = 0;
+        _glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_BINDING, &binding);
+        _fake_glUniformBlockBinding(program, index, binding);
+    }
+
+    _glUseProgram(prevProgram);
+}
+
+
+static void
+recreatePrograms(Context *ctx)
+{
+    std::set<GLuint> recreatedShaders;
+
+    for (GLuint program : ctx->sharedRes->programs) {
+        if (!_glIsProgram(program)) {
+            continue;
+        }
+
+        GLint attachedShaders = 0;
+        _glGetProgramiv(program, GL_ATTACHED_SHADERS, &attachedShaders);
+        std::vector<GLuint> shaders(attachedShaders);
+        if (attachedShaders) {
+            _glGetAttachedShaders(program, attachedShaders, NULL, shaders.data());
+        } else {
+            os::log("apitrace: warning: %s: program %u has no shaders attached\n", __FUNCTION__, program);
+        }
+
+        for (GLuint shader : shaders) {
+            if (recreatedShaders.insert(shader).second) {
+                recreateShader(shader);
+            }
+        }
+
+        _fake_glCreateProgram(program);
+        for (GLuint shader : shaders) {
+            _fake_glAttachShader(program, shader);
+        }
+
+        // Same as what is done when glLinkProgram is traced
+        GLint activeAttributes = 0;
+        _glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &activeAttributes);
+        for (GLint attrib = 0; attrib < activeAttributes; ++attrib) {
+            GLint size = 0;
+            GLenum type = 0;
+            GLchar name[256];
+            _glGetActiveAttrib(program, attrib, sizeof name, NULL, &size, &type, name);
+            if (name[0] != 'g' || name[1] != 'l' || name[2] != '_') {
+                GLint location = _glGetAttribLocation(program, name);
+                if (location >= 0) {
+                    _fake_glBindAttribLocation(program, location, name);
+                }
+            }
+        }
+
+        GLint linked = GL_FALSE;
+        _glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        _fake_glLinkProgram(program);
+        if (linked) {
+            recreateUniforms(program);
+        }
+    }
+
+    // Shaders not attached to any program yet
+    for (GLuint shader : ctx->sharedRes->shaders) {
+        if (_glIsShader(shader) &&
+            recreatedShaders.insert(shader).second) {
+            recreateShader(shader);
+        }
+    }
+}
+
+
+static void
+recreateFramebuffers(Context *ctx)
+{
+    GLint maxColorAttachments = _glGetInteger(GL_MAX_COLOR_ATTACHMENTS);
+    GLint maxDrawBuffers = _glGetInteger(GL_MAX_DRAW_BUFFERS);
+
+    std::vector<GLenum> attachments;
+    for (GLint i = 0; i < maxColorAttachments; ++i) {
+        attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+    attachments.push_back(GL_DEPTH_ATTACHMENT);
+    attachments.push_back(GL_STENCIL_ATTACHMENT);
+
+    GLint prevFramebuffer = _glGetInteger(GL_DRAW_FRAMEBUFFER_BINDING);
+
+    for (GLuint framebuffer : ctx->framebuffers) {
+        _fake_glGenFramebuffers(1, &framebuffer);
+        if (!_glIsFramebuffer(framebuffer)) {
+            continue;
+        }
+
+        _glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        _fake_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        for (GLenum attachment : attachments) {
+            GLint type = GL_NONE;
+            GLint name = 0;
+            _glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                                   GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+            if (type == GL_NONE) {
+                continue;
+            }
+            _glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                                   GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &name);
+
+            if (type == GL_RENDERBUFFER) {
+                _fake_glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, name);
+            } else if (type == GL_TEXTURE) {
+                GLint level = 0;
+                GLint face = 0;
+                GLint layer = 0;
+                _glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                                       GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL, &level);
+                _glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                                       GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_CUBE_MAP_FACE, &face);
+                _glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                                       GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LAYER, &layer);
+
+                GLenum target = GL_TEXTURE_2D;
+                auto it = ctx->sharedRes->textures.find(name);
+                if (it != ctx->sharedRes->textures.end() && it->second != GL_NONE) {
+                    target = it->second;
+                }
+
+                switch (target) {
+                case GL_TEXTURE_3D:
+                case GL_TEXTURE_1D_ARRAY:
+                case GL_TEXTURE_2D_ARRAY:
+                case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+                case GL_TEXTURE_CUBE_MAP_ARRAY:
+                    _fake_glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, name, level, layer);
+                    break;
+                default:
+                    _fake_glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, face ? face : target, name, level);
+                    break;
+                }
+            }
+        }
+
+        std::vector<GLenum> drawBuffers(maxDrawBuffers);
+        for (GLint i = 0; i < maxDrawBuffers; ++i) {
+            drawBuffers[i] = _glGetInteger(GL_DRAW_BUFFER0 + i);
+        }
+        _fake_glDrawBuffers(maxDrawBuffers, drawBuffers.data());
+
+        GLint prevReadFramebuffer = _glGetInteger(GL_READ_FRAMEBUFFER_BINDING);
+        _glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        _fake_glReadBuffer(_glGetInteger(GL_READ_BUFFER));
+        _glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFramebuffer);
+    }
+
+    _glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFramebuffer);
+}
+
+
+static void
+recreateVertexArrays(Context *ctx)
+{
+    GLint maxAttribs = _glGetInteger(GL_MAX_VERTEX_ATTRIBS);
+    GLint prevVertexArray = _glGetInteger(GL_VERTEX_ARRAY_BINDING);
+    GLint prevArrayBuffer = _glGetInteger(GL_ARRAY_BUFFER_BINDING);
+
+    // The default vertex array only exists in compatibility profiles
+    std::vector<GLuint> vertexArrays;
+    if (!ctx->profile.core) {
+        vertexArrays.push_back(0);
+    }
+    vertexArrays.insert(vertexArrays.end(), ctx->vertexArrays.begin(), ctx->vertexArrays.end());
+
+    for (GLuint vertexArray : vertexArrays) {
+        if (vertexArray) {
+            _fake_glGenVertexArrays(1, &vertexArray);
+            if (!_glIsVertexArray(vertexArray)) {
+                continue;
+            }
+        }
+
+        _glBindVertexArray(vertexArray);
+        _fake_glBindVertexArray(vertexArray);
+
+        for (GLint index = 0; index < maxAttribs; ++index) {
+            GLint buffer = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING);
+            // Attributes sourced from user memory are emitted at draw time
+            if (buffer) {
+                GLint size = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_SIZE);
+                GLint type = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_TYPE);
+                GLint normalized = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED);
+                GLint integer = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_INTEGER);
+                GLint stride = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_STRIDE);
+                GLvoid *pointer = NULL;
+                _glGetVertexAttribPointerv(index, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+
+                _fake_glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                if (integer) {
+                    _fake_glVertexAttribIPointer(index, size, type, stride, pointer);
+                } else {
+                    _fake_glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+                }
+            }
+
+            GLint divisor = _glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_DIVISOR);
+            if (divisor) {
+                _fake_glVertexAttribDivisor(index, divisor);
+            }
+
+            if (_glGetVertexAttribi(index, GL_VERTEX_ATTRIB_ARRAY_ENABLED)) {
+                _fake_glEnableVertexAttribArray(index);
+            }
+        }
+
+        GLint elementBuffer = _glGetInteger(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+        if (elementBuffer) {
+            _fake_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+        }
+    }
+
+    _glBindVertexArray(prevVertexArray);
+    _fake_glBindVertexArray(prevVertexArray);
+    _fake_glBindBuffer(GL_ARRAY_BUFFER, prevArrayBuffer);
+}
+
+
+static void
+recreateBindings(Context *ctx)
+{
+    static const GLenum bufferTargets[][2] = {
+        { GL_COPY_READ_BUFFER, GL_COPY_READ_BUFFER_BINDING },
+        { GL_COPY_WRITE_BUFFER, GL_COPY_WRITE_BUFFER_BINDING },
+        { GL_PIXEL_PACK_BUFFER, GL_PIXEL_PACK_BUFFER_BINDING },
+        { GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING },
+        { GL_TEXTURE_BUFFER, GL_TEXTURE_BINDING_BUFFER },
+        { GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING },
+    };
+    for (auto & target : bufferTargets) {
+        GLint buffer = _glGetInteger(target[1]);
+        if (buffer) {
+            _fake_glBindBuffer(target[0], buffer);
+        }
+    }
+
+    GLint maxUniformBuffers = _glGetInteger(GL_MAX_UNIFORM_BUFFER_BINDINGS);
+    for (GLint index = 0; index < maxUniformBuffers; ++index) {
+        GLint buffer = 0;
+        _glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, index, &buffer);
+        if (!buffer) {
+            continue;
+        }
+        GLint64 start = 0;
+        GLint64 size = 0;
+        _glGetInteger64i_v(GL_UNIFORM_BUFFER_START, index, &start);
+        _glGetInteger64i_v(GL_UNIFORM_BUFFER_SIZE, index, &size);
+        if (size) {
+            _fake_glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, start, size);
+        } else {
+            _fake_glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+        }
+    }
+
+    static const GLenum textureTargets[] = {
+        GL_TEXTURE_1D,
+        GL_TEXTURE_1D_ARRAY,
+        GL_TEXTURE_2D,
+        GL_TEXTURE_2D_ARRAY,
+        GL_TEXTURE_2D_MULTISAMPLE,
+        GL_TEXTURE_3D,
+        GL_TEXTURE_RECTANGLE,
+        GL_TEXTURE_CUBE_MAP,
+        GL_TEXTURE_BUFFER,
+    };
+    GLint activeTexture = _glGetInteger(GL_ACTIVE_TEXTURE);
+    GLint maxTextureUnits = _glGetInteger(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS);
+    for (GLint unit = 0; unit < maxTextureUnits; ++unit) {
+        _glActiveTexture(GL_TEXTURE0 + unit);
+        bool activated = false;
+        for (GLenum target : textureTargets) {
+            GLint texture = _glGetInteger(getTextureBinding(target));
+            if (texture) {
+                if (!activated) {
+                    _fake_glActiveTexture(GL_TEXTURE0 + unit);
+                    activated = true;
+                }
+                _fake_glBindTexture(target, texture);
+            }
+        }
+    }
+    _glActiveTexture(activeTexture);
+    _fake_glActiveTexture(activeTexture);
+
+    _fake_glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _glGetInteger(GL_DRAW_FRAMEBUFFER_BINDING));
+    _fake_glBindFramebuffer(GL_READ_FRAMEBUFFER, _glGetInteger(GL_READ_FRAMEBUFFER_BINDING));
+    _fake_glBindRenderbuffer(GL_RENDERBUFFER, _glGetInteger(GL_RENDERBUFFER_BINDING));
+    _fake_glUseProgram(_glGetInteger(GL_CURRENT_PROGRAM));
+}
+
+
+static void
+recreateFixedState(void)
+{
+    static const GLenum caps[] = {
+        GL_BLEND,
+        GL_CULL_FACE,
+        GL_DEPTH_CLAMP,
+        GL_DEPTH_TEST,
+        GL_DITHER,
+        GL_FRAMEBUFFER_SRGB,
+        GL_MULTISAMPLE,
+        GL_POLYGON_OFFSET_FILL,
+        GL_PRIMITIVE_RESTART,
+        GL_PROGRAM_POINT_SIZE,
+        GL_RASTERIZER_DISCARD,
+        GL_SAMPLE_ALPHA_TO_COVERAGE,
+        GL_SCISSOR_TEST,
+        GL_STENCIL_TEST,
+        GL_TEXTURE_CUBE_MAP_SEAMLESS,
+    };
+    for (GLenum cap : caps) {
+        if (_glIsEnabled(cap)) {
+            _fake_glEnable(cap);
+        } else {
+            _fake_glDisable(cap);
+        }
+    }
+
+    _fake_glBlendFuncSeparate(_glGetInteger(GL_BLEND_SRC_RGB),
+                              _glGetInteger(GL_BLEND_DST_RGB),
+                              _glGetInteger(GL_BLEND_SRC_ALPHA),
+                              _glGetInteger(GL_BLEND_DST_ALPHA));
+    _fake_glBlendEquationSeparate(_glGetInteger(GL_BLEND_EQUATION_RGB),
+                                  _glGetInteger(GL_BLEND_EQUATION_ALPHA));
+
+    _fake_glDepthFunc(_glGetInteger(GL_DEPTH_FUNC));
+    _fake_glDepthMask(_glGetInteger(GL_DEPTH_WRITEMASK));
+
+    GLboolean colorMask[4] = {GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE};
+    _glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+    _fake_glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+
+    _fake_glCullFace(_glGetInteger(GL_CULL_FACE_MODE));
+    _fake_glFrontFace(_glGetInteger(GL_FRONT_FACE));
+
+    GLfloat polygonOffset[2] = {0.0f, 0.0f};
+    _glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &polygonOffset[0]);
+    _glGetFloatv(GL_POLYGON_OFFSET_UNITS, &polygonOffset[1]);
+    _fake_glPolygonOffset(polygonOffset[0], polygonOffset[1]);
+
+    GLfloat clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    GLdouble clearDepth = 1.0;
+    _glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    _glGetDoublev(GL_DEPTH_CLEAR_VALUE, &clearDepth);
+    _fake_glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    _fake_glClearDepth(clearDepth);
+    _fake_glClearStencil(_glGetInteger(GL_STENCIL_CLEAR_VALUE));
+
+    _fake_glStencilFuncSeparate(GL_FRONT,
+                                _glGetInteger(GL_STENCIL_FUNC),
+                                _glGetInteger(GL_STENCIL_REF),
+                                _glGetInteger(GL_STENCIL_VALUE_MASK));
+    _fake_glStencilOpSeparate(GL_FRONT,
+                              _glGetInteger(GL_STENCIL_FAIL),
+                              _glGetInteger(GL_STENCIL_PASS_DEPTH_FAIL),
+                              _glGetInteger(GL_STENCIL_PASS_DEPTH_PASS));
+    _fake_glStencilMaskSeparate(GL_FRONT, _glGetInteger(GL_STENCIL_WRITEMASK));
+    _fake_glStencilFuncSeparate(GL_BACK,
+                                _glGetInteger(GL_STENCIL_BACK_FUNC),
+                                _glGetInteger(GL_STENCIL_BACK_REF),
+                                _glGetInteger(GL_STENCIL_BACK_VALUE_MASK));
+    _fake_glStencilOpSeparate(GL_BACK,
+                              _glGetInteger(GL_STENCIL_BACK_FAIL),
+                              _glGetInteger(GL_STENCIL_BACK_PASS_DEPTH_FAIL),
+                              _glGetInteger(GL_STENCIL_BACK_PASS_DEPTH_PASS));
+    _fake_glStencilMaskSeparate(GL_BACK, _glGetInteger(GL_STENCIL_BACK_WRITEMASK));
+
+    GLint viewport[4] = {0, 0, 0, 0};
+    GLint scissor[4] = {0, 0, 0, 0};
+    _glGetIntegerv(GL_VIEWPORT, viewport);
+    _glGetIntegerv(GL_SCISSOR_BOX, scissor);
+    _fake_glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    _fake_glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+}
+
+
+void
+recreateState(void)
+{
+    Context *ctx = getContext();
+
+    if (!ctx->bound) {
+        os::log("apitrace: warning: %s: no current context, state not recreated\n", __FUNCTION__);
+        return;
+    }
+
+    if (!ctx->profile.versionGreaterOrEqual(glfeatures::API_GL, 3, 2)) {
+        std::string version = ctx->profile.str();
+        os::log("apitrace: warning: %s: %s context not supported, state not recreated\n", __FUNCTION__, version.c_str());
+        return;
+    }
+
+    if (!ctx->profile.core) {
+        os::log("apitrace: warning: %s: fixed function state not recreated\n", __FUNCTION__);
+    }
+
+    std::lock_guard<std::mutex> lock(objectsMutex);
+
+    // Read and record images tightly packed, from and to client memory
+    GLint pixelStore[NUM_PIXEL_STORE_PARAMS];
+    for (size_t i = 0; i < NUM_PIXEL_STORE_PARAMS; ++i) {
+        GLenum pname = pixelStoreParams[i];
+        _glGetIntegerv(pname, &pixelStore[i]);
+        _glPixelStorei(pname, defaultPixelStoreValue(pname));
+        _fake_glPixelStorei(pname, defaultPixelStoreValue(pname));
+    }
+    GLint packBuffer = _glGetInteger(GL_PIXEL_PACK_BUFFER_BINDING);
+    GLint unpackBuffer = _glGetInteger(GL_PIXEL_UNPACK_BUFFER_BINDING);
+    _glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    _glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    recreateBuffers(ctx);
+    recreateTextures(ctx);
+    recreateRenderbuffers(ctx);
+    recreatePrograms(ctx);
+    recreateFramebuffers(ctx);
+    recreateVertexArrays(ctx);
+
+    _glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+    _glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+    for (size_t i = 0; i < NUM_PIXEL_STORE_PARAMS; ++i) {
+        _glPixelStorei(pixelStoreParams[i], pixelStore[i]);
+        _fake_glPixelStorei(pixelStoreParams[i], pixelStore[i]);
+    }
+
+    recreateBindings(ctx);
+    recreateFixedState();
+
+    // The default viewport has been emitted above
+    ctx->boundDrawable = true;
+}
+
+
+} /* namespace gltrace */
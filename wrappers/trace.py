@@ -465,8 +465,8 @@ def getInterfaceHierarchy(allIfaces, baseIface):
 class Tracer:
     '''Base class to orchestrate the code generation of API tracing.'''
 
-    # 0-3 are reserved to memcpy, malloc, free, and realloc
-    __id = 4
+    # 0-4 are reserved to memcpy, malloc, free, realloc, and apitrace_stats
+    __id = 5
 
     def __init__(self):
         self.api = None
@@ -579,9 +579,16 @@ class Tracer:
         print('}')
         print()
 
+    def isFunctionAlwaysRecorded(self, function):
+        # Whether the function must be recorded even while capture is deferred
+        return False
+
     def traceFunctionImplBody(self, function):
         if not function.internal:
-            print('    unsigned _call = trace::localWriter.beginEnter(&_%s_sig);' % (function.name,))
+            if self.isFunctionAlwaysRecorded(function):
+                print('    unsigned _call = trace::localWriter.beginEnter(&_%s_sig, false, true);' % (function.name,))
+            else:
+                print('    unsigned _call = trace::localWriter.beginEnter(&_%s_sig);' % (function.name,))
             for arg in function.args:
                 if not arg.output:
                     self.serializeArg(function, arg)
@@ -621,9 +628,12 @@ class Tracer:
         return 'true'
 
     def serializeArg(self, function, arg):
+        # Skip the serialization of calls which are not recorded
+        print('    if (!trace::localWriter.isDiscarding()) {')
         print('    trace::localWriter.beginArg(%u);' % (arg.index,))
         self.serializeArgValue(function, arg)
         print('    trace::localWriter.endArg();')
+        print('    }')
 
     def serializeArgValue(self, function, arg):
         self.serializeValue(arg.type, arg.name)
@@ -649,9 +659,11 @@ class Tracer:
         self.unwrapValue(arg.type, arg.name)
 
     def serializeRet(self, function, instance):
+        print('    if (!trace::localWriter.isDiscarding()) {')
         print('    trace::localWriter.beginReturn();')
         self.serializeValue(function.type, instance)
         print('    trace::localWriter.endReturn();')
+        print('    }')
 
     def serializeValue(self, type, instance):
         serializer = self.serializerFactory()
@@ -998,16 +1010,28 @@ class Tracer:
     def emit_memcpy(self, ptr, size):
         print('    trace::fakeMemcpy(%s, %s);' % (ptr, size))
     
+    def serializeFakeArgValue(self, function, arg, instance):
+        self.serializeValue(arg.type, instance)
+
     def fake_call(self, function, args):
         print('        {')
         print('            unsigned _fake_call = trace::localWriter.beginEnter(&_%s_sig, true);' % (function.name,))
         for arg, instance in zip(function.args, args):
-            assert not arg.output
-            print('            trace::localWriter.beginArg(%u);' % (arg.index,))
-            self.serializeValue(arg.type, instance)
-            print('            trace::localWriter.endArg();')
+            if not arg.output:
+                print('            trace::localWriter.beginArg(%u);' % (arg.index,))
+                self.serializeFakeArgValue(function, arg, instance)
+                print('            trace::localWriter.endArg();')
         print('            trace::localWriter.endEnter();')
         print('            trace::localWriter.beginLeave(_fake_call);')
+        for arg, instance in zip(function.args, args):
+            if arg.output:
+                print('            trace::localWriter.beginArg(%u);' % (arg.index,))
+                self.serializeFakeArgValue(function, arg, instance)
+                print('            trace::localWriter.endArg();')
+        if function.type is not stdapi.Void:
+            print('            trace::localWriter.beginReturn();')
+            self.serializeValue(function.type, '_result')
+            print('            trace::localWriter.endReturn();')
         print('            trace::localWriter.endLeave();')
         print('        }')
        